@@ -0,0 +1,423 @@
+/*
+ * Copyright(C) 2021 Dennis Fleurbaaij <mail@dennisfleurbaaij.com>
+ *
+ * This program is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, version 3.
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License along with this program. If not, see < https://www.gnu.org/licenses/>.
+ */
+
+#include "pch.h"
+
+#include <intrin.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <functional>
+#include <map>
+#include <memory>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <SimdLevel.h>
+#include <video_frame_formatter/CFFMpegDecoderVideoFrameFormatter.h>
+#include <video_frame_formatter/CNoopVideoFrameFormatter.h>
+#include <video_frame_formatter/CRGBtoRGB48VideoFrameFormatter.h>
+#include <video_frame_formatter/CSlicedVideoFrameFormatter.h>
+#include <video_frame_formatter/CV210toP010VideoFrameFormatter.h>
+#include <video_frame_formatter/CV210toP210VideoFrameFormatter.h>
+
+
+/**
+ * Formatter micro-benchmark
+ *
+ * Runs every formatter over synthetic frames at a range of resolutions and reports the
+ * median time per frame, the memory throughput (input + output bytes) and pixels per TSC
+ * cycle. Results can be written as JSON and compared against an earlier JSON run to flag
+ * regressions, in which case the exit code is 2.
+ *
+ * Usage: VideoProcessor-Benchmark [--frames N] [--filter TEXT] [--json OUT] [--baseline IN] [--tolerance PERCENT]
+ */
+
+
+// Input frames are rotated to keep the working set out of the caches like a live capture would
+static const unsigned int INPUT_FRAME_COUNT = 4;
+static const unsigned int WARMUP_FRAME_COUNT = 3;
+static const unsigned int DEFAULT_FRAME_COUNT = 50;
+static const double DEFAULT_TOLERANCE_PERCENT = 5.0;
+
+
+struct Resolution
+{
+	const char* name;
+	unsigned int width;
+	unsigned int height;
+};
+
+
+static const Resolution RESOLUTIONS[] =
+{
+	{ "720p", 1280, 720 },
+	{ "1080p", 1920, 1080 },
+	{ "2160p", 3840, 2160 },
+	{ "4320p", 7680, 4320 }
+};
+
+
+struct BenchmarkCase
+{
+	std::string name;
+	VideoFrameEncoding inputEncoding;
+	std::function<IVideoFrameFormatter*()> create;
+};
+
+
+struct BenchmarkResult
+{
+	std::string name;
+	std::string resolution;
+	unsigned int width = 0;
+	unsigned int height = 0;
+
+	// Non-empty if the formatter could not run this case
+	std::string skipReason;
+
+	double nsPerFrame = 0;  // Median
+	double nsPerFrameMin = 0;
+	double gbPerSecond = 0;
+	double pixelsPerCycle = 0;
+};
+
+
+static std::string Narrow(const TCHAR* str)
+{
+	return std::string(CStringA(str));
+}
+
+
+static std::vector<BenchmarkCase> BuildCases()
+{
+	std::vector<BenchmarkCase> cases;
+
+	cases.push_back({ "Noop", VideoFrameEncoding::V210, []() { return new CNoopVideoFrameFormatter(); } });
+
+	for (SimdLevel simdLevel : { SimdLevel::SCALAR, SimdLevel::SSSE3, SimdLevel::AVX2, SimdLevel::AVX512 })
+	{
+		if (simdLevel > CpuSimdLevel())
+			break;
+
+		const std::string level = "/" + Narrow(ToString(simdLevel));
+
+		cases.push_back({ "V210toP210" + level, VideoFrameEncoding::V210,
+			[simdLevel]() { return new CV210toP210VideoFrameFormatter(simdLevel); } });
+
+		for (ChromaSiting chromaSiting : { ChromaSiting::LEFT, ChromaSiting::TOP_LEFT })
+			cases.push_back({ "V210toP010(" + Narrow(ToString(chromaSiting)) + ")" + level, VideoFrameEncoding::V210,
+				[simdLevel, chromaSiting]() { return new CV210toP010VideoFrameFormatter(chromaSiting, simdLevel); } });
+
+		for (VideoFrameEncoding videoFrameEncoding : { VideoFrameEncoding::R210, VideoFrameEncoding::R12B })
+			cases.push_back({ "RGBtoRGB48(" + Narrow(ToString(videoFrameEncoding)) + ")" + level, videoFrameEncoding,
+				[simdLevel]() { return new CRGBtoRGB48VideoFrameFormatter(simdLevel); } });
+	}
+
+	cases.push_back({ "FFMpegDecoder(R210)", VideoFrameEncoding::R210,
+		[]() { return new CFFMpegDecoderVideoFrameFormatter(AV_CODEC_ID_R210, AV_PIX_FMT_RGB48LE); } });
+	cases.push_back({ "FFMpegDecoder(R12B)", VideoFrameEncoding::R12B,
+		[]() { return new CFFMpegDecoderVideoFrameFormatter(AV_CODEC_ID_R12B, AV_PIX_FMT_RGB48LE); } });
+
+	const unsigned int sliceCount = std::min(
+		std::max(std::thread::hardware_concurrency(), 1u),
+		CSlicedVideoFrameFormatter::MAX_SLICE_COUNT);
+	const std::string slices = "/" + std::to_string(sliceCount) + "-slices";
+
+	cases.push_back({ "Sliced(Noop)" + slices, VideoFrameEncoding::V210,
+		[sliceCount]() { return new CSlicedVideoFrameFormatter(new CNoopVideoFrameFormatter(), sliceCount); } });
+	cases.push_back({ "Sliced(V210toP010(Top left))" + slices, VideoFrameEncoding::V210,
+		[sliceCount]() { return new CSlicedVideoFrameFormatter(new CV210toP010VideoFrameFormatter(ChromaSiting::TOP_LEFT), sliceCount); } });
+	cases.push_back({ "Sliced(RGBtoRGB48(R12B))" + slices, VideoFrameEncoding::R12B,
+		[sliceCount]() { return new CSlicedVideoFrameFormatter(new CRGBtoRGB48VideoFrameFormatter(), sliceCount); } });
+
+	return cases;
+}
+
+
+static BenchmarkResult RunCase(const BenchmarkCase& benchmarkCase, const Resolution& resolution, unsigned int frameCount)
+{
+	BenchmarkResult result;
+	result.name = benchmarkCase.name;
+	result.resolution = resolution.name;
+	result.width = resolution.width;
+	result.height = resolution.height;
+
+	VideoStateComPtr videoState = new VideoState();
+	videoState->valid = true;
+	videoState->displayMode = std::make_shared<DisplayMode>(resolution.width, resolution.height, false /* interlaced */, 60000, 1000);
+	videoState->videoFrameEncoding = benchmarkCase.inputEncoding;
+
+	std::unique_ptr<IVideoFrameFormatter> formatter;
+	try
+	{
+		formatter.reset(benchmarkCase.create());
+		formatter->OnVideoState(videoState);
+	}
+	catch (std::runtime_error& e)
+	{
+		// Not every formatter handles every resolution (V210 needs 6 pixel aligned widths for example)
+		result.skipReason = e.what();
+		return result;
+	}
+
+	const size_t inFrameSize = videoState->BytesPerFrame();
+	const size_t outFrameSize = formatter->GetOutFrameSize();
+
+	// Random data is valid input for all encodings here, every bit pattern decodes to something
+	std::mt19937 rng(1234);
+	std::vector<std::vector<uint32_t>> inData(INPUT_FRAME_COUNT);
+	for (std::vector<uint32_t>& data : inData)
+	{
+		data.resize((inFrameSize + sizeof(uint32_t) - 1) / sizeof(uint32_t));
+		for (uint32_t& v : data)
+			v = rng();
+	}
+
+	std::vector<BYTE> outData(outFrameSize);
+
+	std::vector<double> nsPerFrame;
+	std::vector<double> cyclesPerFrame;
+	nsPerFrame.reserve(frameCount);
+	cyclesPerFrame.reserve(frameCount);
+
+	for (unsigned int i = 0; i < WARMUP_FRAME_COUNT + frameCount; ++i)
+	{
+		const VideoFrame videoFrame(inData[i % INPUT_FRAME_COUNT].data(), i, 0, nullptr);
+
+		const auto start = std::chrono::steady_clock::now();
+		const uint64_t startCycles = __rdtsc();
+
+		const bool formatted = formatter->FormatVideoFrame(videoFrame, outData.data());
+
+		const uint64_t endCycles = __rdtsc();
+		const auto end = std::chrono::steady_clock::now();
+
+		// Decoders with frame latency do not produce output for the first frames
+		if (i < WARMUP_FRAME_COUNT || !formatted)
+			continue;
+
+		nsPerFrame.push_back((double)std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count());
+		cyclesPerFrame.push_back((double)(endCycles - startCycles));
+	}
+
+	if (nsPerFrame.empty())
+	{
+		result.skipReason = "Formatter did not produce any frames";
+		return result;
+	}
+
+	std::sort(nsPerFrame.begin(), nsPerFrame.end());
+	std::sort(cyclesPerFrame.begin(), cyclesPerFrame.end());
+
+	result.nsPerFrame = nsPerFrame[nsPerFrame.size() / 2];
+	result.nsPerFrameMin = nsPerFrame.front();
+	result.gbPerSecond = (double)(inFrameSize + outFrameSize) / result.nsPerFrame;  // bytes/ns == GB/s
+	result.pixelsPerCycle = (double)resolution.width * resolution.height / cyclesPerFrame[cyclesPerFrame.size() / 2];
+
+	return result;
+}
+
+
+static std::string JsonEscape(const std::string& str)
+{
+	std::string escaped;
+	for (const char c : str)
+	{
+		if (c == '"' || c == '\\')
+			escaped += '\\';
+		escaped += c;
+	}
+	return escaped;
+}
+
+
+static std::string ResultKey(const std::string& name, const std::string& resolution)
+{
+	return name + "@" + resolution;
+}
+
+
+// Results are written one per line, which keeps reading back a baseline a simple line scan
+static void WriteJson(const char* path, const std::vector<BenchmarkResult>& results, unsigned int frameCount)
+{
+	FILE* file = nullptr;
+	if (fopen_s(&file, path, "w") != 0 || !file)
+		throw std::runtime_error("Failed to open JSON output file");
+
+	fprintf(file, "{\n");
+	fprintf(file, "  \"cpu_simd_level\": \"%s\",\n", Narrow(ToString(CpuSimdLevel())).c_str());
+	fprintf(file, "  \"frames\": %u,\n", frameCount);
+	fprintf(file, "  \"results\": [\n");
+
+	for (size_t i = 0; i < results.size(); ++i)
+	{
+		const BenchmarkResult& r = results[i];
+		const char* separator = (i + 1 < results.size()) ? "," : "";
+
+		if (!r.skipReason.empty())
+			fprintf(file,
+				"    {\"name\": \"%s\", \"resolution\": \"%s\", \"width\": %u, \"height\": %u, \"skipped\": \"%s\"}%s\n",
+				JsonEscape(r.name).c_str(), r.resolution.c_str(), r.width, r.height, JsonEscape(r.skipReason).c_str(), separator);
+		else
+			fprintf(file,
+				"    {\"name\": \"%s\", \"resolution\": \"%s\", \"width\": %u, \"height\": %u, \"ns_per_frame\": %.0f, \"ns_per_frame_min\": %.0f, \"gb_per_s\": %.3f, \"pixels_per_cycle\": %.4f}%s\n",
+				JsonEscape(r.name).c_str(), r.resolution.c_str(), r.width, r.height, r.nsPerFrame, r.nsPerFrameMin, r.gbPerSecond, r.pixelsPerCycle, separator);
+	}
+
+	fprintf(file, "  ]\n");
+	fprintf(file, "}\n");
+
+	fclose(file);
+}
+
+
+static bool ReadJsonString(const std::string& line, const std::string& key, std::string& value)
+{
+	const std::string prefix = "\"" + key + "\": \"";
+	const size_t start = line.find(prefix);
+	if (start == std::string::npos)
+		return false;
+
+	const size_t end = line.find('"', start + prefix.size());
+	if (end == std::string::npos)
+		return false;
+
+	value = line.substr(start + prefix.size(), end - start - prefix.size());
+	return true;
+}
+
+
+// Read the median time per frame of every non-skipped result in a file written by WriteJson()
+static std::map<std::string, double> ReadBaseline(const char* path)
+{
+	std::ifstream file(path);
+	if (!file)
+		throw std::runtime_error("Failed to open baseline file");
+
+	std::map<std::string, double> baseline;
+
+	std::string line;
+	while (std::getline(file, line))
+	{
+		std::string name, resolution;
+		if (!ReadJsonString(line, "name", name) || !ReadJsonString(line, "resolution", resolution))
+			continue;
+
+		const std::string nsKey = "\"ns_per_frame\": ";
+		const size_t nsStart = line.find(nsKey);
+		if (nsStart == std::string::npos)
+			continue;
+
+		baseline[ResultKey(name, resolution)] = atof(line.c_str() + nsStart + nsKey.size());
+	}
+
+	return baseline;
+}
+
+
+int main(int argc, char* argv[])
+{
+	unsigned int frameCount = DEFAULT_FRAME_COUNT;
+	double tolerancePercent = DEFAULT_TOLERANCE_PERCENT;
+	const char* filter = nullptr;
+	const char* jsonPath = nullptr;
+	const char* baselinePath = nullptr;
+
+	for (int i = 1; i < argc; ++i)
+	{
+		const std::string arg = argv[i];
+		const bool hasValue = (i + 1 < argc);
+
+		if (arg == "--frames" && hasValue)
+			frameCount = std::max(atoi(argv[++i]), 1);
+		else if (arg == "--filter" && hasValue)
+			filter = argv[++i];
+		else if (arg == "--json" && hasValue)
+			jsonPath = argv[++i];
+		else if (arg == "--baseline" && hasValue)
+			baselinePath = argv[++i];
+		else if (arg == "--tolerance" && hasValue)
+			tolerancePercent = atof(argv[++i]);
+		else
+		{
+			fprintf(stderr, "Usage: %s [--frames N] [--filter TEXT] [--json OUT] [--baseline IN] [--tolerance PERCENT]\n", argv[0]);
+			return 1;
+		}
+	}
+
+	try
+	{
+		std::map<std::string, double> baseline;
+		if (baselinePath)
+			baseline = ReadBaseline(baselinePath);
+
+		printf("CPU SIMD level: %s, %u frames per case\n\n", Narrow(ToString(CpuSimdLevel())).c_str(), frameCount);
+		printf("%-40s %-6s %14s %14s %9s %9s %s\n", "Formatter", "Res", "ns/frame", "min ns/frame", "GB/s", "px/cycle", "vs baseline");
+
+		std::vector<BenchmarkResult> results;
+		unsigned int regressionCount = 0;
+
+		for (const BenchmarkCase& benchmarkCase : BuildCases())
+		{
+			if (filter && benchmarkCase.name.find(filter) == std::string::npos)
+				continue;
+
+			for (const Resolution& resolution : RESOLUTIONS)
+			{
+				const BenchmarkResult result = RunCase(benchmarkCase, resolution, frameCount);
+				results.push_back(result);
+
+				if (!result.skipReason.empty())
+				{
+					printf("%-40s %-6s skipped: %s\n", result.name.c_str(), result.resolution.c_str(), result.skipReason.c_str());
+					continue;
+				}
+
+				std::string comparison;
+				const auto it = baseline.find(ResultKey(result.name, result.resolution));
+				if (it != baseline.end() && it->second > 0)
+				{
+					const double changePercent = (result.nsPerFrame / it->second - 1.0) * 100.0;
+					const bool regressed = changePercent > tolerancePercent;
+					if (regressed)
+						++regressionCount;
+
+					char buffer[64];
+					snprintf(buffer, sizeof(buffer), "%+.1f%%%s", changePercent, regressed ? " REGRESSION" : "");
+					comparison = buffer;
+				}
+
+				printf("%-40s %-6s %14.0f %14.0f %9.2f %9.3f %s\n",
+					result.name.c_str(), result.resolution.c_str(),
+					result.nsPerFrame, result.nsPerFrameMin, result.gbPerSecond, result.pixelsPerCycle,
+					comparison.c_str());
+			}
+		}
+
+		if (jsonPath)
+			WriteJson(jsonPath, results, frameCount);
+
+		if (regressionCount > 0)
+		{
+			printf("\n%u case(s) regressed more than %.1f%% against the baseline\n", regressionCount, tolerancePercent);
+			return 2;
+		}
+	}
+	catch (std::runtime_error& e)
+	{
+		fprintf(stderr, "Error: %s\n", e.what());
+		return 1;
+	}
+
+	return 0;
+}
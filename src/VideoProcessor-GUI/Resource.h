@@ -76,13 +76,14 @@
 #define ID_COMMAND_FULLSCREEN_TOGGLE    32772
 #define ID_COMMAND_FULLSCREEN_EXIT      32778
 #define ID_COMMAND_RENDERER_RESET       32780
+#define ID_COMMAND_TRACE_DUMP           32781
 
 // Next default values for new objects
 // 
 #ifdef APSTUDIO_INVOKED
 #ifndef APSTUDIO_READONLY_SYMBOLS
 #define _APS_NEXT_RESOURCE_VALUE        134
-#define _APS_NEXT_COMMAND_VALUE         32781
+#define _APS_NEXT_COMMAND_VALUE         32782
 #define _APS_NEXT_CONTROL_VALUE         1073
 #define _APS_NEXT_SYMED_VALUE           101
 #endif
@@ -13,6 +13,7 @@ extern "C" {
 #include <libavutil/log.h>
 }
 
+#include <FrameTrace.h>
 #include <VideoProcessorDlg.h>
 
 #include "VideoProcessorApp.h"
@@ -83,6 +84,55 @@ BOOL CVideoProcessorApp::InitInstance()
 					dlg.StartFrameOffset(pArgs[i + 1]);
 				}
 			}
+
+			// /formatter_slices [count]
+			if (wcscmp(pArgs[i], L"/formatter_slices") == 0 && (i + 1) < iNumOfArgs)
+			{
+				dlg.FormatterSliceCount(pArgs[i + 1]);
+			}
+
+			// /format_at_ingest
+			if (wcscmp(pArgs[i], L"/format_at_ingest") == 0)
+			{
+				dlg.FormatAtIngest();
+			}
+
+			// /trace, record frame traces which can be dumped with the T key
+			if (wcscmp(pArgs[i], L"/trace") == 0)
+			{
+				FrameTrace::SetEnabled(true);
+			}
+
+			// /sample_buffers [count]
+			if (wcscmp(pArgs[i], L"/sample_buffers") == 0 && (i + 1) < iNumOfArgs)
+			{
+				dlg.SampleBufferCount(pArgs[i + 1]);
+			}
+
+			// /record [directory], record the raw capture while rendering
+			if (wcscmp(pArgs[i], L"/record") == 0 && (i + 1) < iNumOfArgs)
+			{
+				dlg.RecordDirectory(pArgs[i + 1]);
+			}
+
+			// /record_size [GiB]
+			if (wcscmp(pArgs[i], L"/record_size") == 0 && (i + 1) < iNumOfArgs)
+			{
+				dlg.RecordMaxSize(pArgs[i + 1]);
+			}
+
+			// /record_skip_zero_fill, lets the recording writes overlap but leaves old disk
+			// contents in the unwritten parts of the file, needs the volume maintenance privilege
+			if (wcscmp(pArgs[i], L"/record_skip_zero_fill") == 0)
+			{
+				dlg.RecordSkipZeroFill();
+			}
+
+			// /replay [file], offer a recorded raw capture as capture device
+			if (wcscmp(pArgs[i], L"/replay") == 0 && (i + 1) < iNumOfArgs)
+			{
+				dlg.ReplayFile(pArgs[i + 1]);
+			}
 		}
 
 		// Set set ourselves to high prio.
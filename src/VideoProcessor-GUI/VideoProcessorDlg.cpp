@@ -10,6 +10,7 @@
 
 #include <atlstr.h>
 #include <algorithm>
+#include <fstream>
 #include <vector>
 
 #include <version.h>
@@ -17,6 +18,9 @@
 #include <VideoConversionOverride.h>
 #include <resource.h>
 #include <StringUtils.h>
+#include <FrameTrace.h>
+#include <PipelineLatency.h>
+#include <WallClock.h>
 #include <VideoProcessorApp.h>
 #include <microsoft_directshow/video_renderers/DirectShowVideoRenderers.h>
 #include <microsoft_directshow/video_renderers/DirectShowMPCVideoRenderer.h>
@@ -25,12 +29,31 @@
 #include <microsoft_directshow/video_renderers/DirectShowGenericHDRVideoRenderer.h>
 #include <microsoft_directshow/DirectShowRendererStartStopTimeMethod.h>
 #include <microsoft_directshow/DirectShowDefines.h>
+#include <microsoft_directshow/live_source_filter/ALiveSourceVideoOutputPin.h>
+#include <raw_capture/RawCaptureReplayDevice.h>
+#include <video_frame_formatter/CSlicedVideoFrameFormatter.h>
 #include <guid.h>
 
 #include "VideoProcessorDlg.h"
 
 
 const static UINT_PTR TIMER_ID_1SECOND = 1;
+const static UINT_PTR TIMER_ID_LATENCY_CONTROLLER = 2;
+
+// How often the latency controller samples the exit latency
+const static UINT LATENCY_CONTROLLER_INTERVAL_MS = 100;
+
+// Frame lead the latency controller aims for, in frame durations
+const static double LATENCY_CONTROLLER_TARGET_LEAD_FRAMES = 0.5;
+
+// How often the per-stage pipeline latencies are logged while rendering
+const static unsigned int PIPELINE_LATENCY_LOG_INTERVAL_S = 10;
+
+// How far back a frame trace dump goes
+const static int64_t FRAME_TRACE_DUMP_SECONDS = 10;
+
+// Frames queued for the unbuffered renderer while it's busy, beyond this the oldest are dropped
+const static uint32_t CAPTURE_INGEST_QUEUE_SIZE = 2;
 
 
 BEGIN_MESSAGE_MAP(CVideoProcessorDlg, CDialog)
@@ -80,6 +103,7 @@ BEGIN_MESSAGE_MAP(CVideoProcessorDlg, CDialog)
 	ON_COMMAND(ID_COMMAND_FULLSCREEN_TOGGLE, &CVideoProcessorDlg::OnCommandFullScreenToggle)
 	ON_COMMAND(ID_COMMAND_FULLSCREEN_EXIT, &CVideoProcessorDlg::OnCommandFullScreenExit)
 	ON_COMMAND(ID_COMMAND_RENDERER_RESET, &CVideoProcessorDlg::OnCommandRendererReset)
+	ON_COMMAND(ID_COMMAND_TRACE_DUMP, &CVideoProcessorDlg::OnCommandTraceDump)
 
 END_MESSAGE_MAP()
 
@@ -141,6 +165,7 @@ static const std::vector<DirectShowStartStopTimeMethod> RENDERER_DIRECTSHOW_STAR
 	DirectShowStartStopTimeMethod::DS_SSTM_CLOCK_SMART,
 	DirectShowStartStopTimeMethod::DS_SSTM_CLOCK_THEO,
 	DirectShowStartStopTimeMethod::DS_SSTM_CLOCK_CLOCK,
+	DirectShowStartStopTimeMethod::DS_SSTM_CLOCK_FILTERED,
 	DirectShowStartStopTimeMethod::DS_SSTM_THEO_THEO,
 	DirectShowStartStopTimeMethod::DS_SSTM_CLOCK_NONE,
 	DirectShowStartStopTimeMethod::DS_SSTM_THEO_NONE,
@@ -211,7 +236,8 @@ static const std::vector<std::pair<LPCTSTR, DXVA_VideoPrimaries>> DIRECTSHOW_PRI
 static const std::vector<VideoConversionOverride> RENDERER_VIDEO_CONVERSION =
 {
 	VideoConversionOverride::VIDEOCONVERSION_NONE,
-	VideoConversionOverride::VIDEOCONVERSION_V210_TO_P010
+	VideoConversionOverride::VIDEOCONVERSION_V210_TO_P010,
+	VideoConversionOverride::VIDEOCONVERSION_V210_TO_P010_TOP_LEFT
 };
 
 
@@ -265,6 +291,73 @@ void CVideoProcessorDlg::StartFrameOffset(const CString& frameOffset)
 }
 
 
+void CVideoProcessorDlg::FormatterSliceCount(const CString& sliceCount)
+{
+	// Like the other options a bad value is ignored and the default kept
+	const int count = _wtoi(sliceCount);
+	if (count < 1 || count > (int)CSlicedVideoFrameFormatter::MAX_SLICE_COUNT)
+	{
+		DbgLog((LOG_TRACE, 1, TEXT("CVideoProcessorDlg::FormatterSliceCount(): Ignoring out of range slice count \"%s\""), (LPCTSTR)sliceCount));
+		return;
+	}
+
+	m_rendererPipelineOptions.formatterSliceCount = count;
+}
+
+
+void CVideoProcessorDlg::FormatAtIngest()
+{
+	m_rendererPipelineOptions.formatAtIngest = true;
+}
+
+
+void CVideoProcessorDlg::SampleBufferCount(const CString& bufferCount)
+{
+	const int count = _wtoi(bufferCount);
+	if (count < 1 || count > (int)ALiveSourceVideoOutputPin::MAX_SAMPLE_BUFFER_COUNT)
+	{
+		DbgLog((LOG_TRACE, 1, TEXT("CVideoProcessorDlg::SampleBufferCount(): Ignoring out of range sample buffer count \"%s\""), (LPCTSTR)bufferCount));
+		return;
+	}
+
+	m_rendererPipelineOptions.sampleBufferCount = count;
+}
+
+
+void CVideoProcessorDlg::RecordDirectory(const CString& directory)
+{
+	m_recordDirectory = directory;
+}
+
+
+void CVideoProcessorDlg::RecordMaxSize(const CString& sizeGiB)
+{
+	const int size = _wtoi(sizeGiB);
+	if (size < 1)
+	{
+		DbgLog((LOG_TRACE, 1, TEXT("CVideoProcessorDlg::RecordMaxSize(): Ignoring out of range record size \"%s\""), (LPCTSTR)sizeGiB));
+		return;
+	}
+
+	m_recordMaxSizeGiB = size;
+}
+
+
+void CVideoProcessorDlg::RecordSkipZeroFill()
+{
+	m_recordSkipZeroFill = true;
+}
+
+
+void CVideoProcessorDlg::ReplayFile(const CString& path)
+{
+	RawCaptureReplayDevice::Config config;
+	config.path = path;
+
+	m_replayCaptureDevice = new RawCaptureReplayDevice(config);
+}
+
+
 //
 // UI-related handlers
 //
@@ -673,6 +766,8 @@ LRESULT CVideoProcessorDlg::OnMessageRendererStateChange(WPARAM wParam, LPARAM l
 
 		assert(oldRendererState == RendererState::RENDERSTATE_READY);
 
+		m_frameDistributor->Start();
+
 		m_deliverCaptureDataToRenderer.store(true, std::memory_order_release);
 		enableButtons = true;
 		m_windowedVideoWindow.ShowLogo(false);
@@ -746,6 +841,34 @@ void CVideoProcessorDlg::OnCommandRendererReset()
 }
 
 
+void CVideoProcessorDlg::OnCommandTraceDump()
+{
+	if (!FrameTrace::IsEnabled())
+	{
+		DbgLog((LOG_TRACE, 1, TEXT("CVideoProcessorDlg::OnCommandTraceDump(): Frame trace not enabled, start with /trace")));
+		return;
+	}
+
+	CString path;
+	path.Format(TEXT("videoprocessor-trace-%I64d.json"), GetWallClockTime() / TICKS_PER_SECOND);
+
+	std::ofstream stream(path.GetString());
+	if (!stream)
+	{
+		DbgLog((LOG_TRACE, 1, TEXT("CVideoProcessorDlg::OnCommandTraceDump(): Failed to open %s"), path.GetString()));
+		return;
+	}
+
+	const int64_t ticksPerSecond = PipelineLatency::TicksPerSecond();
+	const size_t eventCount = FrameTrace::WriteChromeTrace(
+		stream, PipelineLatency::Now() - FRAME_TRACE_DUMP_SECONDS * ticksPerSecond, ticksPerSecond);
+
+	DbgLog((LOG_TRACE, 1,
+		TEXT("CVideoProcessorDlg::OnCommandTraceDump(): Wrote %zu events of the last %I64d seconds to %s"),
+		eventCount, FRAME_TRACE_DUMP_SECONDS, path.GetString()));
+}
+
+
 
 //
 // ICaptureDeviceDiscovererCallback
@@ -813,6 +936,15 @@ void CVideoProcessorDlg::OnCaptureDeviceVideoStateChange(VideoStateComPtr videoS
 
 	assert(videoState);
 
+	// The recorder needs the state in order with the frames, the main thread only gets to it later
+	{
+		std::lock_guard<std::mutex> lock(m_rawCaptureRecorderMutex);
+
+		m_rawCaptureLastVideoState = videoState;
+		if (m_rawCaptureRecorder)
+			m_rawCaptureRecorder->OnVideoState(videoState);
+	}
+
 	PostMessage(
 		WM_MESSAGE_CAPTURE_DEVICE_VIDEO_STATE_CHANGE,
 		(WPARAM)videoState.Detach(),
@@ -824,6 +956,8 @@ void CVideoProcessorDlg::OnCaptureDeviceVideoFrame(VideoFrame& videoFrame)
 {
 	// WARNING: Most likely to be called from some internal capture card thread!
 
+	FrameTraceScope frameTrace(FrameTraceEvent::ON_CAPTURE_DEVICE_VIDEO_FRAME, videoFrame.GetCounter());
+
 	// This is an atomic bool which is set by the main thread and used in context of the
 	// capture thread which will deliver frames.
 	if (m_deliverCaptureDataToRenderer.load(std::memory_order_acquire))
@@ -833,7 +967,7 @@ void CVideoProcessorDlg::OnCaptureDeviceVideoFrame(VideoFrame& videoFrame)
 		assert(m_videoRenderer);
 		assert(m_rendererState == RendererState::RENDERSTATE_RENDERING);
 
-		m_videoRenderer->OnVideoFrame(videoFrame);
+		m_frameDistributor->OnVideoFrame(videoFrame);
 	}
 }
 
@@ -1234,6 +1368,11 @@ void CVideoProcessorDlg::CaptureStop()
 
 	m_captureDeviceVideoState = nullptr;
 
+	{
+		std::lock_guard<std::mutex> lock(m_rawCaptureRecorderMutex);
+		m_rawCaptureLastVideoState = nullptr;
+	}
+
 	// Update GUI
 	CaptureGUIClear();
 	m_captureDeviceStateText.SetWindowText(TEXT("Stopping"));
@@ -1367,6 +1506,10 @@ void CVideoProcessorDlg::RenderStart()
 	m_windowedVideoWindow.SetWindowTextW(TEXT("Starting..."));
 	m_rendererState = RendererState::RENDERSTATE_STARTING;
 
+	// Formatting at ingest can only be done with a frame queue
+	DirectShowVideoRenderer::PipelineOptions pipelineOptions = m_rendererPipelineOptions;
+	pipelineOptions.formatAtIngest = pipelineOptions.formatAtIngest && GetRendererVideoFrameUseQueue();
+
 	//
 	// Construct renderer
 	//
@@ -1384,6 +1527,7 @@ void CVideoProcessorDlg::RenderStart()
 			GetRendererVideoFrameUseQueue(),
 			GetRendererVideoFrameQueueSizeMax(),
 			videoConversionOverride,
+			pipelineOptions,
 			forceNominalRange,
 			forceVideoTransferFunction,
 			forceVideoTransferMatrix,
@@ -1420,6 +1564,7 @@ void CVideoProcessorDlg::RenderStart()
 					GetRendererVideoFrameUseQueue(),
 					GetRendererVideoFrameQueueSizeMax(),
 					videoConversionOverride,
+					pipelineOptions,
 					forceNominalRange,
 					forceVideoTransferFunction,
 					forceVideoTransferMatrix,
@@ -1436,7 +1581,8 @@ void CVideoProcessorDlg::RenderStart()
 					directShowStartStopTimeMethod,
 					GetRendererVideoFrameUseQueue(),
 					GetRendererVideoFrameQueueSizeMax(),
-					videoConversionOverride);
+					videoConversionOverride,
+					pipelineOptions);
 			}
 			else
 				m_videoRenderer = new DirectShowGenericVideoRenderer(
@@ -1449,7 +1595,8 @@ void CVideoProcessorDlg::RenderStart()
 					directShowStartStopTimeMethod,
 					GetRendererVideoFrameUseQueue(),
 					GetRendererVideoFrameQueueSizeMax(),
-					videoConversionOverride);
+					videoConversionOverride,
+					pipelineOptions);
 
 			if (!m_videoRenderer)
 				FatalError(TEXT("Failed to build DirectShow Video Renderer"));
@@ -1458,12 +1605,55 @@ void CVideoProcessorDlg::RenderStart()
 				m_videoRenderer->OnVideoState(m_builtVideoState);
 
 			m_videoRenderer->Build();
+
+			// The unbuffered renderer delivers in the calling thread, keep that off the capture
+			// callback thread. The buffered one only queues.
+			m_frameDistributor.reset(new FrameDistributor());
+			if (GetRendererVideoFrameUseQueue())
+				m_frameDistributor->AddInlineSink(*m_videoRenderer);
+			else
+				m_frameDistributor->AddSink(*m_videoRenderer, CAPTURE_INGEST_QUEUE_SIZE, FrameDropPolicy::DROP_OLDEST);
+
+			// The recorder never blocks, it can take the frames in the capture thread
+			if (!m_recordDirectory.IsEmpty())
+			{
+				CString path = m_recordDirectory;
+				path.AppendFormat(TEXT("\\capture-%s.vprc"), CTime::GetCurrentTime().Format(TEXT("%Y%m%d-%H%M%S")).GetString());
+
+				std::unique_ptr<RawCaptureRecorder> rawCaptureRecorder(new RawCaptureRecorder(
+					path,
+					(uint64_t)m_recordMaxSizeGiB << 30,
+					timingClock->TimingClockTicksPerSecond(),
+					RawCaptureRecorder::DEFAULT_MAX_QUEUED_FRAMES,
+					RawCaptureRecorder::DEFAULT_MAX_IN_FLIGHT_WRITES,
+					m_recordSkipZeroFill));
+
+				rawCaptureRecorder->Start();
+
+				// Seed with the state the capture thread saw last, it passes on the ones after
+				{
+					std::lock_guard<std::mutex> lock(m_rawCaptureRecorderMutex);
+
+					if (m_rawCaptureLastVideoState)
+						rawCaptureRecorder->OnVideoState(m_rawCaptureLastVideoState);
+
+					m_rawCaptureRecorder = std::move(rawCaptureRecorder);
+				}
+
+				m_frameDistributor->AddInlineSink(*m_rawCaptureRecorder);
+			}
+
+			// Latencies are per renderer run
+			PipelineLatency::Reset();
+
 			m_videoRenderer->Start();
 
 			m_rendererStateText.SetWindowText(TEXT("Started, waiting for image..."));
 		}
 		catch (std::runtime_error e)
 		{
+			m_frameDistributor.reset();
+			RawCaptureRecorderRemove();
 			delete m_videoRenderer;
 			m_videoRenderer = nullptr;
 
@@ -1502,9 +1692,17 @@ void CVideoProcessorDlg::RenderStop()
 	// After this call no frames will ever go through to the renderer
 	m_deliverCaptureDataToRenderer.store(false, std::memory_order_release);
 
+	m_latencyController.reset();
+
 	// Update internal state before call to StartCapture as that might be synchronous
 	m_rendererState = RendererState::RENDERSTATE_STOPPING;
 
+	// Drain the sinks' threads before the renderer goes away under them
+	m_frameDistributor->Stop();
+
+	if (m_rawCaptureRecorder)
+		m_rawCaptureRecorder->Stop();
+
 	m_videoRenderer->Stop();
 
 	m_rendererStateText.SetWindowText(TEXT("Stopping"));
@@ -1521,6 +1719,8 @@ void CVideoProcessorDlg::RenderRemove()
 	assert(m_rendererState == RendererState::RENDERSTATE_STOPPED);
 	assert(!m_deliverCaptureDataToRenderer);
 
+	m_frameDistributor.reset();
+	RawCaptureRecorderRemove();
 	delete m_videoRenderer;
 	m_videoRenderer = nullptr;
 
@@ -1530,6 +1730,17 @@ void CVideoProcessorDlg::RenderRemove()
 }
 
 
+void CVideoProcessorDlg::RawCaptureRecorderRemove()
+{
+	// Take it away from the capture thread first, destroying it can wait for the disk
+	std::unique_ptr<RawCaptureRecorder> rawCaptureRecorder;
+	{
+		std::lock_guard<std::mutex> lock(m_rawCaptureRecorderMutex);
+		rawCaptureRecorder = std::move(m_rawCaptureRecorder);
+	}
+}
+
+
 void CVideoProcessorDlg::RenderGUIClear()
 {
 	// Renderer group
@@ -1643,6 +1854,81 @@ void CVideoProcessorDlg::UpdateTimingClockFrameOffset()
 }
 
 
+void CVideoProcessorDlg::UpdateLatencyController()
+{
+	const bool timingClockFrameOffsetAuto = m_timingClockFrameOffsetAutoCheck.GetCheck();
+	if (!timingClockFrameOffsetAuto ||
+		m_rendererState != RendererState::RENDERSTATE_RENDERING ||
+		m_captureDeviceState != CaptureDeviceState::CAPTUREDEVICESTATE_CAPTURING)
+	{
+		m_latencyController.reset();
+		return;
+	}
+
+	assert(m_videoRenderer);
+	assert(m_captureDevice);
+	assert(m_captureDeviceVideoState);
+
+	// A backed up queue says nothing about the offset, leave that to the renderer reset
+	if (m_videoRenderer->GetFrameQueueSize() >= 3)
+		return;
+
+	if (!m_latencyController)
+	{
+		const double frameDurationMs = 1000.0 / m_captureDeviceVideoState->displayMode->RefreshRateHz();
+
+		LatencyController::Config config;
+		config.targetLeadMs = frameDurationMs * LATENCY_CONTROLLER_TARGET_LEAD_FRAMES;
+
+		m_latencyController.reset(new LatencyController(config));
+		m_latencyController->Reset(GetTimingClockFrameOffsetMs());
+	}
+
+	const int previousOffsetMs = m_latencyController->OffsetMs();
+	// Runs more often than frames are delivered, the controller skips samples it already has
+	const int offsetMs = m_latencyController->Update(
+		m_videoRenderer->ExitLatencyMs(),
+		m_videoRenderer->ExitLatencySampleCount(),
+		GetWallClockTime() / 10000000.0);
+
+	// Applied without a renderer reset, the controller only takes small steps
+	if (offsetMs != previousOffsetMs)
+	{
+		const LatencyController::Telemetry telemetry = m_latencyController->GetTelemetry();
+
+		DbgLog((LOG_TRACE, 1,
+			TEXT("CVideoProcessorDlg::UpdateLatencyController(): Frame offset %i -> %i ms, lead: %.02f ms, filtered error: %.02f ms"),
+			previousOffsetMs, offsetMs, telemetry.leadMs, telemetry.filteredErrorMs));
+
+		SetTimingClockFrameOffsetMs(offsetMs);
+		m_captureDevice->SetFrameOffsetMs(offsetMs);
+	}
+}
+
+
+void CVideoProcessorDlg::LogPipelineLatency()
+{
+	for (int i = 0; i < (int)LatencyStage::COUNT; ++i)
+	{
+		const LatencyStage stage = (LatencyStage)i;
+		const LatencyHistogram::Snapshot snapshot = PipelineLatency::GetSnapshot(stage);
+
+		DbgLog((LOG_TRACE, 1,
+			TEXT("CVideoProcessorDlg::LogPipelineLatency(): %s over %I64u frames, p50: %.03f ms, p99: %.03f ms, p99.9: %.03f ms, max: %.03f ms"),
+			ToString(stage), snapshot.count,
+			snapshot.p50 / 1000.0, snapshot.p99 / 1000.0, snapshot.p999 / 1000.0, snapshot.max / 1000.0));
+	}
+
+	if (m_rawCaptureRecorder)
+	{
+		DbgLog((LOG_TRACE, 1,
+			TEXT("CVideoProcessorDlg::LogPipelineLatency(): Raw capture recorded %I64u frames, dropped: %I64u, backlog: %u, write: %.1f MiB/s"),
+			m_rawCaptureRecorder->RecordedFrameCount(), m_rawCaptureRecorder->DroppedFrameCount(),
+			m_rawCaptureRecorder->Backlog(), m_rawCaptureRecorder->WriteBandwidthMiBps()));
+	}
+}
+
+
 void CVideoProcessorDlg::RebuildRendererCombo()
 {
 	ClearRendererCombo();
@@ -2113,6 +2399,10 @@ BOOL CVideoProcessorDlg::OnInitDialog()
 	// Start discovery services
 	m_blackMagicDeviceDiscoverer->Start();
 
+	// A replay shows up like a discovered device, this hands over the reference
+	if (m_replayCaptureDevice)
+		OnCaptureDeviceFound(m_replayCaptureDevice);
+
 	m_accelerator = LoadAccelerators(AfxGetResourceHandle(), MAKEINTRESOURCE(IDR_ACCELERATOR1));
 	if (!m_accelerator)
 		FatalError(TEXT("Failed to load accelerator"));
@@ -2131,6 +2421,7 @@ BOOL CVideoProcessorDlg::OnInitDialog()
 
 	// Start timers
 	SetTimer(TIMER_ID_1SECOND, 1000, nullptr);
+	SetTimer(TIMER_ID_LATENCY_CONTROLLER, LATENCY_CONTROLLER_INTERVAL_MS, nullptr);
 
 	return TRUE;
 }
@@ -2255,6 +2546,12 @@ void CVideoProcessorDlg::OnClose()
 
 void CVideoProcessorDlg::OnTimer(UINT_PTR nIDEvent)
 {
+	if (nIDEvent == TIMER_ID_LATENCY_CONTROLLER)
+	{
+		UpdateLatencyController();
+		return;
+	}
+
 	CString cstring;
 
 	if (m_rendererState == RendererState::RENDERSTATE_RENDERING)
@@ -2324,51 +2621,25 @@ void CVideoProcessorDlg::OnTimer(UINT_PTR nIDEvent)
 	}
 
 
-	// Auto adjust
+	if (m_timerSeconds % PIPELINE_LATENCY_LOG_INTERVAL_S == 0 &&
+		m_rendererState == RendererState::RENDERSTATE_RENDERING)
+	{
+		LogPipelineLatency();
+	}
+
+	// Auto reset
 	if (m_timerSeconds % 5 == 0 &&
 		m_rendererState == RendererState::RENDERSTATE_RENDERING)
 	{
 		assert(m_videoRenderer);
 		assert(m_captureDevice);
 
-		bool queueOk = true;
-
 		// Auto-click reset on renderer if requested
 		const bool rendererResetAuto = m_rendererResetAutoCheck.GetCheck();
-		if (rendererResetAuto)
+		if (rendererResetAuto && m_videoRenderer->GetFrameQueueSize() >= 3)
 		{
-			const bool needsReset = m_videoRenderer->GetFrameQueueSize() >= 3;
-			queueOk = !needsReset;
-
-			if (needsReset)
-			{
-				DbgLog((LOG_TRACE, 1, TEXT("CVideoProcessorDlg::OnTimer(): Resetting renderer")));
-				m_videoRenderer->Reset();
-			}
-		}
-
-		// Auto update the clock frame offset to get just over zero
-		// only do this if the queue is ok as it will have a major impact on the offset(or unmanaged)
-		const bool timingClockFrameOffsetAuto = m_timingClockFrameOffsetAutoCheck.GetCheck();
-		if (queueOk && timingClockFrameOffsetAuto)
-		{
-			const double videoFrameLead = -(m_videoRenderer->ExitLatencyMs());
-			const double frameDurationMs = 1000.0 / m_captureDeviceVideoState->displayMode->RefreshRateHz();
-
-			const bool needsAdjusting =
-				videoFrameLead < 0 ||
-				videoFrameLead >(frameDurationMs * 2);
-
-			if (needsAdjusting)
-			{
-				DbgLog((LOG_TRACE, 1, TEXT("CVideoProcessorDlg::OnTimer(): Adjusting clock frame offset + reset")));
-
-				const int delta = (int)round(-videoFrameLead);
-				const int newOffset = GetTimingClockFrameOffsetMs() + delta;
-
-				SetTimingClockFrameOffsetMs(newOffset);
-				UpdateTimingClockFrameOffset();
-			}
+			DbgLog((LOG_TRACE, 1, TEXT("CVideoProcessorDlg::OnTimer(): Resetting renderer")));
+			m_videoRenderer->Reset();
 		}
 	}
 
@@ -11,11 +11,17 @@
 
 #include <set>
 #include <atomic>
+#include <memory>
+#include <mutex>
 
 #include <blackmagic_decklink/BlackMagicDeckLinkCaptureDeviceDiscoverer.h>
 #include <PixelValueRange.h>
 #include <CCie1931Control.h>
 #include <IRenderer.h>
+#include <FrameDistributor.h>
+#include <raw_capture/RawCaptureRecorder.h>
+#include <LatencyController.h>
+#include <microsoft_directshow/video_renderers/DirectShowVideoRenderer.h>
 #include <VideoFrame.h>
 #include <FullscreenVideoWindow.h>
 #include <WindowedVideoWindow.h>
@@ -56,6 +62,13 @@ public:
 	void DefaultRendererName(const CString&);
 	void StartFrameOffsetAuto();
 	void StartFrameOffset(const CString&);
+	void FormatterSliceCount(const CString&);
+	void FormatAtIngest();
+	void SampleBufferCount(const CString&);
+	void RecordDirectory(const CString&);
+	void RecordMaxSize(const CString&);
+	void RecordSkipZeroFill();
+	void ReplayFile(const CString&);
 
 	// UI-related handlers
 	afx_msg void OnCaptureDeviceSelected();
@@ -93,6 +106,7 @@ public:
 	void OnCommandFullScreenToggle();
 	void OnCommandFullScreenExit();
 	void OnCommandRendererReset();
+	void OnCommandTraceDump();
 
 	// ICaptureDeviceDiscovererCallback
 	void OnCaptureDeviceFound(ACaptureDeviceComPtr& captureDevice) override;
@@ -220,15 +234,35 @@ protected:
 	CString m_defaultRendererName;
 	bool m_frameOffsetAutoStart = false;
 	CString m_defaultFrameOffset = TEXT("90");
+	DirectShowVideoRenderer::PipelineOptions m_rendererPipelineOptions;
+	CString m_recordDirectory;
+	unsigned int m_recordMaxSizeGiB = 16;
+	bool m_recordSkipZeroFill = false;
+	ACaptureDeviceComPtr m_replayCaptureDevice;
 
 
 	IVideoRenderer* m_videoRenderer = nullptr;
 	RendererState m_rendererState = RendererState::RENDERSTATE_UNKNOWN;
 
+	// Fans captured frames out to the renderer and any other sinks, exists along with the renderer
+	std::unique_ptr<FrameDistributor> m_frameDistributor;
+
+	// Records the raw capture if a record directory is set, exists along with the renderer.
+	// The capture thread hands it the video states, only set and reset under the mutex.
+	std::unique_ptr<RawCaptureRecorder> m_rawCaptureRecorder;
+	std::mutex m_rawCaptureRecorderMutex;
+
+	// Last video state the capture device sent, under m_rawCaptureRecorderMutex. Seeds the
+	// recorder as m_captureDeviceVideoState can lag behind the capture thread.
+	VideoStateComPtr m_rawCaptureLastVideoState;
+
 	std::atomic_bool m_deliverCaptureDataToRenderer = false;
 
 	uint32_t m_timerSeconds = 0;
 
+	// Steers the frame offset if it's on auto, only exists while rendering
+	std::unique_ptr<LatencyController> m_latencyController;
+
 	// We often have to wait for devices to come back etc. Hence many functions can't complete
 	// immediately. We solve this by setting a desired capture device and input and calling UpdateState()
 	// at various points which will work towards our desired state
@@ -251,6 +285,7 @@ protected:
 	void RenderStop();
 	void RenderRemove();
 	void RenderGUIClear();
+	void RawCaptureRecorderRemove();
 	void FullScreenVideoWindowConstruct();
 	void FullScreenVideoWindowDestroy();
 	HWND GetRenderWindow();
@@ -260,6 +295,8 @@ protected:
 	int GetTimingClockFrameOffsetMs();
 	void SetTimingClockFrameOffsetMs(int timingClockFrameOffsetMs);
 	void UpdateTimingClockFrameOffset();
+	void UpdateLatencyController();
+	void LogPipelineLatency();
 	void RebuildRendererCombo();
 	void ClearRendererCombo();
 
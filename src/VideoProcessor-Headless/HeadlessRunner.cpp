@@ -0,0 +1,682 @@
+/*
+ * Copyright(C) 2021 Dennis Fleurbaaij <mail@dennisfleurbaaij.com>
+ *
+ * This program is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, version 3.
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License along with this program. If not, see < https://www.gnu.org/licenses/>.
+ */
+
+
+#include "pch.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <NullVideoRenderer.h>
+#include <PipelineLatency.h>
+#include <raw_capture/RawCaptureReplayDevice.h>
+#include <synthetic/SyntheticCaptureDevice.h>
+
+
+/**
+ * Headless pipeline runner
+ *
+ * Runs the synthetic capture device through the formatter and queue stack into a null renderer,
+ * without a window, DirectShow graph or GPU. Reports the sustained frame rate, process CPU time
+ * per frame, drops and the per-stage latency percentiles. With --unthrottled the source produces
+ * frames as fast as the renderer takes them, the frame rate then is the max sustainable one (the
+ * CPU time includes the source spinning for free buffers).
+ *
+ * With --replay the source is a raw capture recorded with the GUI's /record option instead, replayed
+ * at its original timing or unthrottled. The mode and encoding are the recorded ones then and the
+ * run ends early when the recording does.
+ *
+ * Runs can be scripted in a scenario file, one run per line with the same options as the command
+ * line. Options given on the command line are the defaults for every line, blank lines and lines
+ * starting with # are skipped. Results can be written as JSON, one run per line.
+ *
+ * Usage: VideoProcessor-Headless [run options] [--scenarios FILE] [--json OUT]
+ */
+
+
+static const char* RUN_OPTIONS_USAGE =
+	"Run options:\n"
+	"  --mode HEIGHTpRATE    Progressive 16:9 mode, for example 1080p24, 2160p59.94 or 4320p60\n"
+	"  --encoding NAME       uyvy, hdyc, v210, r210, r10b, r10l, r12b or r12l\n"
+	"  --seconds N           Measure for N seconds\n"
+	"  --frames N            Measure until N frames have been delivered\n"
+	"  --unthrottled         Source produces frames as fast as they are taken\n"
+	"  --queue N             Renderer frame queue size\n"
+	"  --slices N            Format every frame in N slices\n"
+	"  --p010                Convert v210 to p010 instead of p210\n"
+	"  --drift PPM           Source clock drift\n"
+	"  --jitter US           Source timestamp and callback jitter\n"
+	"  --drop P              Source frame drop probability\n"
+	"  --replay FILE         Replay a raw capture instead of the synthetic source\n";
+
+// Time the pipeline gets to start rendering
+static const double START_TIMEOUT_S = 5.0;
+
+// Not measured after the start, the source catches up on the frames it held back while the
+// renderer was being built
+static const double WARMUP_S = 1.0;
+
+static const double DEFAULT_SECONDS = 10.0;
+static const unsigned int DEFAULT_QUEUE_SIZE = 4;
+
+// Capture buffers beyond the queue size when throttled, one being captured and one being formatted
+static const uint32_t CAPTURE_BUFFERS_EXTRA = 2;
+
+
+struct EncodingName
+{
+	const char* name;
+	VideoFrameEncoding videoFrameEncoding;
+};
+
+
+static const EncodingName ENCODING_NAMES[] =
+{
+	{ "uyvy", VideoFrameEncoding::UYVY },
+	{ "hdyc", VideoFrameEncoding::HDYC },
+	{ "v210", VideoFrameEncoding::V210 },
+	{ "r210", VideoFrameEncoding::R210 },
+	{ "r10b", VideoFrameEncoding::R10b },
+	{ "r10l", VideoFrameEncoding::R10l },
+	{ "r12b", VideoFrameEncoding::R12B },
+	{ "r12l", VideoFrameEncoding::R12L }
+};
+
+
+struct RunOptions
+{
+	std::string mode = "1080p24";
+	std::string encoding = "v210";
+	double seconds = 0.0;
+	uint64_t frames = 0;
+	bool unthrottled = false;
+	unsigned int queueSize = DEFAULT_QUEUE_SIZE;
+	unsigned int sliceCount = 1;
+	bool p010 = false;
+	double driftPpm = 0.0;
+	double jitterUs = 0.0;
+	double dropProbability = 0.0;
+	std::string replay;
+
+	std::string Name() const
+	{
+		std::string name = replay.empty() ? (mode + " " + encoding) : ("replay " + replay);
+		if (unthrottled)
+			name += " unthrottled";
+		if (p010)
+			name += " p010";
+		if (sliceCount > 1)
+			name += " slices=" + std::to_string(sliceCount);
+		return name;
+	}
+};
+
+
+struct RunResult
+{
+	std::string name;
+	std::string formatter;
+
+	// Non-empty if the run failed
+	std::string error;
+
+	double seconds = 0.0;
+	uint64_t frames = 0;
+	double fps = 0.0;
+	double nominalFps = 0.0;
+	double cpuMsPerFrame = 0.0;
+	double cpuPercent = 0.0;
+	uint64_t sourceMissedFrames = 0;
+	uint64_t queueDroppedFrames = 0;
+	LatencyHistogram::Snapshot latency[(int)LatencyStage::COUNT];
+};
+
+
+static std::string Narrow(const TCHAR* str)
+{
+	return std::string(CStringA(str));
+}
+
+
+// User and kernel time of all threads of this process
+static double ProcessCpuSeconds()
+{
+	FILETIME creationTime, exitTime, kernelTime, userTime;
+	if (!GetProcessTimes(GetCurrentProcess(), &creationTime, &exitTime, &kernelTime, &userTime))
+		throw std::runtime_error("Failed to get process times");
+
+	ULARGE_INTEGER kernel, user;
+	kernel.LowPart = kernelTime.dwLowDateTime;
+	kernel.HighPart = kernelTime.dwHighDateTime;
+	user.LowPart = userTime.dwLowDateTime;
+	user.HighPart = userTime.dwHighDateTime;
+
+	return (kernel.QuadPart + user.QuadPart) / 10000000.0;  // 100ns units
+}
+
+
+// "2160p59.94" to a 16:9 display mode, fractional rates are the NTSC x/1.001 ones
+static DisplayModeSharedPtr ParseMode(const std::string& mode)
+{
+	const size_t p = mode.find('p');
+	if (p == std::string::npos || p == 0 || p + 1 == mode.size())
+		throw std::runtime_error("Invalid mode, expected HEIGHTpRATE");
+
+	const unsigned int height = (unsigned int)atoi(mode.substr(0, p).c_str());
+	const std::string rate = mode.substr(p + 1);
+	const double refreshRateHz = atof(rate.c_str());
+
+	if (rate.find('.') != std::string::npos)
+		return std::make_shared<DisplayMode>(height * 16 / 9, height, false, (unsigned int)std::lround(refreshRateHz * 1.001) * 1000, 1001);
+
+	return std::make_shared<DisplayMode>(height * 16 / 9, height, false, (unsigned int)std::lround(refreshRateHz * 1000), 1000);
+}
+
+
+static VideoFrameEncoding ParseEncoding(const std::string& encoding)
+{
+	for (const EncodingName& encodingName : ENCODING_NAMES)
+	{
+		if (encoding == encodingName.name)
+			return encodingName.videoFrameEncoding;
+	}
+
+	throw std::runtime_error("Unknown encoding");
+}
+
+
+// Parse the run option at args[i], moves i to its last argument. Returns false if it's not a run option.
+static bool ParseRunOption(const std::vector<std::string>& args, size_t& i, RunOptions& options)
+{
+	const std::string& arg = args[i];
+	const bool hasValue = (i + 1 < args.size());
+
+	if (arg == "--unthrottled")
+		options.unthrottled = true;
+	else if (arg == "--p010")
+		options.p010 = true;
+	else if (!hasValue)
+		return false;
+	else if (arg == "--mode")
+		options.mode = args[++i];
+	else if (arg == "--encoding")
+		options.encoding = args[++i];
+	else if (arg == "--seconds")
+		options.seconds = atof(args[++i].c_str());
+	else if (arg == "--frames")
+		options.frames = _strtoui64(args[++i].c_str(), nullptr, 10);
+	else if (arg == "--queue")
+		options.queueSize = std::max(atoi(args[++i].c_str()), 1);
+	else if (arg == "--slices")
+		options.sliceCount = std::max(atoi(args[++i].c_str()), 1);
+	else if (arg == "--drift")
+		options.driftPpm = atof(args[++i].c_str());
+	else if (arg == "--jitter")
+		options.jitterUs = atof(args[++i].c_str());
+	else if (arg == "--drop")
+		options.dropProbability = atof(args[++i].c_str());
+	else if (arg == "--replay")
+		options.replay = args[++i];
+	else
+		return false;
+
+	return true;
+}
+
+
+// Every line is a run which starts from the given defaults
+static std::vector<RunOptions> ReadScenarios(const char* path, const RunOptions& defaults)
+{
+	std::ifstream file(path);
+	if (!file)
+		throw std::runtime_error("Failed to open scenario file");
+
+	std::vector<RunOptions> runs;
+
+	std::string line;
+	while (std::getline(file, line))
+	{
+		std::istringstream lineStream(line);
+		std::vector<std::string> args;
+		std::string arg;
+		while (lineStream >> arg)
+			args.push_back(arg);
+
+		if (args.empty() || args[0][0] == '#')
+			continue;
+
+		RunOptions options = defaults;
+		for (size_t i = 0; i < args.size(); ++i)
+		{
+			if (!ParseRunOption(args, i, options))
+				throw std::runtime_error("Invalid option in scenario file: " + args[i]);
+		}
+
+		runs.push_back(options);
+	}
+
+	return runs;
+}
+
+
+/**
+ * Glue between the capture device and the renderer, what the GUI does without the window.
+ *
+ * The renderer is (re)built on the capture thread when the video state changes.
+ */
+class HeadlessPipeline:
+	public ICaptureDeviceCallback,
+	public IRendererCallback
+{
+public:
+
+	HeadlessPipeline(ACaptureDevice& captureDevice, const RunOptions& options):
+		m_captureDevice(captureDevice),
+		m_options(options)
+	{
+	}
+
+	virtual ~HeadlessPipeline()
+	{
+		StopRenderer();
+	}
+
+	// ICaptureDeviceCallback
+	void OnCaptureDeviceState(CaptureDeviceState) override {}
+	void OnCaptureDeviceCardStateChange(CaptureDeviceCardStateComPtr) override {}
+
+	void OnCaptureDeviceVideoStateChange(VideoStateComPtr videoState) override
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+
+		try
+		{
+			if (m_renderer && m_renderer->OnVideoState(videoState))
+				return;
+
+			StopRendererLocked();
+
+			if (!videoState->valid)
+				return;
+
+			m_renderer.reset(new NullVideoRenderer(
+				*this,
+				m_captureDevice.GetTimingClock(),
+				m_options.queueSize,
+				m_options.p010 ? VideoConversionOverride::VIDEOCONVERSION_V210_TO_P010 : VideoConversionOverride::VIDEOCONVERSION_NONE,
+				m_options.sliceCount));
+
+			m_renderer->OnVideoState(videoState);
+			m_renderer->Build();
+			m_renderer->Start();
+			m_rendering = true;
+		}
+		catch (std::runtime_error& e)
+		{
+			m_error = e.what();
+			StopRendererLocked();
+		}
+	}
+
+	void OnCaptureDeviceVideoFrame(VideoFrame& videoFrame) override
+	{
+		// Renderer only changes on this thread
+		if (m_rendering)
+			m_renderer->OnVideoFrame(videoFrame);
+	}
+
+	void OnCaptureDeviceError(const CString& error) override
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_error = std::string(CStringA(error));
+	}
+
+	// IRendererCallback
+	void OnRendererState(RendererState) override {}
+	void OnRendererDetailString(const CString&) override {}
+
+	bool IsRendering() const { return m_rendering; }
+
+	// Counts over all renderers so far
+	uint64_t DeliveredFrameCount()
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		return m_previousDeliveredFrameCount + (m_renderer ? m_renderer->DeliveredFrameCount() : 0);
+	}
+
+	uint64_t DroppedFrameCount()
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		return m_previousDroppedFrameCount + (m_renderer ? m_renderer->DroppedFrameCount() : 0);
+	}
+
+	std::string FormatterName()
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		return m_renderer ? Narrow(m_renderer->FormatterName()) : std::string();
+	}
+
+	std::string Error()
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		return m_error;
+	}
+
+	// Only call when capture has stopped
+	void StopRenderer()
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		StopRendererLocked();
+	}
+
+private:
+
+	ACaptureDevice& m_captureDevice;
+	const RunOptions m_options;
+
+	std::mutex m_mutex;
+	std::unique_ptr<NullVideoRenderer> m_renderer;
+	std::atomic_bool m_rendering = false;
+	uint64_t m_previousDeliveredFrameCount = 0;
+	uint64_t m_previousDroppedFrameCount = 0;
+	std::string m_error;
+
+	void StopRendererLocked()
+	{
+		if (!m_renderer)
+			return;
+
+		if (m_rendering)
+		{
+			m_rendering = false;
+			m_renderer->Stop();
+		}
+
+		m_previousDeliveredFrameCount += m_renderer->DeliveredFrameCount();
+		m_previousDroppedFrameCount += m_renderer->DroppedFrameCount();
+		m_renderer.reset();
+	}
+};
+
+
+static RunResult Run(const RunOptions& options)
+{
+	RunResult result;
+	result.name = options.Name();
+
+	try
+	{
+		// Unthrottled the capture buffers are the back-pressure, one less than the queue can
+		// hold means the queue never overflows.
+		const uint32_t bufferCount = options.unthrottled ?
+			std::max(options.queueSize, 2u) :
+			options.queueSize + CAPTURE_BUFFERS_EXTRA;
+
+		ACaptureDeviceComPtr captureDevice;
+		RawCaptureReplayDevice* replayDevice = nullptr;
+
+		if (options.replay.empty())
+		{
+			SyntheticCaptureDevice::Config config;
+			config.displayMode = ParseMode(options.mode);
+			config.videoFrameEncoding = ParseEncoding(options.encoding);
+			config.clock.driftPpm = options.driftPpm;
+			config.clock.timestampJitterUs = options.jitterUs;
+			config.clock.callbackJitterUs = options.jitterUs;
+			config.clock.dropProbability = options.dropProbability;
+			config.unthrottled = options.unthrottled;
+			config.bufferCount = bufferCount;
+
+			result.nominalFps = config.displayMode->RefreshRateHz();
+
+			captureDevice = new SyntheticCaptureDevice(config);
+		}
+		else
+		{
+			RawCaptureReplayDevice::Config config;
+			config.path = options.replay.c_str();
+			config.unthrottled = options.unthrottled;
+			config.bufferCount = bufferCount;
+
+			replayDevice = new RawCaptureReplayDevice(config);
+			captureDevice = replayDevice;
+
+			const RawCaptureFile& file = replayDevice->File();
+			result.nominalFps = file.State(file.IndexEntry(0).stateId)->displayMode->RefreshRateHz();
+		}
+
+		HeadlessPipeline pipeline(*captureDevice, options);
+
+		captureDevice->SetCallbackHandler(&pipeline);
+		captureDevice->StartCapture();
+
+		// Wait for the first video state to have built the renderer
+		const auto startTimeout = std::chrono::steady_clock::now() + std::chrono::duration<double>(START_TIMEOUT_S);
+		while (!pipeline.IsRendering() && pipeline.Error().empty() && std::chrono::steady_clock::now() < startTimeout)
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+
+		if (pipeline.IsRendering())
+		{
+			std::this_thread::sleep_for(std::chrono::duration<double>(WARMUP_S));
+
+			const double seconds = (options.seconds > 0.0 || options.frames > 0) ? options.seconds : DEFAULT_SECONDS;
+
+			PipelineLatency::Reset();
+			const auto start = std::chrono::steady_clock::now();
+			const double startCpuSeconds = ProcessCpuSeconds();
+			const uint64_t startDeliveredFrameCount = pipeline.DeliveredFrameCount();
+			const uint64_t startDroppedFrameCount = pipeline.DroppedFrameCount();
+			const uint64_t startMissedFrameCount = captureDevice->VideoFrameMissedCount();
+
+			while (pipeline.Error().empty())
+			{
+				std::this_thread::sleep_for(std::chrono::milliseconds(10));
+
+				const double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+				if (seconds > 0.0 && elapsed >= seconds)
+					break;
+
+				if (options.frames > 0 && pipeline.DeliveredFrameCount() - startDeliveredFrameCount >= options.frames)
+					break;
+
+				if (replayDevice && replayDevice->IsFinished())
+					break;
+			}
+
+			result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+			const double cpuSeconds = ProcessCpuSeconds() - startCpuSeconds;
+
+			result.frames = pipeline.DeliveredFrameCount() - startDeliveredFrameCount;
+			result.queueDroppedFrames = pipeline.DroppedFrameCount() - startDroppedFrameCount;
+			result.sourceMissedFrames = captureDevice->VideoFrameMissedCount() - startMissedFrameCount;
+			result.fps = result.frames / result.seconds;
+			result.cpuPercent = cpuSeconds / result.seconds * 100.0;
+			if (result.frames > 0)
+				result.cpuMsPerFrame = cpuSeconds * 1000.0 / result.frames;
+
+			for (int i = 0; i < (int)LatencyStage::COUNT; ++i)
+				result.latency[i] = PipelineLatency::GetSnapshot((LatencyStage)i);
+
+			result.formatter = pipeline.FormatterName();
+		}
+		else if (pipeline.Error().empty())
+		{
+			result.error = "Pipeline did not start rendering";
+		}
+
+		captureDevice->StopCapture();
+		pipeline.StopRenderer();
+		captureDevice->SetCallbackHandler(nullptr);
+
+		if (result.error.empty())
+			result.error = pipeline.Error();
+	}
+	catch (std::runtime_error& e)
+	{
+		result.error = e.what();
+	}
+
+	return result;
+}
+
+
+static std::string JsonEscape(const std::string& str)
+{
+	std::string escaped;
+	for (const char c : str)
+	{
+		if (c == '"' || c == '\\')
+			escaped += '\\';
+		escaped += c;
+	}
+	return escaped;
+}
+
+
+// Results are written one per line like the formatter benchmark does
+static void WriteJson(const char* path, const std::vector<RunResult>& results)
+{
+	FILE* file = nullptr;
+	if (fopen_s(&file, path, "w") != 0 || !file)
+		throw std::runtime_error("Failed to open JSON output file");
+
+	fprintf(file, "{\n");
+	fprintf(file, "  \"results\": [\n");
+
+	for (size_t i = 0; i < results.size(); ++i)
+	{
+		const RunResult& r = results[i];
+		const char* separator = (i + 1 < results.size()) ? "," : "";
+
+		if (!r.error.empty())
+		{
+			fprintf(file, "    {\"name\": \"%s\", \"error\": \"%s\"}%s\n",
+				JsonEscape(r.name).c_str(), JsonEscape(r.error).c_str(), separator);
+			continue;
+		}
+
+		fprintf(file,
+			"    {\"name\": \"%s\", \"formatter\": \"%s\", \"seconds\": %.3f, \"frames\": %I64u, \"fps\": %.3f, \"nominal_fps\": %.3f, "
+			"\"cpu_ms_per_frame\": %.4f, \"cpu_percent\": %.1f, \"source_missed\": %I64u, \"queue_dropped\": %I64u, \"latency_us\": {",
+			JsonEscape(r.name).c_str(), r.formatter.c_str(), r.seconds, r.frames, r.fps, r.nominalFps,
+			r.cpuMsPerFrame, r.cpuPercent, r.sourceMissedFrames, r.queueDroppedFrames);
+
+		bool first = true;
+		for (int s = 0; s < (int)LatencyStage::COUNT; ++s)
+		{
+			const LatencyHistogram::Snapshot& snapshot = r.latency[s];
+			if (snapshot.count == 0)
+				continue;
+
+			fprintf(file, "%s\"%s\": {\"count\": %I64u, \"p50\": %I64u, \"p99\": %I64u, \"p999\": %I64u, \"max\": %I64u}",
+				first ? "" : ", ", Narrow(ToString((LatencyStage)s)).c_str(),
+				snapshot.count, snapshot.p50, snapshot.p99, snapshot.p999, snapshot.max);
+			first = false;
+		}
+
+		fprintf(file, "}}%s\n", separator);
+	}
+
+	fprintf(file, "  ]\n");
+	fprintf(file, "}\n");
+
+	fclose(file);
+}
+
+
+static void PrintResult(const RunResult& r)
+{
+	if (!r.error.empty())
+	{
+		printf("%-36s failed: %s\n", r.name.c_str(), r.error.c_str());
+		return;
+	}
+
+	printf("%-36s %-12s %9.2f %9.2f %10.3f %7.1f %9I64u %9I64u\n",
+		r.name.c_str(), r.formatter.c_str(), r.fps, r.nominalFps,
+		r.cpuMsPerFrame, r.cpuPercent, r.sourceMissedFrames, r.queueDroppedFrames);
+
+	for (int s = 0; s < (int)LatencyStage::COUNT; ++s)
+	{
+		const LatencyHistogram::Snapshot& snapshot = r.latency[s];
+		if (snapshot.count == 0)
+			continue;
+
+		printf("    %-22s p50 %8I64u   p99 %8I64u   p99.9 %8I64u   max %8I64u us\n",
+			Narrow(ToString((LatencyStage)s)).c_str(), snapshot.p50, snapshot.p99, snapshot.p999, snapshot.max);
+	}
+}
+
+
+int main(int argc, char* argv[])
+{
+	RunOptions options;
+	const char* scenarioPath = nullptr;
+	const char* jsonPath = nullptr;
+
+	const std::vector<std::string> args(argv + 1, argv + argc);
+	for (size_t i = 0; i < args.size(); ++i)
+	{
+		const bool hasValue = (i + 1 < args.size());
+
+		if (args[i] == "--scenarios" && hasValue)
+			scenarioPath = argv[1 + ++i];
+		else if (args[i] == "--json" && hasValue)
+			jsonPath = argv[1 + ++i];
+		else if (!ParseRunOption(args, i, options))
+		{
+			fprintf(stderr, "Usage: %s [run options] [--scenarios FILE] [--json OUT]\n\n%s", argv[0], RUN_OPTIONS_USAGE);
+			return 1;
+		}
+	}
+
+	try
+	{
+		const std::vector<RunOptions> runs = scenarioPath ?
+			ReadScenarios(scenarioPath, options) :
+			std::vector<RunOptions>(1, options);
+
+		printf("%-36s %-12s %9s %9s %10s %7s %9s %9s\n",
+			"Scenario", "Formatter", "fps", "nominal", "CPU ms/f", "CPU %", "src miss", "q drop");
+
+		std::vector<RunResult> results;
+		bool failed = false;
+
+		for (const RunOptions& run : runs)
+		{
+			const RunResult result = Run(run);
+			PrintResult(result);
+
+			failed |= !result.error.empty();
+			results.push_back(result);
+		}
+
+		if (jsonPath)
+			WriteJson(jsonPath, results);
+
+		if (failed)
+			return 2;
+	}
+	catch (std::runtime_error& e)
+	{
+		fprintf(stderr, "Error: %s\n", e.what());
+		return 1;
+	}
+
+	return 0;
+}
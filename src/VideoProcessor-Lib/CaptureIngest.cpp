@@ -0,0 +1,121 @@
+/*
+ * Copyright(C) 2021 Dennis Fleurbaaij <mail@dennisfleurbaaij.com>
+ *
+ * This program is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, version 3.
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License along with this program. If not, see < https://www.gnu.org/licenses/>.
+ */
+
+
+
+#include <pch.h>
+
+#include <FrameTrace.h>
+#include <PipelineLatency.h>
+
+#include "CaptureIngest.h"
+
+
+CaptureIngest::CaptureIngest(
+	IVideoFrameSink& sink,
+	uint32_t maxQueuedFrames,
+	FrameDropPolicy dropPolicy):
+	m_sink(sink),
+	m_maxQueuedFrames(maxQueuedFrames),
+	m_dropPolicy(dropPolicy)
+{
+	if (maxQueuedFrames < 1 || maxQueuedFrames > CVideoFrameRing::CAPACITY)
+		throw std::runtime_error("Capture ingest queue size out of range");
+}
+
+
+CaptureIngest::~CaptureIngest()
+{
+	if (m_ingestThread.joinable())
+		Stop();
+
+	m_ingestQueue.Purge();
+}
+
+
+void CaptureIngest::Start()
+{
+	if (m_ingestThread.joinable())
+		throw std::runtime_error("Start() called but already started");
+
+	m_isActive = true;
+	m_ingestThread = std::thread(&CaptureIngest::IngestThreadProc, this);
+}
+
+
+void CaptureIngest::Stop()
+{
+	if (!m_ingestThread.joinable())
+		throw std::runtime_error("Stop() called while not started");
+
+	m_isActive = false;
+	m_ingestQueueEvent.Set();
+	m_ingestThread.join();
+
+	m_droppedFrameCount += m_ingestQueue.Purge();
+
+	DbgLog((LOG_TRACE, 1,
+		TEXT("CaptureIngest ingested frames: %I64u, dropped: %I64u"),
+		m_ingestedFrameCount.load(), m_droppedFrameCount.load()));
+}
+
+
+void CaptureIngest::OnVideoFrame(VideoFrame& videoFrame)
+{
+	// ! WARNING: Runs in the capture thread, must never block
+
+	if (!m_isActive)
+		return;
+
+	// Only the capture thread pushes, so the queue can't fill up behind this check
+	if (m_dropPolicy == FrameDropPolicy::DROP_NEWEST && m_ingestQueue.Size() >= m_maxQueuedFrames)
+	{
+		++m_droppedFrameCount;
+		return;
+	}
+
+	// Keep the capture buffer alive until the ingest thread is done with it, the ring
+	// drops older or non-monotonic frames to make space
+	videoFrame.SetQueueTime(PipelineLatency::Now());
+	m_droppedFrameCount += m_ingestQueue.Push(VideoFrameHandle(videoFrame), m_maxQueuedFrames);
+	m_ingestQueueEvent.Set();
+
+	// Stop() might have purged the queue while we were pushing, don't leave
+	// the frame behind in that case
+	if (!m_isActive)
+		m_droppedFrameCount += m_ingestQueue.Purge();
+}
+
+
+void CaptureIngest::IngestThreadProc()
+{
+	// ! WARNING: Runs in the ingest thread
+
+	DbgLog((LOG_TRACE, 1, TEXT("CaptureIngest thread starting")));
+
+	while (m_isActive)
+	{
+		VideoFrameHandle videoFrame;
+		bool hasNextFrame = false;
+		timingclocktime_t nextFrameTimestamp = 0;
+		if (!m_ingestQueue.Pop(videoFrame, 1, hasNextFrame, nextFrameTimestamp))
+		{
+			m_ingestQueueEvent.Wait();
+			continue;
+		}
+
+		PipelineLatency::RecordSince(LatencyStage::INGEST_WAIT, videoFrame->GetQueueTime());
+		FrameTrace::RecordInstant(FrameTraceEvent::INGEST, videoFrame->GetCounter());
+
+		// The sink takes its own reference if it holds on to the frame
+		m_sink.OnVideoFrame(*videoFrame);
+		++m_ingestedFrameCount;
+	}
+
+	DbgLog((LOG_TRACE, 1, TEXT("CaptureIngest thread exiting")));
+}
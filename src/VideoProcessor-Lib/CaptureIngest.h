@@ -0,0 +1,75 @@
+/*
+ * Copyright(C) 2021 Dennis Fleurbaaij <mail@dennisfleurbaaij.com>
+ *
+ * This program is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, version 3.
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License along with this program. If not, see < https://www.gnu.org/licenses/>.
+ */
+
+
+#pragma once
+
+
+#include <atomic>
+#include <thread>
+
+#include <FrameDropPolicy.h>
+#include <IVideoFrameSink.h>
+#include <VideoFrame.h>
+#include <microsoft_directshow/live_source_filter/CVideoFrameRing.h>
+
+
+/**
+ * Hands captured frames from the capture callback thread over to a sink, like the renderer.
+ *
+ * The capture driver won't deliver the next frame until its callback returns, so anything the
+ * sink does on that thread adds to the callback residency and, if it gets long enough,
+ * makes the driver drop frames. OnVideoFrame() only takes a reference on the frame and pushes it
+ * on a bounded lock-free ring, an ingest thread then calls the sink with it.
+ *
+ * If the ingest thread falls behind frames are dropped according to the drop policy, the capture
+ * thread is never blocked.
+ */
+class CaptureIngest:
+	public IVideoFrameSink
+{
+public:
+
+	CaptureIngest(
+		IVideoFrameSink& sink,
+		uint32_t maxQueuedFrames,
+		FrameDropPolicy dropPolicy = FrameDropPolicy::DROP_OLDEST);
+	virtual ~CaptureIngest();
+
+	void Start();
+	void Stop();
+
+	// IVideoFrameSink
+	// Runs in the capture thread, never blocks. Frames are ignored while not started.
+	void OnVideoFrame(VideoFrame&) override;
+
+	// Frames dropped because the ingest queue was full or they were out of order
+	uint64_t DroppedFrameCount() const { return m_droppedFrameCount; }
+
+	// Frames handed to the sink
+	uint64_t IngestedFrameCount() const { return m_ingestedFrameCount; }
+
+private:
+
+	IVideoFrameSink& m_sink;
+	const uint32_t m_maxQueuedFrames;
+	const FrameDropPolicy m_dropPolicy;
+
+	CVideoFrameRing m_ingestQueue;
+	std::atomic_bool m_isActive = false;
+
+	// Auto-reset, set after every push to m_ingestQueue and by Stop()
+	CAMEvent m_ingestQueueEvent;
+	std::thread m_ingestThread;
+
+	std::atomic<uint64_t> m_droppedFrameCount = 0;
+	std::atomic<uint64_t> m_ingestedFrameCount = 0;
+
+	// Ingest thread function
+	void IngestThreadProc();
+};
@@ -0,0 +1,26 @@
+/*
+ * Copyright(C) 2021 Dennis Fleurbaaij <mail@dennisfleurbaaij.com>
+ *
+ * This program is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, version 3.
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License along with this program. If not, see < https://www.gnu.org/licenses/>.
+ */
+
+#include <pch.h>
+
+#include "ChromaSiting.h"
+
+
+const TCHAR* ToString(const ChromaSiting chromaSiting)
+{
+	switch (chromaSiting)
+	{
+	case ChromaSiting::LEFT:
+		return TEXT("Left (MPEG-2)");
+
+	case ChromaSiting::TOP_LEFT:
+		return TEXT("Top-left");
+	}
+
+	throw std::runtime_error("ChromaSiting ToString() failed, value not recognized");
+}
@@ -0,0 +1,30 @@
+/*
+ * Copyright(C) 2021 Dennis Fleurbaaij <mail@dennisfleurbaaij.com>
+ *
+ * This program is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, version 3.
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License along with this program. If not, see < https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+
+#include <atlstr.h>
+
+
+/**
+ * Position of the chroma samples relative to the luma samples when subsampling
+ * vertically to 4:2:0. Horizontally chroma is always co-sited with the left luma
+ * sample, as it is in the 4:2:2 input.
+ */
+enum class ChromaSiting
+{
+	// MPEG-2 style, vertically halfway between the two luma lines (also called "left")
+	LEFT,
+
+	// Co-sited with the top-left luma sample, as used by UHD BD HDR10 (chroma_loc_type 2)
+	TOP_LEFT
+};
+
+
+const TCHAR* ToString(const ChromaSiting);
@@ -0,0 +1,227 @@
+/*
+ * Copyright(C) 2021 Dennis Fleurbaaij <mail@dennisfleurbaaij.com>
+ *
+ * This program is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, version 3.
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License along with this program. If not, see < https://www.gnu.org/licenses/>.
+ */
+
+
+#include <pch.h>
+
+#include "FrameBufferPool.h"
+
+
+// Pre-faulting steps by the smallest page size
+static const size_t PRE_FAULT_STEP = 4096;
+
+
+// Large pages need SE_LOCK_MEMORY_NAME held by the user and enabled on the process token
+static bool EnableLockMemoryPrivilege()
+{
+	HANDLE token;
+	if (!OpenProcessToken(GetCurrentProcess(), TOKEN_ADJUST_PRIVILEGES | TOKEN_QUERY, &token))
+		return false;
+
+	TOKEN_PRIVILEGES privileges;
+	privileges.PrivilegeCount = 1;
+	privileges.Privileges[0].Attributes = SE_PRIVILEGE_ENABLED;
+
+	// AdjustTokenPrivileges() succeeds with ERROR_NOT_ALL_ASSIGNED if the user does not hold it
+	const bool success =
+		LookupPrivilegeValue(nullptr, SE_LOCK_MEMORY_NAME, &privileges.Privileges[0].Luid) &&
+		AdjustTokenPrivileges(token, FALSE, &privileges, 0, nullptr, nullptr) &&
+		GetLastError() == ERROR_SUCCESS;
+
+	CloseHandle(token);
+
+	return success;
+}
+
+
+//
+// FrameBuffer
+//
+
+
+FrameBuffer::FrameBuffer(FrameBufferPool& pool, BYTE* data, uint32_t index):
+	m_pool(pool),
+	m_data(data),
+	m_index(index)
+{
+	assert(data);
+}
+
+
+HRESULT	FrameBuffer::QueryInterface(REFIID iid, LPVOID* ppv)
+{
+	if (!ppv)
+		return E_INVALIDARG;
+
+	*ppv = nullptr;
+
+	if (iid == IID_IUnknown)
+	{
+		*ppv = this;
+		AddRef();
+		return S_OK;
+	}
+
+	return E_NOINTERFACE;
+}
+
+
+ULONG FrameBuffer::AddRef()
+{
+	return ++m_refCount;
+}
+
+
+ULONG FrameBuffer::Release()
+{
+	assert(m_refCount > 0);
+
+	const ULONG newRefValue = --m_refCount;
+	if (newRefValue == 0)
+		m_pool.Return(this);
+
+	return newRefValue;
+}
+
+
+//
+// FrameBufferPool
+//
+
+
+FrameBufferPool::FrameBufferPool(size_t bufferSize, uint32_t bufferCount, size_t alignment, bool largePages):
+	m_bufferSize(bufferSize)
+{
+	if (bufferSize == 0)
+		throw std::runtime_error("Frame buffer size must be > 0");
+	if (bufferCount == 0 || bufferCount >= FREE_LIST_END)
+		throw std::runtime_error("Frame buffer count out of range");
+	if (alignment == 0 || (alignment & (alignment - 1)) != 0 || alignment > ALIGNMENT_PAGE)
+		throw std::runtime_error("Frame buffer alignment must be a power of two up to a page");
+
+	// VirtualAlloc() returns page aligned memory, so rounding the stride is all that's needed
+	const size_t stride = (bufferSize + alignment - 1) & ~(alignment - 1);
+	m_memorySize = stride * bufferCount;
+
+	if (largePages)
+	{
+		// Thread-safe static init, only try to get the privilege once
+		static const bool lockMemoryPrivilegeEnabled = EnableLockMemoryPrivilege();
+
+		const size_t largePageSize = GetLargePageMinimum();
+		if (largePageSize > 0 && lockMemoryPrivilegeEnabled)
+		{
+			const size_t largePagesMemorySize = (m_memorySize + largePageSize - 1) / largePageSize * largePageSize;
+
+			m_memory = (BYTE*)VirtualAlloc(
+				nullptr, largePagesMemorySize,
+				MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE);
+
+			if (m_memory)
+			{
+				m_memorySize = largePagesMemorySize;
+				m_largePages = true;
+			}
+		}
+
+		if (!m_largePages)
+			DbgLog((LOG_TRACE, 1, TEXT("FrameBufferPool: Large pages not available, using normal pages")));
+	}
+
+	if (!m_memory)
+	{
+		m_memory = (BYTE*)VirtualAlloc(nullptr, m_memorySize, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+		if (!m_memory)
+			throw std::runtime_error("Failed to allocate frame buffers");
+	}
+
+	// All buffers start out free, in order
+	m_buffers.reserve(bufferCount);
+	m_next.reset(new std::atomic<uint32_t>[bufferCount]);
+
+	for (uint32_t i = 0; i < bufferCount; ++i)
+	{
+		m_buffers.push_back(new FrameBuffer(*this, m_memory + i * stride, i));
+		m_next[i] = (i + 1 < bufferCount) ? i + 1 : FREE_LIST_END;
+	}
+
+	m_freeListHead = MakeHead(0, 0);
+}
+
+
+FrameBufferPool::~FrameBufferPool()
+{
+	assert(m_inUseCount == 0);
+
+	for (FrameBuffer* buffer : m_buffers)
+		delete buffer;
+
+	VirtualFree(m_memory, 0, MEM_RELEASE);
+}
+
+
+FrameBuffer* FrameBufferPool::Acquire()
+{
+	uint64_t head = m_freeListHead.load(std::memory_order_acquire);
+	uint32_t index;
+
+	while (true)
+	{
+		index = HeadIndex(head);
+		if (index == FREE_LIST_END)
+		{
+			++m_missCount;
+			return nullptr;
+		}
+
+		// If another thread took this buffer in the meantime the next index might be stale,
+		// but then the tag changed and the compare-and-swap fails.
+		const uint32_t next = m_next[index].load(std::memory_order_relaxed);
+
+		if (m_freeListHead.compare_exchange_weak(head, MakeHead(next, head), std::memory_order_acquire))
+			break;
+	}
+
+	FrameBuffer* buffer = m_buffers[index];
+	assert(buffer->m_refCount == 0);
+	buffer->m_refCount = 1;
+
+	const uint32_t inUseCount = ++m_inUseCount;
+	uint32_t highWaterMark = m_highWaterMark;
+	while (inUseCount > highWaterMark && !m_highWaterMark.compare_exchange_weak(highWaterMark, inUseCount)) {}
+
+	return buffer;
+}
+
+
+void FrameBufferPool::PreFault()
+{
+	// Large pages are never paged out
+	if (m_largePages)
+		return;
+
+	// Write back what's there so that buffers in use keep their contents
+	volatile BYTE* memory = m_memory;
+	for (size_t offset = 0; offset < m_memorySize; offset += PRE_FAULT_STEP)
+		memory[offset] = memory[offset];
+}
+
+
+void FrameBufferPool::Return(FrameBuffer* buffer)
+{
+	assert(m_inUseCount > 0);
+	--m_inUseCount;
+
+	// Release, the buffer contents and next index must be visible to whoever acquires it
+	uint64_t head = m_freeListHead.load(std::memory_order_relaxed);
+	do
+	{
+		m_next[buffer->m_index].store(HeadIndex(head), std::memory_order_relaxed);
+	}
+	while (!m_freeListHead.compare_exchange_weak(head, MakeHead(buffer->m_index, head), std::memory_order_release, std::memory_order_relaxed));
+}
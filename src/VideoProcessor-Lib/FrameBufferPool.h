@@ -0,0 +1,129 @@
+/*
+ * Copyright(C) 2021 Dennis Fleurbaaij <mail@dennisfleurbaaij.com>
+ *
+ * This program is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, version 3.
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License along with this program. If not, see < https://www.gnu.org/licenses/>.
+ */
+
+
+#pragma once
+
+
+#include <atomic>
+#include <memory>
+#include <vector>
+
+
+class FrameBufferPool;
+
+
+/**
+ * A single buffer of a FrameBufferPool.
+ *
+ * It is handed out with one reference and returns to its pool on the last Release(),
+ * which makes it usable as the source buffer of a VideoFrame.
+ */
+class FrameBuffer:
+	public IUnknown
+{
+public:
+
+	BYTE* Data() const { return m_data; }
+
+	// IUnknown
+	HRESULT	QueryInterface(REFIID iid, LPVOID* ppv) override;
+	ULONG AddRef() override;
+	ULONG Release() override;
+
+private:
+
+	friend class FrameBufferPool;
+
+	FrameBuffer(FrameBufferPool& pool, BYTE* data, uint32_t index);
+
+	FrameBufferPool& m_pool;
+	BYTE* const m_data;
+	const uint32_t m_index;
+	std::atomic<ULONG> m_refCount = 0;
+};
+
+
+/**
+ * Fixed set of equally sized frame buffers which get recycled rather than reallocated.
+ *
+ * All buffers live in a single allocation made up front, each starts on a multiple of the
+ * requested alignment. Optionally this is backed by large pages, which needs the "Lock pages in
+ * memory" privilege, if that fails it silently falls back to normal pages.
+ *
+ * Acquire() and the buffer's Release() are lock-free and can be called from any thread. The free
+ * list is a stack of buffer indices, its head is tagged with a counter which changes on every
+ * update to make a concurrent pop and push-back of the same buffer detectable (ABA).
+ */
+class FrameBufferPool
+{
+public:
+
+	// Buffer start alignments
+	static const size_t ALIGNMENT_CACHE_LINE = 64;
+	static const size_t ALIGNMENT_PAGE = 4096;
+
+	FrameBufferPool(size_t bufferSize, uint32_t bufferCount, size_t alignment = ALIGNMENT_CACHE_LINE, bool largePages = false);
+
+	// All buffers must have been returned
+	~FrameBufferPool();
+
+	// Get a free buffer with a single reference, nullptr and counted as a miss if all are in use.
+	FrameBuffer* Acquire();
+
+	// Touch every page of every buffer so that no page faults happen when they are first used.
+	// Meant to be called when capture starts, not thread-safe against buffers being written.
+	void PreFault();
+
+	size_t GetBufferSize() const { return m_bufferSize; }
+	uint32_t GetBufferCount() const { return (uint32_t)m_buffers.size(); }
+	bool UsesLargePages() const { return m_largePages; }
+
+	//
+	// Stats
+	//
+
+	// Amount of buffers currently handed out
+	uint32_t GetInUseCount() const { return m_inUseCount; }
+
+	// Highest amount of buffers handed out at the same time
+	uint32_t GetHighWaterMark() const { return m_highWaterMark; }
+
+	// Amount of Acquire() calls which found no free buffer
+	uint64_t GetMissCount() const { return m_missCount; }
+
+private:
+
+	friend class FrameBuffer;
+
+	// Called by the buffer on its last Release()
+	void Return(FrameBuffer*);
+
+	// Free list head layout: tag (32 bits) | buffer index (32 bits)
+	static const uint32_t FREE_LIST_END = 0xFFFFFFFF;
+	static uint32_t HeadIndex(uint64_t head) { return (uint32_t)head; }
+	static uint64_t MakeHead(uint32_t index, uint64_t previous) { return (((previous >> 32) + 1) << 32) | index; }
+
+	const size_t m_bufferSize;
+	bool m_largePages = false;
+	BYTE* m_memory = nullptr;
+	size_t m_memorySize = 0;
+
+	std::vector<FrameBuffer*> m_buffers;
+
+	// Next free buffer index for every buffer in the free list
+	std::unique_ptr<std::atomic<uint32_t>[]> m_next;
+
+	// Written by all threads on every acquire and return, padded onto their own cache line
+	char m_padBefore[64];
+	std::atomic<uint64_t> m_freeListHead;
+	std::atomic<uint32_t> m_inUseCount = 0;
+	std::atomic<uint32_t> m_highWaterMark = 0;
+	std::atomic<uint64_t> m_missCount = 0;
+	char m_padAfter[64 - sizeof(uint64_t) * 3];
+};
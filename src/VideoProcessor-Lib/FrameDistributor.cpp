@@ -0,0 +1,139 @@
+/*
+ * Copyright(C) 2021 Dennis Fleurbaaij <mail@dennisfleurbaaij.com>
+ *
+ * This program is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, version 3.
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License along with this program. If not, see < https://www.gnu.org/licenses/>.
+ */
+
+
+
+#include <pch.h>
+
+#include "FrameDistributor.h"
+
+
+FrameDistributor::FrameDistributor()
+{
+}
+
+
+FrameDistributor::~FrameDistributor()
+{
+	if (m_started)
+		Stop();
+}
+
+
+size_t FrameDistributor::AddSink(IVideoFrameSink& sink, uint32_t maxQueuedFrames, FrameDropPolicy dropPolicy, uint32_t frameInterval)
+{
+	return AddSink(
+		sink,
+		std::unique_ptr<CaptureIngest>(new CaptureIngest(sink, maxQueuedFrames, dropPolicy)),
+		frameInterval);
+}
+
+
+size_t FrameDistributor::AddInlineSink(IVideoFrameSink& sink, uint32_t frameInterval)
+{
+	return AddSink(sink, nullptr, frameInterval);
+}
+
+
+void FrameDistributor::Start()
+{
+	if (m_started)
+		throw std::runtime_error("Start() called but already started");
+
+	for (auto& sink : m_sinks)
+	{
+		if (sink->ingest)
+			sink->ingest->Start();
+	}
+
+	m_started = true;
+	m_isActive = true;
+}
+
+
+void FrameDistributor::Stop()
+{
+	if (!m_started)
+		throw std::runtime_error("Stop() called while not started");
+
+	m_isActive = false;
+
+	// Ingest threads are drained after this, the sinks won't be called anymore
+	for (auto& sink : m_sinks)
+	{
+		if (sink->ingest)
+			sink->ingest->Stop();
+	}
+
+	m_started = false;
+
+	for (size_t i = 0; i < m_sinks.size(); ++i)
+	{
+		DbgLog((LOG_TRACE, 1,
+			TEXT("FrameDistributor sink %zu delivered frames: %I64u, dropped: %I64u"),
+			i, DeliveredFrameCount(i), DroppedFrameCount(i)));
+	}
+}
+
+
+void FrameDistributor::OnVideoFrame(VideoFrame& videoFrame)
+{
+	// ! WARNING: Runs in the capture thread
+
+	if (!m_isActive)
+		return;
+
+	for (auto& sink : m_sinks)
+	{
+		if (sink->frameCounter++ % sink->frameInterval != 0)
+			continue;
+
+		if (sink->ingest)
+		{
+			sink->ingest->OnVideoFrame(videoFrame);
+		}
+		else
+		{
+			sink->sink->OnVideoFrame(videoFrame);
+			++sink->deliveredFrameCount;
+		}
+	}
+}
+
+
+uint64_t FrameDistributor::DeliveredFrameCount(size_t sink) const
+{
+	const Sink& entry = *m_sinks.at(sink);
+	return entry.ingest ? entry.ingest->IngestedFrameCount() : entry.deliveredFrameCount.load();
+}
+
+
+uint64_t FrameDistributor::DroppedFrameCount(size_t sink) const
+{
+	const Sink& entry = *m_sinks.at(sink);
+	return entry.ingest ? entry.ingest->DroppedFrameCount() : 0;
+}
+
+
+size_t FrameDistributor::AddSink(IVideoFrameSink& sink, std::unique_ptr<CaptureIngest> ingest, uint32_t frameInterval)
+{
+	if (m_started)
+		throw std::runtime_error("Sinks can only be added while stopped");
+
+	if (frameInterval < 1)
+		throw std::runtime_error("Frame interval must be >= 1");
+
+	std::unique_ptr<Sink> newSink(new Sink());
+	newSink->sink = &sink;
+	newSink->ingest = std::move(ingest);
+	newSink->frameInterval = frameInterval;
+
+	m_sinks.push_back(std::move(newSink));
+
+	return m_sinks.size() - 1;
+}
@@ -0,0 +1,88 @@
+/*
+ * Copyright(C) 2021 Dennis Fleurbaaij <mail@dennisfleurbaaij.com>
+ *
+ * This program is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, version 3.
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License along with this program. If not, see < https://www.gnu.org/licenses/>.
+ */
+
+
+#pragma once
+
+
+#include <atomic>
+#include <memory>
+#include <vector>
+
+#include <CaptureIngest.h>
+#include <FrameDropPolicy.h>
+#include <IVideoFrameSink.h>
+#include <VideoFrame.h>
+
+
+/**
+ * Fans every captured frame out to any number of sinks without copying it.
+ *
+ * All sinks get the same frame data, each one holds its own reference on the frame's source
+ * buffer for as long as it needs it. Queued sinks get their own CaptureIngest, a bounded queue
+ * with its own drop policy and thread, so a slow sink only ever loses frames itself and never
+ * holds up the capture thread or the other sinks. Inline sinks are called on the capture thread
+ * and must never block, they're meant for sinks which queue internally already like the
+ * buffered renderer.
+ *
+ * Sinks can be given a frame interval to only get every n-th frame, for a low-rate preview for
+ * example.
+ */
+class FrameDistributor:
+	public IVideoFrameSink
+{
+public:
+
+	FrameDistributor();
+	virtual ~FrameDistributor();
+
+	// Sinks can only be added while stopped, they are called in the order they were added
+	// and are referred to by the index returned.
+	size_t AddSink(IVideoFrameSink&, uint32_t maxQueuedFrames, FrameDropPolicy, uint32_t frameInterval = 1);
+	size_t AddInlineSink(IVideoFrameSink&, uint32_t frameInterval = 1);
+
+	void Start();
+	void Stop();
+
+	// IVideoFrameSink
+	// Runs in the capture thread, never blocks unless an inline sink does.
+	// Frames are ignored while not started.
+	void OnVideoFrame(VideoFrame&) override;
+
+	size_t SinkCount() const { return m_sinks.size(); }
+
+	// Frames handed to the sink
+	uint64_t DeliveredFrameCount(size_t sink) const;
+
+	// Frames the sink's queue dropped, frames skipped for the frame interval don't count
+	uint64_t DroppedFrameCount(size_t sink) const;
+
+private:
+
+	struct Sink
+	{
+		IVideoFrameSink* sink;
+
+		// Queue and thread of a queued sink, nullptr for an inline one
+		std::unique_ptr<CaptureIngest> ingest;
+
+		uint32_t frameInterval;
+
+		// Frames seen for the frame interval, capture thread only
+		uint64_t frameCounter = 0;
+
+		// Inline sinks only, queued ones are counted by their ingest
+		std::atomic<uint64_t> deliveredFrameCount = 0;
+	};
+
+	std::vector<std::unique_ptr<Sink>> m_sinks;
+	std::atomic_bool m_isActive = false;
+	bool m_started = false;
+
+	size_t AddSink(IVideoFrameSink&, std::unique_ptr<CaptureIngest>, uint32_t frameInterval);
+};
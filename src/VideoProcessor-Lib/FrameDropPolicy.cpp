@@ -0,0 +1,27 @@
+/*
+ * Copyright(C) 2021 Dennis Fleurbaaij <mail@dennisfleurbaaij.com>
+ *
+ * This program is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, version 3.
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License along with this program. If not, see < https://www.gnu.org/licenses/>.
+ */
+
+
+#include <pch.h>
+
+#include "FrameDropPolicy.h"
+
+
+const TCHAR* ToString(const FrameDropPolicy frameDropPolicy)
+{
+	switch (frameDropPolicy)
+	{
+	case FrameDropPolicy::DROP_OLDEST:
+		return TEXT("Drop oldest");
+
+	case FrameDropPolicy::DROP_NEWEST:
+		return TEXT("Drop newest");
+	}
+
+	throw std::runtime_error("FrameDropPolicy ToString() failed, value not recognized");
+}
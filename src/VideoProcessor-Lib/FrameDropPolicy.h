@@ -0,0 +1,29 @@
+/*
+ * Copyright(C) 2021 Dennis Fleurbaaij <mail@dennisfleurbaaij.com>
+ *
+ * This program is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, version 3.
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License along with this program. If not, see < https://www.gnu.org/licenses/>.
+ */
+
+
+#pragma once
+
+
+#include <atlstr.h>
+
+
+/**
+ * What a bounded frame queue does with a new frame when it's full
+ */
+enum class FrameDropPolicy
+{
+	// Make space by dropping the oldest queued frame, for sinks which want to be current
+	DROP_OLDEST,
+
+	// Drop the new frame, for sinks which want a gap-free run of frames while they keep up
+	DROP_NEWEST
+};
+
+
+const TCHAR* ToString(const FrameDropPolicy);
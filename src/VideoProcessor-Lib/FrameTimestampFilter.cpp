@@ -0,0 +1,169 @@
+/*
+ * Copyright(C) 2021 Dennis Fleurbaaij <mail@dennisfleurbaaij.com>
+ *
+ * This program is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, version 3.
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License along with this program. If not, see < https://www.gnu.org/licenses/>.
+ */
+
+#include <pch.h>
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+#include "FrameTimestampFilter.h"
+
+
+// The measured frame duration is kept within this many ppm of nominal
+static const double MAX_FRAME_DURATION_DEVIATION_PPM = 1000.0;
+
+// A timestamp further than this many frame durations from the prediction is a discontinuity
+static const double DISCONTINUITY_FRAMES = 0.5;
+
+
+FrameTimestampFilter::FrameTimestampFilter(double nominalFrameDurationTicks, timingclocktime_t ticksPerSecond):
+	m_nominalFrameDurationTicks(nominalFrameDurationTicks),
+	m_ticksPerSecond(ticksPerSecond),
+	m_frameDurationTicks(nominalFrameDurationTicks)
+{
+	if (nominalFrameDurationTicks <= 0.0 || ticksPerSecond <= 0)
+		throw std::runtime_error("Frame duration and ticks per second must be > 0");
+}
+
+
+timingclocktime_t FrameTimestampFilter::Filter(uint64_t frameCounter, timingclocktime_t timestamp)
+{
+	if (m_sampleCount > 0)
+	{
+		const bool counterDiscontinuity = frameCounter <= m_referenceFrameCounter;
+		const bool timestampDiscontinuity =
+			!counterDiscontinuity &&
+			fabs((timestamp - m_referenceTimestamp) - Predict(frameCounter)) > (m_nominalFrameDurationTicks * DISCONTINUITY_FRAMES);
+
+		if (counterDiscontinuity || timestampDiscontinuity)
+		{
+			++m_discontinuityCount;
+			Reset();
+		}
+	}
+
+	// Raw jitter, only over directly successive frames
+	if (m_previousTimestamp != TIMING_CLOCK_TIME_INVALID && frameCounter == m_previousFrameCounter + 1)
+	{
+		const double jitter = (timestamp - m_previousTimestamp) - m_nominalFrameDurationTicks;
+		m_rawIntervalJitterSum2 += jitter * jitter;
+		++m_rawIntervalCount;
+	}
+
+	m_previousFrameCounter = frameCounter;
+	m_previousTimestamp = timestamp;
+
+	m_samples[m_sampleNext] = { frameCounter, timestamp };
+	m_sampleNext = (m_sampleNext + 1) % WINDOW_SIZE;
+	if (m_sampleCount < WINDOW_SIZE)
+		++m_sampleCount;
+
+	Fit();
+
+	const timingclocktime_t filtered = m_referenceTimestamp + (timingclocktime_t)llround(Predict(frameCounter));
+
+	const double residual = (double)(filtered - timestamp);
+	m_residualSum2 += residual * residual;
+	m_residualMax = std::max(m_residualMax, fabs(residual));
+	++m_statisticsFrameCount;
+
+	return filtered;
+}
+
+
+void FrameTimestampFilter::Reset()
+{
+	m_sampleCount = 0;
+	m_sampleNext = 0;
+	m_intercept = 0.0;
+	m_frameDurationTicks = m_nominalFrameDurationTicks;
+}
+
+
+FrameTimestampFilter::Statistics FrameTimestampFilter::TakeStatistics()
+{
+	const double usPerTick = 1000000.0 / m_ticksPerSecond;
+
+	Statistics statistics;
+	statistics.frameCount = m_statisticsFrameCount;
+	statistics.residualRmsUs = m_statisticsFrameCount ? sqrt(m_residualSum2 / m_statisticsFrameCount) * usPerTick : 0.0;
+	statistics.residualMaxUs = m_residualMax * usPerTick;
+	statistics.rawIntervalJitterRmsUs = m_rawIntervalCount ? sqrt(m_rawIntervalJitterSum2 / m_rawIntervalCount) * usPerTick : 0.0;
+	statistics.frameDurationPpm = (m_frameDurationTicks / m_nominalFrameDurationTicks - 1.0) * 1000000.0;
+	statistics.discontinuityCount = m_discontinuityCount;
+
+	m_statisticsFrameCount = 0;
+	m_residualSum2 = 0.0;
+	m_residualMax = 0.0;
+	m_rawIntervalCount = 0;
+	m_rawIntervalJitterSum2 = 0.0;
+
+	return statistics;
+}
+
+
+double FrameTimestampFilter::Predict(uint64_t frameCounter) const
+{
+	return m_intercept + m_frameDurationTicks * (double)(int64_t)(frameCounter - m_referenceFrameCounter);
+}
+
+
+void FrameTimestampFilter::Fit()
+{
+	// Nothing to fit, the prediction stays nominal
+	if (m_sampleCount == 0)
+	{
+		m_frameDurationTicks = m_nominalFrameDurationTicks;
+		m_intercept = 0.0;
+		return;
+	}
+
+	// Everything relative to the newest frame to keep the doubles small
+	const Sample& newest = m_samples[(m_sampleNext + WINDOW_SIZE - 1) % WINDOW_SIZE];
+	m_referenceFrameCounter = newest.frameCounter;
+	m_referenceTimestamp = newest.timestamp;
+
+	double sumX = 0.0;
+	double sumY = 0.0;
+	for (uint32_t i = 0; i < m_sampleCount; i++)
+	{
+		sumX += (double)(int64_t)(m_samples[i].frameCounter - m_referenceFrameCounter);
+		sumY += (double)(m_samples[i].timestamp - m_referenceTimestamp);
+	}
+
+	const double meanX = sumX / m_sampleCount;
+	const double meanY = sumY / m_sampleCount;
+
+	// Too few frames to measure the duration, lock onto nominal. A slope needs at least two
+	// frames, below that the fit is the newest frame itself.
+	static_assert(MIN_FIT_FRAMES >= 2, "Frame duration fit needs at least 2 frames");
+
+	double frameDurationTicks = m_nominalFrameDurationTicks;
+	if (m_sampleCount >= MIN_FIT_FRAMES)
+	{
+		double sxx = 0.0;
+		double sxy = 0.0;
+		for (uint32_t i = 0; i < m_sampleCount; i++)
+		{
+			const double dx = (double)(int64_t)(m_samples[i].frameCounter - m_referenceFrameCounter) - meanX;
+			const double dy = (double)(m_samples[i].timestamp - m_referenceTimestamp) - meanY;
+			sxx += dx * dx;
+			sxy += dx * dy;
+		}
+
+		const double maxDeviation = m_nominalFrameDurationTicks * MAX_FRAME_DURATION_DEVIATION_PPM / 1000000.0;
+		frameDurationTicks = std::min(std::max(
+			sxy / sxx,
+			m_nominalFrameDurationTicks - maxDeviation),
+			m_nominalFrameDurationTicks + maxDeviation);
+	}
+
+	m_frameDurationTicks = frameDurationTicks;
+	m_intercept = meanY - m_frameDurationTicks * meanX;
+}
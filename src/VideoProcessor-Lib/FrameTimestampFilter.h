@@ -0,0 +1,104 @@
+/*
+ * Copyright(C) 2021 Dennis Fleurbaaij <mail@dennisfleurbaaij.com>
+ *
+ * This program is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, version 3.
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License along with this program. If not, see < https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+
+#include <cstdint>
+
+#include <TimingClock.h>
+
+
+/**
+ * Removes the jitter from per-frame capture timestamps.
+ *
+ * The timestamps are modelled as a straight line over the frame counter, start plus counter
+ * times frame duration, fitted with least squares over a sliding window. The frame duration
+ * starts at the nominal one of the display mode and follows the measured one once there are
+ * enough frames, within a small band around nominal so a bad fit can't run away.
+ *
+ * A frame counter which does not go up or a timestamp more than half a frame from the
+ * prediction is a discontinuity, the filter then snaps to that frame and starts over.
+ *
+ * Not thread-safe.
+ */
+class FrameTimestampFilter
+{
+public:
+
+	// Amount of frames in the fit window
+	static const uint32_t WINDOW_SIZE = 128;
+
+	// Amount of frames needed before the frame duration is measured rather than nominal
+	static const uint32_t MIN_FIT_FRAMES = 16;
+
+	// Residual and jitter statistics since the last call to TakeStatistics()
+	struct Statistics
+	{
+		uint32_t frameCount;
+
+		// Filtered minus raw timestamp, in us
+		double residualRmsUs;
+		double residualMaxUs;
+
+		// Raw frame interval minus nominal, in us, this is the jitter the clock methods pass on
+		double rawIntervalJitterRmsUs;
+
+		// Measured frame duration versus nominal
+		double frameDurationPpm;
+
+		uint64_t discontinuityCount;
+	};
+
+	FrameTimestampFilter(double nominalFrameDurationTicks, timingclocktime_t ticksPerSecond);
+
+	// Take a raw frame timestamp and return the filtered one
+	timingclocktime_t Filter(uint64_t frameCounter, timingclocktime_t timestamp);
+
+	// Get the current frame duration estimate in clock ticks
+	double FrameDurationTicks() const { return m_frameDurationTicks; }
+
+	// Forget all frames
+	void Reset();
+
+	Statistics TakeStatistics();
+
+private:
+
+	struct Sample
+	{
+		uint64_t frameCounter;
+		timingclocktime_t timestamp;
+	};
+
+	const double m_nominalFrameDurationTicks;
+	const timingclocktime_t m_ticksPerSecond;
+
+	Sample m_samples[WINDOW_SIZE];
+	uint32_t m_sampleCount = 0;
+	uint32_t m_sampleNext = 0;
+
+	// Fit: timestamp = m_referenceTimestamp + m_intercept + m_frameDurationTicks * (counter - m_referenceFrameCounter)
+	uint64_t m_referenceFrameCounter = 0;
+	timingclocktime_t m_referenceTimestamp = 0;
+	double m_intercept = 0.0;
+	double m_frameDurationTicks;
+
+	// Statistics
+	uint64_t m_previousFrameCounter = 0;
+	timingclocktime_t m_previousTimestamp = TIMING_CLOCK_TIME_INVALID;
+	uint32_t m_statisticsFrameCount = 0;
+	double m_residualSum2 = 0.0;
+	double m_residualMax = 0.0;
+	uint32_t m_rawIntervalCount = 0;
+	double m_rawIntervalJitterSum2 = 0.0;
+	uint64_t m_discontinuityCount = 0;
+
+	double Predict(uint64_t frameCounter) const;
+	void Fit();
+};
@@ -0,0 +1,351 @@
+/*
+ * Copyright(C) 2021 Dennis Fleurbaaij <mail@dennisfleurbaaij.com>
+ *
+ * This program is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, version 3.
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License along with this program. If not, see < https://www.gnu.org/licenses/>.
+ */
+
+
+#include <pch.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <mutex>
+#include <vector>
+
+#include <PipelineLatency.h>
+
+#include "FrameTrace.h"
+
+
+struct FrameTraceSlot
+{
+	// Write index + 1 of the event in the slot, 0 if empty or being written
+	std::atomic<uint64_t> sequence;
+
+	std::atomic<int64_t> start;
+	std::atomic<int64_t> end;
+	std::atomic<uint64_t> frameCounter;
+	std::atomic<uint32_t> event;
+};
+
+
+struct FrameTraceThreadBuffer
+{
+	FrameTraceSlot slots[FrameTrace::THREAD_BUFFER_CAPACITY];
+
+	// Only used by the owning thread
+	uint64_t writeIndex = 0;
+
+	// Trace thread id, a new one every time the buffer gets a new owner
+	std::atomic<uint32_t> threadId;
+
+	// Guarded by the registry lock
+	bool inUse = false;
+	uint64_t releaseOrder = 0;
+
+	FrameTraceThreadBuffer()
+	{
+		for (FrameTraceSlot& slot : slots)
+			slot.sequence.store(0, std::memory_order_relaxed);
+
+		threadId.store(0, std::memory_order_relaxed);
+	}
+
+	void Clear()
+	{
+		for (FrameTraceSlot& slot : slots)
+			slot.sequence.store(0, std::memory_order_relaxed);
+	}
+};
+
+
+// All thread buffers, intentionally never freed as threads might still record during shutdown
+struct FrameTraceRegistry
+{
+	std::mutex lock;
+	std::vector<FrameTraceThreadBuffer*> buffers;
+	uint32_t nextThreadId = 1;
+	uint64_t nextReleaseOrder = 1;
+};
+
+
+// Hands the calling thread's buffer back to the registry when the thread exits
+struct FrameTraceThreadBufferHandle
+{
+	FrameTraceThreadBuffer* buffer = nullptr;
+	bool acquireFailed = false;
+
+	~FrameTraceThreadBufferHandle();
+};
+
+
+static std::atomic<bool> g_enabled(false);
+static thread_local FrameTraceThreadBufferHandle t_threadBuffer;
+
+
+static FrameTraceRegistry& Registry()
+{
+	static FrameTraceRegistry* registry = new FrameTraceRegistry();
+	return *registry;
+}
+
+
+static FrameTraceThreadBuffer* AcquireThreadBuffer()
+{
+	FrameTraceRegistry& registry = Registry();
+	std::lock_guard<std::mutex> lock(registry.lock);
+
+	FrameTraceThreadBuffer* buffer = nullptr;
+	if (registry.buffers.size() < FrameTrace::MAX_THREAD_BUFFERS)
+	{
+		buffer = new FrameTraceThreadBuffer();
+		registry.buffers.push_back(buffer);
+	}
+	else
+	{
+		// Reuse the one which was given up longest ago
+		for (FrameTraceThreadBuffer* candidate : registry.buffers)
+		{
+			if (!candidate->inUse && (!buffer || candidate->releaseOrder < buffer->releaseOrder))
+				buffer = candidate;
+		}
+
+		if (!buffer)
+			return nullptr;
+
+		buffer->Clear();
+	}
+
+	buffer->inUse = true;
+	buffer->threadId.store(registry.nextThreadId++, std::memory_order_relaxed);
+
+	return buffer;
+}
+
+
+FrameTraceThreadBufferHandle::~FrameTraceThreadBufferHandle()
+{
+	if (!buffer)
+		return;
+
+	FrameTraceRegistry& registry = Registry();
+	std::lock_guard<std::mutex> lock(registry.lock);
+
+	buffer->inUse = false;
+	buffer->releaseOrder = registry.nextReleaseOrder++;
+}
+
+
+static const char* EventName(FrameTraceEvent event)
+{
+	switch (event)
+	{
+	case FrameTraceEvent::VIDEO_INPUT_FRAME_ARRIVED:
+		return "VideoInputFrameArrived";
+
+	case FrameTraceEvent::ON_CAPTURE_DEVICE_VIDEO_FRAME:
+		return "OnCaptureDeviceVideoFrame";
+
+	case FrameTraceEvent::INGEST:
+		return "Ingest";
+
+	case FrameTraceEvent::ON_VIDEO_FRAME:
+		return "OnVideoFrame";
+
+	case FrameTraceEvent::DEQUEUE:
+		return "Dequeue";
+
+	case FrameTraceEvent::FORMAT:
+		return "FormatVideoFrame";
+
+	case FrameTraceEvent::DELIVER:
+		return "Deliver";
+	}
+
+	throw std::runtime_error("FrameTraceEvent name not recognized");
+}
+
+
+void FrameTrace::SetEnabled(bool enabled)
+{
+	g_enabled.store(enabled, std::memory_order_relaxed);
+}
+
+
+bool FrameTrace::IsEnabled()
+{
+	return g_enabled.load(std::memory_order_relaxed);
+}
+
+
+void FrameTrace::Record(FrameTraceEvent event, uint64_t frameCounter, int64_t start, int64_t end)
+{
+	assert(event < FrameTraceEvent::COUNT);
+	assert(end >= start);
+
+	if (!IsEnabled())
+		return;
+
+	FrameTraceThreadBuffer* buffer = t_threadBuffer.buffer;
+	if (!buffer)
+	{
+		// All buffers taken by live threads, this thread goes untraced
+		if (t_threadBuffer.acquireFailed)
+			return;
+
+		buffer = AcquireThreadBuffer();
+		if (!buffer)
+		{
+			t_threadBuffer.acquireFailed = true;
+			return;
+		}
+
+		t_threadBuffer.buffer = buffer;
+	}
+
+	FrameTraceSlot& slot = buffer->slots[buffer->writeIndex % THREAD_BUFFER_CAPACITY];
+
+	// Mark as being written before touching the contents
+	slot.sequence.store(0, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+
+	slot.start.store(start, std::memory_order_relaxed);
+	slot.end.store(end, std::memory_order_relaxed);
+	slot.frameCounter.store(frameCounter, std::memory_order_relaxed);
+	slot.event.store((uint32_t)event, std::memory_order_relaxed);
+
+	++buffer->writeIndex;
+	slot.sequence.store(buffer->writeIndex, std::memory_order_release);
+}
+
+
+void FrameTrace::RecordSince(FrameTraceEvent event, uint64_t frameCounter, int64_t start)
+{
+	if (IsEnabled())
+		Record(event, frameCounter, start, PipelineLatency::Now());
+}
+
+
+void FrameTrace::RecordInstant(FrameTraceEvent event, uint64_t frameCounter)
+{
+	if (IsEnabled())
+	{
+		const int64_t now = PipelineLatency::Now();
+		Record(event, frameCounter, now, now);
+	}
+}
+
+
+size_t FrameTrace::WriteChromeTrace(std::ostream& stream, int64_t since, int64_t ticksPerSecond)
+{
+	assert(ticksPerSecond > 0);
+
+	struct Event
+	{
+		uint32_t threadId;
+		FrameTraceEvent event;
+		uint64_t frameCounter;
+		int64_t start;
+		int64_t end;
+	};
+
+	std::vector<Event> events;
+
+	{
+		FrameTraceRegistry& registry = Registry();
+		std::lock_guard<std::mutex> lock(registry.lock);
+
+		for (const FrameTraceThreadBuffer* buffer : registry.buffers)
+		{
+			const uint32_t threadId = buffer->threadId.load(std::memory_order_relaxed);
+
+			for (const FrameTraceSlot& slot : buffer->slots)
+			{
+				const uint64_t sequence = slot.sequence.load(std::memory_order_acquire);
+				if (sequence == 0)
+					continue;
+
+				Event event;
+				event.threadId = threadId;
+				event.start = slot.start.load(std::memory_order_relaxed);
+				event.end = slot.end.load(std::memory_order_relaxed);
+				event.frameCounter = slot.frameCounter.load(std::memory_order_relaxed);
+				const uint32_t eventId = slot.event.load(std::memory_order_relaxed);
+
+				// Skip slots which got overwritten while reading them
+				std::atomic_thread_fence(std::memory_order_acquire);
+				if (slot.sequence.load(std::memory_order_relaxed) != sequence)
+					continue;
+
+				if (event.end < since || eventId >= (uint32_t)FrameTraceEvent::COUNT)
+					continue;
+
+				event.event = (FrameTraceEvent)eventId;
+				events.push_back(event);
+			}
+		}
+	}
+
+	std::sort(events.begin(), events.end(), [](const Event& a, const Event& b) { return a.start < b.start; });
+
+	// Relative to the first event to keep the numbers readable
+	const int64_t origin = events.empty() ? since : events.front().start;
+	const double usPerTick = 1000000.0 / ticksPerSecond;
+
+	stream << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+
+	char line[256];
+	for (size_t i = 0; i < events.size(); ++i)
+	{
+		const Event& event = events[i];
+		const double ts = (event.start - origin) * usPerTick;
+
+		if (event.end == event.start)
+		{
+			snprintf(line, sizeof(line),
+				"%s\n{\"name\":\"%s\",\"cat\":\"frame\",\"ph\":\"i\",\"s\":\"t\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"args\":{\"frame\":%llu}}",
+				i == 0 ? "" : ",", EventName(event.event), event.threadId, ts,
+				(unsigned long long)event.frameCounter);
+		}
+		else
+		{
+			snprintf(line, sizeof(line),
+				"%s\n{\"name\":\"%s\",\"cat\":\"frame\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f,\"args\":{\"frame\":%llu}}",
+				i == 0 ? "" : ",", EventName(event.event), event.threadId, ts,
+				(event.end - event.start) * usPerTick, (unsigned long long)event.frameCounter);
+		}
+
+		stream << line;
+	}
+
+	stream << "\n]}\n";
+
+	return events.size();
+}
+
+
+void FrameTrace::Clear()
+{
+	FrameTraceRegistry& registry = Registry();
+	std::lock_guard<std::mutex> lock(registry.lock);
+
+	for (FrameTraceThreadBuffer* buffer : registry.buffers)
+		buffer->Clear();
+}
+
+
+FrameTraceScope::FrameTraceScope(FrameTraceEvent event, uint64_t frameCounter):
+	m_event(event),
+	m_frameCounter(frameCounter),
+	m_start(FrameTrace::IsEnabled() ? PipelineLatency::Now() : 0)
+{
+}
+
+
+FrameTraceScope::~FrameTraceScope()
+{
+	if (m_start != 0)
+		FrameTrace::Record(m_event, m_frameCounter, m_start, PipelineLatency::Now());
+}
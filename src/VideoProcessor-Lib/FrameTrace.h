@@ -0,0 +1,106 @@
+/*
+ * Copyright(C) 2021 Dennis Fleurbaaij <mail@dennisfleurbaaij.com>
+ *
+ * This program is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, version 3.
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License along with this program. If not, see < https://www.gnu.org/licenses/>.
+ */
+
+
+#pragma once
+
+
+#include <cstdint>
+#include <ostream>
+
+
+/**
+ * Traced spans of a frame's way through the pipeline
+ */
+enum class FrameTraceEvent
+{
+	// DeckLink capture callback
+	VIDEO_INPUT_FRAME_ARRIVED,
+
+	// Capture device callback into the application
+	ON_CAPTURE_DEVICE_VIDEO_FRAME,
+
+	// Capture ingest thread handing the frame to the renderer
+	INGEST,
+
+	// Live source pin accepting the frame
+	ON_VIDEO_FRAME,
+
+	// Delivery thread taking the frame off the queue, instant
+	DEQUEUE,
+
+	FORMAT,
+	DELIVER,
+
+	COUNT
+};
+
+
+/**
+ * Process-wide flight recorder of frame trace events.
+ *
+ * Every recording thread gets its own fixed-size ring buffer, the oldest events get
+ * overwritten. Recording is a handful of relaxed stores into the thread's own buffer, nothing is
+ * shared between threads and nothing blocks. While disabled, which is the default, recording
+ * is a single load of the enabled flag.
+ *
+ * Slots are guarded by a sequence number which is cleared while the slot is written, the
+ * writer never waits for readers and readers skip slots which changed while being read.
+ *
+ * Buffers of exited threads are kept, so the events leading up to a restart can still be
+ * dumped, until MAX_THREAD_BUFFERS is reached after which they get reused.
+ *
+ * Times are in PipelineLatency::Now() ticks.
+ */
+class FrameTrace
+{
+public:
+
+	// Events per thread, at 60fps and a few events per frame a thread holds over a minute
+	static const uint32_t THREAD_BUFFER_CAPACITY = 16384;
+
+	static const uint32_t MAX_THREAD_BUFFERS = 32;
+
+	static void SetEnabled(bool enabled);
+	static bool IsEnabled();
+
+	// Record a span, start == end records an instant event
+	static void Record(FrameTraceEvent, uint64_t frameCounter, int64_t start, int64_t end);
+
+	// Record a span from start until now and an instant event now
+	static void RecordSince(FrameTraceEvent, uint64_t frameCounter, int64_t start);
+	static void RecordInstant(FrameTraceEvent, uint64_t frameCounter);
+
+	// Write all events which ended at or after since as Chrome trace event JSON, which can be
+	// opened in chrome://tracing or ui.perfetto.dev. Returns the number of events written.
+	static size_t WriteChromeTrace(std::ostream&, int64_t since, int64_t ticksPerSecond);
+
+	// Forget all recorded events, only to be called when no thread is recording
+	static void Clear();
+};
+
+
+/**
+ * Records a span from construction to destruction, if tracing was enabled at construction.
+ */
+class FrameTraceScope
+{
+public:
+
+	FrameTraceScope(FrameTraceEvent, uint64_t frameCounter = 0);
+	~FrameTraceScope();
+
+	// For spans which only learn the frame counter along the way
+	void SetFrameCounter(uint64_t frameCounter) { m_frameCounter = frameCounter; }
+
+private:
+
+	const FrameTraceEvent m_event;
+	uint64_t m_frameCounter;
+	int64_t m_start;
+};
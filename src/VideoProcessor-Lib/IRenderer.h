@@ -9,6 +9,7 @@
 #pragma once
 
 
+#include <IVideoFrameSink.h>
 #include <VideoFrame.h>
 #include <VideoState.h>
 
@@ -49,7 +50,8 @@ struct IRendererCallback
 /**
  * Video renderer interface
  */
-class IVideoRenderer
+class IVideoRenderer:
+	public IVideoFrameSink
 {
 public:
 
@@ -68,7 +70,7 @@ public:
 	// Draw the current buffer as frame
 	// VideoFrames can be buffered and they can be internally refcounted, hence non-constant
 	// ! Only can be called if Start() exectued correctly and before Stop() is called
-	virtual void OnVideoFrame(VideoFrame&) = 0;
+	void OnVideoFrame(VideoFrame&) override = 0;
 
 	// Handler for windows events for the graph's pEvent
 	virtual HRESULT OnWindowsEvent(LONG_PTR param1, LONG_PTR param2) = 0;
@@ -123,10 +125,13 @@ public:
 
 	// Get the time it took in milliseconds from the frame's capture timestamp to the point where we hand it
 	// over to the bit which puts the image on the wire. It's the furthest possible timestamp we can take.
-	// This value does not need to be per frame, sampling is fine
+	// This is the last delivered frame, see ExitLatencySampleCount() for when it changed
 	// Only valid te be called if the RendererState called back RENDERSTATE_RENDERING
 	virtual double ExitLatencyMs() const = 0;
 
+	// Get the amount of exit latency samples taken, which goes up whenever ExitLatencyMs() got a new value
+	virtual uint64_t ExitLatencySampleCount() const = 0;
+
 	// Get the amount of dropped frames due to queue actions
 	virtual uint64_t DroppedFrameCount() const = 0;
 };
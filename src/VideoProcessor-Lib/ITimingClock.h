@@ -30,6 +30,11 @@ public:
 	 */
 	virtual timingclocktime_t TimingClockNow() = 0;
 
+	/**
+	 * True if TimingClockNow() can be called, clocks of capture devices only run while capturing.
+	 */
+	virtual bool TimingClockRunning() = 0;
+
 	/**
 	 * Get ticks/second from the timing clock
 	 */
@@ -0,0 +1,29 @@
+/*
+ * Copyright(C) 2021 Dennis Fleurbaaij <mail@dennisfleurbaaij.com>
+ *
+ * This program is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, version 3.
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License along with this program. If not, see < https://www.gnu.org/licenses/>.
+ */
+
+
+#pragma once
+
+
+#include <VideoFrame.h>
+
+
+/**
+ * Interface for anything which consumes captured video frames, renderers, recorders, analysis...
+ */
+class IVideoFrameSink
+{
+public:
+
+	virtual ~IVideoFrameSink() {}
+
+	// Handle a captured frame.
+	// The frame is only valid during the call, a sink which holds on to it for longer has to
+	// take a VideoFrameHandle on it.
+	virtual void OnVideoFrame(VideoFrame&) = 0;
+};
@@ -0,0 +1,124 @@
+/*
+ * Copyright(C) 2021 Dennis Fleurbaaij <mail@dennisfleurbaaij.com>
+ *
+ * This program is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, version 3.
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License along with this program. If not, see < https://www.gnu.org/licenses/>.
+ */
+
+#include <pch.h>
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+#include "LatencyController.h"
+
+
+LatencyController::LatencyController(const Config& config):
+	m_config(config)
+{
+	if (m_config.filterTimeConstantS < 0.0)
+		throw std::runtime_error("Filter time constant must be >= 0");
+
+	if (m_config.settleMs < 0.0 || m_config.settleMs > m_config.hysteresisMs)
+		throw std::runtime_error("Settle band must be within the hysteresis band");
+
+	if (m_config.maxSlewMsPerS <= 0.0)
+		throw std::runtime_error("Slew limit must be > 0");
+
+	if (m_config.minOffsetMs > m_config.maxOffsetMs)
+		throw std::runtime_error("Minimum offset must be <= maximum offset");
+}
+
+
+void LatencyController::Reset(int offsetMs)
+{
+	m_offsetMs = std::min(std::max((double)offsetMs, m_config.minOffsetMs), m_config.maxOffsetMs);
+	m_leadMs = 0.0;
+	m_errorMs = 0.0;
+	m_filteredErrorMs = 0.0;
+	m_previousFilteredErrorMs = 0.0;
+	m_previousTimeS = 0.0;
+	m_correcting = false;
+	m_sampleCount = 0;
+	m_exitLatencySampleCount = 0;
+}
+
+
+int LatencyController::Update(double exitLatencyMs, double timeS)
+{
+	m_leadMs = -exitLatencyMs;
+	m_errorMs = m_config.targetLeadMs - m_leadMs;
+
+	// The first sample primes the filter
+	if (m_sampleCount++ == 0)
+	{
+		m_filteredErrorMs = m_errorMs;
+		m_previousFilteredErrorMs = m_errorMs;
+		m_previousTimeS = timeS;
+		return OffsetMs();
+	}
+
+	const double dt = timeS - m_previousTimeS;
+	if (dt <= 0.0)
+		return OffsetMs();
+
+	m_previousTimeS = timeS;
+
+	const double alpha = dt / (m_config.filterTimeConstantS + dt);
+	m_filteredErrorMs += alpha * (m_errorMs - m_filteredErrorMs);
+
+	const double absFilteredErrorMs = fabs(m_filteredErrorMs);
+	if (!m_correcting && absFilteredErrorMs > m_config.hysteresisMs)
+		m_correcting = true;
+	else if (m_correcting && absFilteredErrorMs < m_config.settleMs)
+		m_correcting = false;
+
+	if (m_correcting)
+	{
+		double delta =
+			m_config.kp * (m_filteredErrorMs - m_previousFilteredErrorMs) +
+			m_config.ki * m_filteredErrorMs * dt;
+
+		const double maxDelta = m_config.maxSlewMsPerS * dt;
+		delta = std::min(std::max(delta, -maxDelta), maxDelta);
+
+		m_offsetMs = std::min(std::max(m_offsetMs + delta, m_config.minOffsetMs), m_config.maxOffsetMs);
+	}
+
+	m_previousFilteredErrorMs = m_filteredErrorMs;
+
+	return OffsetMs();
+}
+
+
+int LatencyController::Update(double exitLatencyMs, uint64_t exitLatencySampleCount, double timeS)
+{
+	if (exitLatencySampleCount == m_exitLatencySampleCount)
+		return OffsetMs();
+
+	m_exitLatencySampleCount = exitLatencySampleCount;
+
+	return Update(exitLatencyMs, timeS);
+}
+
+
+int LatencyController::OffsetMs() const
+{
+	return (int)round(m_offsetMs);
+}
+
+
+LatencyController::Telemetry LatencyController::GetTelemetry() const
+{
+	Telemetry telemetry;
+	telemetry.leadMs = m_leadMs;
+	telemetry.errorMs = m_errorMs;
+	telemetry.filteredErrorMs = m_filteredErrorMs;
+	telemetry.offsetMs = m_offsetMs;
+	telemetry.correcting = m_correcting;
+	telemetry.sampleCount = m_sampleCount;
+
+	return telemetry;
+}
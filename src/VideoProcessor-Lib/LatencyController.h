@@ -0,0 +1,110 @@
+/*
+ * Copyright(C) 2021 Dennis Fleurbaaij <mail@dennisfleurbaaij.com>
+ *
+ * This program is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, version 3.
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License along with this program. If not, see < https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+
+#include <cstdint>
+
+
+/**
+ * Closed-loop controller which keeps the frame lead constant by steering the capture frame offset.
+ *
+ * The frame lead is how far ahead of its presentation time a frame is handed to the renderer,
+ * which is the negated exit latency. Raising the frame offset by 1ms raises the lead by 1ms, so
+ * holding the lead on target while the offset is adjusted gives a constant end-to-end delay.
+ *
+ * Every sample the error (target - lead) goes through a first order low-pass filter and a PI
+ * control law in velocity form, which does not wind up when the output is clamped. Corrections
+ * start when the filtered error leaves the hysteresis band and stop once it is back within the
+ * inner (settle) band, in between the offset is left alone. The offset never moves faster than
+ * the slew limit to prevent visible jumps.
+ *
+ * Not thread-safe, samples and reads are expected from a single (GUI) thread.
+ */
+class LatencyController
+{
+public:
+
+	struct Config
+	{
+		// Frame lead to hold
+		double targetLeadMs = 0.0;
+
+		// PI gains, proportional on the change of the error and integral per second
+		double kp = 0.2;
+		double ki = 0.5;
+
+		// Time constant of the error low-pass filter
+		double filterTimeConstantS = 1.0;
+
+		// Start correcting above this absolute filtered error, stop below the settle band
+		double hysteresisMs = 1.0;
+		double settleMs = 0.5;
+
+		// Maximum change of the offset per second
+		double maxSlewMsPerS = 2.0;
+
+		// Offset limits
+		double minOffsetMs = -1000.0;
+		double maxOffsetMs = 1000.0;
+	};
+
+	struct Telemetry
+	{
+		// Last sample
+		double leadMs;
+
+		// Last unfiltered and filtered error, target - lead
+		double errorMs;
+		double filteredErrorMs;
+
+		// Requested offset, unrounded
+		double offsetMs;
+
+		// True if outside of the hysteresis band and correcting
+		bool correcting;
+
+		uint64_t sampleCount;
+	};
+
+	LatencyController(const Config&);
+
+	// Start over from the given offset, this forgets all filter state
+	void Reset(int offsetMs);
+
+	// Process a new exit latency sample taken at timeS (seconds, any monotonic origin).
+	// Returns the frame offset in ms to apply, which is the previous one if nothing changed.
+	int Update(double exitLatencyMs, double timeS);
+
+	// As above for an exit latency which is refreshed on its own schedule, exitLatencySampleCount
+	// is the amount of measurements taken so far. A measurement which was already processed is
+	// skipped rather than integrated again.
+	int Update(double exitLatencyMs, uint64_t exitLatencySampleCount, double timeS);
+
+	// Get the current frame offset in ms
+	int OffsetMs() const;
+
+	Telemetry GetTelemetry() const;
+
+	const Config& GetConfig() const { return m_config; }
+
+private:
+
+	const Config m_config;
+
+	double m_offsetMs = 0.0;
+	double m_leadMs = 0.0;
+	double m_errorMs = 0.0;
+	double m_filteredErrorMs = 0.0;
+	double m_previousFilteredErrorMs = 0.0;
+	double m_previousTimeS = 0.0;
+	bool m_correcting = false;
+	uint64_t m_sampleCount = 0;
+	uint64_t m_exitLatencySampleCount = 0;
+};
@@ -0,0 +1,141 @@
+/*
+ * Copyright(C) 2021 Dennis Fleurbaaij <mail@dennisfleurbaaij.com>
+ *
+ * This program is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, version 3.
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License along with this program. If not, see < https://www.gnu.org/licenses/>.
+ */
+
+
+#include <pch.h>
+
+#include <cmath>
+
+#include "LatencyHistogram.h"
+
+
+LatencyHistogram::LatencyHistogram()
+{
+	Reset();
+}
+
+
+void LatencyHistogram::Record(uint64_t value)
+{
+	m_buckets[BucketIndex(value)].fetch_add(1, std::memory_order_relaxed);
+
+	uint64_t max = m_max.load(std::memory_order_relaxed);
+	while (value > max)
+	{
+		if (m_max.compare_exchange_weak(max, value, std::memory_order_relaxed))
+			break;
+	}
+}
+
+
+LatencyHistogram::Snapshot LatencyHistogram::GetSnapshot() const
+{
+	uint32_t counts[BUCKET_COUNT];
+	uint64_t total = 0;
+
+	for (unsigned int i = 0; i < BUCKET_COUNT; ++i)
+	{
+		counts[i] = m_buckets[i].load(std::memory_order_relaxed);
+		total += counts[i];
+	}
+
+	Snapshot snapshot;
+	snapshot.count = total;
+	if (total == 0)
+		return snapshot;
+
+	snapshot.max = m_max.load(std::memory_order_relaxed);
+	snapshot.p50 = ValueAtQuantile(counts, total, 0.5, snapshot.max);
+	snapshot.p99 = ValueAtQuantile(counts, total, 0.99, snapshot.max);
+	snapshot.p999 = ValueAtQuantile(counts, total, 0.999, snapshot.max);
+
+	return snapshot;
+}
+
+
+void LatencyHistogram::Reset()
+{
+	for (unsigned int i = 0; i < BUCKET_COUNT; ++i)
+		m_buckets[i].store(0, std::memory_order_relaxed);
+
+	m_max.store(0, std::memory_order_relaxed);
+}
+
+
+unsigned int LatencyHistogram::BucketIndex(uint64_t value)
+{
+	if (value < SUB_BUCKET_COUNT)
+		return (unsigned int)value;
+
+	// Position of the highest set bit
+	unsigned int exponent = 0;
+	uint64_t v = value;
+	if (v >> 32) { v >>= 32; exponent += 32; }
+	if (v >> 16) { v >>= 16; exponent += 16; }
+	if (v >> 8) { v >>= 8; exponent += 8; }
+	if (v >> 4) { v >>= 4; exponent += 4; }
+	if (v >> 2) { v >>= 2; exponent += 2; }
+	if (v >> 1) { exponent += 1; }
+
+	if (exponent > MAX_EXPONENT)
+		return BUCKET_COUNT - 1;
+
+	const unsigned int subBucket = (unsigned int)(value >> (exponent - SUB_BUCKET_BITS)) & (SUB_BUCKET_COUNT - 1);
+	return (exponent - SUB_BUCKET_BITS + 1) * SUB_BUCKET_COUNT + subBucket;
+}
+
+
+uint64_t LatencyHistogram::BucketLowerBound(unsigned int index)
+{
+	assert(index < BUCKET_COUNT);
+
+	if (index < SUB_BUCKET_COUNT)
+		return index;
+
+	const unsigned int exponent = index / SUB_BUCKET_COUNT + SUB_BUCKET_BITS - 1;
+	const uint64_t subBucket = index % SUB_BUCKET_COUNT;
+	return (SUB_BUCKET_COUNT + subBucket) << (exponent - SUB_BUCKET_BITS);
+}
+
+
+uint64_t LatencyHistogram::BucketUpperBound(unsigned int index)
+{
+	assert(index < BUCKET_COUNT);
+
+	if (index < SUB_BUCKET_COUNT)
+		return index;
+
+	const unsigned int exponent = index / SUB_BUCKET_COUNT + SUB_BUCKET_BITS - 1;
+	return BucketLowerBound(index) + (1ULL << (exponent - SUB_BUCKET_BITS)) - 1;
+}
+
+
+uint64_t LatencyHistogram::ValueAtQuantile(const uint32_t* counts, uint64_t total, double quantile, uint64_t max)
+{
+	// Rank of the value, 1-based
+	uint64_t rank = (uint64_t)std::ceil(quantile * total);
+	if (rank < 1)
+		rank = 1;
+
+	uint64_t seen = 0;
+	for (unsigned int i = 0; i < BUCKET_COUNT; ++i)
+	{
+		seen += counts[i];
+		if (seen >= rank)
+		{
+			const uint64_t lower = BucketLowerBound(i);
+			const uint64_t value = lower + (BucketUpperBound(i) - lower) / 2;
+
+			// The maximum might have been read before a concurrent record of this bucket,
+			// in which case the bucket is the better estimate
+			return (max >= lower && value > max) ? max : value;
+		}
+	}
+
+	return max;
+}
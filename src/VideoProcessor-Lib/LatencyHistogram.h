@@ -0,0 +1,74 @@
+/*
+ * Copyright(C) 2021 Dennis Fleurbaaij <mail@dennisfleurbaaij.com>
+ *
+ * This program is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, version 3.
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License along with this program. If not, see < https://www.gnu.org/licenses/>.
+ */
+
+
+#pragma once
+
+
+#include <atomic>
+#include <cstdint>
+
+
+/**
+ * Lock-free log-linear histogram of non-negative integer values, intended for latencies in us.
+ *
+ * Values below 16 get a bucket each, above that every power of two is split into 16 linear
+ * sub-buckets which bounds the relative error of a reported percentile to 1/16th. Values beyond
+ * the largest bucket are counted in it, the maximum is tracked exactly.
+ *
+ * Record() is wait-free apart from the maximum and can be called from any number of threads
+ * concurrently with GetSnapshot(). A snapshot taken while recording is not atomic as a whole,
+ * but its percentiles are always computed over the bucket counts it read.
+ */
+class LatencyHistogram
+{
+public:
+
+	static const unsigned int SUB_BUCKET_BITS = 4;
+	static const unsigned int SUB_BUCKET_COUNT = 1 << SUB_BUCKET_BITS;
+
+	// Highest power of two with buckets of its own, 2^26us is about 67 seconds
+	static const unsigned int MAX_EXPONENT = 26;
+
+	static const unsigned int BUCKET_COUNT = (MAX_EXPONENT - SUB_BUCKET_BITS + 2) * SUB_BUCKET_COUNT;
+
+	struct Snapshot
+	{
+		uint64_t count = 0;
+
+		// Percentiles are the midpoint of the bucket they fall in, clamped to the maximum
+		uint64_t p50 = 0;
+		uint64_t p99 = 0;
+		uint64_t p999 = 0;
+		uint64_t max = 0;
+	};
+
+	LatencyHistogram();
+
+	// Count a value
+	void Record(uint64_t value);
+
+	// Get the percentiles over all values recorded since the last reset
+	Snapshot GetSnapshot() const;
+
+	// Forget all values, values recorded concurrently might or might not survive this
+	void Reset();
+
+	// Bucket a value is counted in and the range of values in that bucket, for tests
+	static unsigned int BucketIndex(uint64_t value);
+	static uint64_t BucketLowerBound(unsigned int index);
+	static uint64_t BucketUpperBound(unsigned int index);
+
+private:
+
+	std::atomic<uint32_t> m_buckets[BUCKET_COUNT];
+	std::atomic<uint64_t> m_max;
+
+	// Value at the given quantile of the sorted counts
+	static uint64_t ValueAtQuantile(const uint32_t* counts, uint64_t total, double quantile, uint64_t max);
+};
@@ -0,0 +1,289 @@
+/*
+ * Copyright(C) 2021 Dennis Fleurbaaij <mail@dennisfleurbaaij.com>
+ *
+ * This program is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, version 3.
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License along with this program. If not, see < https://www.gnu.org/licenses/>.
+ */
+
+
+#include <pch.h>
+
+#include <FrameTrace.h>
+#include <PipelineLatency.h>
+#include <video_frame_formatter/CSlicedVideoFrameFormatter.h>
+#include <video_frame_formatter/VideoFrameConversion.h>
+
+#include "NullVideoRenderer.h"
+
+
+NullVideoRenderer::NullVideoRenderer(
+	IRendererCallback& callback,
+	ITimingClock* timingClock,
+	size_t frameQueueMaxSize,
+	VideoConversionOverride videoConversionOverride,
+	unsigned int formatterSliceCount):
+	m_callback(callback),
+	m_timingClock(timingClock),
+	m_videoConversionOverride(videoConversionOverride),
+	m_formatterSliceCount(formatterSliceCount)
+{
+	if (!timingClock)
+		throw std::runtime_error("Null renderer needs a timing clock");
+
+	if (timingClock->TimingClockTicksPerSecond() < 1000LL)
+		throw std::runtime_error("TimingClock needs resolution of at least millisecond level");
+
+	SetFrameQueueMaxSize(frameQueueMaxSize);
+}
+
+
+NullVideoRenderer::~NullVideoRenderer()
+{
+	if (m_deliveryThread.joinable())
+		Stop();
+
+	m_videoFrameQueue.Purge();
+}
+
+
+bool NullVideoRenderer::OnVideoState(VideoStateComPtr& videoState)
+{
+	if (!videoState)
+		throw std::runtime_error("null video state is invalid");
+
+	if (m_videoState)
+	{
+		// Unacceptable changes to this renderer, return false and get cleaned up
+		if (videoState->valid == false ||
+			videoState->colorspace != m_videoState->colorspace ||
+			videoState->eotf != m_videoState->eotf ||
+			*(videoState->displayMode) != *(m_videoState->displayMode) ||
+			videoState->videoFrameEncoding != m_videoState->videoFrameEncoding)
+		{
+			return false;
+		}
+	}
+	else
+	{
+		// No video state yet, initialize
+		m_videoState = videoState;
+	}
+
+	// All good, continue
+	return true;
+}
+
+
+void NullVideoRenderer::OnVideoFrame(VideoFrame& videoFrame)
+{
+	// ! WARNING: Runs in the capture thread, must never block
+
+	assert(m_state == RendererState::RENDERSTATE_RENDERING);
+
+	// Get delay until now once in a while
+	if (m_frameCounter % 20 == 0)
+	{
+		m_frameLatencyEntry = TimingClockDiffMs(
+			videoFrame.GetTimingTimestamp(), m_timingClock->TimingClockNow(), m_timingClock->TimingClockTicksPerSecond());
+	}
+
+	++m_frameCounter;
+
+	if (!m_isActive)
+		return;
+
+	FrameTraceScope frameTrace(FrameTraceEvent::ON_VIDEO_FRAME, videoFrame.GetCounter());
+
+	videoFrame.SetQueueTime(PipelineLatency::Now());
+	PipelineLatency::RecordSince(LatencyStage::CALLBACK_TO_ENQUEUE, videoFrame.GetArrivalTime());
+
+	// Prevent from getting cleaned up and add to queue, the ring drops older or
+	// non-monotonic frames to make space
+	m_droppedFrameCount += m_videoFrameQueue.Push(VideoFrameHandle(videoFrame), m_frameQueueMaxSize);
+	m_frameQueueEvent.Set();
+
+	// Stop() might have purged the queue while we were pushing, don't leave
+	// the frame behind in that case
+	if (!m_isActive)
+		m_droppedFrameCount += m_videoFrameQueue.Purge();
+}
+
+
+void NullVideoRenderer::Build()
+{
+	assert(m_videoState);
+	assert(!m_videoFrameFormatter);
+
+	// Same choice as the MPC video renderer
+	const VideoFrameConversion videoFrameConversion =
+		VideoFrameConversionPick(m_videoState->videoFrameEncoding, m_videoConversionOverride);
+
+	m_videoFrameFormatter.reset(VideoFrameConversionFormatter(videoFrameConversion));
+	m_formatterName = ToString(videoFrameConversion);
+
+	m_videoFrameFormatter->OnVideoState(m_videoState);
+
+	if (m_formatterSliceCount > 1)
+	{
+		m_videoFrameFormatter.reset(new CSlicedVideoFrameFormatter(m_videoFrameFormatter.release(), m_formatterSliceCount));
+		m_videoFrameFormatter->OnVideoState(m_videoState);
+	}
+
+	m_samplePool.reset(new FrameBufferPool(
+		m_videoFrameFormatter->GetOutFrameSize(),
+		1,
+		FrameBufferPool::ALIGNMENT_PAGE));
+
+	// Don't take the page faults on the first frames
+	m_samplePool->PreFault();
+
+	SetState(RendererState::RENDERSTATE_READY);
+}
+
+
+void NullVideoRenderer::Start()
+{
+	if (!m_samplePool)
+		throw std::runtime_error("Call Build() before Start()");
+
+	if (m_deliveryThread.joinable())
+		throw std::runtime_error("Start() called but already started");
+
+	m_isActive = true;
+	m_deliveryThread = std::thread(&NullVideoRenderer::DeliveryThreadProc, this);
+
+	SetState(RendererState::RENDERSTATE_RENDERING);
+}
+
+
+void NullVideoRenderer::Stop()
+{
+	if (!m_deliveryThread.joinable())
+		throw std::runtime_error("Stop() called while not started");
+
+	SetState(RendererState::RENDERSTATE_STOPPING);
+
+	m_isActive = false;
+	m_frameQueueEvent.Set();
+	m_deliveryThread.join();
+
+	m_videoFrameQueue.Purge();
+
+	DbgLog((LOG_TRACE, 1,
+		TEXT("NullVideoRenderer delivered frames: %I64u, dropped: %I64u"),
+		m_deliveredFrameCount.load(), m_droppedFrameCount.load()));
+
+	SetState(RendererState::RENDERSTATE_STOPPED);
+}
+
+
+void NullVideoRenderer::Reset()
+{
+	m_videoFrameQueue.Purge();
+	m_frameCounter = 0;
+}
+
+
+void NullVideoRenderer::SetFrameQueueMaxSize(size_t frameQueueMaxSize)
+{
+	if (frameQueueMaxSize <= 0)
+		throw std::runtime_error("Frame queue size must be > 0");
+
+	if (frameQueueMaxSize > CVideoFrameRing::CAPACITY)
+		frameQueueMaxSize = CVideoFrameRing::CAPACITY;
+
+	m_frameQueueMaxSize = (uint32_t)frameQueueMaxSize;
+}
+
+
+size_t NullVideoRenderer::GetFrameQueueSize()
+{
+	return m_videoFrameQueue.Size();
+}
+
+
+double NullVideoRenderer::EntryLatencyMs() const
+{
+	if (m_state != RendererState::RENDERSTATE_RENDERING)
+		throw std::runtime_error("Invalid state, can only be called while rendering");
+
+	return m_frameLatencyEntry;
+}
+
+
+double NullVideoRenderer::ExitLatencyMs() const
+{
+	if (m_state != RendererState::RENDERSTATE_RENDERING)
+		throw std::runtime_error("Invalid state, can only be called while rendering");
+
+	return m_frameLatencyExit;
+}
+
+
+uint64_t NullVideoRenderer::ExitLatencySampleCount() const
+{
+	return m_frameLatencyExitSampleCount;
+}
+
+
+uint64_t NullVideoRenderer::DroppedFrameCount() const
+{
+	return m_droppedFrameCount;
+}
+
+
+void NullVideoRenderer::SetState(RendererState state)
+{
+	DbgLog((LOG_TRACE, 1, TEXT("NullVideoRenderer::SetState(): %s"), ToString(state)));
+
+	assert(m_state != state);
+
+	m_state = state;
+	m_callback.OnRendererState(state);
+}
+
+
+void NullVideoRenderer::DeliveryThreadProc()
+{
+	// ! WARNING: Runs in the delivery thread
+
+	DbgLog((LOG_TRACE, 1, TEXT("NullVideoRenderer delivery thread starting")));
+
+	while (m_isActive)
+	{
+		VideoFrameHandle videoFrame;
+		bool hasNextFrame = false;
+		timingclocktime_t nextFrameTimestamp = 0;
+		if (!m_videoFrameQueue.Pop(videoFrame, 1, hasNextFrame, nextFrameTimestamp))
+		{
+			m_frameQueueEvent.Wait();
+			continue;
+		}
+
+		PipelineLatency::RecordSince(LatencyStage::QUEUE_WAIT, videoFrame->GetQueueTime());
+		FrameTrace::RecordInstant(FrameTraceEvent::DEQUEUE, videoFrame->GetCounter());
+
+		// The sample is only in use here, so it always is free
+		FrameBuffer* sample = m_samplePool->Acquire();
+		assert(sample);
+
+		const int64_t formatStart = PipelineLatency::Now();
+		const bool formatSuccess = m_videoFrameFormatter->FormatVideoFrame(*videoFrame, sample->Data());
+		PipelineLatency::RecordSince(LatencyStage::FORMAT, formatStart);
+		FrameTrace::RecordSince(FrameTraceEvent::FORMAT, videoFrame->GetCounter(), formatStart);
+
+		if (formatSuccess)
+		{
+			m_frameLatencyExit = TimingClockDiffMs(
+				videoFrame->GetTimingTimestamp(), m_timingClock->TimingClockNow(), m_timingClock->TimingClockTicksPerSecond());
+			++m_frameLatencyExitSampleCount;
+
+			++m_deliveredFrameCount;
+		}
+
+		sample->Release();
+	}
+
+	DbgLog((LOG_TRACE, 1, TEXT("NullVideoRenderer delivery thread exiting")));
+}
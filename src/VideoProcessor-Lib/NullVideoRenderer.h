@@ -0,0 +1,107 @@
+/*
+ * Copyright(C) 2021 Dennis Fleurbaaij <mail@dennisfleurbaaij.com>
+ *
+ * This program is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, version 3.
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License along with this program. If not, see < https://www.gnu.org/licenses/>.
+ */
+
+
+#pragma once
+
+
+#include <atomic>
+#include <memory>
+#include <thread>
+
+#include <FrameBufferPool.h>
+#include <IRenderer.h>
+#include <ITimingClock.h>
+#include <VideoConversionOverride.h>
+#include <video_frame_formatter/IVideoFrameFormatter.h>
+#include <microsoft_directshow/live_source_filter/CVideoFrameRing.h>
+
+
+/**
+ * Video renderer which formats every frame and then throws it away.
+ *
+ * This runs the same formatter and queue stack as the DirectShow renderers, a lock-free frame
+ * queue which is drained by a delivery thread that formats into sample buffers, but without a
+ * window, graph or GPU. It's meant for headless benchmarking of the pipeline.
+ *
+ * The formatter is picked by VideoFrameConversionPick() like the MPC video renderer does, optionally sliced.
+ */
+class NullVideoRenderer:
+	public IVideoRenderer
+{
+public:
+
+	NullVideoRenderer(
+		IRendererCallback& callback,
+		ITimingClock* timingClock,
+		size_t frameQueueMaxSize,
+		VideoConversionOverride videoConversionOverride,
+		unsigned int formatterSliceCount);
+	virtual ~NullVideoRenderer();
+
+	// IVideoRenderer
+	bool OnVideoState(VideoStateComPtr&) override;
+	void OnVideoFrame(VideoFrame& videoFrame) override;
+	HRESULT OnWindowsEvent(LONG_PTR param1, LONG_PTR param2) override { return S_OK; }
+	void Build() override;
+	void Start() override;
+	void Stop() override;
+	void Reset() override;
+	void OnSize() override {}
+	void OnPaint() override {}
+	void SetFrameQueueMaxSize(size_t) override;
+	size_t GetFrameQueueSize() override;
+	double EntryLatencyMs() const override;
+	double ExitLatencyMs() const override;
+	uint64_t ExitLatencySampleCount() const override;
+	uint64_t DroppedFrameCount() const override;
+
+	// Amount of frames formatted and thrown away
+	uint64_t DeliveredFrameCount() const { return m_deliveredFrameCount; }
+
+	// Name of the formatter in use, valid after Build()
+	const TCHAR* FormatterName() const { return m_formatterName; }
+
+private:
+
+	IRendererCallback& m_callback;
+	ITimingClock* m_timingClock;
+	VideoStateComPtr m_videoState;
+	VideoConversionOverride m_videoConversionOverride;
+	unsigned int m_formatterSliceCount;
+
+	std::unique_ptr<IVideoFrameFormatter> m_videoFrameFormatter;
+	const TCHAR* m_formatterName = TEXT("None");
+
+	// Stand-in for the renderer's samples, only the delivery thread uses one at a time
+	std::unique_ptr<FrameBufferPool> m_samplePool;
+
+	std::atomic<uint32_t> m_frameQueueMaxSize;
+	CVideoFrameRing m_videoFrameQueue;
+	std::atomic_bool m_isActive = false;
+
+	// Auto-reset, set after every push to m_videoFrameQueue and by Stop()
+	CAMEvent m_frameQueueEvent;
+	std::thread m_deliveryThread;
+
+	uint64_t m_frameCounter = 0;
+	double m_frameLatencyEntry = 0.0;
+	std::atomic<double> m_frameLatencyExit = 0.0;
+	std::atomic<uint64_t> m_frameLatencyExitSampleCount = 0;
+	std::atomic<uint64_t> m_deliveredFrameCount = 0;
+	std::atomic<uint64_t> m_droppedFrameCount = 0;
+
+	// Use SetState()
+	RendererState m_state = RendererState::RENDERSTATE_UNKNOWN;
+
+	// Helper for state setting and callbacks
+	void SetState(RendererState state);
+
+	// Delivery thread function
+	void DeliveryThreadProc();
+};
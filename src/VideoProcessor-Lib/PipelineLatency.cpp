@@ -0,0 +1,105 @@
+/*
+ * Copyright(C) 2021 Dennis Fleurbaaij <mail@dennisfleurbaaij.com>
+ *
+ * This program is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, version 3.
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License along with this program. If not, see < https://www.gnu.org/licenses/>.
+ */
+
+
+#include <pch.h>
+
+#include "PipelineLatency.h"
+
+
+static LatencyHistogram g_stageHistograms[(int)LatencyStage::COUNT];
+
+
+const TCHAR* ToString(const LatencyStage stage)
+{
+	switch (stage)
+	{
+	case LatencyStage::HARDWARE_TO_CALLBACK:
+		return TEXT("Hardware to callback");
+
+	case LatencyStage::CALLBACK_RESIDENCY:
+		return TEXT("Callback residency");
+
+	case LatencyStage::INGEST_WAIT:
+		return TEXT("Ingest wait");
+
+	case LatencyStage::CALLBACK_TO_ENQUEUE:
+		return TEXT("Callback to enqueue");
+
+	case LatencyStage::QUEUE_WAIT:
+		return TEXT("Queue wait");
+
+	case LatencyStage::FORMAT:
+		return TEXT("Format");
+
+	case LatencyStage::DELIVERY_BUFFER_WAIT:
+		return TEXT("Delivery buffer wait");
+
+	case LatencyStage::DELIVER:
+		return TEXT("Deliver");
+	}
+
+	throw std::runtime_error("LatencyStage ToString() failed, value not recognized");
+}
+
+
+int64_t PipelineLatency::Now()
+{
+	LARGE_INTEGER now;
+	QueryPerformanceCounter(&now);
+	return now.QuadPart;
+}
+
+
+int64_t PipelineLatency::TicksPerSecond()
+{
+	static const int64_t frequency = []()
+	{
+		LARGE_INTEGER f;
+		QueryPerformanceFrequency(&f);
+		return (int64_t)f.QuadPart;
+	}();
+
+	return frequency;
+}
+
+
+void PipelineLatency::Record(LatencyStage stage, uint64_t us)
+{
+	assert(stage < LatencyStage::COUNT);
+
+	g_stageHistograms[(int)stage].Record(us);
+}
+
+
+void PipelineLatency::RecordSince(LatencyStage stage, int64_t start)
+{
+	if (start == 0)
+		return;
+
+	const int64_t elapsed = Now() - start;
+	if (elapsed < 0)
+		return;
+
+	Record(stage, (uint64_t)(elapsed * (1000000.0 / TicksPerSecond())));
+}
+
+
+LatencyHistogram::Snapshot PipelineLatency::GetSnapshot(LatencyStage stage)
+{
+	assert(stage < LatencyStage::COUNT);
+
+	return g_stageHistograms[(int)stage].GetSnapshot();
+}
+
+
+void PipelineLatency::Reset()
+{
+	for (LatencyHistogram& histogram : g_stageHistograms)
+		histogram.Reset();
+}
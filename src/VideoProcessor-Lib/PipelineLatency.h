@@ -0,0 +1,81 @@
+/*
+ * Copyright(C) 2021 Dennis Fleurbaaij <mail@dennisfleurbaaij.com>
+ *
+ * This program is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, version 3.
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License along with this program. If not, see < https://www.gnu.org/licenses/>.
+ */
+
+
+#pragma once
+
+
+#include <atlstr.h>
+
+#include <LatencyHistogram.h>
+
+
+/**
+ * The stages a captured frame goes through on its way to the renderer
+ */
+enum class LatencyStage
+{
+	// Hardware timestamp of the frame to the capture callback, timing clock, sampled every 20 frames
+	HARDWARE_TO_CALLBACK,
+
+	// Time spent in the capture callback, from arrival until it returns to the driver
+	CALLBACK_RESIDENCY,
+
+	// Time spent in the capture ingest queue, until handed to the renderer
+	INGEST_WAIT,
+
+	// Capture callback to the frame being queued for delivery, includes formatting at ingest
+	CALLBACK_TO_ENQUEUE,
+
+	// Time spent in the delivery queue
+	QUEUE_WAIT,
+
+	// Formatting the frame, either into the sample or into the ingest buffer
+	FORMAT,
+
+	// Waiting for the renderer to release a sample
+	DELIVERY_BUFFER_WAIT,
+
+	// Delivering the sample to the renderer
+	DELIVER,
+
+	COUNT
+};
+
+
+const TCHAR* ToString(const LatencyStage stage);
+
+
+/**
+ * Process-wide per-stage latency histograms, always on.
+ *
+ * Recording is lock-free and cheap enough to do for every frame from the capture, formatting
+ * and delivery threads. Snapshots can be polled from any thread.
+ */
+class PipelineLatency
+{
+public:
+
+	// Current performance counter, the timebase of RecordSince()
+	static int64_t Now();
+
+	// Frequency of Now()
+	static int64_t TicksPerSecond();
+
+	// Record a latency in us
+	static void Record(LatencyStage, uint64_t us);
+
+	// Record the time from start, which was taken with Now(), until now.
+	// Start times of 0 are taken as unknown and ignored.
+	static void RecordSince(LatencyStage, int64_t start);
+
+	static LatencyHistogram::Snapshot GetSnapshot(LatencyStage);
+
+	// Forget everything recorded so far for all stages
+	static void Reset();
+};
@@ -0,0 +1,92 @@
+/*
+ * Copyright(C) 2021 Dennis Fleurbaaij <mail@dennisfleurbaaij.com>
+ *
+ * This program is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, version 3.
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License along with this program. If not, see < https://www.gnu.org/licenses/>.
+ */
+
+#include <pch.h>
+
+#include <intrin.h>
+#include <immintrin.h>
+
+#include "SimdLevel.h"
+
+
+// CPUID bits, see the Intel SDM vol 2A "CPUID - CPU Identification"
+#define CPUID_1_ECX_SSSE3 (1 << 9)
+#define CPUID_1_ECX_OSXSAVE (1 << 27)
+#define CPUID_1_ECX_AVX (1 << 28)
+#define CPUID_7_EBX_AVX2 (1 << 5)
+#define CPUID_7_EBX_AVX512F (1 << 16)
+#define CPUID_7_EBX_AVX512BW (1 << 30)
+
+// XCR0 bits which the OS sets if it saves the register state on context switches
+#define XCR0_SSE_AVX 0x06  // XMM + YMM
+#define XCR0_AVX512 0xE0  // opmask + ZMM_Hi256 + Hi16_ZMM
+
+
+static SimdLevel DetectSimdLevel()
+{
+	int regs[4];  // eax, ebx, ecx, edx
+
+	__cpuid(regs, 0);
+	const int maxLeaf = regs[0];
+
+	__cpuid(regs, 1);
+	const int ecx1 = regs[2];
+
+	if (!(ecx1 & CPUID_1_ECX_SSSE3))
+		return SimdLevel::SCALAR;
+
+	// Everything above SSE needs the OS to preserve the wider registers
+	if (!(ecx1 & CPUID_1_ECX_OSXSAVE) || !(ecx1 & CPUID_1_ECX_AVX) || maxLeaf < 7)
+		return SimdLevel::SSSE3;
+
+	const unsigned long long xcr0 = _xgetbv(0);
+	if ((xcr0 & XCR0_SSE_AVX) != XCR0_SSE_AVX)
+		return SimdLevel::SSSE3;
+
+	__cpuidex(regs, 7, 0);
+	const int ebx7 = regs[1];
+
+	if (!(ebx7 & CPUID_7_EBX_AVX2))
+		return SimdLevel::SSSE3;
+
+	if ((ebx7 & CPUID_7_EBX_AVX512F) &&
+		(ebx7 & CPUID_7_EBX_AVX512BW) &&
+		(xcr0 & XCR0_AVX512) == XCR0_AVX512)
+		return SimdLevel::AVX512;
+
+	return SimdLevel::AVX2;
+}
+
+
+const TCHAR* ToString(const SimdLevel simdLevel)
+{
+	switch (simdLevel)
+	{
+	case SimdLevel::SCALAR:
+		return TEXT("Scalar");
+
+	case SimdLevel::SSSE3:
+		return TEXT("SSSE3");
+
+	case SimdLevel::AVX2:
+		return TEXT("AVX2");
+
+	case SimdLevel::AVX512:
+		return TEXT("AVX-512");
+	}
+
+	throw std::runtime_error("SimdLevel ToString() failed, value not recognized");
+}
+
+
+SimdLevel CpuSimdLevel()
+{
+	// Thread-safe static init
+	static const SimdLevel simdLevel = DetectSimdLevel();
+	return simdLevel;
+}
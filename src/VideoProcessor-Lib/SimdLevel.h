@@ -0,0 +1,40 @@
+/*
+ * Copyright(C) 2021 Dennis Fleurbaaij <mail@dennisfleurbaaij.com>
+ *
+ * This program is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, version 3.
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License along with this program. If not, see < https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+
+#include <atlstr.h>
+
+
+/**
+ * SIMD instruction set levels for which we have hand-written kernels.
+ * These are ordered, a higher level implies support for all lower levels.
+ */
+enum class SimdLevel
+{
+	// Plain C++, runs everywhere
+	SCALAR,
+
+	// SSE up to and including SSSE3 (pshufb)
+	SSSE3,
+
+	// AVX2 256-bit integer
+	AVX2,
+
+	// AVX-512 F + BW, 512-bit integer
+	AVX512
+};
+
+
+const TCHAR* ToString(const SimdLevel);
+
+
+// Return the highest SIMD level supported by both the CPU and the OS.
+// This is detected once through CPUID and cached.
+SimdLevel CpuSimdLevel();
@@ -0,0 +1,169 @@
+/*
+ * Copyright(C) 2021 Dennis Fleurbaaij <mail@dennisfleurbaaij.com>
+ *
+ * This program is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, version 3.
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License along with this program. If not, see < https://www.gnu.org/licenses/>.
+ */
+
+#include <pch.h>
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+#include "TimingClockModel.h"
+
+
+// Reads which take longer than this many times the fastest one are rejected,
+// the absolute slack prevents rejecting everything with a very fast fastest read.
+static const int64_t MAX_READ_DURATION_FACTOR = 4;
+static const double READ_DURATION_SLACK_US = 20.0;
+
+// Samples further than this from the prediction are rejected once the model is valid
+static const double MAX_RESIDUAL_US = 500.0;
+
+// This many far-off samples in a row means the clock stepped
+static const uint32_t MAX_CONSECUTIVE_REJECTED = 8;
+
+
+TimingClockModel::TimingClockModel(timingclocktime_t clockTicksPerSecond, int64_t counterTicksPerSecond):
+	m_clockTicksPerSecond(clockTicksPerSecond),
+	m_counterTicksPerSecond(counterTicksPerSecond),
+	m_nominalRate((double)clockTicksPerSecond / counterTicksPerSecond)
+{
+	if (clockTicksPerSecond <= 0 || counterTicksPerSecond <= 0)
+		throw std::runtime_error("Clock and counter ticks per second must be > 0");
+}
+
+
+bool TimingClockModel::AddSample(int64_t counterBefore, timingclocktime_t clockTime, int64_t counterAfter)
+{
+	assert(counterAfter >= counterBefore);
+
+	const int64_t readCounterTicks = counterAfter - counterBefore;
+	const int64_t counter = counterBefore + readCounterTicks / 2;
+
+	// Slow read
+	const int64_t slackCounterTicks = (int64_t)(READ_DURATION_SLACK_US * m_counterTicksPerSecond / 1000000.0);
+	if (m_minReadCounterTicks != INT64_MAX &&
+		readCounterTicks > m_minReadCounterTicks * MAX_READ_DURATION_FACTOR + slackCounterTicks)
+	{
+		++m_rejectedSampleCount;
+		return false;
+	}
+
+	// Far from the prediction
+	if (IsValid())
+	{
+		const double residualUs =
+			(clockTime - ClockTimeAt(counter)) * 1000000.0 / m_clockTicksPerSecond;
+
+		if (fabs(residualUs) > MAX_RESIDUAL_US)
+		{
+			++m_rejectedSampleCount;
+
+			if (++m_consecutiveRejectedCount < MAX_CONSECUTIVE_REJECTED)
+				return false;
+
+			// Stepped, start over from this sample
+			Reset();
+		}
+	}
+
+	m_consecutiveRejectedCount = 0;
+	m_minReadCounterTicks = std::min(m_minReadCounterTicks, readCounterTicks);
+
+	m_samples[m_sampleNext] = { counter, clockTime };
+	m_sampleNext = (m_sampleNext + 1) % WINDOW_SIZE;
+	if (m_sampleCount < WINDOW_SIZE)
+		++m_sampleCount;
+	++m_acceptedSampleCount;
+
+	Fit();
+
+	return true;
+}
+
+
+void TimingClockModel::Reset()
+{
+	m_sampleCount = 0;
+	m_sampleNext = 0;
+	m_minReadCounterTicks = INT64_MAX;
+	m_consecutiveRejectedCount = 0;
+	m_intercept = 0.0;
+	m_rate = 0.0;
+	m_residualRmsUs = 0.0;
+}
+
+
+timingclocktime_t TimingClockModel::ClockTimeAt(int64_t counter) const
+{
+	assert(IsValid());
+
+	const double offset = m_intercept + m_rate * (double)(counter - m_referenceCounter);
+	return m_referenceClockTime + (timingclocktime_t)llround(offset);
+}
+
+
+double TimingClockModel::DriftPpm() const
+{
+	if (!IsValid())
+		return 0.0;
+
+	return (m_rate / m_nominalRate - 1.0) * 1000000.0;
+}
+
+
+void TimingClockModel::Fit()
+{
+	// Everything relative to the newest sample to keep the doubles small
+	const Sample& newest = m_samples[(m_sampleNext + WINDOW_SIZE - 1) % WINDOW_SIZE];
+	m_referenceCounter = newest.counter;
+	m_referenceClockTime = newest.clockTime;
+
+	if (m_sampleCount == 1)
+	{
+		m_intercept = 0.0;
+		m_rate = m_nominalRate;
+		m_residualRmsUs = 0.0;
+		return;
+	}
+
+	double sumX = 0.0;
+	double sumY = 0.0;
+	for (uint32_t i = 0; i < m_sampleCount; i++)
+	{
+		sumX += (double)(m_samples[i].counter - m_referenceCounter);
+		sumY += (double)(m_samples[i].clockTime - m_referenceClockTime);
+	}
+
+	const double meanX = sumX / m_sampleCount;
+	const double meanY = sumY / m_sampleCount;
+
+	double sxx = 0.0;
+	double sxy = 0.0;
+	for (uint32_t i = 0; i < m_sampleCount; i++)
+	{
+		const double dx = (double)(m_samples[i].counter - m_referenceCounter) - meanX;
+		const double dy = (double)(m_samples[i].clockTime - m_referenceClockTime) - meanY;
+		sxx += dx * dx;
+		sxy += dx * dy;
+	}
+
+	// All samples at the same counter value, keep the nominal rate
+	m_rate = (sxx > 0.0) ? (sxy / sxx) : m_nominalRate;
+	m_intercept = meanY - m_rate * meanX;
+
+	double sumResidual2 = 0.0;
+	for (uint32_t i = 0; i < m_sampleCount; i++)
+	{
+		const double x = (double)(m_samples[i].counter - m_referenceCounter);
+		const double y = (double)(m_samples[i].clockTime - m_referenceClockTime);
+		const double residual = y - (m_intercept + m_rate * x);
+		sumResidual2 += residual * residual;
+	}
+
+	m_residualRmsUs = sqrt(sumResidual2 / m_sampleCount) * 1000000.0 / m_clockTicksPerSecond;
+}
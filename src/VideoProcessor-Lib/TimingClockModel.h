@@ -0,0 +1,105 @@
+/*
+ * Copyright(C) 2021 Dennis Fleurbaaij <mail@dennisfleurbaaij.com>
+ *
+ * This program is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, version 3.
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License along with this program. If not, see < https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+
+#include <cstdint>
+
+#include <TimingClock.h>
+
+
+/**
+ * Model of a timing clock as a linear function of a local high resolution counter, normally the
+ * performance counter. Once fitted the clock time can be predicted from the counter alone,
+ * without reading the clock itself.
+ *
+ * Samples pair a clock reading with the counter values right before and after it. Offset and
+ * rate are a least squares fit over a sliding window of samples, the rate relative to the
+ * nominal one is the drift.
+ *
+ * Outliers are rejected in two ways:
+ * - Reads which took much longer than the fastest one seen, the counter midpoint of those is
+ *   not a good estimate of when the clock was read (preemption, driver hiccups).
+ * - Once valid, samples far from the prediction. If that happens for many samples in a row the
+ *   clock is assumed to have stepped and the fit starts over.
+ *
+ * Not thread-safe.
+ */
+class TimingClockModel
+{
+public:
+
+	// Amount of samples in the fit window
+	static const uint32_t WINDOW_SIZE = 64;
+
+	// Amount of samples needed before the model is used
+	static const uint32_t MIN_SAMPLES = 4;
+
+	TimingClockModel(timingclocktime_t clockTicksPerSecond, int64_t counterTicksPerSecond);
+
+	// Add a sample, counterBefore and counterAfter bracket the clock read.
+	// Returns false if the sample was rejected as an outlier.
+	bool AddSample(int64_t counterBefore, timingclocktime_t clockTime, int64_t counterAfter);
+
+	// Forget all samples
+	void Reset();
+
+	// True if there are enough samples to predict
+	bool IsValid() const { return m_sampleCount >= MIN_SAMPLES; }
+
+	// Predict the clock time at the given counter value, only call if valid
+	timingclocktime_t ClockTimeAt(int64_t counter) const;
+
+	// Get the measured rate difference with the nominal one in parts per million,
+	// positive means the clock runs fast compared to the counter.
+	double DriftPpm() const;
+
+	// Get the root mean square of the fit residuals in microseconds
+	double ResidualRmsUs() const { return m_residualRmsUs; }
+
+	uint64_t AcceptedSampleCount() const { return m_acceptedSampleCount; }
+	uint64_t RejectedSampleCount() const { return m_rejectedSampleCount; }
+
+private:
+
+	struct Sample
+	{
+		int64_t counter;
+		timingclocktime_t clockTime;
+	};
+
+	const timingclocktime_t m_clockTicksPerSecond;
+	const int64_t m_counterTicksPerSecond;
+
+	// Nominal clock ticks per counter tick
+	const double m_nominalRate;
+
+	// Ring of the last samples
+	Sample m_samples[WINDOW_SIZE];
+	uint32_t m_sampleCount = 0;
+	uint32_t m_sampleNext = 0;
+
+	// Fastest clock read seen, counter ticks
+	int64_t m_minReadCounterTicks = INT64_MAX;
+
+	// Samples rejected in a row for being far from the prediction
+	uint32_t m_consecutiveRejectedCount = 0;
+
+	// Fit: clockTime = m_referenceClockTime + m_intercept + m_rate * (counter - m_referenceCounter)
+	int64_t m_referenceCounter = 0;
+	timingclocktime_t m_referenceClockTime = 0;
+	double m_intercept = 0.0;
+	double m_rate = 0.0;
+	double m_residualRmsUs = 0.0;
+
+	uint64_t m_acceptedSampleCount = 0;
+	uint64_t m_rejectedSampleCount = 0;
+
+	void Fit();
+};
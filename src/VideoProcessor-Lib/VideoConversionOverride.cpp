@@ -20,6 +20,9 @@ const TCHAR* ToString(const VideoConversionOverride videoConversionOverride)
 
 	case VideoConversionOverride::VIDEOCONVERSION_V210_TO_P010:
 		return TEXT("V210 > P010");
+
+	case VideoConversionOverride::VIDEOCONVERSION_V210_TO_P010_TOP_LEFT:
+		return TEXT("V210 > P010 (top-left chroma)");
 	}
 
 	throw std::runtime_error("VideoConversionOverride ToString() failed, value not recognized");
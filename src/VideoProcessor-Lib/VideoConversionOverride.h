@@ -20,8 +20,11 @@ enum class VideoConversionOverride
 	// No override, let renderer decide
 	VIDEOCONVERSION_NONE,
 
-	// If the video is v210 (YUV422) convert it to p010 (YUV420)
-	VIDEOCONVERSION_V210_TO_P010
+	// If the video is v210 (YUV422) convert it to p010 (YUV420), MPEG-2 (left) chroma siting
+	VIDEOCONVERSION_V210_TO_P010,
+
+	// If the video is v210 (YUV422) convert it to p010 (YUV420), top-left chroma siting
+	VIDEOCONVERSION_V210_TO_P010_TOP_LEFT
 };
 
 
@@ -26,7 +26,9 @@ VideoFrame::VideoFrame(const VideoFrame& videoFrame) :
 	m_data(videoFrame.m_data),
 	m_counter(videoFrame.m_counter),
 	m_timingTimestamp(videoFrame.m_timingTimestamp),
-	m_sourceBuffer(videoFrame.m_sourceBuffer)
+	m_sourceBuffer(videoFrame.m_sourceBuffer),
+	m_arrivalTime(videoFrame.m_arrivalTime),
+	m_queueTime(videoFrame.m_queueTime)
 {
 }
 
@@ -38,14 +40,16 @@ VideoFrame::~VideoFrame()
 
 void VideoFrame::SourceBufferAddRef()
 {
-	m_sourceBuffer->AddRef();
+	if (m_sourceBuffer)
+		m_sourceBuffer->AddRef();
 }
 
 
 void VideoFrame::SourceBufferRelease()
 {
-	const ULONG refCount = m_sourceBuffer->Release();
-	assert(refCount == 0);
+	// Other handles might still hold on to it, the count needn't reach zero here
+	if (m_sourceBuffer)
+		m_sourceBuffer->Release();
 }
 
 
@@ -57,6 +61,8 @@ VideoFrame& VideoFrame::operator= (const VideoFrame& videoFrame)
 	m_counter = videoFrame.m_counter;
 	m_timingTimestamp = videoFrame.m_timingTimestamp;
 	m_sourceBuffer = videoFrame.m_sourceBuffer;
+	m_arrivalTime = videoFrame.m_arrivalTime;
+	m_queueTime = videoFrame.m_queueTime;
 
 	return *this;
 }
@@ -21,9 +21,9 @@ public:
 	/**
 	 * Constructor
 	 *
-	 * This is just a pointer to some data.
-	 * If this data in any way, shape or form might be gone by the time it's used, you can use the
-	 * sourceBuffer argument to have the VideoFrame constr/destr do ref management.
+	 * This is just a pointer to some data, copies don't touch the source buffer's refcount.
+	 * If this data in any way, shape or form might be gone by the time it's used, hold on to it
+	 * with a VideoFrameHandle which keeps a reference on the sourceBuffer.
 	 */
 	VideoFrame() {}
 	VideoFrame(
@@ -44,15 +44,28 @@ public:
 	// Timestamp set by the timing clock.
 	timingclocktime_t GetTimingTimestamp() const { return m_timingTimestamp; }
 
-	// Memory functions to hold onto the video buffer for longer
-	void SourceBufferAddRef();
-	void SourceBufferRelease();
+	// Performance counter (PipelineLatency::Now()) at which the capture callback got the frame
+	// and at which it was queued for delivery, 0 if unknown.
+	int64_t GetArrivalTime() const { return m_arrivalTime; }
+	void SetArrivalTime(int64_t arrivalTime) { m_arrivalTime = arrivalTime; }
+	int64_t GetQueueTime() const { return m_queueTime; }
+	void SetQueueTime(int64_t queueTime) { m_queueTime = queueTime; }
 
 	VideoFrame& operator= (const VideoFrame& videoFrame);
 
 private:
-	const void* m_data;
-	uint64_t m_counter;
-	timingclocktime_t m_timingTimestamp;
-	IUnknown* m_sourceBuffer;
+
+	// Source buffer references are only managed by VideoFrameHandle, the ring only moves the
+	// fields in and out of its slots
+	friend class VideoFrameHandle;
+	friend class CVideoFrameRing;
+	void SourceBufferAddRef();
+	void SourceBufferRelease();
+
+	const void* m_data = nullptr;
+	uint64_t m_counter = 0;
+	timingclocktime_t m_timingTimestamp = 0;
+	IUnknown* m_sourceBuffer = nullptr;
+	int64_t m_arrivalTime = 0;
+	int64_t m_queueTime = 0;
 };
@@ -0,0 +1,87 @@
+/*
+ * Copyright(C) 2021 Dennis Fleurbaaij <mail@dennisfleurbaaij.com>
+ *
+ * This program is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, version 3.
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License along with this program. If not, see < https://www.gnu.org/licenses/>.
+ */
+
+
+
+#include <pch.h>
+
+#include "VideoFrameHandle.h"
+
+
+VideoFrameHandle::VideoFrameHandle(const VideoFrame& videoFrame):
+	m_videoFrame(videoFrame),
+	m_owned(true)
+{
+	m_videoFrame.SourceBufferAddRef();
+}
+
+
+VideoFrameHandle VideoFrameHandle::Adopt(const VideoFrame& videoFrame)
+{
+	VideoFrameHandle videoFrameHandle;
+	videoFrameHandle.m_videoFrame = videoFrame;
+	videoFrameHandle.m_owned = true;
+
+	return videoFrameHandle;
+}
+
+
+VideoFrameHandle::VideoFrameHandle(VideoFrameHandle&& videoFrameHandle):
+	m_videoFrame(videoFrameHandle.m_videoFrame),
+	m_owned(videoFrameHandle.m_owned)
+{
+	videoFrameHandle.m_owned = false;
+}
+
+
+VideoFrameHandle& VideoFrameHandle::operator= (VideoFrameHandle&& videoFrameHandle)
+{
+	if (this != &videoFrameHandle)
+	{
+		Reset();
+
+		m_videoFrame = videoFrameHandle.m_videoFrame;
+		m_owned = videoFrameHandle.m_owned;
+		videoFrameHandle.m_owned = false;
+	}
+
+	return *this;
+}
+
+
+VideoFrameHandle::~VideoFrameHandle()
+{
+	Reset();
+}
+
+
+VideoFrameHandle VideoFrameHandle::Share() const
+{
+	assert(m_owned);
+
+	return VideoFrameHandle(m_videoFrame);
+}
+
+
+void VideoFrameHandle::Reset()
+{
+	if (!m_owned)
+		return;
+
+	m_owned = false;
+	m_videoFrame.SourceBufferRelease();
+}
+
+
+VideoFrame VideoFrameHandle::Detach()
+{
+	assert(m_owned);
+
+	m_owned = false;
+	return m_videoFrame;
+}
@@ -0,0 +1,69 @@
+/*
+ * Copyright(C) 2021 Dennis Fleurbaaij <mail@dennisfleurbaaij.com>
+ *
+ * This program is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, version 3.
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License along with this program. If not, see < https://www.gnu.org/licenses/>.
+ */
+
+
+#pragma once
+
+
+#include <VideoFrame.h>
+
+
+/**
+ * Owning handle to a video frame, holds one reference on the frame's source buffer.
+ *
+ * Handles are move-only, moving hands the reference over without touching the refcount so
+ * queues can pass frames along for free. Another owner has to ask for it explicitly with Share(),
+ * which costs a single AddRef(). The reference is released when the handle is reset, assigned to
+ * or destroyed.
+ *
+ * The source buffer is usually the capture card's frame or a FrameBufferPool buffer, either way
+ * its data stays valid for as long as any handle to it exists.
+ */
+class VideoFrameHandle
+{
+public:
+
+	// Empty handle
+	VideoFrameHandle() {}
+
+	// Take a new reference on the frame's source buffer
+	explicit VideoFrameHandle(const VideoFrame&);
+
+	// Take over a reference which is held already, like a freshly acquired pool buffer
+	static VideoFrameHandle Adopt(const VideoFrame&);
+
+	VideoFrameHandle(VideoFrameHandle&&);
+	VideoFrameHandle& operator= (VideoFrameHandle&&);
+
+	VideoFrameHandle(const VideoFrameHandle&) = delete;
+	VideoFrameHandle& operator= (const VideoFrameHandle&) = delete;
+
+	~VideoFrameHandle();
+
+	// Another handle to the same frame, takes one more reference
+	VideoFrameHandle Share() const;
+
+	// Release the reference, the handle is empty after
+	void Reset();
+
+	// Give up the reference without releasing it, the handle is empty after. Meant for lock-free
+	// queues which can't hold handles, the reference has to be taken back with Adopt().
+	VideoFrame Detach();
+
+	explicit operator bool() const { return m_owned; }
+
+	VideoFrame& operator*() { assert(m_owned); return m_videoFrame; }
+	const VideoFrame& operator*() const { assert(m_owned); return m_videoFrame; }
+	VideoFrame* operator->() { assert(m_owned); return &m_videoFrame; }
+	const VideoFrame* operator->() const { assert(m_owned); return &m_videoFrame; }
+
+private:
+
+	VideoFrame m_videoFrame;
+	bool m_owned = false;
+};
@@ -53,7 +53,7 @@ public:
 
 private:
 
-	std::atomic<ULONG> m_refCount;
+	std::atomic<ULONG> m_refCount = 0;
 };
 
 
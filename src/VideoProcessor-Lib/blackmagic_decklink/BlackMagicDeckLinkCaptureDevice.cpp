@@ -16,7 +16,9 @@
 
 #include <blackmagic_decklink/BlackMagicDeckLinkTranslate.h>
 #include <cie.h>
+#include <FrameTrace.h>
 #include <StringUtils.h>
+#include <PipelineLatency.h>
 #include <WallClock.h>
 
 #include "BlackMagicDeckLinkCaptureDevice.h"
@@ -375,6 +377,12 @@ timingclocktime_t BlackMagicDeckLinkCaptureDevice::TimingClockNow()
 }
 
 
+bool BlackMagicDeckLinkCaptureDevice::TimingClockRunning()
+{
+	return m_outputCaptureData.load(std::memory_order_acquire);
+}
+
+
 timingclocktime_t BlackMagicDeckLinkCaptureDevice::TimingClockTicksPerSecond() const
 {
 	// This is hard-coded, we can also take a more course approach by using the exact frame-frequency muliplied by 1000
@@ -554,6 +562,9 @@ HRESULT STDMETHODCALLTYPE BlackMagicDeckLinkCaptureDevice::VideoInputFrameArrive
 	{
 		assert(m_bmdDisplayMode);
 
+		const int64_t arrivalTime = PipelineLatency::Now();
+		FrameTraceScope frameTrace(FrameTraceEvent::VIDEO_INPUT_FRAME_ARRIVED);
+
 		timingclocktime_t timingClockFrameTime = 0;
 
 		// Get timestamp
@@ -577,13 +588,19 @@ HRESULT STDMETHODCALLTYPE BlackMagicDeckLinkCaptureDevice::VideoInputFrameArrive
 		}
 
 		m_previousTimingClockFrameTime = timingClockFrameTime;
+		frameTrace.SetFrameCounter(m_capturedVideoFrameCount);
 
-		// Every every so often get the hardware latency.
+		// Get hardware latency every so often, reading the clock is a driver call.
 		// TODO: Change to framerate rather than fixed number of frames
 		if(m_capturedVideoFrameCount % 20 == 0)
 		{
-			timingclocktime_t timingClockNow = TimingClockNow();
+			const timingclocktime_t timingClockNow = TimingClockNow();
 			m_hardwareLatencyMs = TimingClockDiffMs(timingClockFrameTime, timingClockNow, TimingClockTicksPerSecond());
+
+			if (timingClockNow > timingClockFrameTime)
+				PipelineLatency::Record(
+					LatencyStage::HARDWARE_TO_CALLBACK,
+					(uint64_t)((timingClockNow - timingClockFrameTime) * (1000000.0 / TimingClockTicksPerSecond())));
 		}
 
 		// Offset timestamp. Do this after getting the hardware latency else it'll account for this as well
@@ -795,8 +812,12 @@ HRESULT STDMETHODCALLTYPE BlackMagicDeckLinkCaptureDevice::VideoInputFrameArrive
 		VideoFrame vpVideoFrame(
 			data, m_capturedVideoFrameCount,
 			timingClockFrameTime, videoFrame);
+		vpVideoFrame.SetArrivalTime(arrivalTime);
 
 		m_callback->OnCaptureDeviceVideoFrame(vpVideoFrame);
+
+		// Everything up to here holds up the driver's next callback
+		PipelineLatency::RecordSince(LatencyStage::CALLBACK_RESIDENCY, arrivalTime);
 	}  // videoFrame
 
 	return S_OK;
@@ -62,6 +62,7 @@ public:
 
 	// ITimingClock
 	timingclocktime_t TimingClockNow() override;
+	bool TimingClockRunning() override;
 	timingclocktime_t TimingClockTicksPerSecond() const override;
 	const TCHAR* TimingClockDescription() override;
 
@@ -93,7 +94,8 @@ private:
 	bool m_canCapture = true;
 	std::vector<CaptureInput> m_captureInputSet;
 
-	timingclocktime_t m_frameOffsetTicks = 0;
+	// Set from the GUI thread, read by the capture thread
+	std::atomic<timingclocktime_t> m_frameOffsetTicks = 0;
 	double m_hardwareLatencyMs = 0;
 
 	// If false this will not send any more frames out.
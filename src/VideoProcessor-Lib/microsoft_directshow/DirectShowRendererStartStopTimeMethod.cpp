@@ -24,6 +24,9 @@ const TCHAR* ToString(const DirectShowStartStopTimeMethod rendererTimestamp)
 	case DirectShowStartStopTimeMethod::DS_SSTM_CLOCK_CLOCK:
 		return TEXT("Clock-Clock");
 
+	case DirectShowStartStopTimeMethod::DS_SSTM_CLOCK_FILTERED:
+		return TEXT("Clock-Filtered");
+
 	case DirectShowStartStopTimeMethod::DS_SSTM_THEO_THEO:
 		return TEXT("Theo-Theo");
 
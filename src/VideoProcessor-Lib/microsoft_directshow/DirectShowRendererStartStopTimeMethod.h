@@ -28,6 +28,10 @@ enum DirectShowStartStopTimeMethod
 	// Use the given clock for start plus the start of the next frame for the stop time.
 	DS_SSTM_CLOCK_CLOCK,
 
+	// Use the given clock with the jitter filtered out for start plus the filtered frame
+	// duration for stop. Follows the clock's drift.
+	DS_SSTM_CLOCK_FILTERED,
+
 	// Theoretical timestamp based on frame duration
 	DS_SSTM_THEO_THEO,
 
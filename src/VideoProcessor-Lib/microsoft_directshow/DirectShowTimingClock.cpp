@@ -12,27 +12,129 @@
 #include "DirectShowTimingClock.h"
 
 
+// Time between timing clock samples, faster until the model is valid
+static const DWORD SAMPLE_INTERVAL_MS = 250;
+static const DWORD SAMPLE_INTERVAL_STARTUP_MS = 10;
+
+// Log the model state every this many samples
+static const uint64_t LOG_INTERVAL_SAMPLES = 240;
+
+
+static LONGLONG PerformanceCounterNow()
+{
+	LARGE_INTEGER now;
+	QueryPerformanceCounter(&now);
+	return now.QuadPart;
+}
+
+
+static LONGLONG PerformanceCounterFrequency()
+{
+	LARGE_INTEGER frequency;
+	QueryPerformanceFrequency(&frequency);
+	return frequency.QuadPart;
+}
+
+
 DirectShowTimingClock::DirectShowTimingClock(ITimingClock& timingClock):
 	CBaseReferenceClock(DIRECTSHOW_TIMING_CLOCK_NAME, nullptr, nullptr, nullptr),
 	m_timingClock(timingClock),
-	m_ticksPer100ns(m_timingClock.TimingClockTicksPerSecond() / 10000000.0)
+	m_ticksPerSecond(m_timingClock.TimingClockTicksPerSecond()),
+	m_model(m_ticksPerSecond, PerformanceCounterFrequency()),
+	m_samplingStopEvent(TRUE)
 {
 	DbgLog((LOG_TRACE, 1, TEXT("DirectShowTimingClock::DirectShowTimingClock()")));
 
-	assert(m_ticksPer100ns > 0);
+	assert(m_ticksPerSecond > 0);
+
+	m_samplingThread = std::thread(&DirectShowTimingClock::SamplingThreadProc, this);
 }
 
 
 DirectShowTimingClock::~DirectShowTimingClock()
 {
-	DbgLog((LOG_TRACE, 1, TEXT("DirectShowTimingClock::~DirectShowTimingClock()")));
+	m_samplingStopEvent.Set();
+	m_samplingThread.join();
+
+	DbgLog((LOG_TRACE, 1,
+		TEXT("DirectShowTimingClock::~DirectShowTimingClock(): Drift: %.02f ppm, residual rms: %.02f us, samples: %I64u, rejected: %I64u"),
+		m_model.DriftPpm(), m_model.ResidualRmsUs(), m_model.AcceptedSampleCount(), m_model.RejectedSampleCount()));
 }
 
 
 REFERENCE_TIME DirectShowTimingClock::GetPrivateTime()
 {
-	const REFERENCE_TIME rt = (REFERENCE_TIME)(m_timingClock.TimingClockNow() / m_ticksPer100ns);
+	const LONGLONG counterNow = PerformanceCounterNow();
+
+	timingclocktime_t timingClockNow = TIMING_CLOCK_TIME_INVALID;
+	{
+		CAutoLock lock(&m_modelLock);
+
+		if (m_model.IsValid())
+			timingClockNow = m_model.ClockTimeAt(counterNow);
+	}
+
+	if (timingClockNow == TIMING_CLOCK_TIME_INVALID)
+		timingClockNow = m_timingClock.TimingClockNow();
+
+	// Integer conversion in two parts, a full multiply would overflow on long running clocks
+	const REFERENCE_TIME rt =
+		(timingClockNow / m_ticksPerSecond) * 10000000LL +
+		((timingClockNow % m_ticksPerSecond) * 10000000LL) / m_ticksPerSecond;
 	assert(rt > 0);
 
 	return rt;
 }
+
+
+double DirectShowTimingClock::DriftPpm()
+{
+	CAutoLock lock(&m_modelLock);
+	return m_model.DriftPpm();
+}
+
+
+void DirectShowTimingClock::SamplingThreadProc()
+{
+	// ! WARNING: Runs in the sampling thread
+
+	DWORD intervalMs = SAMPLE_INTERVAL_STARTUP_MS;
+
+	do
+	{
+		// The capture device's clock can only be read while it's capturing
+		if (!m_timingClock.TimingClockRunning())
+			continue;
+
+		// Bracket the read as tightly as possible, the model rejects slow ones
+		LONGLONG counterBefore = 0;
+		timingclocktime_t timingClockTime = TIMING_CLOCK_TIME_INVALID;
+		LONGLONG counterAfter = 0;
+
+		try
+		{
+			counterBefore = PerformanceCounterNow();
+			timingClockTime = m_timingClock.TimingClockNow();
+			counterAfter = PerformanceCounterNow();
+		}
+		catch (std::runtime_error& e)
+		{
+			// Capture might have stopped since the check, skip this sample
+			DbgLog((LOG_TRACE, 1, TEXT("DirectShowTimingClock::SamplingThreadProc(): Skipping sample, failed to read timing clock: %S"), e.what()));
+			continue;
+		}
+
+		CAutoLock lock(&m_modelLock);
+
+		if (m_model.AddSample(counterBefore, timingClockTime, counterAfter) &&
+			m_model.AcceptedSampleCount() % LOG_INTERVAL_SAMPLES == 0)
+		{
+			DbgLog((LOG_TRACE, 1,
+				TEXT("DirectShowTimingClock::SamplingThreadProc(): Drift: %.02f ppm, residual rms: %.02f us, rejected: %I64u"),
+				m_model.DriftPpm(), m_model.ResidualRmsUs(), m_model.RejectedSampleCount()));
+		}
+
+		intervalMs = m_model.IsValid() ? SAMPLE_INTERVAL_MS : SAMPLE_INTERVAL_STARTUP_MS;
+	}
+	while (!m_samplingStopEvent.Wait(intervalMs));
+}
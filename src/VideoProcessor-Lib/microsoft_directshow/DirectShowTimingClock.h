@@ -9,9 +9,12 @@
 #pragma once
 
 
+#include <thread>
+
 #include <refclock.h>
 
 #include <ITimingClock.h>
+#include <TimingClockModel.h>
 
 
 #define DIRECTSHOW_TIMING_CLOCK_NAME TEXT("TimingClock")
@@ -20,6 +23,10 @@
 /**
  * Clock which can get the time from an timingclock interface.
  * To be used in Directshow graphs
+ *
+ * Reading the timing clock can be expensive (a driver call for hardware clocks), so a thread
+ * samples it at a low rate into a model against the performance counter. The time is
+ * predicted from the model and the timing clock is only read directly until it is valid.
  */
 class DirectShowTimingClock:
 	public CBaseReferenceClock
@@ -32,7 +39,18 @@ public:
 	// CBaseReferenceClock
 	REFERENCE_TIME GetPrivateTime() override;
 
+	// Get the measured drift of the timing clock against the performance counter in ppm
+	double DriftPpm();
+
 private:
 	ITimingClock& m_timingClock;
-	const double m_ticksPer100ns;
+	const timingclocktime_t m_ticksPerSecond;
+
+	CCritSec m_modelLock;
+	TimingClockModel m_model;
+
+	CAMEvent m_samplingStopEvent;
+	std::thread m_samplingThread;
+
+	void SamplingThreadProc();
 };
@@ -8,12 +8,26 @@
 
 #include <pch.h>
 
+#include <algorithm>
+
+#include <FrameTrace.h>
 #include <guid.h>
 #include <IMediaSideData.h>
+#include <PipelineLatency.h>
 
 #include "ALiveSourceVideoOutputPin.h"
 
 
+// A GetDeliveryBuffer() which waits at least this long is counted as a stall
+static const LONGLONG DELIVERY_BUFFER_STALL_MS = 1;
+
+// Amount of samples over which the GetDeliveryBuffer() wait is averaged
+static const uint32_t DELIVERY_BUFFER_WAIT_WINDOW = 500;
+
+// Log the timestamp filter statistics every this many frames
+static const uint64_t FRAME_TIMESTAMP_FILTER_LOG_INTERVAL = 500;
+
+
 ALiveSourceVideoOutputPin::ALiveSourceVideoOutputPin(
 	CLiveSource* filter,
 	CCritSec* pLock,
@@ -22,6 +36,9 @@ ALiveSourceVideoOutputPin::ALiveSourceVideoOutputPin(
 		LIVE_SOURCE_FILTER_NAME, filter, pLock, phr,
 		LIVE_SOURCE_FILTER_VIDEO_OUPUT_PIN_NAME)
 {
+	LARGE_INTEGER frequency;
+	QueryPerformanceFrequency(&frequency);
+	m_performanceFrequency = frequency.QuadPart;
 }
 
 
@@ -30,7 +47,8 @@ void ALiveSourceVideoOutputPin::Initialize(
 	timestamp_t frameDuration,
 	ITimingClock* const timingClock,
 	DirectShowStartStopTimeMethod timestamp,
-	const AM_MEDIA_TYPE& mediaType)
+	const AM_MEDIA_TYPE& mediaType,
+	unsigned int sampleBufferCount)
 {
 	if (!videoFrameFormatter)
 		throw std::runtime_error("Cannot set null IVideoFrameFormatter");
@@ -40,11 +58,27 @@ void ALiveSourceVideoOutputPin::Initialize(
 	assert(frameDuration > 50000LL); // 5ms frame is 200Hz, probably a reasonable upper bound
 	assert(frameDuration < 10000000LL);  // 1Hz, reasonable lower bound
 
+	if (sampleBufferCount < 1 || sampleBufferCount > MAX_SAMPLE_BUFFER_COUNT)
+		throw std::runtime_error("Sample buffer count out of range");
+
 	m_videoFrameFormatter = videoFrameFormatter;
 	m_frameDuration = frameDuration;
 	m_timingClock = timingClock;
 	m_timestamp = timestamp;
 	m_mediaType = mediaType;
+	m_sampleBufferCount = sampleBufferCount;
+
+	m_frameTimestampFilter.reset();
+	if (m_timestamp == DirectShowStartStopTimeMethod::DS_SSTM_CLOCK_FILTERED)
+	{
+		if (!m_timingClock)
+			throw std::runtime_error("Filtered timestamps need a timing clock");
+
+		const timingclocktime_t ticksPerSecond = m_timingClock->TimingClockTicksPerSecond();
+		m_frameTimestampFilter.reset(new FrameTimestampFilter(
+			m_frameDuration * (ticksPerSecond / 10000000.0),
+			ticksPerSecond));
+	}
 }
 
 
@@ -136,7 +170,9 @@ HRESULT ALiveSourceVideoOutputPin::DecideBufferSize(IMemAllocator *pAlloc, ALLOC
 
 	HRESULT hr = NOERROR;
 
-	ppropInputRequest->cBuffers = 1;
+	// The downstream requirements are a minimum, on top of that ask for our own count. Alignment
+	// and prefix requirements are passed as-is.
+	ppropInputRequest->cBuffers = std::max(ppropInputRequest->cBuffers, (long)m_sampleBufferCount);
 	ppropInputRequest->cbBuffer = m_videoFrameFormatter->GetOutFrameSize();
 
 	ASSERT(ppropInputRequest->cbBuffer);
@@ -153,10 +189,57 @@ HRESULT ALiveSourceVideoOutputPin::DecideBufferSize(IMemAllocator *pAlloc, ALLOC
 		return E_FAIL;
 	}
 
+	// Fewer buffers still work, there's just less overlap
+	DbgLog((LOG_TRACE, 1,
+		TEXT("ALiveSourceVideoOutputPin::DecideBufferSize(): Requested %ld buffers, got %ld"),
+		ppropInputRequest->cBuffers, Actual.cBuffers));
+
 	return S_OK;
 }
 
 
+HRESULT ALiveSourceVideoOutputPin::GetDeliveryBuffer(
+	IMediaSample** ppSample, REFERENCE_TIME* pStartTime, REFERENCE_TIME* pEndTime, DWORD dwFlags)
+{
+	LARGE_INTEGER start;
+	QueryPerformanceCounter(&start);
+
+	// This blocks until the renderer releases a sample if all are in use
+	const HRESULT hr = CBaseOutputPin::GetDeliveryBuffer(ppSample, pStartTime, pEndTime, dwFlags);
+
+	LARGE_INTEGER stop;
+	QueryPerformanceCounter(&stop);
+
+	const LONGLONG wait = stop.QuadPart - start.QuadPart;
+	PipelineLatency::Record(LatencyStage::DELIVERY_BUFFER_WAIT, (uint64_t)((wait * 1000000.0) / m_performanceFrequency));
+
+	if (wait * 1000 >= DELIVERY_BUFFER_STALL_MS * m_performanceFrequency)
+		++m_deliveryBufferStallCount;
+
+	m_deliveryBufferWaitSum += wait;
+	m_deliveryBufferWaitMax = std::max(m_deliveryBufferWaitMax, wait);
+	++m_deliveryBufferWaitCount;
+
+	if (m_deliveryBufferWaitCount >= DELIVERY_BUFFER_WAIT_WINDOW)
+	{
+		m_deliveryBufferWaitMs =
+			(m_deliveryBufferWaitSum * 1000.0) / (m_deliveryBufferWaitCount * (double)m_performanceFrequency);
+
+		DbgLog((LOG_TRACE, 1,
+			TEXT("ALiveSourceVideoOutputPin::GetDeliveryBuffer() wait over %u samples, avg: %.03f ms, max: %.03f ms, stalls: %I64u"),
+			m_deliveryBufferWaitCount, m_deliveryBufferWaitMs.load(),
+			(m_deliveryBufferWaitMax * 1000.0) / m_performanceFrequency,
+			m_deliveryBufferStallCount.load()));
+
+		m_deliveryBufferWaitSum = 0;
+		m_deliveryBufferWaitMax = 0;
+		m_deliveryBufferWaitCount = 0;
+	}
+
+	return hr;
+}
+
+
 //
 // IAMPushSource
 //
@@ -319,6 +402,13 @@ void ALiveSourceVideoOutputPin::Reset()
 	m_frameCounterOffset = 0;
 	m_previousTimeStop = 0;
 	m_droppedFrameCount = 0;
+	m_lateDroppedFrameCount = 0;
+	m_overflowDroppedFrameCount = 0;
+	m_reorderedDroppedFrameCount = 0;
+	m_deliveryBufferStallCount = 0;
+
+	// Reset() runs on the GUI thread while the delivering thread may be in the filter
+	m_frameTimestampFilterResetPending = true;
 
 	if (FAILED(DeliverEndFlush()))
 		throw std::runtime_error("Failed to deliver endflush");
@@ -375,18 +465,24 @@ HRESULT ALiveSourceVideoOutputPin::RenderVideoFrameIntoSample(VideoFrame& videoF
 	REFERENCE_TIME timeStart = REFERENCE_TIME_INVALID;
 	REFERENCE_TIME timeStop = REFERENCE_TIME_INVALID;
 
+	const timingclocktime_t frameTimestamp =
+		(m_timestamp == DirectShowStartStopTimeMethod::DS_SSTM_CLOCK_FILTERED) ?
+		FilterFrameTimestamp(videoFrame) :
+		videoFrame.GetTimingTimestamp();
+
 	// Determine start time
 	switch (m_timestamp)
 	{
 	case DirectShowStartStopTimeMethod::DS_SSTM_CLOCK_SMART:
 	case DirectShowStartStopTimeMethod::DS_SSTM_CLOCK_THEO:
 	case DirectShowStartStopTimeMethod::DS_SSTM_CLOCK_CLOCK:
+	case DirectShowStartStopTimeMethod::DS_SSTM_CLOCK_FILTERED:
 	case DirectShowStartStopTimeMethod::DS_SSTM_CLOCK_NONE:
 
 		// Get frame timestamp as reference time
 		timeStart =
 			(REFERENCE_TIME)(
-				videoFrame.GetTimingTimestamp() *
+				frameTimestamp *
 				(10000000.0 / m_timingClock->TimingClockTicksPerSecond()));
 
 		// Guarantee first frame to start counting at time zero
@@ -446,6 +542,15 @@ HRESULT ALiveSourceVideoOutputPin::RenderVideoFrameIntoSample(VideoFrame& videoF
 		assert(m_startTimeOffset > 0);
 		timeStop -= m_startTimeOffset;
 		break;
+
+	case DirectShowStartStopTimeMethod::DS_SSTM_CLOCK_FILTERED:
+
+		timeStop =
+			timeStart +
+			(REFERENCE_TIME)llround(
+				m_frameTimestampFilter->FrameDurationTicks() *
+				(10000000.0 / m_timingClock->TimingClockTicksPerSecond()));
+		break;
 	}
 
 	// Set right amount of values
@@ -454,6 +559,7 @@ HRESULT ALiveSourceVideoOutputPin::RenderVideoFrameIntoSample(VideoFrame& videoF
 	case DirectShowStartStopTimeMethod::DS_SSTM_CLOCK_SMART:
 	case DirectShowStartStopTimeMethod::DS_SSTM_CLOCK_THEO:
 	case DirectShowStartStopTimeMethod::DS_SSTM_CLOCK_CLOCK:
+	case DirectShowStartStopTimeMethod::DS_SSTM_CLOCK_FILTERED:
 	case DirectShowStartStopTimeMethod::DS_SSTM_THEO_THEO:
 
 		hr = pSample->SetTime(&timeStart, &timeStop);
@@ -503,8 +609,7 @@ HRESULT ALiveSourceVideoOutputPin::RenderVideoFrameIntoSample(VideoFrame& videoF
 	timestamp_t startTime = ::GetWallClockTime();
 #endif
 
-	const bool formatSuccess =
-		m_videoFrameFormatter->FormatVideoFrame(videoFrame, pData);
+	const bool formatSuccess = FormatVideoFrameIntoSample(videoFrame, pData);
 
 	if (!formatSuccess)
 	{
@@ -578,18 +683,52 @@ HRESULT ALiveSourceVideoOutputPin::RenderVideoFrameIntoSample(VideoFrame& videoF
 		}
 	}
 
-	if (m_frameCounter % 20 == 0)
-	{
-		//
-		// Calculate the exit latency, which is right before we hand-off to the DirectShow
-		// renderer.
-		//
+	//
+	// Calculate the exit latency, which is right before we hand-off to the DirectShow
+	// renderer. Taken every frame so the latency controller never works on a stale sample.
+	//
 
-		const timingclocktime_t now = m_timingClock->TimingClockNow();
+	const timingclocktime_t now = m_timingClock->TimingClockNow();
 
-		m_exitLatencyMs = TimingClockDiffMs(
-			videoFrame.GetTimingTimestamp(), now, m_timingClock->TimingClockTicksPerSecond());
-	}
+	m_exitLatencyMs = TimingClockDiffMs(
+		videoFrame.GetTimingTimestamp(), now, m_timingClock->TimingClockTicksPerSecond());
+	++m_exitLatencySampleCount;
 
 	return hr;
 }
+
+
+bool ALiveSourceVideoOutputPin::FormatVideoFrameIntoSample(const VideoFrame& videoFrame, BYTE* pData)
+{
+	const int64_t start = PipelineLatency::Now();
+	const bool formatSuccess = m_videoFrameFormatter->FormatVideoFrame(videoFrame, pData);
+	PipelineLatency::RecordSince(LatencyStage::FORMAT, start);
+	FrameTrace::RecordSince(FrameTraceEvent::FORMAT, videoFrame.GetCounter(), start);
+
+	return formatSuccess;
+}
+
+
+timingclocktime_t ALiveSourceVideoOutputPin::FilterFrameTimestamp(const VideoFrame& videoFrame)
+{
+	assert(m_frameTimestampFilter);
+
+	if (m_frameTimestampFilterResetPending.exchange(false))
+		m_frameTimestampFilter->Reset();
+
+	const timingclocktime_t filteredTimestamp =
+		m_frameTimestampFilter->Filter(videoFrame.GetCounter(), videoFrame.GetTimingTimestamp());
+
+	// Compare with the raw timestamps the other clock methods use
+	if (m_frameCounter % FRAME_TIMESTAMP_FILTER_LOG_INTERVAL == 0)
+	{
+		const FrameTimestampFilter::Statistics statistics = m_frameTimestampFilter->TakeStatistics();
+
+		DbgLog((LOG_TRACE, 1,
+			TEXT("::FillBuffer(#%I64u): Timestamp filter over %u frames, filtered-raw rms: %.01f us, max: %.01f us, raw interval jitter rms: %.01f us, duration: %+.01f ppm, discontinuities: %I64u"),
+			videoFrame.GetCounter(), statistics.frameCount, statistics.residualRmsUs, statistics.residualMaxUs,
+			statistics.rawIntervalJitterRmsUs, statistics.frameDurationPpm, statistics.discontinuityCount));
+	}
+
+	return filteredTimestamp;
+}
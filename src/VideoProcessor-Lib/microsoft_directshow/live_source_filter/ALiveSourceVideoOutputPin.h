@@ -9,6 +9,10 @@
 #pragma once
 
 
+#include <atomic>
+#include <memory>
+
+#include <FrameTimestampFilter.h>
 #include <video_frame_formatter/IVideoFrameFormatter.h>
 #include <microsoft_directshow/DirectShowRendererStartStopTimeMethod.h>
 #include <microsoft_directshow/DirectShowDefines.h>
@@ -36,18 +40,25 @@ public:
 
 	DECLARE_IUNKNOWN;
 
+	// Maximum amount of samples to ask the downstream allocator for
+	static const unsigned int MAX_SAMPLE_BUFFER_COUNT = 8;
+
+	// sampleBufferCount is the amount of samples to ask the downstream allocator for, more than
+	// one lets formatting the next frame overlap with the presentation of the current one.
 	void Initialize(
 		IVideoFrameFormatter* const videoFrameFormatter,
 		timestamp_t frameDuration,
 		ITimingClock* const timingClock,
 		DirectShowStartStopTimeMethod timestamp,
-		const AM_MEDIA_TYPE& mediaType);
+		const AM_MEDIA_TYPE& mediaType,
+		unsigned int sampleBufferCount);
 
 	// CBaseOutputPin overrides
 	HRESULT GetMediaType(int iPosition, CMediaType* pmt);
 	HRESULT CheckMediaType(const CMediaType *pmt);
 	HRESULT DecideAllocator(IMemInputPin* pPin, IMemAllocator** pAlloc);
 	HRESULT DecideBufferSize(IMemAllocator *pAlloc, ALLOCATOR_PROPERTIES *ppropInputRequest);
+	HRESULT GetDeliveryBuffer(IMediaSample** ppSample, REFERENCE_TIME* pStartTime, REFERENCE_TIME* pEndTime, DWORD dwFlags) override;
 
 	// IAMPushSource
 	STDMETHODIMP GetMaxStreamOffset(REFERENCE_TIME* prtMaxOffset) override;
@@ -94,24 +105,61 @@ public:
 
 	// Get the exit latency in ms, which the amount of time between the frame timestamp
 	// and when the frame is delivered to the DirectShow renderer.
-	// This is sampled.
+	// This is the last delivered frame, written by the delivering thread.
 	double ExitLatencyMs() const { return m_exitLatencyMs;  }
 
+	// Get the amount of exit latency samples taken, goes up with every delivered frame
+	uint64_t ExitLatencySampleCount() const { return m_exitLatencySampleCount; }
+
+	// Get the wake latency in ms, which is the amount of time between a frame being queued
+	// and the delivery thread waking up for it. Zero for pins without a delivery thread.
+	// This is averaged over a window.
+	double WakeLatencyMs() const { return m_wakeLatencyMs; }
+
 	// Get the amount of dropped frames due to queue actions
 	uint64_t DroppedFrameCount() const { return m_droppedFrameCount; }
 
+	// Get the amount of dropped frames by reason, frames purged on a reset or stop are only
+	// part of the total.
+	// - Late: could not make their presentation deadline anymore and a newer frame was queued
+	// - Overflow: oldest frames dropped to stay within the queue size
+	// - Reordered: frames with a timestamp not older than the one which was queued after them
+	uint64_t LateDroppedFrameCount() const { return m_lateDroppedFrameCount; }
+	uint64_t OverflowDroppedFrameCount() const { return m_overflowDroppedFrameCount; }
+	uint64_t ReorderedDroppedFrameCount() const { return m_reorderedDroppedFrameCount; }
+
+	// Get the time in ms GetDeliveryBuffer() waited for a free sample.
+	// This is averaged over a window.
+	double DeliveryBufferWaitMs() const { return m_deliveryBufferWaitMs; }
+
+	// Get the amount of times GetDeliveryBuffer() had to wait for the renderer to release a sample
+	uint64_t DeliveryBufferStallCount() const { return m_deliveryBufferStallCount; }
+
 protected:
 
-	uint64_t m_droppedFrameCount = 0;
+	// Updated from the capture thread and from threads purging the queue
+	std::atomic<uint64_t> m_droppedFrameCount = 0;
+
+	// Per-reason drop counts, every increment here is also added to m_droppedFrameCount
+	std::atomic<uint64_t> m_lateDroppedFrameCount = 0;
+	std::atomic<uint64_t> m_overflowDroppedFrameCount = 0;
+	std::atomic<uint64_t> m_reorderedDroppedFrameCount = 0;
 
 	// Render function to render a videoFrame onto a IMediaSample.
 	// Will not release the sample or dec videoframe nor do the Deliver()
 	// Will return S_FRAME_NOT_RENDERED if frame could not be renderered, not an error per-se
 	HRESULT RenderVideoFrameIntoSample(VideoFrame&, IMediaSample* const);
 
+	// Write the image of the video frame into the sample data, by default through the formatter.
+	// Returns true if something was written, false if not
+	virtual bool FormatVideoFrameIntoSample(const VideoFrame&, BYTE* pData);
+
 	// Get the next frame timestamp. If it doesn't know it's invalid. Overridden by implementations
 	virtual REFERENCE_TIME NextFrameTimestamp() const { return REFERENCE_TIME_INVALID; }
 
+	// Get the frame's timing timestamp with the jitter filtered out, for DS_SSTM_CLOCK_FILTERED
+	timingclocktime_t FilterFrameTimestamp(const VideoFrame&);
+
 	IVideoFrameFormatter* m_videoFrameFormatter;
 	timestamp_t m_frameDuration;
 	ITimingClock* m_timingClock;
@@ -129,5 +177,27 @@ protected:
 	HDRDataSharedPtr m_hdrData = nullptr;
 	bool m_hdrChanged = false;
 
-	double m_exitLatencyMs = 0.0;
+	std::atomic<double> m_exitLatencyMs = 0.0;
+	std::atomic<uint64_t> m_exitLatencySampleCount = 0;
+	std::atomic<double> m_wakeLatencyMs = 0.0;
+
+	// Performance counter ticks per second
+	LONGLONG m_performanceFrequency = 0;
+
+private:
+
+	unsigned int m_sampleBufferCount = 1;
+
+	// Only exists for DS_SSTM_CLOCK_FILTERED, used from the delivering thread
+	std::unique_ptr<FrameTimestampFilter> m_frameTimestampFilter;
+
+	// Set by Reset(), the delivering thread resets the filter before its next frame
+	std::atomic<bool> m_frameTimestampFilterResetPending = false;
+
+	// GetDeliveryBuffer() wait instrumentation, in performance counter ticks
+	LONGLONG m_deliveryBufferWaitSum = 0;
+	LONGLONG m_deliveryBufferWaitMax = 0;
+	uint32_t m_deliveryBufferWaitCount = 0;
+	std::atomic<double> m_deliveryBufferWaitMs = 0.0;
+	std::atomic<uint64_t> m_deliveryBufferStallCount = 0;
 };
@@ -8,14 +8,41 @@
 
 #include <pch.h>
 
+#include <algorithm>
+#include <cmath>
+
+#include <FrameTrace.h>
+#include <PipelineLatency.h>
+
 #include "CBufferedLiveSourceVideoOutputPin.h"
 
 
+// A held back clock-clock frame is delivered without waiting for its successor
+// if that one is this many frame durations late.
+static const int HELD_FRAME_DEADLINE_FRAMES = 2;
+
+// A frame is late once this many frame durations have passed since its timing timestamp
+static const int LATE_FRAME_DEADLINE_FRAMES = 1;
+
+// Amount of wakes over which the wake latency is averaged
+static const uint32_t WAKE_LATENCY_WINDOW = 500;
+
+// Captured frames waiting to be formatted at ingest, this pins capture buffers so is kept
+// small. If formatting can't keep up the oldest is dropped.
+static const uint32_t INGEST_QUEUE_MAX_SIZE = 2;
+
+// Formatted frame buffers in use outside of the delivery queue, one being formatted and one
+// being delivered.
+static const uint32_t FORMATTED_FRAME_POOL_EXTRA_BUFFERS = 2;
+
+
 CBufferedLiveSourceVideoOutputPin::CBufferedLiveSourceVideoOutputPin(
 	CLiveSource* filter,
 	CCritSec* pLock,
-	HRESULT* phr):
-	ALiveSourceVideoOutputPin(filter, pLock, phr)
+	HRESULT* phr,
+	bool formatAtIngest):
+	ALiveSourceVideoOutputPin(filter, pLock, phr),
+	m_formatAtIngest(formatAtIngest)
 {
 }
 
@@ -46,15 +73,45 @@ HRESULT CBufferedLiveSourceVideoOutputPin::Active()
 
 		assert(!ThreadExists());
 
+		m_isActive = true;
+
+		m_wakeLatencySum = 0;
+		m_wakeLatencyMax = 0;
+		m_wakeCount = 0;
+
+		// Buffers for a full delivery queue and the ones in flight, the delivery queue is
+		// capped to this pool when pushing so that formatting never runs out.
+		if (m_formatAtIngest)
 		{
-			CAutoLock lock2(&m_filterCritSec);
+			assert(!m_formattedFramePool);
 
-			m_isActive = true;
+			m_formattedFramePool.reset(new FrameBufferPool(
+				m_videoFrameFormatter->GetOutFrameSize(),
+				m_frameQueueMaxSize + FORMATTED_FRAME_POOL_EXTRA_BUFFERS,
+				FrameBufferPool::ALIGNMENT_PAGE,
+				true));
+
+			// Don't take the page faults on the first frames
+			m_formattedFramePool->PreFault();
+
+			m_streamingCopyFunc = GetStreamingCopyFunc(CpuSimdLevel());
+			m_formatThread = std::thread(&CBufferedLiveSourceVideoOutputPin::FormatThreadProc, this);
 		}
 
-		// start the thread
+		// start the thread, without it nothing may be left running
 		if (!Create())
+		{
+			m_isActive = false;
+			m_ingestQueueEvent.Set();
+
+			if (m_formatThread.joinable())
+				m_formatThread.join();
+
+			PurgeQueue();
+			m_formattedFramePool.reset();
+
 			return E_FAIL;
+		}
 
 		return S_OK;
 	}
@@ -74,18 +131,35 @@ HRESULT CBufferedLiveSourceVideoOutputPin::Inactive()
 		if (FAILED(hr))
 			return hr;
 
-		{
-			CAutoLock lock2(&m_filterCritSec);
-
-			m_isActive = false;
+		m_isActive = false;
+		m_ingestQueueEvent.Set();
+		m_frameQueueEvent.Set();
 
-			PurgeQueue();
-		}
+		if (m_formatThread.joinable())
+			m_formatThread.join();
 
 		if (ThreadExists())
 		{
 			Close();
 		}
+
+		// All formatted frame buffers are back in the pool after this
+		PurgeQueue();
+
+		if (m_formattedFramePool)
+		{
+			DbgLog((LOG_TRACE, 1,
+				TEXT("CBufferedLiveSourceVideoOutputPin formatted frame pool: %u buffers, large pages: %d, high-water mark: %u, misses: %I64u"),
+				m_formattedFramePool->GetBufferCount(), m_formattedFramePool->UsesLargePages(),
+				m_formattedFramePool->GetHighWaterMark(), m_formattedFramePool->GetMissCount()));
+
+			m_formattedFramePool.reset();
+		}
+
+		DbgLog((LOG_TRACE, 1,
+			TEXT("CBufferedLiveSourceVideoOutputPin dropped frames: %I64u, late: %I64u, overflow: %I64u, reordered: %I64u"),
+			m_droppedFrameCount.load(), m_lateDroppedFrameCount.load(),
+			m_overflowDroppedFrameCount.load(), m_reorderedDroppedFrameCount.load()));
 	}
 
 	return S_OK;
@@ -94,42 +168,33 @@ HRESULT CBufferedLiveSourceVideoOutputPin::Inactive()
 
 HRESULT CBufferedLiveSourceVideoOutputPin::OnVideoFrame(VideoFrame& videoFrame)
 {
-	{
-		CAutoLock lock(&m_filterCritSec);
+	// ! WARNING: Runs in the capture thread, must never block
 
-		// Reject frames if not processing
-		if (!m_isActive)
-			return S_OK;
+	// Reject frames if not processing
+	if (!m_isActive)
+		return S_OK;
 
-		// If this frame's timestamp is lower or equal to the one before it,
-		// erase that earlier one
-		while (!m_videoFrameQueue.empty())
-		{
-			VideoFrame lastFrame = m_videoFrameQueue.back();
+	FrameTraceScope frameTrace(FrameTraceEvent::ON_VIDEO_FRAME, videoFrame.GetCounter());
 
-			// Previous one was younger, nothing to do
-			if (videoFrame.GetTimingTimestamp() > lastFrame.GetTimingTimestamp())
-				break;
+	// Prevent from getting cleaned up and add to queue, the ring drops older or
+	// non-monotonic frames to make space
+	VideoFrameHandle videoFrameHandle(videoFrame);
 
-			// Previous one was older or equal, erase
-			lastFrame.SourceBufferRelease();
-			m_videoFrameQueue.pop_back();
-			++m_droppedFrameCount;
-		}
-
-		// If full throw away oldest to make space
-		if (m_videoFrameQueue.size() >= m_frameQueueMaxSize)
-		{
-			m_videoFrameQueue.front().SourceBufferRelease();
-			m_videoFrameQueue.pop_front();
-			++m_droppedFrameCount;
-		}
-
-		// Prevent from getting cleaned up and add to queue
-		videoFrame.SourceBufferAddRef();
-		m_videoFrameQueue.push_back(videoFrame);
+	if (m_formatAtIngest)
+	{
+		PushToQueue(m_ingestQueue, std::move(videoFrameHandle), INGEST_QUEUE_MAX_SIZE);
+		m_ingestQueueEvent.Set();
+	}
+	else
+	{
+		QueueForDelivery(std::move(videoFrameHandle));
 	}
 
+	// Inactive() might have purged the queue while we were pushing, don't leave
+	// the frame behind in that case
+	if (!m_isActive)
+		PurgeQueue();
+
 	return S_OK;
 }
 
@@ -139,29 +204,23 @@ void CBufferedLiveSourceVideoOutputPin::SetFrameQueueMaxSize(size_t frameQueueMa
 	if (frameQueueMaxSize <= 0)
 		throw std::runtime_error("Frame queue size must be > 0");
 
+	if (frameQueueMaxSize > CVideoFrameRing::CAPACITY)
 	{
-		CAutoLock lock(&m_filterCritSec);
-
-		m_frameQueueMaxSize = frameQueueMaxSize;
+		DbgLog((LOG_TRACE, 1,
+			TEXT("CBufferedLiveSourceVideoOutputPin::SetFrameQueueMaxSize(): Clamping %zu to %u"),
+			frameQueueMaxSize, CVideoFrameRing::CAPACITY));
 
-		// If full throw away oldest to make space if needed
-		while (m_videoFrameQueue.size() >= m_frameQueueMaxSize)
-		{
-			m_videoFrameQueue.front().SourceBufferRelease();
-			m_videoFrameQueue.pop_front();
-			++m_droppedFrameCount;
-		}
+		frameQueueMaxSize = CVideoFrameRing::CAPACITY;
 	}
+
+	// The capture thread trims the queue to the new size on the next frame
+	m_frameQueueMaxSize = (uint32_t)frameQueueMaxSize;
 }
 
 
 size_t CBufferedLiveSourceVideoOutputPin::GetFrameQueueSize()
 {
-	{
-		CAutoLock lock(&m_filterCritSec);
-
-		return m_videoFrameQueue.size();
-	}
+	return m_videoFrameQueue.Size();
 }
 
 
@@ -178,59 +237,88 @@ DWORD CBufferedLiveSourceVideoOutputPin::ThreadProc()
 
 	DbgLog((LOG_TRACE, 1, TEXT("CBufferedLiveSourceVideoOutputPin worker thread starting")));
 
+	// Set if the wait for the successor of a held back clock-clock frame timed out
+	bool heldFrameDeadlinePassed = false;
+
 	while (true)
 	{
-		// TODO: Sleep thread on empty queue and wake if frames arrive
-		Sleep(1);
-
-		VideoFrame videoFrame;
-
+		// Stop thread
+		if (!m_isActive)
+			break;
+
+		// For most timing empty is really empty, however for the clock-to-clock
+		// we need to keep one frame in until the next one arrives or it's too late.
+		const uint32_t minQueueSize =
+			(m_timestamp == DirectShowStartStopTimeMethod::DS_SSTM_CLOCK_CLOCK && !heldFrameDeadlinePassed) ? 2 : 1;
+
+		// Get the front frame (oldest) and the start time of the one after it
+		VideoFrameHandle videoFrame;
+		bool hasNextFrame = false;
+		timingclocktime_t nextFrameTimestamp = 0;
+		if (!m_videoFrameQueue.Pop(videoFrame, minQueueSize, hasNextFrame, nextFrameTimestamp))
 		{
-			CAutoLock lock(&m_filterCritSec);
+			heldFrameDeadlinePassed = false;
 
-			// Stop thread
-			if (!m_isActive)
-				break;
-
-			// For most timing empty is really empty, however for the clock-to-clock
-			// we need to keep one frame in.
-			if (m_timestamp == DirectShowStartStopTimeMethod::DS_SSTM_CLOCK_CLOCK)
+			const DWORD timeoutMs = FrameWaitTimeoutMs();
+			if (timeoutMs == 0)
 			{
-				if (m_videoFrameQueue.size() <= 1)
-					continue;
+				heldFrameDeadlinePassed = true;
+				continue;
 			}
+
+			LARGE_INTEGER waitStart;
+			QueryPerformanceCounter(&waitStart);
+
+			if (m_frameQueueEvent.Wait(timeoutMs))
+				OnWake(waitStart.QuadPart);
 			else
+				heldFrameDeadlinePassed = true;
+
+			continue;
+		}
+
+		heldFrameDeadlinePassed = false;
+		PipelineLatency::RecordSince(LatencyStage::QUEUE_WAIT, videoFrame->GetQueueTime());
+		FrameTrace::RecordInstant(FrameTraceEvent::DEQUEUE, videoFrame->GetCounter());
+
+		// Rather present the newer one than this one late
+		if (hasNextFrame && IsFrameLate(*videoFrame))
+		{
+			++m_droppedFrameCount;
+			++m_lateDroppedFrameCount;
+			continue;
+		}
+
+		switch (m_timestamp)
+		{
+		case DirectShowStartStopTimeMethod::DS_SSTM_CLOCK_CLOCK:
+
+			// Successor is late, pretend it arrives on time
+			if (!hasNextFrame)
 			{
-				if (m_videoFrameQueue.empty())
-					continue;
+				m_nextVideoFrameStartTime =
+					(REFERENCE_TIME)(
+					videoFrame->GetTimingTimestamp() *
+					(10000000.0 / m_timingClock->TimingClockTicksPerSecond())) +
+					m_frameDuration;
+				break;
 			}
+			// break;  not here intentionally
 
-			// Get the front frame (oldest)
-			videoFrame = m_videoFrameQueue.front();
-			m_videoFrameQueue.pop_front();
+		case DirectShowStartStopTimeMethod::DS_SSTM_CLOCK_SMART:
 
-			// Get the current front's start time
-			switch (m_timestamp)
+			if (hasNextFrame)
 			{
-			case DirectShowStartStopTimeMethod::DS_SSTM_CLOCK_CLOCK:
-				assert(!m_videoFrameQueue.empty());
-				// break;  not here intentionally
-
-			case DirectShowStartStopTimeMethod::DS_SSTM_CLOCK_SMART:
-
-				if (!m_videoFrameQueue.empty())
-				{
-					m_nextVideoFrameStartTime =
-						(REFERENCE_TIME)(
-						m_videoFrameQueue.front().GetTimingTimestamp() *
-						(10000000.0 / m_timingClock->TimingClockTicksPerSecond()));
-				}
-				else
-				{
-					m_nextVideoFrameStartTime = REFERENCE_TIME_INVALID;
-				}
-				break;
+				m_nextVideoFrameStartTime =
+					(REFERENCE_TIME)(
+					nextFrameTimestamp *
+					(10000000.0 / m_timingClock->TimingClockTicksPerSecond()));
+			}
+			else
+			{
+				m_nextVideoFrameStartTime = REFERENCE_TIME_INVALID;
 			}
+			break;
 		}
 
 		// Get buffer for sample
@@ -238,40 +326,36 @@ DWORD CBufferedLiveSourceVideoOutputPin::ThreadProc()
 		IMediaSample* pSample = nullptr;
 		HRESULT hr = this->GetDeliveryBuffer(&pSample, nullptr, nullptr, 0);
 		if (FAILED(hr))
-		{
-			videoFrame.SourceBufferRelease();
 			return -1;
-		}
 
 		// Convert
-		hr = RenderVideoFrameIntoSample(videoFrame, pSample);
+		hr = RenderVideoFrameIntoSample(*videoFrame, pSample);
 		if (FAILED(hr))
 		{
-			videoFrame.SourceBufferRelease();
 			pSample->Release();
 			return -2;
 		}
 		if (hr == S_FRAME_NOT_RENDERED)
 		{
-			videoFrame.SourceBufferRelease();
 			pSample->Release();
 			continue;
 		}
 
 		// Deliver frame to renderer
+		const int64_t deliverStart = PipelineLatency::Now();
 		hr = this->Deliver(pSample);
+		PipelineLatency::RecordSince(LatencyStage::DELIVER, deliverStart);
+		FrameTrace::RecordSince(FrameTraceEvent::DELIVER, videoFrame->GetCounter(), deliverStart);
 		if (FAILED(hr))
 		{
 			DbgLog((LOG_TRACE, 1,
 				TEXT("::FillBuffer(#%I64u): Failed to deliver sample, error: %i"),
-				videoFrame.GetCounter(), hr));
+				videoFrame->GetCounter(), hr));
 
-			videoFrame.SourceBufferRelease();
 			pSample->Release();
 			return -3;
 		}
 
-		videoFrame.SourceBufferRelease();
 		pSample->Release();
 	}
 
@@ -281,17 +365,186 @@ DWORD CBufferedLiveSourceVideoOutputPin::ThreadProc()
 }
 
 
-void CBufferedLiveSourceVideoOutputPin::PurgeQueue()
+void CBufferedLiveSourceVideoOutputPin::FormatThreadProc()
 {
+	// ! WARNING: Runs in the formatting thread
+
+	DbgLog((LOG_TRACE, 1, TEXT("CBufferedLiveSourceVideoOutputPin formatting thread starting")));
+
+	while (m_isActive)
 	{
-		CAutoLock lock(&m_filterCritSec);
+		VideoFrameHandle videoFrame;
+		bool hasNextFrame = false;
+		timingclocktime_t nextFrameTimestamp = 0;
+		if (!m_ingestQueue.Pop(videoFrame, 1, hasNextFrame, nextFrameTimestamp))
+		{
+			m_ingestQueueEvent.Wait();
+			continue;
+		}
 
-		while (!m_videoFrameQueue.empty())
+		// Don't spend formatting time on a frame which won't be shown
+		if (hasNextFrame && IsFrameLate(*videoFrame))
 		{
-			VideoFrame popFrame = m_videoFrameQueue.front();
-			popFrame.SourceBufferRelease();
-			m_videoFrameQueue.pop_front();
 			++m_droppedFrameCount;
+			++m_lateDroppedFrameCount;
+			continue;
+		}
+
+		// Can only happen if the queue size was raised after activation
+		FrameBuffer* buffer = m_formattedFramePool->Acquire();
+		if (!buffer)
+		{
+			DbgLog((LOG_TRACE, 1,
+				TEXT("CBufferedLiveSourceVideoOutputPin::FormatThreadProc(#%I64u): No free formatted frame buffer, dropping"),
+				videoFrame->GetCounter()));
+
+			++m_droppedFrameCount;
+			++m_overflowDroppedFrameCount;
+			continue;
 		}
+
+		// The formatted frame owns the buffer reference from here on
+		VideoFrameHandle formattedFrame = VideoFrameHandle::Adopt(
+			VideoFrame(buffer->Data(), videoFrame->GetCounter(), videoFrame->GetTimingTimestamp(), buffer));
+		formattedFrame->SetArrivalTime(videoFrame->GetArrivalTime());
+
+		const int64_t formatStart = PipelineLatency::Now();
+		const bool formatSuccess = m_videoFrameFormatter->FormatVideoFrame(*videoFrame, buffer->Data());
+		PipelineLatency::RecordSince(LatencyStage::FORMAT, formatStart);
+		FrameTrace::RecordSince(FrameTraceEvent::FORMAT, videoFrame->GetCounter(), formatStart);
+
+		// Done with the capture buffer, hand it back before the frame gets queued
+		videoFrame.Reset();
+
+		if (!formatSuccess)
+		{
+			DbgLog((LOG_TRACE, 1,
+				TEXT("CBufferedLiveSourceVideoOutputPin::FormatThreadProc(#%I64u): Format failed"),
+				formattedFrame->GetCounter()));
+
+			continue;
+		}
+
+		QueueForDelivery(std::move(formattedFrame));
 	}
+
+	DbgLog((LOG_TRACE, 1, TEXT("CBufferedLiveSourceVideoOutputPin formatting thread exiting")));
+}
+
+
+void CBufferedLiveSourceVideoOutputPin::QueueForDelivery(VideoFrameHandle&& videoFrame)
+{
+	videoFrame->SetQueueTime(PipelineLatency::Now());
+	PipelineLatency::RecordSince(LatencyStage::CALLBACK_TO_ENQUEUE, videoFrame->GetArrivalTime());
+
+	// Keep the formatted frames within the pool
+	uint32_t maxSize = m_frameQueueMaxSize;
+	if (m_formattedFramePool)
+		maxSize = std::min(maxSize, m_formattedFramePool->GetBufferCount() - FORMATTED_FRAME_POOL_EXTRA_BUFFERS);
+
+	const timingclocktime_t timingTimestamp = videoFrame->GetTimingTimestamp();
+	PushToQueue(m_videoFrameQueue, std::move(videoFrame), maxSize);
+	m_lastPushedFrameTimestamp = timingTimestamp;
+
+	// Wake the delivery thread
+	LARGE_INTEGER now;
+	QueryPerformanceCounter(&now);
+	m_lastSignalTime = now.QuadPart;
+	m_frameQueueEvent.Set();
+}
+
+
+void CBufferedLiveSourceVideoOutputPin::PushToQueue(CVideoFrameRing& queue, VideoFrameHandle&& videoFrame, uint32_t maxSize)
+{
+	uint32_t reorderedFrameCount = 0;
+	const uint32_t droppedFrameCount = queue.Push(std::move(videoFrame), maxSize, &reorderedFrameCount);
+
+	m_droppedFrameCount += droppedFrameCount;
+	m_reorderedDroppedFrameCount += reorderedFrameCount;
+	m_overflowDroppedFrameCount += droppedFrameCount - reorderedFrameCount;
+}
+
+
+bool CBufferedLiveSourceVideoOutputPin::IsFrameLate(const VideoFrame& videoFrame) const
+{
+	// Theoretical start times are not related to the timing clock
+	if (m_timestamp == DirectShowStartStopTimeMethod::DS_SSTM_THEO_THEO ||
+		m_timestamp == DirectShowStartStopTimeMethod::DS_SSTM_THEO_NONE)
+		return false;
+
+	const timingclocktime_t ticksPerSecond = m_timingClock->TimingClockTicksPerSecond();
+	const timingclocktime_t deadline =
+		videoFrame.GetTimingTimestamp() +
+		(timingclocktime_t)((LATE_FRAME_DEADLINE_FRAMES * m_frameDuration) * (ticksPerSecond / 10000000.0));
+
+	return m_timingClock->TimingClockNow() > deadline;
+}
+
+
+bool CBufferedLiveSourceVideoOutputPin::FormatVideoFrameIntoSample(const VideoFrame& videoFrame, BYTE* pData)
+{
+	if (!m_formatAtIngest)
+		return ALiveSourceVideoOutputPin::FormatVideoFrameIntoSample(videoFrame, pData);
+
+	// Already formatted, a plain copy
+	const size_t size = m_formattedFramePool->GetBufferSize();
+	StreamingCopyRows(m_streamingCopyFunc, pData, size, (const BYTE*)videoFrame.GetData(), size, size, 1);
+
+	return true;
+}
+
+
+void CBufferedLiveSourceVideoOutputPin::PurgeQueue()
+{
+	m_droppedFrameCount += m_ingestQueue.Purge();
+	m_droppedFrameCount += m_videoFrameQueue.Purge();
+}
+
+
+DWORD CBufferedLiveSourceVideoOutputPin::FrameWaitTimeoutMs() const
+{
+	if (m_timestamp != DirectShowStartStopTimeMethod::DS_SSTM_CLOCK_CLOCK ||
+		m_videoFrameQueue.Size() == 0)
+		return INFINITE;
+
+	// Held frame's successor is due one frame duration after it, allow for some jitter
+	const timingclocktime_t ticksPerSecond = m_timingClock->TimingClockTicksPerSecond();
+	const timingclocktime_t deadline =
+		m_lastPushedFrameTimestamp +
+		(timingclocktime_t)((HELD_FRAME_DEADLINE_FRAMES * m_frameDuration) * (ticksPerSecond / 10000000.0));
+
+	const double leftMs = TimingClockDiffMs(m_timingClock->TimingClockNow(), deadline, ticksPerSecond);
+	if (leftMs <= 0.0)
+		return 0;
+
+	return (DWORD)ceil(leftMs);
+}
+
+
+void CBufferedLiveSourceVideoOutputPin::OnWake(LONGLONG waitStart)
+{
+	LARGE_INTEGER now;
+	QueryPerformanceCounter(&now);
+
+	// If the event was already set when we started waiting we did not sleep
+	const LONGLONG latency = now.QuadPart - std::max(waitStart, m_lastSignalTime.load());
+	if (latency < 0)
+		return;
+
+	m_wakeLatencySum += latency;
+	m_wakeLatencyMax = std::max(m_wakeLatencyMax, latency);
+	++m_wakeCount;
+
+	if (m_wakeCount < WAKE_LATENCY_WINDOW)
+		return;
+
+	m_wakeLatencyMs = (m_wakeLatencySum * 1000.0) / (m_wakeCount * (double)m_performanceFrequency);
+
+	DbgLog((LOG_TRACE, 1,
+		TEXT("CBufferedLiveSourceVideoOutputPin wake latency over %u wakes, avg: %.03f ms, max: %.03f ms"),
+		m_wakeCount, m_wakeLatencyMs.load(), (m_wakeLatencyMax * 1000.0) / m_performanceFrequency));
+
+	m_wakeLatencySum = 0;
+	m_wakeLatencyMax = 0;
+	m_wakeCount = 0;
 }
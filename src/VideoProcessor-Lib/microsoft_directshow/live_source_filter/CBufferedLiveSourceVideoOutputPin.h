@@ -9,18 +9,33 @@
 #pragma once
 
 
-#include <deque>
+#include <memory>
+#include <thread>
 
 #include <microsoft_directshow/DirectShowDefines.h>
+#include <video_frame_formatter/StreamingCopy.h>
+#include <FrameBufferPool.h>
 #include "ALiveSourceVideoOutputPin.h"
 
 #include "CLiveSource.h"
+#include "CVideoFrameRing.h"
 
 
 /**
  * This is an buffered output pin, any presented frame will be buffered first
  * and then a separate thread will deliver the buffers to the renderer.
  *
+ * The buffer is a lock-free ring, the capture thread calling OnVideoFrame() never
+ * waits for the delivery thread. The delivery thread sleeps on an event which is
+ * signalled for every queued frame.
+ *
+ * Optionally frames are formatted at ingest: a formatting thread converts every captured frame
+ * into a pre-allocated buffer and releases the capture buffer right away, the delivery thread
+ * then only has to copy the formatted frame into the sample.
+ *
+ * Frames which missed their presentation deadline are dropped before being formatted or
+ * delivered if a newer frame is already queued, so a backlog drains to the newest on-time frame.
+ *
  * This class borrows heavily from DirectShow CSourceStream.
  */
 class CBufferedLiveSourceVideoOutputPin:
@@ -32,7 +47,8 @@ public:
 	CBufferedLiveSourceVideoOutputPin(
 		CLiveSource* filter,
 		CCritSec* pLock,
-		HRESULT* phr);
+		HRESULT* phr,
+		bool formatAtIngest);
 	virtual ~CBufferedLiveSourceVideoOutputPin();
 
 	// CBaseOutputPin
@@ -46,21 +62,67 @@ public:
 	void Reset() override;
 	REFERENCE_TIME NextFrameTimestamp() const override { return m_nextVideoFrameStartTime; }
 
+protected:
+
+	// ALiveSourceVideoOutputPin
+	bool FormatVideoFrameIntoSample(const VideoFrame&, BYTE* pData) override;
+
 private:
 
-	size_t m_frameQueueMaxSize = 0;
+	std::atomic<uint32_t> m_frameQueueMaxSize = 0;
 
-	std::deque<VideoFrame> m_videoFrameQueue;
+	// Frames ready for delivery, formatted already if m_formatAtIngest
+	CVideoFrameRing m_videoFrameQueue;
 	std::atomic_bool m_isActive = false;
 
-	CCritSec m_filterCritSec;
-
 	REFERENCE_TIME m_nextVideoFrameStartTime = REFERENCE_TIME_INVALID;
 
+	// Auto-reset, set after every push to m_videoFrameQueue and by Inactive()
+	CAMEvent m_frameQueueEvent;
+
+	// Format at ingest, the capture thread queues to m_ingestQueue from which the
+	// formatting thread fills m_videoFrameQueue with frames in m_formattedFramePool buffers.
+	const bool m_formatAtIngest;
+	CVideoFrameRing m_ingestQueue;
+	CAMEvent m_ingestQueueEvent;
+	std::thread m_formatThread;
+	std::unique_ptr<FrameBufferPool> m_formattedFramePool;
+	StreamingCopyFunc m_streamingCopyFunc = nullptr;
+
+	// Timestamp of the newest pushed frame, used for the clock-clock hold back deadline
+	std::atomic<timingclocktime_t> m_lastPushedFrameTimestamp = 0;
+
+	// Wake latency instrumentation, performance counter ticks
+	std::atomic<LONGLONG> m_lastSignalTime = 0;
+	LONGLONG m_wakeLatencySum = 0;
+	LONGLONG m_wakeLatencyMax = 0;
+	uint32_t m_wakeCount = 0;
+
 	// Thread function, upon return thread exist.
 	// Return codes > 0 indicate an error occured
 	DWORD ThreadProc();
 
-	// Remove all items from the videoFrameQueue
+	// Formatting thread function when formatting at ingest
+	void FormatThreadProc();
+
+	// Push a frame on the delivery queue and wake the delivery thread
+	void QueueForDelivery(VideoFrameHandle&&);
+
+	// Push a frame on the given queue and account the frames it dropped
+	void PushToQueue(CVideoFrameRing&, VideoFrameHandle&&, uint32_t maxSize);
+
+	// Returns true if the frame's presentation deadline has passed. The deadline is the end of
+	// its display interval, its timing timestamp already includes the frame offset.
+	bool IsFrameLate(const VideoFrame&) const;
+
+	// Remove all items from the queues
 	void PurgeQueue();
+
+	// Get how long the delivery thread may sleep waiting for the next frame.
+	// This is INFINITE unless a clock-clock frame is being held back, in which case
+	// it's the time left until we give up on its successor.
+	DWORD FrameWaitTimeoutMs() const;
+
+	// Account a delivery thread wake, waitStart is when it started waiting
+	void OnWake(LONGLONG waitStart);
 };
@@ -52,13 +52,18 @@ STDMETHODIMP CLiveSource::Initialize(
 	ITimingClock* timingClock,
 	DirectShowStartStopTimeMethod timestamp,
 	bool useFrameQueue,
-	size_t frameQueueMaxSize)
+	size_t frameQueueMaxSize,
+	bool formatAtIngest,
+	unsigned int sampleBufferCount)
 {
 	assert(!m_videoOutputPin);
 	assert(videoFrameFormatter);
 	assert(mediaType.majortype.Data1 > 0);
 	assert(frameDuration > 0);
 
+	if (formatAtIngest && !useFrameQueue)
+		throw std::runtime_error("Formatting at ingest needs a frame queue");
+
 	HRESULT hr = S_OK;
 
 	if (useFrameQueue)
@@ -66,7 +71,8 @@ STDMETHODIMP CLiveSource::Initialize(
 		m_videoOutputPin = new CBufferedLiveSourceVideoOutputPin(
 			this,
 			&m_critSec,
-			&hr);
+			&hr,
+			formatAtIngest);
 	}
 	else
 	{
@@ -87,7 +93,8 @@ STDMETHODIMP CLiveSource::Initialize(
 		frameDuration,
 		timingClock,
 		timestamp,
-		mediaType);
+		mediaType,
+		sampleBufferCount);
 
 	if (useFrameQueue)
 		m_videoOutputPin->SetFrameQueueMaxSize(frameQueueMaxSize);
@@ -187,7 +194,49 @@ double CLiveSource::ExitLatencyMs() const
 }
 
 
+uint64_t CLiveSource::ExitLatencySampleCount() const
+{
+	return m_videoOutputPin->ExitLatencySampleCount();
+}
+
+
+double CLiveSource::WakeLatencyMs() const
+{
+	return m_videoOutputPin->WakeLatencyMs();
+}
+
+
+double CLiveSource::DeliveryBufferWaitMs() const
+{
+	return m_videoOutputPin->DeliveryBufferWaitMs();
+}
+
+
+uint64_t CLiveSource::DeliveryBufferStallCount() const
+{
+	return m_videoOutputPin->DeliveryBufferStallCount();
+}
+
+
 uint64_t CLiveSource::DroppedFrameCount() const
 {
 	return m_videoOutputPin->DroppedFrameCount();
 }
+
+
+uint64_t CLiveSource::LateDroppedFrameCount() const
+{
+	return m_videoOutputPin->LateDroppedFrameCount();
+}
+
+
+uint64_t CLiveSource::OverflowDroppedFrameCount() const
+{
+	return m_videoOutputPin->OverflowDroppedFrameCount();
+}
+
+
+uint64_t CLiveSource::ReorderedDroppedFrameCount() const
+{
+	return m_videoOutputPin->ReorderedDroppedFrameCount();
+}
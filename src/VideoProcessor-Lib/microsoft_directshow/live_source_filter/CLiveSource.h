@@ -52,7 +52,9 @@ public:
 		ITimingClock* timingClock,
 		DirectShowStartStopTimeMethod timestamp,
 		bool useFrameQueue,
-		size_t frameQueueMaxSize) override;
+		size_t frameQueueMaxSize,
+		bool formatAtIngest,
+		unsigned int sampleBufferCount) override;
 	STDMETHODIMP Destroy() override;
 	STDMETHODIMP OnHDRData(HDRDataSharedPtr&) override;
 	STDMETHODIMP OnVideoFrame(VideoFrame&) override;
@@ -85,13 +87,32 @@ public:
 
 	// Get the exit latency in ms, which the amount of time between the frame timestamp
 	// and when the frame is delivered to the DirectShow renderer.
-	// This is sampled.
+	// This is the last delivered frame.
 	double ExitLatencyMs() const;
 
+	// Get the amount of exit latency samples taken
+	uint64_t ExitLatencySampleCount() const;
+
+	// Get the wake latency in ms of the delivery thread, zero if unbuffered.
+	// This is averaged over a window.
+	double WakeLatencyMs() const;
+
+	// Get the time in ms waited for a free sample from the renderer.
+	// This is averaged over a window.
+	double DeliveryBufferWaitMs() const;
+
+	// Get the amount of times we had to wait for the renderer to release a sample
+	uint64_t DeliveryBufferStallCount() const;
+
 
 	// Get the amount of dropped frames due to queue actions
 	uint64_t DroppedFrameCount() const;
 
+	// Get the amount of dropped frames by reason, see ALiveSourceVideoOutputPin
+	uint64_t LateDroppedFrameCount() const;
+	uint64_t OverflowDroppedFrameCount() const;
+	uint64_t ReorderedDroppedFrameCount() const;
+
 private:
 	ALiveSourceVideoOutputPin* m_videoOutputPin = nullptr;
 
@@ -8,6 +8,9 @@
 
 #include <pch.h>
 
+#include <FrameTrace.h>
+#include <PipelineLatency.h>
+
 #include "CUnbufferedLiveSourceVideoOutputPin.h"
 
 
@@ -31,6 +34,11 @@ HRESULT CUnbufferedLiveSourceVideoOutputPin::OnVideoFrame(VideoFrame& videoFrame
 	BYTE* pData = nullptr;
 	HRESULT hr;
 
+	FrameTraceScope frameTrace(FrameTraceEvent::ON_VIDEO_FRAME, videoFrame.GetCounter());
+
+	// Nothing is queued, the frame is handed over directly
+	PipelineLatency::RecordSince(LatencyStage::CALLBACK_TO_ENQUEUE, videoFrame.GetArrivalTime());
+
 	// Get buffer for sample
 	// Note you can fill in start and stop time, but following the code shows that they are unused.
 	IMediaSample* pSample = nullptr;
@@ -49,7 +57,10 @@ HRESULT CUnbufferedLiveSourceVideoOutputPin::OnVideoFrame(VideoFrame& videoFrame
 	}
 
 	// Deliver to downstream renderer (this will block)
+	const int64_t deliverStart = PipelineLatency::Now();
 	hr = this->Deliver(pSample);
+	PipelineLatency::RecordSince(LatencyStage::DELIVER, deliverStart);
+	FrameTrace::RecordSince(FrameTraceEvent::DELIVER, videoFrame.GetCounter(), deliverStart);
 	pSample->Release();
 
 	return hr;
@@ -0,0 +1,177 @@
+/*
+ * Copyright(C) 2021 Dennis Fleurbaaij <mail@dennisfleurbaaij.com>
+ *
+ * This program is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, version 3.
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License along with this program. If not, see < https://www.gnu.org/licenses/>.
+ */
+
+
+#include <pch.h>
+
+#include "CVideoFrameRing.h"
+
+
+static_assert((CVideoFrameRing::CAPACITY & (CVideoFrameRing::CAPACITY - 1)) == 0, "Capacity must be a power of two");
+static_assert(CVideoFrameRing::CAPACITY < 0x8000, "Capacity must fit the 16-bit counters");
+
+
+CVideoFrameRing::CVideoFrameRing():
+	m_state(0)
+{
+}
+
+
+CVideoFrameRing::~CVideoFrameRing()
+{
+	Purge();
+}
+
+
+uint32_t CVideoFrameRing::Push(VideoFrameHandle&& videoFrame, uint32_t maxSize, uint32_t* reorderedFrameCount)
+{
+	assert(videoFrame);
+	assert(maxSize > 0);
+	assert(maxSize <= CAPACITY);
+
+	uint32_t droppedFrameCount = 0;
+
+	// If this frame's timestamp is lower or equal to the ones before it, erase those. Only the
+	// producer writes slots so the newest one is stable, popping it from the back only fails if
+	// another thread took a frame in the meantime.
+	uint64_t state = m_state.load(std::memory_order_acquire);
+	while (Count(state) > 0)
+	{
+		const uint16_t tail = Tail(state) - 1;
+		const VideoFrame lastFrame = LoadSlot(m_slots[tail % CAPACITY]);
+
+		// Previous one was younger, nothing to do
+		if (videoFrame->GetTimingTimestamp() > lastFrame.GetTimingTimestamp())
+			break;
+
+		if (m_state.compare_exchange_weak(
+				state, MakeState(Head(state), tail, state),
+				std::memory_order_acq_rel, std::memory_order_acquire))
+		{
+			VideoFrameHandle::Adopt(lastFrame).Reset();
+			++droppedFrameCount;
+			state = m_state.load(std::memory_order_acquire);
+		}
+	}
+
+	if (reorderedFrameCount)
+		*reorderedFrameCount = droppedFrameCount;
+
+	// If full throw away oldest to make space
+	while (Count(m_state.load(std::memory_order_acquire)) >= maxSize)
+	{
+		VideoFrameHandle frontFrame;
+		if (PopFront(frontFrame))
+		{
+			frontFrame.Reset();
+			++droppedFrameCount;
+		}
+	}
+
+	// The tail slot is free as there is room and only the producer fills slots
+	state = m_state.load(std::memory_order_acquire);
+	StoreSlot(m_slots[Tail(state) % CAPACITY], videoFrame.Detach());
+
+	while (!m_state.compare_exchange_weak(
+			state, MakeState(Head(state), Tail(state) + 1, state),
+			std::memory_order_acq_rel, std::memory_order_acquire))
+	{
+	}
+
+	return droppedFrameCount;
+}
+
+
+bool CVideoFrameRing::Pop(VideoFrameHandle& videoFrame, uint32_t minSize, bool& hasNextFrame, timingclocktime_t& nextFrameTimestamp)
+{
+	assert(minSize > 0);
+
+	uint64_t state = m_state.load(std::memory_order_acquire);
+	while (true)
+	{
+		const uint32_t count = Count(state);
+		if (count < minSize)
+			return false;
+
+		const uint16_t head = Head(state);
+		const VideoFrame frontFrame = LoadSlot(m_slots[head % CAPACITY]);
+
+		hasNextFrame = (count > 1);
+		if (hasNextFrame)
+			nextFrameTimestamp = m_slots[(uint16_t)(head + 1) % CAPACITY].timingTimestamp.load(std::memory_order_relaxed);
+
+		if (m_state.compare_exchange_weak(
+				state, MakeState(head + 1, Tail(state), state),
+				std::memory_order_acq_rel, std::memory_order_acquire))
+		{
+			videoFrame = VideoFrameHandle::Adopt(frontFrame);
+			return true;
+		}
+	}
+}
+
+
+uint32_t CVideoFrameRing::Purge()
+{
+	uint32_t purgedFrameCount = 0;
+
+	VideoFrameHandle videoFrame;
+	while (PopFront(videoFrame))
+	{
+		videoFrame.Reset();
+		++purgedFrameCount;
+	}
+
+	return purgedFrameCount;
+}
+
+
+uint32_t CVideoFrameRing::Size() const
+{
+	return Count(m_state.load(std::memory_order_acquire));
+}
+
+
+uint64_t CVideoFrameRing::MakeState(uint16_t head, uint16_t tail, uint64_t previous)
+{
+	const uint32_t sequence = (uint32_t)previous + 1;
+	return ((uint64_t)head << 48) | ((uint64_t)tail << 32) | sequence;
+}
+
+
+void CVideoFrameRing::StoreSlot(Slot& slot, const VideoFrame& videoFrame)
+{
+	slot.data.store(videoFrame.m_data, std::memory_order_relaxed);
+	slot.counter.store(videoFrame.m_counter, std::memory_order_relaxed);
+	slot.timingTimestamp.store(videoFrame.m_timingTimestamp, std::memory_order_relaxed);
+	slot.sourceBuffer.store(videoFrame.m_sourceBuffer, std::memory_order_relaxed);
+	slot.arrivalTime.store(videoFrame.m_arrivalTime, std::memory_order_relaxed);
+	slot.queueTime.store(videoFrame.m_queueTime, std::memory_order_relaxed);
+}
+
+
+VideoFrame CVideoFrameRing::LoadSlot(const Slot& slot)
+{
+	VideoFrame videoFrame;
+	videoFrame.m_data = slot.data.load(std::memory_order_relaxed);
+	videoFrame.m_counter = slot.counter.load(std::memory_order_relaxed);
+	videoFrame.m_timingTimestamp = slot.timingTimestamp.load(std::memory_order_relaxed);
+	videoFrame.m_sourceBuffer = slot.sourceBuffer.load(std::memory_order_relaxed);
+	videoFrame.m_arrivalTime = slot.arrivalTime.load(std::memory_order_relaxed);
+	videoFrame.m_queueTime = slot.queueTime.load(std::memory_order_relaxed);
+
+	return videoFrame;
+}
+
+
+bool CVideoFrameRing::PopFront(VideoFrameHandle& videoFrame)
+{
+	bool hasNextFrame;
+	timingclocktime_t nextFrameTimestamp;
+	return Pop(videoFrame, 1, hasNextFrame, nextFrameTimestamp);
+}
@@ -0,0 +1,100 @@
+/*
+ * Copyright(C) 2021 Dennis Fleurbaaij <mail@dennisfleurbaaij.com>
+ *
+ * This program is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, version 3.
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License along with this program. If not, see < https://www.gnu.org/licenses/>.
+ */
+
+
+#pragma once
+
+
+#include <atomic>
+
+#include <VideoFrameHandle.h>
+
+
+/**
+ * Bounded lock-free ring of video frames with a single producer.
+ *
+ * The producer pushes frames and, to never block, drops frames itself: the newest queued frames
+ * if the pushed one is not younger than them and the oldest if the ring is over the requested
+ * size. As the producer removes from both ends a plain head/tail SPSC ring does not work, so head,
+ * tail and a sequence number are packed in a single atomic word which all sides update with a
+ * compare-and-swap. The sequence number changes on every update which stops a frame popped by
+ * another thread from being taken after the producer replaced it (ABA).
+ *
+ * Frames are read from their slot before the compare-and-swap which claims them, a slot which
+ * the producer re-filled in the meantime will make that compare-and-swap fail and the copy is
+ * discarded without being used. As such a read can overlap the producer's write, the slot
+ * fields are relaxed atomics rather than a plain VideoFrame. The compare-and-swap on the state
+ * word provides the ordering.
+ *
+ * Frames are moved in and out as handles, queued frames keep their handle's source buffer
+ * reference. The slots only hold the detached frames, so speculative reads never touch a
+ * refcount, the reference goes back into a handle once a frame is claimed. Frames dropped by the
+ * ring are released by it.
+ */
+class CVideoFrameRing
+{
+public:
+
+	// Maximum amount of queued frames
+	static const uint32_t CAPACITY = 64;
+
+	CVideoFrameRing();
+	~CVideoFrameRing();
+
+	// Producer only.
+	// Queue the frame after dropping all queued frames which are not older than it and as many
+	// of the oldest as needed to stay within maxSize. Returns the amount of frames dropped, of
+	// which reorderedFrameCount (if given) were dropped for not being older than the pushed one.
+	uint32_t Push(VideoFrameHandle&& videoFrame, uint32_t maxSize, uint32_t* reorderedFrameCount = nullptr);
+
+	// Any thread, normally the consumer.
+	// Take the oldest frame if at least minSize (>= 1) frames are queued. If there is a frame
+	// behind it its timestamp is returned in nextFrameTimestamp, hasNextFrame tells if there was.
+	bool Pop(VideoFrameHandle& videoFrame, uint32_t minSize, bool& hasNextFrame, timingclocktime_t& nextFrameTimestamp);
+
+	// Any thread.
+	// Release all queued frames, returns the amount released.
+	uint32_t Purge();
+
+	// Any thread, the amount of queued frames at the time of the call
+	uint32_t Size() const;
+
+private:
+
+	// State word layout: head (16 bits) | tail (16 bits) | sequence (32 bits)
+	// head and tail are free-running, slot index is counter % CAPACITY
+	static uint16_t Head(uint64_t state) { return (uint16_t)(state >> 48); }
+	static uint16_t Tail(uint64_t state) { return (uint16_t)(state >> 32); }
+	static uint32_t Count(uint64_t state) { return (uint16_t)(Tail(state) - Head(state)); }
+	static uint64_t MakeState(uint16_t head, uint16_t tail, uint64_t previous);
+
+	// A detached frame, field by field
+	struct Slot
+	{
+		std::atomic<const void*> data = nullptr;
+		std::atomic<uint64_t> counter = 0;
+		std::atomic<timingclocktime_t> timingTimestamp = 0;
+		std::atomic<IUnknown*> sourceBuffer = nullptr;
+		std::atomic<int64_t> arrivalTime = 0;
+		std::atomic<int64_t> queueTime = 0;
+	};
+
+	static void StoreSlot(Slot& slot, const VideoFrame& videoFrame);
+	static VideoFrame LoadSlot(const Slot& slot);
+
+	// Pop the oldest frame without a size requirement, used for dropping
+	bool PopFront(VideoFrameHandle& videoFrame);
+
+	// The state word sits on its own cache line, away from the slots which the producer writes
+	// and from the members of the owner.
+	char m_padBefore[64];
+	std::atomic<uint64_t> m_state;
+	char m_padAfter[64 - sizeof(std::atomic<uint64_t>)];
+
+	Slot m_slots[CAPACITY];
+};
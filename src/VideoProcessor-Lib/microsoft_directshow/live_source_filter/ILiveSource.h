@@ -26,6 +26,8 @@ static const GUID CLSID_CLiveSource =
 DECLARE_INTERFACE_(ILiveSource, IUnknown)
 {
 	// Initialize, can only be called once
+	// formatAtIngest formats frames on their own thread before queueing, needs useFrameQueue
+	// sampleBufferCount is the minimum amount of samples to negotiate with the renderer
 	STDMETHOD(Initialize)(
 		IVideoFrameFormatter* videoFrameFormatter,
 		const AM_MEDIA_TYPE& mediaSubType,
@@ -33,7 +35,9 @@ DECLARE_INTERFACE_(ILiveSource, IUnknown)
 		ITimingClock * timingClock,
 		DirectShowStartStopTimeMethod timestamp,
 		bool useFrameQueue,
-		size_t frameQueueMaxSize) PURE;
+		size_t frameQueueMaxSize,
+		bool formatAtIngest,
+		unsigned int sampleBufferCount) PURE;
 
 	// Destroy, can only be called once
 	STDMETHOD(Destroy)(void) PURE;
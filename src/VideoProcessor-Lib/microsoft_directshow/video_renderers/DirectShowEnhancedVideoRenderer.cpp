@@ -20,7 +20,8 @@ DirectShowEnhancedVideoRenderer::DirectShowEnhancedVideoRenderer(
 	DirectShowStartStopTimeMethod timestamp,
 	bool useFrameQueue,
 	size_t frameQueueMaxSize,
-	VideoConversionOverride videoConversionOverride):
+	VideoConversionOverride videoConversionOverride,
+	const PipelineOptions& pipelineOptions):
 	DirectShowGenericVideoRenderer(
 		CLSID_EnhancedVideoRenderer,
 		callback,
@@ -31,7 +32,8 @@ DirectShowEnhancedVideoRenderer::DirectShowEnhancedVideoRenderer(
 		timestamp,
 		useFrameQueue,
 		frameQueueMaxSize,
-		videoConversionOverride)
+		videoConversionOverride,
+		pipelineOptions)
 {
 	callback.OnRendererDetailString(TEXT("DirectShow Enhanced Video Renderer"));
 }
@@ -30,7 +30,8 @@ public:
 		DirectShowStartStopTimeMethod directShowStartStopTimeMethod,
 		bool useFrameQueue,
 		size_t frameQueueMaxSize,
-		VideoConversionOverride videoConversionOverride);
+		VideoConversionOverride videoConversionOverride,
+		const PipelineOptions& pipelineOptions);
 
 	virtual ~DirectShowEnhancedVideoRenderer() {}
 };
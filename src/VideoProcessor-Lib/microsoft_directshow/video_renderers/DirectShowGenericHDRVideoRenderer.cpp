@@ -12,8 +12,8 @@
 
 #include <guid.h>
 #include <video_frame_formatter/CNoopVideoFrameFormatter.h>
+#include <video_frame_formatter/CRGBtoRGB48VideoFrameFormatter.h>
 #include <video_frame_formatter/CV210toP010VideoFrameFormatter.h>
-#include <video_frame_formatter/CFFMpegDecoderVideoFrameFormatter.h>
 #include <microsoft_directshow/DirectShowTranslations.h>
 
 #include "DirectShowGenericHDRVideoRenderer.h"
@@ -30,6 +30,7 @@ DirectShowGenericHDRVideoRenderer::DirectShowGenericHDRVideoRenderer(
 	bool useFrameQueue,
 	size_t frameQueueMaxSize,
 	VideoConversionOverride videoConversionOverride,
+	const PipelineOptions& pipelineOptions,
 	DXVA_NominalRange forceNominalRange,
 	DXVA_VideoTransferFunction forceVideoTransferFunction,
 	DXVA_VideoTransferMatrix forceVideoTransferMatrix,
@@ -43,7 +44,8 @@ DirectShowGenericHDRVideoRenderer::DirectShowGenericHDRVideoRenderer(
 		timestamp,
 		useFrameQueue,
 		frameQueueMaxSize,
-		videoConversionOverride),
+		videoConversionOverride,
+		pipelineOptions),
 	m_rendererCLSID(rendererCLSID),
 	m_forceNominalRange(forceNominalRange),
 	m_forceVideoTransferFunction(forceVideoTransferFunction),
@@ -108,15 +110,27 @@ void DirectShowGenericHDRVideoRenderer::MediaTypeGenerate()
 	GUID mediaSubType;
 	int bitCount;
 	LONG heightMultiplier = 1;
+	DXVA_VideoChromaSubsampling videoChromaSubsampling = DXVA_VideoChromaSubsampling_Unknown;
 
 	// v210 (YUV422) to p010 (YUV420)
 	// This is lossy, only use to revert decklink upscaling
 	if (m_videoState->videoFrameEncoding == VideoFrameEncoding::V210 &&
-		m_videoConversionOverride == VideoConversionOverride::VIDEOCONVERSION_V210_TO_P010)
+		(m_videoConversionOverride == VideoConversionOverride::VIDEOCONVERSION_V210_TO_P010 ||
+		 m_videoConversionOverride == VideoConversionOverride::VIDEOCONVERSION_V210_TO_P010_TOP_LEFT))
 	{
+		const ChromaSiting chromaSiting =
+			(m_videoConversionOverride == VideoConversionOverride::VIDEOCONVERSION_V210_TO_P010_TOP_LEFT) ?
+			ChromaSiting::TOP_LEFT :
+			ChromaSiting::LEFT;
+
+		videoChromaSubsampling =
+			(chromaSiting == ChromaSiting::TOP_LEFT) ?
+			DXVA_VideoChromaSubsampling_Cosited :
+			DXVA_VideoChromaSubsampling_MPEG2;
+
 		mediaSubType = MEDIASUBTYPE_P010;
 		bitCount = 10;
-		m_videoFramFormatter = new CV210toP010VideoFrameFormatter();
+		m_videoFramFormatter = new CV210toP010VideoFrameFormatter(chromaSiting);
 	}
 
 	// Default conversions
@@ -124,28 +138,18 @@ void DirectShowGenericHDRVideoRenderer::MediaTypeGenerate()
 	{
 		switch (m_videoState->videoFrameEncoding)
 		{
-			// r210 to RGB48
+			// 10- and 12-bit RGB to RGB48
 		case VideoFrameEncoding::R210:
-
-			mediaSubType = MEDIASUBTYPE_RGB0;
-			bitCount = 48;
-			heightMultiplier = -1;
-
-			m_videoFramFormatter = new CFFMpegDecoderVideoFrameFormatter(
-				AV_CODEC_ID_R210,
-				AV_PIX_FMT_RGB48LE);
-			break;
-
-			// RGB 12-bit to RGB48
+		case VideoFrameEncoding::R10b:
+		case VideoFrameEncoding::R10l:
 		case VideoFrameEncoding::R12B:
+		case VideoFrameEncoding::R12L:
 
 			mediaSubType = MEDIASUBTYPE_RGB0;
 			bitCount = 48;
 			heightMultiplier = -1;
 
-			m_videoFramFormatter = new CFFMpegDecoderVideoFrameFormatter(
-				AV_CODEC_ID_R12B,
-				AV_PIX_FMT_RGB48LE);
+			m_videoFramFormatter = new CRGBtoRGB48VideoFrameFormatter();
 			break;
 
 			// No conversion needed
@@ -215,6 +219,8 @@ void DirectShowGenericHDRVideoRenderer::MediaTypeGenerate()
 		m_forceNominalRange :
 		DXVA_NominalRange::DXVA_NominalRange_Unknown;  // = Let renderer guess
 
+	colorimetry->VideoChromaSubsampling = videoChromaSubsampling;
+
 	pvi2->dwControlFlags += AMCONTROL_USED;
 	pvi2->dwControlFlags += AMCONTROL_COLORINFO_PRESENT;
 
@@ -27,7 +27,8 @@ DirectShowGenericVideoRenderer::DirectShowGenericVideoRenderer(
 	DirectShowStartStopTimeMethod timestamp,
 	bool useFrameQueue,
 	size_t frameQueueMaxSize,
-	VideoConversionOverride videoConversionOverride):
+	VideoConversionOverride videoConversionOverride,
+	const PipelineOptions& pipelineOptions):
 	DirectShowVideoRenderer(
 		callback,
 		videoHwnd,
@@ -37,7 +38,8 @@ DirectShowGenericVideoRenderer::DirectShowGenericVideoRenderer(
 		timestamp,
 		useFrameQueue,
 		frameQueueMaxSize,
-		videoConversionOverride),
+		videoConversionOverride,
+		pipelineOptions),
 	m_rendererCLSID(rendererCLSID)
 {
 	callback.OnRendererDetailString(TEXT("DirectShow generic renderer"));
@@ -69,11 +71,17 @@ void DirectShowGenericVideoRenderer::MediaTypeGenerate()
 	// v210 (YUV422) to p010 (YUV420)
 	// This is lossy, only use to revert decklink upscaling
 	if (m_videoState->videoFrameEncoding == VideoFrameEncoding::V210 &&
-		m_videoConversionOverride == VideoConversionOverride::VIDEOCONVERSION_V210_TO_P010)
+		(m_videoConversionOverride == VideoConversionOverride::VIDEOCONVERSION_V210_TO_P010 ||
+		 m_videoConversionOverride == VideoConversionOverride::VIDEOCONVERSION_V210_TO_P010_TOP_LEFT))
 	{
+		const ChromaSiting chromaSiting =
+			(m_videoConversionOverride == VideoConversionOverride::VIDEOCONVERSION_V210_TO_P010_TOP_LEFT) ?
+			ChromaSiting::TOP_LEFT :
+			ChromaSiting::LEFT;
+
 		mediaSubType = MEDIASUBTYPE_P010;
 		bitCount = 10;
-		m_videoFramFormatter = new CV210toP010VideoFrameFormatter();
+		m_videoFramFormatter = new CV210toP010VideoFrameFormatter(chromaSiting);
 	}
 
 	// Default conversions
@@ -13,10 +13,7 @@
 
 #include <FilterInterfaces.h>
 #include <guid.h>
-#include <video_frame_formatter/CNoopVideoFrameFormatter.h>
-#include <video_frame_formatter/CV210toP010VideoFrameFormatter.h>
-#include <video_frame_formatter/CV210toP210VideoFrameFormatter.h>
-#include <video_frame_formatter/CFFMpegDecoderVideoFrameFormatter.h>
+#include <video_frame_formatter/VideoFrameConversion.h>
 #include <microsoft_directshow/DirectShowTranslations.h>
 
 
@@ -33,6 +30,7 @@ DirectShowMPCVideoRenderer::DirectShowMPCVideoRenderer(
 	bool useFrameQueue,
 	size_t frameQueueMaxSize,
 	VideoConversionOverride videoConversionOverride,
+	const PipelineOptions& pipelineOptions,
 	DXVA_NominalRange forceNominalRange,
 	DXVA_VideoTransferFunction forceVideoTransferFunction,
 	DXVA_VideoTransferMatrix forceVideoTransferMatrix,
@@ -46,7 +44,8 @@ DirectShowMPCVideoRenderer::DirectShowMPCVideoRenderer(
 		directShowStartStopTimeMethod,
 		useFrameQueue,
 		frameQueueMaxSize,
-		videoConversionOverride),
+		videoConversionOverride,
+		pipelineOptions),
 	m_forceNominalRange(forceNominalRange),
 	m_forceVideoTransferFunction(forceVideoTransferFunction),
 	m_forceVideoTransferMatrix(forceVideoTransferMatrix),
@@ -150,63 +149,49 @@ void DirectShowMPCVideoRenderer::MediaTypeGenerate()
 	GUID mediaSubType;
 	int bitCount;
 	LONG heightMultiplier = 1;
+	DXVA_VideoChromaSubsampling videoChromaSubsampling = DXVA_VideoChromaSubsampling_Unknown;
 
-	// v210 (YUV422) to p010 (YUV420)
-	// This is lossy, only use to revert decklink upscaling
-	if (m_videoState->videoFrameEncoding == VideoFrameEncoding::V210 &&
-		m_videoConversionOverride == VideoConversionOverride::VIDEOCONVERSION_V210_TO_P010)
-	{
-		mediaSubType = MEDIASUBTYPE_P010;
-		bitCount = 10;
-		m_videoFramFormatter = new CV210toP010VideoFrameFormatter();
-	}
+	// Formatter choice is shared with the null renderer, so headless runs benchmark the same
+	const VideoFrameConversion videoFrameConversion =
+		VideoFrameConversionPick(m_videoState->videoFrameEncoding, m_videoConversionOverride);
 
-	// Default conversions
-	else
+	switch (videoFrameConversion)
 	{
-		switch (m_videoState->videoFrameEncoding)
-		{
-			// v210 to p210
-		case VideoFrameEncoding::V210:
-
-			mediaSubType = MEDIASUBTYPE_P210;
-			bitCount = 10;
-			m_videoFramFormatter = new CV210toP210VideoFrameFormatter();
-			break;
+		// v210 (YUV422) to p010 (YUV420)
+	case VideoFrameConversion::V210_TO_P010:
+	case VideoFrameConversion::V210_TO_P010_TOP_LEFT:
 
-			// r210 to RGB48
-		case VideoFrameEncoding::R210:
+		videoChromaSubsampling =
+			(videoFrameConversion == VideoFrameConversion::V210_TO_P010_TOP_LEFT) ?
+			DXVA_VideoChromaSubsampling_Cosited :
+			DXVA_VideoChromaSubsampling_MPEG2;
 
-			mediaSubType = MEDIASUBTYPE_RGB0;
-			bitCount = 48;
-			heightMultiplier = -1;
-
-			m_videoFramFormatter = new CFFMpegDecoderVideoFrameFormatter(
-				AV_CODEC_ID_R210,
-				AV_PIX_FMT_RGB48LE);
-			break;
+		mediaSubType = MEDIASUBTYPE_P010;
+		bitCount = 10;
+		break;
 
-			// RGB 12-bit to RGB48
-		case VideoFrameEncoding::R12B:
+		// v210 to p210
+	case VideoFrameConversion::V210_TO_P210:
 
-			mediaSubType = MEDIASUBTYPE_RGB0;
-			bitCount = 48;
-			heightMultiplier = -1;
+		mediaSubType = MEDIASUBTYPE_P210;
+		bitCount = 10;
+		break;
 
-			m_videoFramFormatter = new CFFMpegDecoderVideoFrameFormatter(
-				AV_CODEC_ID_R12B,
-				AV_PIX_FMT_RGB48LE);
-			break;
+		// 10- and 12-bit RGB to RGB48
+	case VideoFrameConversion::RGB_TO_RGB48:
 
-			// No conversion needed
-		default:
-			mediaSubType = TranslateToMediaSubType(m_videoState->videoFrameEncoding);
-			bitCount = VideoFrameEncodingBitsPerPixel(m_videoState->videoFrameEncoding);
+		mediaSubType = MEDIASUBTYPE_RGB0;
+		bitCount = 48;
+		heightMultiplier = -1;
+		break;
 
-			m_videoFramFormatter = new CNoopVideoFrameFormatter();
-		}
+		// No conversion needed
+	default:
+		mediaSubType = TranslateToMediaSubType(m_videoState->videoFrameEncoding);
+		bitCount = VideoFrameEncodingBitsPerPixel(m_videoState->videoFrameEncoding);
 	}
 
+	m_videoFramFormatter = VideoFrameConversionFormatter(videoFrameConversion);
 	m_videoFramFormatter->OnVideoState(m_videoState);
 
 	// Build pmt
@@ -265,6 +250,8 @@ void DirectShowMPCVideoRenderer::MediaTypeGenerate()
 		m_forceNominalRange :
 		DXVA_NominalRange::DXVA_NominalRange_Unknown;  // = Let renderer guess
 
+	colorimetry->VideoChromaSubsampling = videoChromaSubsampling;
+
 	pvi2->dwControlFlags += AMCONTROL_USED;
 	pvi2->dwControlFlags += AMCONTROL_COLORINFO_PRESENT;
 
@@ -31,6 +31,7 @@ public:
 		bool useFrameQueue,
 		size_t frameQueueMaxSize,
 		VideoConversionOverride videoConversionOverride,
+		const PipelineOptions& pipelineOptions,
 		DXVA_NominalRange forceNominalRange,
 		DXVA_VideoTransferFunction forceVideoTransferFunction,
 		DXVA_VideoTransferMatrix forceVideoTransferMatrix,
@@ -13,6 +13,7 @@
 #include <guid.h>
 #include <microsoft_directshow/live_source_filter/CLiveSource.h>
 #include <microsoft_directshow/DIrectShowTranslations.h>
+#include <video_frame_formatter/CSlicedVideoFrameFormatter.h>
 
 #include "DirectShowVideoRenderer.h"
 
@@ -26,7 +27,8 @@ DirectShowVideoRenderer::DirectShowVideoRenderer(
 	DirectShowStartStopTimeMethod timestamp,
 	bool useFrameQueue,
 	size_t frameQueueMaxSize,
-	VideoConversionOverride videoConversionOverride):
+	VideoConversionOverride videoConversionOverride,
+	const PipelineOptions& pipelineOptions):
 	m_callback(callback),
 	m_videoHwnd(videoHwnd),
 	m_eventHwnd(eventHwnd),
@@ -35,7 +37,8 @@ DirectShowVideoRenderer::DirectShowVideoRenderer(
 	m_timestamp(timestamp),
 	m_useFrameQueue(useFrameQueue),
 	m_frameQueueMaxSize(frameQueueMaxSize),
-	m_videoConversionOverride(videoConversionOverride)
+	m_videoConversionOverride(videoConversionOverride),
+	m_pipelineOptions(pipelineOptions)
 {
 	if (!videoHwnd)
 		throw std::runtime_error("Invalid videoHwnd");
@@ -50,6 +53,9 @@ DirectShowVideoRenderer::DirectShowVideoRenderer(
 	if (!useFrameQueue && timestamp == DirectShowStartStopTimeMethod::DS_SSTM_CLOCK_CLOCK)
 		throw std::runtime_error("No queue cannot be used with clock-clock, pick another mode and restart");
 
+	if (!useFrameQueue && pipelineOptions.formatAtIngest)
+		throw std::runtime_error("No queue cannot be used with formatting at ingest");
+
 	ZeroMemory(&m_pmt, sizeof(AM_MEDIA_TYPE));
 }
 
@@ -230,6 +236,15 @@ double DirectShowVideoRenderer::ExitLatencyMs() const
 }
 
 
+uint64_t DirectShowVideoRenderer::ExitLatencySampleCount() const
+{
+	if (m_state != RendererState::RENDERSTATE_RENDERING)
+		throw std::runtime_error("Invalid state, can only be called while rendering");
+
+	return m_liveSource->ExitLatencySampleCount();
+}
+
+
 uint64_t DirectShowVideoRenderer::DroppedFrameCount() const
 {
 	if (m_state != RendererState::RENDERSTATE_RENDERING)
@@ -316,6 +331,15 @@ void DirectShowVideoRenderer::GraphBuild()
 
 	MediaTypeGenerate();
 
+	// Optionally spread the formatting of every frame over multiple threads, the wrapped
+	// formatter passes through if it cannot be sliced.
+	if (m_pipelineOptions.formatterSliceCount > 1)
+	{
+		assert(m_videoFramFormatter);
+		m_videoFramFormatter = new CSlicedVideoFrameFormatter(m_videoFramFormatter, m_pipelineOptions.formatterSliceCount);
+		m_videoFramFormatter->OnVideoState(m_videoState);
+	}
+
 	//
 	// Live source filter
 	//
@@ -595,7 +619,9 @@ void DirectShowVideoRenderer::LiveSourceBuildAndConnect()
 		m_timingClock,
 		m_timestamp,
 		m_useFrameQueue,
-		m_frameQueueMaxSize);
+		m_frameQueueMaxSize,
+		m_pipelineOptions.formatAtIngest,
+		m_pipelineOptions.sampleBufferCount);
 
 	if (m_pGraph->AddFilter(m_liveSource, L"LiveSource") != S_OK)
 	{
@@ -30,6 +30,20 @@ class DirectShowVideoRenderer:
 {
 public:
 
+	// Tuning of the frame pipeline between the capture callback and the renderer,
+	// the defaults keep frames formatted on the delivery thread in one go
+	struct PipelineOptions
+	{
+		// Amount of horizontal slices every frame is formatted in on as many threads
+		unsigned int formatterSliceCount = 1;
+
+		// Format frames on their own thread before queueing, needs the frame queue
+		bool formatAtIngest = false;
+
+		// Minimum amount of samples to ask from the renderer's allocator
+		unsigned int sampleBufferCount = 1;
+	};
+
 	DirectShowVideoRenderer(
 		IRendererCallback& callback,
 		HWND videoHwnd,
@@ -39,7 +53,8 @@ public:
 		DirectShowStartStopTimeMethod timestamp,
 		bool useFrameQueue,
 		size_t frameQueueMaxSize,
-		VideoConversionOverride videoConversionOverride);
+		VideoConversionOverride videoConversionOverride,
+		const PipelineOptions& pipelineOptions);
 	virtual ~DirectShowVideoRenderer();
 
 	// IVideoRenderer
@@ -55,6 +70,7 @@ public:
 	size_t GetFrameQueueSize() override;
 	double EntryLatencyMs() const override;
 	double ExitLatencyMs() const override;
+	uint64_t ExitLatencySampleCount() const override;
 	uint64_t DroppedFrameCount() const override;
 
 protected:
@@ -69,6 +85,7 @@ protected:
 	bool m_useFrameQueue;
 	size_t m_frameQueueMaxSize;
 	VideoConversionOverride m_videoConversionOverride;
+	const PipelineOptions m_pipelineOptions;
 	DXVA_NominalRange m_forceNominalRange = DXVA_NominalRange::DXVA_NominalRange_Unknown;
 	DXVA_VideoTransferFunction m_forceVideoTransferFunction = DXVA_VideoTransferFunction::DXVA_VideoTransFunc_Unknown;
 	DXVA_VideoTransferMatrix m_forceVideoTransferMatrix = DXVA_VideoTransferMatrix::DXVA_VideoTransferMatrix_Unknown;
@@ -0,0 +1,180 @@
+/*
+ * Copyright(C) 2021 Dennis Fleurbaaij <mail@dennisfleurbaaij.com>
+ *
+ * This program is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, version 3.
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License along with this program. If not, see < https://www.gnu.org/licenses/>.
+ */
+
+
+
+#include <pch.h>
+
+#include <algorithm>
+
+#include "RawCaptureFile.h"
+
+
+RawCaptureFile::RawCaptureFile(const CString& path)
+{
+	try
+	{
+		Open(path);
+	}
+	catch (...)
+	{
+		Close();
+		throw;
+	}
+}
+
+
+RawCaptureFile::~RawCaptureFile()
+{
+	Close();
+}
+
+
+const RawCaptureIndexEntry& RawCaptureFile::IndexEntry(uint64_t frame) const
+{
+	assert(frame < m_header->frameCount);
+
+	return m_index[frame];
+}
+
+
+const BYTE* RawCaptureFile::FrameData(const RawCaptureIndexEntry& indexEntry) const
+{
+	return m_view + indexEntry.offset;
+}
+
+
+VideoStateComPtr RawCaptureFile::State(uint32_t stateId) const
+{
+	assert(stateId < m_states.size());
+
+	return new VideoState(*m_states[stateId]);
+}
+
+
+void RawCaptureFile::Prefetch(uint64_t firstFrame, uint64_t frameCount) const
+{
+	if (frameCount == 0 || firstFrame >= m_header->frameCount)
+		return;
+
+	const uint64_t lastFrame = std::min(firstFrame + frameCount, m_header->frameCount) - 1;
+
+	// Frames are stored in order, so this is one range
+	WIN32_MEMORY_RANGE_ENTRY range;
+	range.VirtualAddress = (PVOID)(m_view + m_index[firstFrame].offset);
+	range.NumberOfBytes = (SIZE_T)(m_index[lastFrame].offset + m_index[lastFrame].size - m_index[firstFrame].offset);
+
+	// Only a hint, failure just means page faults later on
+	PrefetchVirtualMemory(GetCurrentProcess(), 1, &range, 0);
+}
+
+
+void RawCaptureFile::Open(const CString& path)
+{
+	m_file = CreateFile(
+		path,
+		GENERIC_READ,
+		FILE_SHARE_READ,
+		nullptr,
+		OPEN_EXISTING,
+		FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN,
+		nullptr);
+	if (m_file == INVALID_HANDLE_VALUE)
+		throw std::runtime_error("Failed to open raw capture file");
+
+	LARGE_INTEGER fileSize;
+	if (!GetFileSizeEx(m_file, &fileSize))
+		throw std::runtime_error("Failed to get raw capture file size");
+
+	m_size = (uint64_t)fileSize.QuadPart;
+	if (m_size < RAW_CAPTURE_ALIGNMENT)
+		throw std::runtime_error("Raw capture file too small");
+
+	m_mapping = CreateFileMapping(m_file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (!m_mapping)
+		throw std::runtime_error("Failed to create raw capture file mapping");
+
+	m_view = (const BYTE*)MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0);
+	if (!m_view)
+		throw std::runtime_error("Failed to map raw capture file");
+
+	m_header = (const RawCaptureFileHeader*)m_view;
+
+	if (m_header->magic != RAW_CAPTURE_MAGIC)
+		throw std::runtime_error("Not a raw capture file");
+
+	if (m_header->version != RAW_CAPTURE_VERSION || m_header->alignment != RAW_CAPTURE_ALIGNMENT)
+		throw std::runtime_error("Unsupported raw capture file version");
+
+	if (m_header->dataEndOffset == 0)
+		throw std::runtime_error("Raw capture recording was not finished");
+
+	// Tables have to fit the file, in this order
+	const uint64_t stateTableSize = (uint64_t)m_header->stateCount * sizeof(RawCaptureStateRecord);
+
+	if (m_header->dataEndOffset < RAW_CAPTURE_ALIGNMENT ||
+		m_header->dataEndOffset > m_header->stateTableOffset ||
+		m_header->stateTableOffset > m_header->indexOffset ||
+		m_header->indexOffset > m_size ||
+		stateTableSize > m_header->indexOffset - m_header->stateTableOffset ||
+		m_header->frameCount > (m_size - m_header->indexOffset) / sizeof(RawCaptureIndexEntry))
+		throw std::runtime_error("Raw capture file tables out of bounds");
+
+	const RawCaptureStateRecord* stateRecords = (const RawCaptureStateRecord*)(m_view + m_header->stateTableOffset);
+	for (uint32_t i = 0; i < m_header->stateCount; ++i)
+		m_states.push_back(FromRawCaptureStateRecord(stateRecords[i]));
+
+	// Every frame has to be inside the frame data and be a frame of its state
+	m_index = (const RawCaptureIndexEntry*)(m_view + m_header->indexOffset);
+	uint64_t previousEnd = RAW_CAPTURE_ALIGNMENT;
+
+	for (uint64_t i = 0; i < m_header->frameCount; ++i)
+	{
+		const RawCaptureIndexEntry& indexEntry = m_index[i];
+
+		if (indexEntry.offset < previousEnd ||
+			indexEntry.offset > m_header->dataEndOffset ||
+			indexEntry.size > m_header->dataEndOffset - indexEntry.offset)
+			throw std::runtime_error("Raw capture frame out of bounds");
+
+		// The stored frame size is not trusted on its own, the replayed state has to agree
+		if (indexEntry.stateId >= m_header->stateCount ||
+			indexEntry.size != stateRecords[indexEntry.stateId].bytesPerFrame ||
+			!m_states[indexEntry.stateId]->displayMode ||
+			indexEntry.size != m_states[indexEntry.stateId]->BytesPerFrame())
+			throw std::runtime_error("Raw capture frame does not match its state");
+
+		previousEnd = indexEntry.offset + indexEntry.size;
+	}
+}
+
+
+void RawCaptureFile::Close()
+{
+	m_states.clear();
+	m_header = nullptr;
+	m_index = nullptr;
+
+	if (m_view)
+	{
+		UnmapViewOfFile(m_view);
+		m_view = nullptr;
+	}
+
+	if (m_mapping)
+	{
+		CloseHandle(m_mapping);
+		m_mapping = nullptr;
+	}
+
+	if (m_file != INVALID_HANDLE_VALUE)
+	{
+		CloseHandle(m_file);
+		m_file = INVALID_HANDLE_VALUE;
+	}
+}
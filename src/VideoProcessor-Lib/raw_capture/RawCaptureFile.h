@@ -0,0 +1,64 @@
+/*
+ * Copyright(C) 2021 Dennis Fleurbaaij <mail@dennisfleurbaaij.com>
+ *
+ * This program is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, version 3.
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License along with this program. If not, see < https://www.gnu.org/licenses/>.
+ */
+
+
+#pragma once
+
+
+#include <vector>
+
+#include <VideoState.h>
+
+#include "RawCaptureFormat.h"
+
+
+/**
+ * Read-only view of a finished raw capture, see RawCaptureFormat.h.
+ *
+ * The whole file is memory mapped, frame data is used in place. The header, state table and
+ * index are validated when opening so that none of the accessors can point outside the file.
+ */
+class RawCaptureFile
+{
+public:
+
+	// Throws if the file can't be opened or is not a finished raw capture
+	RawCaptureFile(const CString& path);
+	~RawCaptureFile();
+
+	const RawCaptureFileHeader& Header() const { return *m_header; }
+
+	uint64_t FrameCount() const { return m_header->frameCount; }
+	const RawCaptureIndexEntry& IndexEntry(uint64_t frame) const;
+
+	// Frame data inside the mapping, valid as long as this object is
+	const BYTE* FrameData(const RawCaptureIndexEntry&) const;
+
+	// A new copy of a recorded state every call, receivers may hold on to it
+	uint32_t StateCount() const { return (uint32_t)m_states.size(); }
+	VideoStateComPtr State(uint32_t stateId) const;
+
+	// Hint the OS to read in the data of the given frames ahead of their use
+	void Prefetch(uint64_t firstFrame, uint64_t frameCount) const;
+
+private:
+
+	HANDLE m_file = INVALID_HANDLE_VALUE;
+	HANDLE m_mapping = nullptr;
+	const BYTE* m_view = nullptr;
+	uint64_t m_size = 0;
+
+	const RawCaptureFileHeader* m_header = nullptr;
+	const RawCaptureIndexEntry* m_index = nullptr;
+	std::vector<VideoStateComPtr> m_states;
+
+	// Map the file and validate it, throws on failure
+	void Open(const CString& path);
+
+	void Close();
+};
@@ -0,0 +1,105 @@
+/*
+ * Copyright(C) 2021 Dennis Fleurbaaij <mail@dennisfleurbaaij.com>
+ *
+ * This program is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, version 3.
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License along with this program. If not, see < https://www.gnu.org/licenses/>.
+ */
+
+
+
+#include <pch.h>
+
+#include <cstring>
+
+#include "RawCaptureFormat.h"
+
+
+RawCaptureStateRecord ToRawCaptureStateRecord(const VideoState& videoState, uint32_t stateId)
+{
+	RawCaptureStateRecord record;
+	memset(&record, 0, sizeof(record));
+
+	record.stateId = stateId;
+	record.valid = videoState.valid ? 1 : 0;
+
+	if (videoState.displayMode)
+	{
+		record.frameWidth = videoState.displayMode->FrameWidth();
+		record.frameHeight = videoState.displayMode->FrameHeight();
+		record.interlaced = videoState.displayMode->IsInterlaced() ? 1 : 0;
+		record.timeScale = videoState.displayMode->TimeScale();
+		record.frameDuration = videoState.displayMode->FrameDuration();
+	}
+
+	record.videoFrameEncoding = (uint32_t)videoState.videoFrameEncoding;
+	record.eotf = (uint32_t)videoState.eotf;
+	record.colorspace = (uint32_t)videoState.colorspace;
+	record.invertedVertical = videoState.invertedVertical ? 1 : 0;
+
+	if (videoState.valid && videoState.displayMode)
+		record.bytesPerFrame = videoState.BytesPerFrame();
+
+	if (videoState.hdrData)
+	{
+		const HDRData& hdrData = *videoState.hdrData;
+
+		record.hasHdrData = 1;
+		record.displayPrimaryRedX = hdrData.displayPrimaryRedX;
+		record.displayPrimaryRedY = hdrData.displayPrimaryRedY;
+		record.displayPrimaryGreenX = hdrData.displayPrimaryGreenX;
+		record.displayPrimaryGreenY = hdrData.displayPrimaryGreenY;
+		record.displayPrimaryBlueX = hdrData.displayPrimaryBlueX;
+		record.displayPrimaryBlueY = hdrData.displayPrimaryBlueY;
+		record.whitePointX = hdrData.whitePointX;
+		record.whitePointY = hdrData.whitePointY;
+		record.masteringDisplayMaxLuminance = hdrData.masteringDisplayMaxLuminance;
+		record.masteringDisplayMinLuminance = hdrData.masteringDisplayMinLuminance;
+		record.maxCll = hdrData.maxCll;
+		record.maxFall = hdrData.maxFall;
+	}
+
+	return record;
+}
+
+
+VideoStateComPtr FromRawCaptureStateRecord(const RawCaptureStateRecord& record)
+{
+	VideoStateComPtr videoState = new VideoState();
+
+	videoState->valid = (record.valid != 0);
+
+	if (record.frameWidth > 0 && record.frameHeight > 0)
+	{
+		videoState->displayMode = std::make_shared<DisplayMode>(
+			record.frameWidth, record.frameHeight, record.interlaced != 0,
+			record.timeScale, record.frameDuration);
+	}
+
+	videoState->videoFrameEncoding = (VideoFrameEncoding)record.videoFrameEncoding;
+	videoState->eotf = (EOTF)record.eotf;
+	videoState->colorspace = (ColorSpace)record.colorspace;
+	videoState->invertedVertical = (record.invertedVertical != 0);
+
+	if (record.hasHdrData)
+	{
+		HDRDataSharedPtr hdrData = std::make_shared<HDRData>();
+
+		hdrData->displayPrimaryRedX = record.displayPrimaryRedX;
+		hdrData->displayPrimaryRedY = record.displayPrimaryRedY;
+		hdrData->displayPrimaryGreenX = record.displayPrimaryGreenX;
+		hdrData->displayPrimaryGreenY = record.displayPrimaryGreenY;
+		hdrData->displayPrimaryBlueX = record.displayPrimaryBlueX;
+		hdrData->displayPrimaryBlueY = record.displayPrimaryBlueY;
+		hdrData->whitePointX = record.whitePointX;
+		hdrData->whitePointY = record.whitePointY;
+		hdrData->masteringDisplayMaxLuminance = record.masteringDisplayMaxLuminance;
+		hdrData->masteringDisplayMinLuminance = record.masteringDisplayMinLuminance;
+		hdrData->maxCll = record.maxCll;
+		hdrData->maxFall = record.maxFall;
+
+		videoState->hdrData = hdrData;
+	}
+
+	return videoState;
+}
@@ -0,0 +1,135 @@
+/*
+ * Copyright(C) 2021 Dennis Fleurbaaij <mail@dennisfleurbaaij.com>
+ *
+ * This program is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, version 3.
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License along with this program. If not, see < https://www.gnu.org/licenses/>.
+ */
+
+
+#pragma once
+
+
+#include <stdint.h>
+
+#include <VideoState.h>
+
+
+/**
+ * Raw capture container, the frames exactly as they came off the card plus their timestamps and
+ * the video states they were captured in.
+ *
+ * Layout, every part starts on a RAW_CAPTURE_ALIGNMENT boundary so it can be written unbuffered
+ * and memory mapped:
+ *  - RawCaptureFileHeader, padded to the alignment
+ *  - Frame data, each frame padded to the alignment
+ *  - State table, RawCaptureStateRecord[stateCount]
+ *  - Frame index, RawCaptureIndexEntry[frameCount]
+ *
+ * The state table and index are written when recording stops, until then the header has a
+ * dataEndOffset of 0. All values are little-endian.
+ */
+
+// "VPRC"
+static const uint32_t RAW_CAPTURE_MAGIC = 0x43525056;
+static const uint32_t RAW_CAPTURE_VERSION = 1;
+
+// Sector and page size multiple
+static const uint32_t RAW_CAPTURE_ALIGNMENT = 4096;
+
+// State id of frames for which no state is known
+static const uint32_t RAW_CAPTURE_STATE_ID_NONE = 0xFFFFFFFF;
+
+
+struct RawCaptureFileHeader
+{
+	uint32_t magic;
+	uint32_t version;
+	uint32_t alignment;
+	uint32_t reserved0;
+
+	// Timing clock resolution of the frame timestamps
+	int64_t timingClockTicksPerSecond;
+
+	// End of the frame data, 0 if the recording was not finished
+	uint64_t dataEndOffset;
+
+	uint64_t stateTableOffset;
+	uint32_t stateCount;
+	uint32_t reserved1;
+
+	uint64_t indexOffset;
+	uint64_t frameCount;
+
+	// Frames which were captured but not recorded
+	uint64_t droppedFrameCount;
+};
+
+
+// A VideoState, HDR values are only meaningful if hasHdrData is set
+struct RawCaptureStateRecord
+{
+	uint32_t stateId;
+	uint32_t valid;
+
+	uint32_t frameWidth;
+	uint32_t frameHeight;
+	uint32_t interlaced;
+	uint32_t timeScale;
+	uint32_t frameDuration;
+
+	uint32_t videoFrameEncoding;
+	uint32_t eotf;
+	uint32_t colorspace;
+	uint32_t invertedVertical;
+	uint32_t bytesPerFrame;
+
+	uint32_t hasHdrData;
+	uint32_t reserved0;
+
+	double displayPrimaryRedX;
+	double displayPrimaryRedY;
+	double displayPrimaryGreenX;
+	double displayPrimaryGreenY;
+	double displayPrimaryBlueX;
+	double displayPrimaryBlueY;
+	double whitePointX;
+	double whitePointY;
+	double masteringDisplayMaxLuminance;
+	double masteringDisplayMinLuminance;
+	double maxCll;
+	double maxFall;
+};
+
+
+struct RawCaptureIndexEntry
+{
+	uint64_t counter;
+	int64_t timingTimestamp;
+
+	// Start of the frame's data in the file
+	uint64_t offset;
+
+	uint32_t stateId;
+
+	// Frame data size, without the padding
+	uint32_t size;
+};
+
+
+static_assert(sizeof(RawCaptureFileHeader) <= RAW_CAPTURE_ALIGNMENT, "Header must fit its block");
+static_assert(sizeof(RawCaptureFileHeader) == 72, "Header layout changed");
+static_assert(sizeof(RawCaptureStateRecord) == 152, "State record layout changed");
+static_assert(sizeof(RawCaptureIndexEntry) == 32, "Index entry layout changed");
+
+
+// Round up to the container alignment
+inline uint64_t RawCaptureAlign(uint64_t size)
+{
+	return (size + RAW_CAPTURE_ALIGNMENT - 1) & ~(uint64_t)(RAW_CAPTURE_ALIGNMENT - 1);
+}
+
+
+// Convert between video states and their records, invalid states have no display mode
+RawCaptureStateRecord ToRawCaptureStateRecord(const VideoState&, uint32_t stateId);
+VideoStateComPtr FromRawCaptureStateRecord(const RawCaptureStateRecord&);
@@ -0,0 +1,531 @@
+/*
+ * Copyright(C) 2021 Dennis Fleurbaaij <mail@dennisfleurbaaij.com>
+ *
+ * This program is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, version 3.
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License along with this program. If not, see < https://www.gnu.org/licenses/>.
+ */
+
+
+
+#include <pch.h>
+
+#include <algorithm>
+#include <cstring>
+
+#include <PipelineLatency.h>
+
+#include "RawCaptureRecorder.h"
+
+
+// Room at the end of the file kept free for the state table
+static const uint64_t STATE_TABLE_RESERVE = RawCaptureAlign((uint64_t)RawCaptureRecorder::MAX_STATE_COUNT * sizeof(RawCaptureStateRecord));
+
+// How often the I/O thread checks for completed writes while there is nothing queued
+static const DWORD WRITE_POLL_INTERVAL_MS = 5;
+
+// Index entries reserved up front per GiB of file, enough for frames of 1 MiB
+static const uint64_t INDEX_RESERVE_PER_GIB = 1024;
+
+
+// SetFileValidData() needs this privilege enabled in the process token, which is only
+// possible when the user holds "Perform volume maintenance tasks".
+static bool EnableManageVolumePrivilege()
+{
+	HANDLE token;
+	if (!OpenProcessToken(GetCurrentProcess(), TOKEN_ADJUST_PRIVILEGES | TOKEN_QUERY, &token))
+		return false;
+
+	TOKEN_PRIVILEGES privileges;
+	privileges.PrivilegeCount = 1;
+	privileges.Privileges[0].Attributes = SE_PRIVILEGE_ENABLED;
+
+	// AdjustTokenPrivileges() succeeds with ERROR_NOT_ALL_ASSIGNED if the user does not hold it
+	const bool success =
+		LookupPrivilegeValue(nullptr, SE_MANAGE_VOLUME_NAME, &privileges.Privileges[0].Luid) &&
+		AdjustTokenPrivileges(token, FALSE, &privileges, 0, nullptr, nullptr) &&
+		GetLastError() == ERROR_SUCCESS;
+
+	CloseHandle(token);
+
+	return success;
+}
+
+
+RawCaptureRecorder::RawCaptureRecorder(
+	const CString& path,
+	uint64_t maxFileSize,
+	timingclocktime_t timingClockTicksPerSecond,
+	uint32_t maxQueuedFrames,
+	uint32_t maxInFlightWrites,
+	bool skipZeroFill):
+	m_path(path),
+	m_fileSize(RawCaptureAlign(maxFileSize)),
+	m_timingClockTicksPerSecond(timingClockTicksPerSecond),
+	m_maxInFlightWrites(maxInFlightWrites),
+	m_skipZeroFill(skipZeroFill),
+	m_queueCapacity(maxQueuedFrames)
+{
+	if (maxQueuedFrames < 1)
+		throw std::runtime_error("Raw capture queue size out of range");
+
+	if (maxInFlightWrites < 1)
+		throw std::runtime_error("Raw capture in-flight write count out of range");
+
+	if (m_fileSize < RAW_CAPTURE_ALIGNMENT + STATE_TABLE_RESERVE + RAW_CAPTURE_ALIGNMENT * 2)
+		throw std::runtime_error("Raw capture file size too small");
+
+	m_queue.reset(new QueuedFrame[m_queueCapacity]);
+	m_writes.reset(new Write[m_maxInFlightWrites]);
+}
+
+
+RawCaptureRecorder::~RawCaptureRecorder()
+{
+	if (m_ioThread.joinable())
+		Stop();
+
+	// Frames pushed after the I/O thread left, released with the queue
+	m_queue.reset();
+}
+
+
+void RawCaptureRecorder::Start()
+{
+	if (m_started)
+		throw std::runtime_error("Start() called but already started");
+	m_started = true;
+
+	m_index.reserve((size_t)((m_fileSize >> 30) + 1) * INDEX_RESERVE_PER_GIB);
+
+	// Unbuffered so that recording doesn't push everything else out of the file cache
+	m_file = CreateFile(
+		m_path,
+		GENERIC_READ | GENERIC_WRITE,
+		FILE_SHARE_READ,
+		nullptr,
+		CREATE_ALWAYS,
+		FILE_ATTRIBUTE_NORMAL | FILE_FLAG_NO_BUFFERING | FILE_FLAG_OVERLAPPED,
+		nullptr);
+	if (m_file == INVALID_HANDLE_VALUE)
+		throw std::runtime_error("Failed to create raw capture file");
+
+	// Preallocate the whole file so writes never have to extend it.
+	LARGE_INTEGER fileSize;
+	fileSize.QuadPart = (LONGLONG)m_fileSize;
+	if (!SetFilePointerEx(m_file, fileSize, nullptr, FILE_BEGIN) || !SetEndOfFile(m_file))
+	{
+		CloseHandle(m_file);
+		m_file = INVALID_HANDLE_VALUE;
+		throw std::runtime_error("Failed to preallocate raw capture file");
+	}
+
+	// Writes past the valid data length make NTFS zero-fill up to them and complete
+	// synchronously, so by default the overlapped writes don't overlap and recording
+	// is limited to a single write at a time. Moving the valid data length skips the
+	// zero-filling but exposes the old disk contents in whatever doesn't get written,
+	// so it's only done on request. Needs the "Perform volume maintenance tasks" privilege.
+	if (m_skipZeroFill)
+	{
+		static const bool manageVolumePrivilegeEnabled = EnableManageVolumePrivilege();
+
+		if (!manageVolumePrivilegeEnabled)
+			DbgLog((LOG_TRACE, 1, TEXT("RawCaptureRecorder::Start(): Volume maintenance privilege not available, writes will not overlap")));
+		else if (!SetFileValidData(m_file, fileSize.QuadPart))
+			DbgLog((LOG_TRACE, 1, TEXT("RawCaptureRecorder::Start(): SetFileValidData() failed with error %lu, writes will not overlap"), GetLastError()));
+	}
+
+	// Unfinished header, so a recording which never got stopped is recognizable
+	BYTE* headerBlock = (BYTE*)VirtualAlloc(nullptr, RAW_CAPTURE_ALIGNMENT, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE);
+	if (!headerBlock)
+	{
+		CloseHandle(m_file);
+		m_file = INVALID_HANDLE_VALUE;
+		throw std::runtime_error("Failed to allocate raw capture file header");
+	}
+
+	RawCaptureFileHeader* header = (RawCaptureFileHeader*)headerBlock;
+	header->magic = RAW_CAPTURE_MAGIC;
+	header->version = RAW_CAPTURE_VERSION;
+	header->alignment = RAW_CAPTURE_ALIGNMENT;
+	header->timingClockTicksPerSecond = m_timingClockTicksPerSecond;
+
+	const bool headerWritten = WriteBlocking(0, headerBlock, RAW_CAPTURE_ALIGNMENT);
+	VirtualFree(headerBlock, 0, MEM_RELEASE);
+
+	if (!headerWritten)
+	{
+		CloseHandle(m_file);
+		m_file = INVALID_HANDLE_VALUE;
+		throw std::runtime_error("Failed to write raw capture file header");
+	}
+
+	m_writeOffset = RAW_CAPTURE_ALIGNMENT;
+
+	m_startTime = PipelineLatency::Now();
+	m_isActive = true;
+	m_ioThread = std::thread(&RawCaptureRecorder::IoThreadProc, this);
+}
+
+
+void RawCaptureRecorder::Stop()
+{
+	if (!m_ioThread.joinable())
+		throw std::runtime_error("Stop() called while not started");
+
+	// The I/O thread writes out what's queued before it exits
+	m_isActive = false;
+	m_queueEvent.Set();
+	m_ioThread.join();
+
+	// Anything which came in after the I/O thread's last look
+	QueuedFrame queuedFrame;
+	while (PopQueue(queuedFrame))
+	{
+		queuedFrame.videoFrame.Reset();
+		++m_droppedFrameCount;
+	}
+
+	WriteTrailer();
+
+	CloseHandle(m_file);
+	m_file = INVALID_HANDLE_VALUE;
+
+	DbgLog((LOG_TRACE, 1,
+		TEXT("RawCaptureRecorder recorded frames: %I64u, dropped: %I64u, bytes: %I64u, write errors: %I64u, %.1f MiB/s"),
+		m_recordedFrameCount.load(), m_droppedFrameCount.load(), m_bytesWritten.load(),
+		m_writeErrorCount, WriteBandwidthMiBps()));
+}
+
+
+void RawCaptureRecorder::OnVideoState(const VideoStateComPtr& videoState)
+{
+	std::lock_guard<std::mutex> lock(m_stateMutex);
+
+	if (m_states.size() >= MAX_STATE_COUNT)
+	{
+		m_currentStateId = RAW_CAPTURE_STATE_ID_NONE;
+		return;
+	}
+
+	const uint32_t stateId = (uint32_t)m_states.size();
+	m_states.push_back(ToRawCaptureStateRecord(*videoState, stateId));
+
+	// Invalid states are recorded, but the frames in them can't be
+	m_currentStateId = (m_states.back().bytesPerFrame > 0) ? stateId : RAW_CAPTURE_STATE_ID_NONE;
+}
+
+
+void RawCaptureRecorder::OnVideoFrame(VideoFrame& videoFrame)
+{
+	// ! WARNING: Runs in the capture thread, must never block
+
+	if (!m_isActive)
+		return;
+
+	const uint32_t stateId = m_currentStateId;
+	if (stateId == RAW_CAPTURE_STATE_ID_NONE)
+	{
+		++m_droppedFrameCount;
+		return;
+	}
+
+	// Only the capture thread pushes so the slot at the tail stays free once there is room
+	const uint64_t tail = m_queueTail.load(std::memory_order_relaxed);
+	if (tail - m_queueHead.load(std::memory_order_acquire) >= m_queueCapacity)
+	{
+		++m_droppedFrameCount;
+		return;
+	}
+
+	QueuedFrame& queuedFrame = m_queue[tail % m_queueCapacity];
+	queuedFrame.videoFrame = VideoFrameHandle(videoFrame);
+	queuedFrame.stateId = stateId;
+
+	m_queueTail.store(tail + 1, std::memory_order_release);
+	m_queueEvent.Set();
+}
+
+
+double RawCaptureRecorder::WriteBandwidthMiBps() const
+{
+	if (m_startTime == 0)
+		return 0.0;
+
+	const double seconds = (double)(PipelineLatency::Now() - m_startTime) / PipelineLatency::TicksPerSecond();
+	if (seconds <= 0.0)
+		return 0.0;
+
+	return m_bytesWritten / seconds / (1024.0 * 1024.0);
+}
+
+
+uint32_t RawCaptureRecorder::Backlog() const
+{
+	const uint64_t queued = m_queueTail.load(std::memory_order_acquire) - m_queueHead.load(std::memory_order_acquire);
+	return (uint32_t)queued + m_inFlightWriteCount;
+}
+
+
+void RawCaptureRecorder::IoThreadProc()
+{
+	// ! WARNING: Runs in the I/O thread
+
+	DbgLog((LOG_TRACE, 1, TEXT("RawCaptureRecorder I/O thread starting")));
+
+	while (true)
+	{
+		QueuedFrame queuedFrame;
+		if (PopQueue(queuedFrame))
+		{
+			WriteFrame(queuedFrame);
+			continue;
+		}
+
+		if (!m_isActive)
+			break;
+
+		// Keep releasing the buffers of completed writes while idle
+		CompleteWrites(false);
+		m_queueEvent.Wait(m_inFlightWriteCount > 0 ? WRITE_POLL_INTERVAL_MS : INFINITE);
+	}
+
+	CompleteWrites(true);
+
+	DbgLog((LOG_TRACE, 1, TEXT("RawCaptureRecorder I/O thread exiting")));
+}
+
+
+bool RawCaptureRecorder::PopQueue(QueuedFrame& queuedFrame)
+{
+	const uint64_t head = m_queueHead.load(std::memory_order_relaxed);
+	if (head == m_queueTail.load(std::memory_order_acquire))
+		return false;
+
+	queuedFrame = std::move(m_queue[head % m_queueCapacity]);
+	m_queueHead.store(head + 1, std::memory_order_release);
+
+	return true;
+}
+
+
+void RawCaptureRecorder::WriteFrame(QueuedFrame& queuedFrame)
+{
+	uint32_t size;
+	{
+		std::lock_guard<std::mutex> lock(m_stateMutex);
+		size = m_states[queuedFrame.stateId].bytesPerFrame;
+	}
+
+	const uint64_t paddedSize = RawCaptureAlign(size);
+
+	RawCaptureIndexEntry entry;
+	entry.counter = queuedFrame.videoFrame->GetCounter();
+	entry.timingTimestamp = queuedFrame.videoFrame->GetTimingTimestamp();
+	entry.offset = m_writeOffset;
+	entry.stateId = queuedFrame.stateId;
+	entry.size = size;
+
+	// Leave room for the state table and the index including this frame
+	const uint64_t trailerSize = STATE_TABLE_RESERVE + RawCaptureAlign((m_index.size() + 1) * sizeof(RawCaptureIndexEntry));
+	if (m_writeOffset + paddedSize + trailerSize > m_fileSize)
+	{
+		++m_droppedFrameCount;
+		return;
+	}
+
+	// Wait for the oldest write if all are in flight
+	Write& write = m_writes[m_nextWrite];
+	if (write.inFlight)
+		CompleteWrite(write);
+
+	// Aligned frames are written straight from the capture buffer, which then has to stay
+	// around until the write completes. Others are copied into a staging buffer padded with
+	// zeroes, which lets go of the capture buffer right away.
+	const void* data = queuedFrame.videoFrame->GetData();
+	const void* writeData;
+
+	if (((uintptr_t)data % RAW_CAPTURE_ALIGNMENT) == 0 && size == paddedSize)
+	{
+		write.videoFrame = std::move(queuedFrame.videoFrame);
+		writeData = data;
+	}
+	else
+	{
+		if (!m_stagingPool || m_stagingPool->GetBufferSize() < paddedSize)
+		{
+			CompleteWrites(true);
+			m_stagingPool.reset();
+			m_stagingPool.reset(new FrameBufferPool((size_t)paddedSize, m_maxInFlightWrites, FrameBufferPool::ALIGNMENT_PAGE));
+		}
+
+		// There is a buffer for every write slot
+		write.stagingBuffer = m_stagingPool->Acquire();
+		assert(write.stagingBuffer);
+
+		memcpy(write.stagingBuffer->Data(), data, size);
+		memset(write.stagingBuffer->Data() + size, 0, (size_t)(paddedSize - size));
+		writeData = write.stagingBuffer->Data();
+
+		queuedFrame.videoFrame.Reset();
+	}
+
+	memset(&write.overlapped, 0, sizeof(write.overlapped));
+	write.overlapped.Offset = (DWORD)m_writeOffset;
+	write.overlapped.OffsetHigh = (DWORD)(m_writeOffset >> 32);
+	write.overlapped.hEvent = write.event;
+
+	if (!WriteFile(m_file, writeData, (DWORD)paddedSize, nullptr, &write.overlapped) &&
+		GetLastError() != ERROR_IO_PENDING)
+	{
+		DbgLog((LOG_ERROR, 1, TEXT("RawCaptureRecorder failed to write frame %I64u, error %lu"),
+			entry.counter, GetLastError()));
+
+		++m_writeErrorCount;
+		++m_droppedFrameCount;
+
+		write.videoFrame.Reset();
+		if (write.stagingBuffer)
+		{
+			write.stagingBuffer->Release();
+			write.stagingBuffer = nullptr;
+		}
+
+		return;
+	}
+
+	write.indexPosition = m_index.size();
+	write.inFlight = true;
+	++m_inFlightWriteCount;
+	m_nextWrite = (m_nextWrite + 1) % m_maxInFlightWrites;
+
+	m_index.push_back(entry);
+
+	m_writeOffset += paddedSize;
+	++m_recordedFrameCount;
+}
+
+
+void RawCaptureRecorder::CompleteWrite(Write& write)
+{
+	assert(write.inFlight);
+
+	DWORD bytesWritten = 0;
+	if (GetOverlappedResult(m_file, &write.overlapped, &bytesWritten, TRUE))
+	{
+		m_bytesWritten += bytesWritten;
+	}
+	else
+	{
+		// The frame is in the index already, mark it so the trailer leaves it out
+		DbgLog((LOG_ERROR, 1, TEXT("RawCaptureRecorder write failed, error %lu"), GetLastError()));
+		++m_writeErrorCount;
+
+		m_index[write.indexPosition].stateId = RAW_CAPTURE_STATE_ID_NONE;
+		--m_recordedFrameCount;
+		++m_droppedFrameCount;
+	}
+
+	write.videoFrame.Reset();
+	if (write.stagingBuffer)
+	{
+		write.stagingBuffer->Release();
+		write.stagingBuffer = nullptr;
+	}
+
+	write.inFlight = false;
+	--m_inFlightWriteCount;
+}
+
+
+void RawCaptureRecorder::CompleteWrites(bool wait)
+{
+	for (uint32_t i = 0; i < m_maxInFlightWrites; i++)
+	{
+		Write& write = m_writes[i];
+		if (write.inFlight && (wait || HasOverlappedIoCompleted(&write.overlapped)))
+			CompleteWrite(write);
+	}
+}
+
+
+bool RawCaptureRecorder::WriteBlocking(uint64_t offset, const void* data, size_t size)
+{
+	assert(offset % RAW_CAPTURE_ALIGNMENT == 0);
+	assert(size % RAW_CAPTURE_ALIGNMENT == 0);
+
+	CAMEvent event(TRUE);
+	OVERLAPPED overlapped;
+	memset(&overlapped, 0, sizeof(overlapped));
+	overlapped.Offset = (DWORD)offset;
+	overlapped.OffsetHigh = (DWORD)(offset >> 32);
+	overlapped.hEvent = event;
+
+	if (!WriteFile(m_file, data, (DWORD)size, nullptr, &overlapped) &&
+		GetLastError() != ERROR_IO_PENDING)
+		return false;
+
+	DWORD bytesWritten = 0;
+	return GetOverlappedResult(m_file, &overlapped, &bytesWritten, TRUE) && bytesWritten == size;
+}
+
+
+void RawCaptureRecorder::WriteTrailer()
+{
+	std::lock_guard<std::mutex> lock(m_stateMutex);
+
+	// Frames whose write failed don't have their data on disk
+	m_index.erase(
+		std::remove_if(m_index.begin(), m_index.end(),
+			[](const RawCaptureIndexEntry& entry) { return entry.stateId == RAW_CAPTURE_STATE_ID_NONE; }),
+		m_index.end());
+
+	// State table and index directly follow the frame data
+	const uint64_t stateTableSize = RawCaptureAlign(m_states.size() * sizeof(RawCaptureStateRecord));
+	const uint64_t indexSize = RawCaptureAlign(m_index.size() * sizeof(RawCaptureIndexEntry));
+	const uint64_t stateTableOffset = m_writeOffset;
+	const uint64_t indexOffset = stateTableOffset + stateTableSize;
+	const size_t trailerSize = (size_t)(stateTableSize + indexSize);
+
+	BYTE* trailer = (BYTE*)VirtualAlloc(nullptr, trailerSize + RAW_CAPTURE_ALIGNMENT, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE);
+	if (!trailer)
+	{
+		DbgLog((LOG_ERROR, 1, TEXT("RawCaptureRecorder failed to allocate the trailer")));
+		++m_writeErrorCount;
+		return;
+	}
+
+	if (!m_states.empty())
+		memcpy(trailer, m_states.data(), m_states.size() * sizeof(RawCaptureStateRecord));
+	if (!m_index.empty())
+		memcpy(trailer + stateTableSize, m_index.data(), m_index.size() * sizeof(RawCaptureIndexEntry));
+
+	// The header goes last so it only claims a finished file once everything else is on disk
+	BYTE* headerBlock = trailer + trailerSize;
+	RawCaptureFileHeader* header = (RawCaptureFileHeader*)headerBlock;
+	header->magic = RAW_CAPTURE_MAGIC;
+	header->version = RAW_CAPTURE_VERSION;
+	header->alignment = RAW_CAPTURE_ALIGNMENT;
+	header->timingClockTicksPerSecond = m_timingClockTicksPerSecond;
+	header->dataEndOffset = m_writeOffset;
+	header->stateTableOffset = stateTableOffset;
+	header->stateCount = (uint32_t)m_states.size();
+	header->indexOffset = indexOffset;
+	header->frameCount = m_index.size();
+	header->droppedFrameCount = m_droppedFrameCount;
+
+	if ((trailerSize > 0 && !WriteBlocking(stateTableOffset, trailer, trailerSize)) ||
+		!WriteBlocking(0, headerBlock, RAW_CAPTURE_ALIGNMENT))
+	{
+		DbgLog((LOG_ERROR, 1, TEXT("RawCaptureRecorder failed to write the trailer, error %lu"), GetLastError()));
+		++m_writeErrorCount;
+	}
+
+	VirtualFree(trailer, 0, MEM_RELEASE);
+
+	// Give back the preallocated space which wasn't used
+	LARGE_INTEGER fileEnd;
+	fileEnd.QuadPart = (LONGLONG)(indexOffset + indexSize);
+	if (!SetFilePointerEx(m_file, fileEnd, nullptr, FILE_BEGIN) || !SetEndOfFile(m_file))
+		DbgLog((LOG_ERROR, 1, TEXT("RawCaptureRecorder failed to trim the file, error %lu"), GetLastError()));
+}
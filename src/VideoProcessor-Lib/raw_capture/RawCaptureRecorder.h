@@ -0,0 +1,182 @@
+/*
+ * Copyright(C) 2021 Dennis Fleurbaaij <mail@dennisfleurbaaij.com>
+ *
+ * This program is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, version 3.
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License along with this program. If not, see < https://www.gnu.org/licenses/>.
+ */
+
+
+#pragma once
+
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <FrameBufferPool.h>
+#include <IVideoFrameSink.h>
+#include <TimingClock.h>
+#include <VideoFrameHandle.h>
+#include <VideoState.h>
+
+#include "RawCaptureFormat.h"
+
+
+/**
+ * Records the frames exactly as they come off the card into a raw capture container, see
+ * RawCaptureFormat.h, to be able to replay field issues.
+ *
+ * The capture thread only takes a reference on the frame and queues it on a bounded
+ * single-producer single-consumer queue. A dedicated I/O thread writes the frames into the
+ * preallocated file with unbuffered overlapped writes, keeping up to maxInFlightWrites of them
+ * in flight. Frames which are page aligned and sized are written straight from the capture
+ * buffer, which is held on to until the write completes, others are copied into an aligned
+ * staging buffer first.
+ *
+ * Nothing ever waits for the disk on the capture thread, when the queue is full or the file is,
+ * frames are dropped and counted. Frames whose write fails are left out of the index.
+ *
+ * A recorder records a single file, Start() and Stop() can be called once.
+ */
+class RawCaptureRecorder:
+	public IVideoFrameSink
+{
+public:
+
+	static const uint32_t DEFAULT_MAX_QUEUED_FRAMES = 8;
+	static const uint32_t DEFAULT_MAX_IN_FLIGHT_WRITES = 4;
+
+	// Video states beyond this are not recorded, nor are the frames in them
+	static const uint32_t MAX_STATE_COUNT = 1024;
+
+	// With skipZeroFill the preallocated file is not zeroed, which lets the writes overlap but
+	// leaves whatever was on disk before in the parts of the file which don't get written.
+	RawCaptureRecorder(
+		const CString& path,
+		uint64_t maxFileSize,
+		timingclocktime_t timingClockTicksPerSecond,
+		uint32_t maxQueuedFrames = DEFAULT_MAX_QUEUED_FRAMES,
+		uint32_t maxInFlightWrites = DEFAULT_MAX_IN_FLIGHT_WRITES,
+		bool skipZeroFill = false);
+	virtual ~RawCaptureRecorder();
+
+	// Create and preallocate the file and start the I/O thread, throws std::runtime_error on failure
+	void Start();
+
+	// Write out the queued frames followed by the state table, index and header and close the file
+	void Stop();
+
+	// Capture thread.
+	// Frames are recorded with the latest state, frames in an invalid state or before the first
+	// state are dropped as their size is unknown.
+	void OnVideoState(const VideoStateComPtr&);
+
+	// IVideoFrameSink
+	// Capture thread, never blocks. Frames are ignored while not started.
+	void OnVideoFrame(VideoFrame&) override;
+
+	//
+	// Stats, any thread
+	//
+
+	uint64_t RecordedFrameCount() const { return m_recordedFrameCount; }
+
+	// Frames lost to a full queue, a full file, an unknown state or a failed write
+	uint64_t DroppedFrameCount() const { return m_droppedFrameCount; }
+
+	uint64_t BytesWritten() const { return m_bytesWritten; }
+
+	// Average write bandwidth since Start() in MiB/s
+	double WriteBandwidthMiBps() const;
+
+	// Frames queued or being written
+	uint32_t Backlog() const;
+
+private:
+
+	struct QueuedFrame
+	{
+		VideoFrameHandle videoFrame;
+		uint32_t stateId = RAW_CAPTURE_STATE_ID_NONE;
+	};
+
+	struct Write
+	{
+		OVERLAPPED overlapped;
+
+		// Manual reset, signalled by the write completing
+		CAMEvent event { TRUE };
+
+		// Either the frame written from directly or the staging buffer it was copied into
+		VideoFrameHandle videoFrame;
+		FrameBuffer* stagingBuffer = nullptr;
+
+		// Position of the frame in m_index
+		size_t indexPosition = 0;
+
+		bool inFlight = false;
+	};
+
+	const CString m_path;
+	const uint64_t m_fileSize;
+	const timingclocktime_t m_timingClockTicksPerSecond;
+	const uint32_t m_maxInFlightWrites;
+	const bool m_skipZeroFill;
+
+	HANDLE m_file = INVALID_HANDLE_VALUE;
+	std::thread m_ioThread;
+	std::atomic_bool m_isActive = false;
+	bool m_started = false;
+
+	// States seen so far, the id is the index
+	std::mutex m_stateMutex;
+	std::vector<RawCaptureStateRecord> m_states;
+	std::atomic<uint32_t> m_currentStateId = RAW_CAPTURE_STATE_ID_NONE;
+
+	// Capture to I/O thread queue, free-running head and tail
+	const uint32_t m_queueCapacity;
+	std::unique_ptr<QueuedFrame[]> m_queue;
+	std::atomic<uint64_t> m_queueHead = 0;
+	std::atomic<uint64_t> m_queueTail = 0;
+
+	// Auto-reset, set after every push and by Stop()
+	CAMEvent m_queueEvent;
+
+	// I/O thread only from here on
+	std::unique_ptr<Write[]> m_writes;
+	uint32_t m_nextWrite = 0;
+	std::atomic<uint32_t> m_inFlightWriteCount = 0;
+	std::unique_ptr<FrameBufferPool> m_stagingPool;
+	uint64_t m_writeOffset = 0;
+	std::vector<RawCaptureIndexEntry> m_index;
+
+	int64_t m_startTime = 0;
+	std::atomic<uint64_t> m_recordedFrameCount = 0;
+	std::atomic<uint64_t> m_droppedFrameCount = 0;
+	std::atomic<uint64_t> m_bytesWritten = 0;
+	uint64_t m_writeErrorCount = 0;
+
+	// I/O thread function
+	void IoThreadProc();
+
+	// Pop the oldest queued frame, false if there is none
+	bool PopQueue(QueuedFrame&);
+
+	// Start the write of a frame, waits for a free write slot if all are in flight
+	void WriteFrame(QueuedFrame&);
+
+	// Wait for a write to complete and release its buffer
+	void CompleteWrite(Write&);
+
+	// Complete the writes which are done already, or all of them if wait is set
+	void CompleteWrites(bool wait);
+
+	// Synchronously write page aligned data at an aligned offset
+	bool WriteBlocking(uint64_t offset, const void* data, size_t size);
+
+	// Write the state table, index and final header, leaves out the frames whose write failed
+	void WriteTrailer();
+};
@@ -0,0 +1,435 @@
+/*
+ * Copyright(C) 2021 Dennis Fleurbaaij <mail@dennisfleurbaaij.com>
+ *
+ * This program is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, version 3.
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License along with this program. If not, see < https://www.gnu.org/licenses/>.
+ */
+
+
+
+#include <pch.h>
+
+#include <FrameTrace.h>
+#include <PipelineLatency.h>
+#include <VideoFrameHandle.h>
+
+#include "RawCaptureReplayDevice.h"
+
+
+/**
+ * Source buffer of a replayed frame, the data itself is in the file mapping. It's in use by
+ * downstream as long as it has references.
+ */
+class RawCaptureReplayFrameBuffer:
+	public IUnknown
+{
+public:
+
+	bool InUse() const { return m_refCount > 0; }
+
+	// IUnknown
+	HRESULT	QueryInterface(REFIID, LPVOID*) override { return E_NOINTERFACE; }
+	ULONG AddRef() override { return ++m_refCount; }
+	ULONG Release() override { return --m_refCount; }
+
+private:
+
+	std::atomic<ULONG> m_refCount = 0;
+};
+
+
+RawCaptureReplayDevice::RawCaptureReplayDevice(const Config& config):
+	m_config(config),
+	m_stopEvent(TRUE)
+{
+	if (m_config.bufferCount < 1)
+		throw std::runtime_error("Raw capture replay needs at least one buffer");
+
+	m_file.reset(new RawCaptureFile(m_config.path));
+
+	if (m_file->FrameCount() == 0)
+		throw std::runtime_error("Raw capture has no frames");
+
+	if (m_file->Header().timingClockTicksPerSecond <= 0)
+		throw std::runtime_error("Raw capture has no timing clock rate");
+
+	for (uint32_t i = 0; i < m_config.bufferCount; ++i)
+		m_frameBuffers.push_back(std::unique_ptr<RawCaptureReplayFrameBuffer>(new RawCaptureReplayFrameBuffer()));
+}
+
+
+RawCaptureReplayDevice::~RawCaptureReplayDevice()
+{
+	if (m_captureThread.joinable())
+		StopCapture();
+
+	m_callback = nullptr;
+}
+
+
+//
+// ACaptureDevice
+//
+
+
+void RawCaptureReplayDevice::SetCallbackHandler(ICaptureDeviceCallback* callback)
+{
+	m_callback = callback;
+
+	// Update client if subscribing
+	if (m_callback)
+	{
+		m_callback->OnCaptureDeviceState(m_state);
+		SendVideoStateCallback();
+	}
+
+	DbgLog((LOG_TRACE, 1, TEXT("RawCaptureReplayDevice::SetCallbackHandler(): updated callback")));
+}
+
+
+CString RawCaptureReplayDevice::GetName()
+{
+	CString name;
+	name.Format(TEXT("Replay %s"), m_config.path.GetString());
+	return name;
+}
+
+
+void RawCaptureReplayDevice::StartCapture()
+{
+	if (m_captureThread.joinable())
+		throw std::runtime_error("StartCapture() called but already started");
+
+	m_stateId = RAW_CAPTURE_STATE_ID_NONE;
+	m_capturedVideoFrameCount = 0;
+	m_missedVideoFrameCount = 0;
+	m_finished = false;
+
+	m_stopEvent.Reset();
+	m_hostStartTime = PipelineLatency::Now();
+	m_captureThread = std::thread(&RawCaptureReplayDevice::CaptureThreadProc, this);
+
+	DbgLog((LOG_TRACE, 1, TEXT("RawCaptureReplayDevice::StartCapture(): completed successfully")));
+}
+
+
+void RawCaptureReplayDevice::StopCapture()
+{
+	if (!m_captureThread.joinable())
+		throw std::runtime_error("StopCapture() called while not started");
+
+	m_stopEvent.Set();
+	m_captureThread.join();
+
+	DbgLog((LOG_TRACE, 1, TEXT("RawCaptureReplayDevice::StopCapture(): completed successfully, frames: %I64u, missed: %I64u"),
+		m_capturedVideoFrameCount.load(), m_missedVideoFrameCount.load()));
+}
+
+
+CaptureInputs RawCaptureReplayDevice::SupportedCaptureInputs()
+{
+	CaptureInputs captureInputs;
+	captureInputs.push_back(CaptureInput(REPLAY_CAPTURE_INPUT_ID, CaptureInputType::HDMI, TEXT("Replay")));
+
+	return captureInputs;
+}
+
+
+void RawCaptureReplayDevice::SetCaptureInput(const CaptureInputId captureInputId)
+{
+	if (captureInputId != REPLAY_CAPTURE_INPUT_ID)
+		throw std::runtime_error("Raw capture replay only has a single input");
+}
+
+
+ITimingClock* RawCaptureReplayDevice::GetTimingClock()
+{
+	if (m_state != CaptureDeviceState::CAPTUREDEVICESTATE_CAPTURING)
+		return nullptr;
+
+	return this;
+}
+
+
+void RawCaptureReplayDevice::SetFrameOffsetMs(int frameOffsetMs)
+{
+	DbgLog((LOG_TRACE, 1, TEXT("RawCaptureReplayDevice::SetFrameOffsetMs() to %i"), frameOffsetMs));
+
+	m_frameOffsetTicks = frameOffsetMs * TimingClockTicksPerSecond() / 1000;
+}
+
+
+//
+// ITimingClock
+//
+
+
+timingclocktime_t RawCaptureReplayDevice::TimingClockNow()
+{
+	return m_file->IndexEntry(0).timingTimestamp + (timingclocktime_t)(HostTimeS() * TimingClockTicksPerSecond());
+}
+
+
+//
+// IUnknown
+//
+
+
+HRESULT	RawCaptureReplayDevice::QueryInterface(REFIID iid, LPVOID* ppv)
+{
+	if (!ppv)
+		return E_INVALIDARG;
+
+	// Initialise the return result
+	*ppv = nullptr;
+
+	// Obtain the IUnknown interface and compare it the provided REFIID
+	if (iid == IID_IUnknown)
+	{
+		*ppv = this;
+		AddRef();
+		return S_OK;
+	}
+
+	return E_NOINTERFACE;
+}
+
+
+ULONG RawCaptureReplayDevice::AddRef(void)
+{
+	return ++m_refCount;
+}
+
+
+ULONG RawCaptureReplayDevice::Release(void)
+{
+	ULONG newRefValue = --m_refCount;
+	if (newRefValue == 0)
+		delete this;
+
+	return newRefValue;
+}
+
+
+//
+// Internal helpers
+//
+
+
+void RawCaptureReplayDevice::CaptureThreadProc()
+{
+	// ! WARNING: Runs in the capture thread
+
+	DbgLog((LOG_TRACE, 1, TEXT("RawCaptureReplayDevice capture thread starting")));
+
+	// Sleeps need to be accurate to keep the cadence
+	timeBeginPeriod(1);
+
+	UpdateState(CaptureDeviceState::CAPTUREDEVICESTATE_CAPTURING);
+	SendCardStateCallback();
+
+	const timingclocktime_t firstTimestamp = m_file->IndexEntry(0).timingTimestamp;
+	const double ticksPerSecond = (double)TimingClockTicksPerSecond();
+
+	m_file->Prefetch(0, m_config.prefetchFrames);
+
+	bool stopped = false;
+	for (uint64_t i = 0; i < m_file->FrameCount(); ++i)
+	{
+		const RawCaptureIndexEntry& indexEntry = m_file->IndexEntry(i);
+
+		if (m_config.unthrottled)
+		{
+			if (m_stopEvent.Check())
+			{
+				stopped = true;
+				break;
+			}
+		}
+		else if (!WaitUntil((indexEntry.timingTimestamp - firstTimestamp) / ticksPerSecond))
+		{
+			stopped = true;
+			break;
+		}
+
+		// Keep the read ahead window full, the frames before it are in already
+		m_file->Prefetch(i + m_config.prefetchFrames, 1);
+
+		m_capturedVideoFrameCount = i + 1;
+
+		const int64_t arrivalTime = PipelineLatency::Now();
+		FrameTraceScope frameTrace(FrameTraceEvent::VIDEO_INPUT_FRAME_ARRIVED, indexEntry.counter);
+
+		// Recorded state changes go out before the first frame they apply to
+		SendVideoStatesUntil(indexEntry.stateId);
+
+		if (!m_config.unthrottled)
+		{
+			const timingclocktime_t timingClockNow = TimingClockNow();
+			if (timingClockNow > indexEntry.timingTimestamp)
+				PipelineLatency::Record(
+					LatencyStage::HARDWARE_TO_CALLBACK,
+					(uint64_t)((timingClockNow - indexEntry.timingTimestamp) * (1000000.0 / ticksPerSecond)));
+		}
+
+		// Downstream holds on to all frames, like a hardware overflow. Unthrottled that's
+		// back-pressure instead.
+		RawCaptureReplayFrameBuffer* frameBuffer = AcquireFrameBuffer();
+		while (!frameBuffer && m_config.unthrottled && !m_stopEvent.Check())
+		{
+			std::this_thread::yield();
+			frameBuffer = AcquireFrameBuffer();
+		}
+
+		if (!frameBuffer)
+		{
+			++m_missedVideoFrameCount;
+			continue;
+		}
+
+		// Downstream takes its own reference if it needs the frame for longer than the callback
+		VideoFrameHandle videoFrame = VideoFrameHandle::Adopt(VideoFrame(
+			m_file->FrameData(indexEntry),
+			indexEntry.counter,
+			indexEntry.timingTimestamp + m_frameOffsetTicks,
+			frameBuffer));
+		videoFrame->SetArrivalTime(arrivalTime);
+
+		if (m_callback)
+			m_callback->OnCaptureDeviceVideoFrame(*videoFrame);
+
+		PipelineLatency::RecordSince(LatencyStage::CALLBACK_RESIDENCY, arrivalTime);
+	}
+
+	// Out of frames, like a source which stopped sending. States which came in after the
+	// last frame, like the input going away, still go out.
+	if (!stopped)
+	{
+		if (m_file->StateCount() > 0)
+			SendVideoStatesUntil(m_file->StateCount() - 1);
+
+		m_finished = true;
+		DbgLog((LOG_TRACE, 1, TEXT("RawCaptureReplayDevice replayed all %I64u frames"), m_file->FrameCount()));
+
+		m_stopEvent.Wait();
+	}
+
+	UpdateState(CaptureDeviceState::CAPTUREDEVICESTATE_READY);
+
+	timeEndPeriod(1);
+
+	DbgLog((LOG_TRACE, 1, TEXT("RawCaptureReplayDevice capture thread exiting")));
+}
+
+
+RawCaptureReplayFrameBuffer* RawCaptureReplayDevice::AcquireFrameBuffer()
+{
+	// Only the capture thread takes a free buffer into use, so one found free stays free
+	for (const auto& frameBuffer : m_frameBuffers)
+	{
+		if (!frameBuffer->InUse())
+		{
+			frameBuffer->AddRef();
+			return frameBuffer.get();
+		}
+	}
+
+	return nullptr;
+}
+
+
+double RawCaptureReplayDevice::HostTimeS() const
+{
+	return (PipelineLatency::Now() - m_hostStartTime) / (double)PipelineLatency::TicksPerSecond();
+}
+
+
+bool RawCaptureReplayDevice::WaitUntil(double hostTimeS)
+{
+	while (true)
+	{
+		const double remainingS = hostTimeS - HostTimeS();
+		if (remainingS <= 0.0)
+			return true;
+
+		// Sleep for all but the last ms, which gets polled to not oversleep
+		const DWORD waitMs = (remainingS > 0.002) ? (DWORD)((remainingS - 0.001) * 1000.0) : 0;
+		if (m_stopEvent.Wait(waitMs))
+			return false;
+	}
+}
+
+
+void RawCaptureReplayDevice::UpdateState(CaptureDeviceState state)
+{
+	m_state = state;
+
+	if (m_callback)
+		m_callback->OnCaptureDeviceState(state);
+}
+
+
+void RawCaptureReplayDevice::SendCardStateCallback()
+{
+	if (!m_callback)
+		return;
+
+	CaptureDeviceCardStateComPtr cardState = new CaptureDeviceCardState();
+	if (!cardState)
+		throw std::runtime_error("Failed to alloc CaptureDeviceCardStateComPtr");
+
+	// Mode the recording started in
+	const VideoStateComPtr videoState = m_file->State(m_file->IndexEntry(0).stateId);
+
+	cardState->inputLocked = InputLocked::YES;
+	cardState->inputDisplayMode = videoState->displayMode;
+
+	CString s;
+	s.Format(_T("Replay frames: %I64u"), m_file->FrameCount());
+	cardState->other.push_back(s);
+
+	s.Format(_T("Replay frames dropped when recording: %I64u"), m_file->Header().droppedFrameCount);
+	cardState->other.push_back(s);
+
+	m_callback->OnCaptureDeviceCardStateChange(cardState);
+}
+
+
+void RawCaptureReplayDevice::SendVideoStateCallback()
+{
+	if (!m_callback)
+		return;
+
+	// Invalid until the first frame
+	VideoStateComPtr videoState;
+	if (m_state == CaptureDeviceState::CAPTUREDEVICESTATE_CAPTURING && m_stateId != RAW_CAPTURE_STATE_ID_NONE)
+		videoState = m_file->State(m_stateId);
+	else
+		videoState = new VideoState();
+
+	if (!videoState)
+		throw std::runtime_error("Failed to alloc VideoStateComPtr");
+
+	m_callback->OnCaptureDeviceVideoStateChange(videoState);
+}
+
+
+void RawCaptureReplayDevice::SendVideoStatesUntil(uint32_t stateId)
+{
+	// States are numbered in the order they came in, this sends the ones no frame was
+	// captured in as well, invalid ones included
+	uint32_t nextStateId = (m_stateId == RAW_CAPTURE_STATE_ID_NONE) ? 0 : m_stateId + 1;
+	for (; nextStateId <= stateId && nextStateId < m_file->StateCount(); ++nextStateId)
+	{
+		m_stateId = nextStateId;
+		SendVideoStateCallback();
+	}
+
+	// Frames are never recorded out of state order, but don't replay one in the wrong state
+	if (m_stateId != stateId)
+	{
+		m_stateId = stateId;
+		SendVideoStateCallback();
+	}
+}
@@ -0,0 +1,152 @@
+/*
+ * Copyright(C) 2021 Dennis Fleurbaaij <mail@dennisfleurbaaij.com>
+ *
+ * This program is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, version 3.
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License along with this program. If not, see < https://www.gnu.org/licenses/>.
+ */
+
+
+#pragma once
+
+
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include <ACaptureDevice.h>
+#include <ITimingClock.h>
+
+#include "RawCaptureFile.h"
+
+
+class RawCaptureReplayFrameBuffer;
+
+
+/**
+ * Capture device which replays a raw capture recorded by the RawCaptureRecorder, for reproducing
+ * what a capture card delivered without the card.
+ *
+ * The file is memory mapped and the frames point straight into the mapping. Frames go out on a
+ * capture thread at their recorded timestamps relative to the first one. Every recorded video
+ * state is sent at its place between the frames, also the invalid ones and the ones no frame was
+ * captured in, with the same guarantees as a hardware device. The timing clock runs at the recorded clock's rate and starts
+ * at the first frame's timestamp, so frames arrive with their original timing and jitter.
+ *
+ * The recorded timestamps already include the frame offset of the recording, the frame offset
+ * set on this device is added on top.
+ *
+ * Downstream can hold on to bufferCount frames, a frame for which none is free counts as missed.
+ * The data of the next prefetchFrames frames is requested from the OS ahead of time so that
+ * delivering a frame does not have to wait for the disk.
+ *
+ * After the last frame the device keeps capturing without delivering frames until it is stopped.
+ */
+class RawCaptureReplayDevice:
+	public ACaptureDevice,
+	public ITimingClock
+{
+public:
+
+	struct Config
+	{
+		// Required
+		CString path;
+
+		// Deliver frames back to back instead of at their recorded times and wait for a free
+		// frame buffer instead of missing the frame, for throughput benchmarks. Frame timestamps
+		// keep the recorded cadence, so they run ahead of the timing clock.
+		bool unthrottled = false;
+
+		// Frames downstream may hold on to at the same time
+		uint32_t bufferCount = 16;
+
+		// Frames read ahead of the one being delivered
+		uint32_t prefetchFrames = 8;
+	};
+
+	// Throws if the file can't be replayed
+	RawCaptureReplayDevice(const Config&);
+	virtual ~RawCaptureReplayDevice();
+
+	const RawCaptureFile& File() const { return *m_file; }
+
+	// True once all recorded frames have been delivered
+	bool IsFinished() const { return m_finished; }
+
+	// ACaptureDevice
+	void SetCallbackHandler(ICaptureDeviceCallback*) override;
+	CString GetName() override;
+	bool CanCapture() override { return true; }
+	void StartCapture() override;
+	void StopCapture() override;
+	CaptureInputId CurrentCaptureInputId() override { return REPLAY_CAPTURE_INPUT_ID; }
+	CaptureInputs SupportedCaptureInputs() override;
+	void SetCaptureInput(const CaptureInputId) override;
+	ITimingClock* GetTimingClock() override;
+	void SetFrameOffsetMs(int) override;
+	double HardwareLatencyMs() const override { return 0.0; }
+	uint64_t VideoFrameCapturedCount() const override { return m_capturedVideoFrameCount; }
+	uint64_t VideoFrameMissedCount() const override { return m_missedVideoFrameCount; }
+
+	// ITimingClock
+	timingclocktime_t TimingClockNow() override;
+	bool TimingClockRunning() override { return m_state == CaptureDeviceState::CAPTUREDEVICESTATE_CAPTURING; }
+	timingclocktime_t TimingClockTicksPerSecond() const override { return m_file->Header().timingClockTicksPerSecond; }
+	const TCHAR* TimingClockDescription() override { return TEXT("Raw capture replay clock"); }
+
+	// IUnknown
+	HRESULT	QueryInterface(REFIID iid, LPVOID* ppv) override;
+	ULONG AddRef() override;
+	ULONG Release() override;
+
+private:
+
+	static const CaptureInputId REPLAY_CAPTURE_INPUT_ID = 0;
+
+	const Config m_config;
+
+	// Outlives the capture runs along with the frame buffers, downstream might hold on to
+	// frames after stopping
+	std::unique_ptr<RawCaptureFile> m_file;
+	std::vector<std::unique_ptr<RawCaptureReplayFrameBuffer>> m_frameBuffers;
+
+	ICaptureDeviceCallback* m_callback = nullptr;
+	std::atomic<CaptureDeviceState> m_state = CaptureDeviceState::CAPTUREDEVICESTATE_READY;
+
+	// Recorded state which was sent last
+	uint32_t m_stateId = RAW_CAPTURE_STATE_ID_NONE;
+
+	// Performance counter at the first frame's timestamp
+	int64_t m_hostStartTime = 0;
+
+	std::atomic<timingclocktime_t> m_frameOffsetTicks = 0;
+	std::atomic<uint64_t> m_capturedVideoFrameCount = 0;
+	std::atomic<uint64_t> m_missedVideoFrameCount = 0;
+	std::atomic_bool m_finished = false;
+
+	CAMEvent m_stopEvent;
+	std::thread m_captureThread;
+
+	std::atomic<ULONG> m_refCount = 0;
+
+	// Capture thread function
+	void CaptureThreadProc();
+
+	// Get a frame buffer which downstream doesn't hold on to, nullptr if there is none
+	RawCaptureReplayFrameBuffer* AcquireFrameBuffer();
+
+	// Host time in seconds since the first frame
+	double HostTimeS() const;
+
+	// Wait until the given host time, returns false if stopped in the meantime
+	bool WaitUntil(double hostTimeS);
+
+	void UpdateState(CaptureDeviceState);
+	void SendCardStateCallback();
+	void SendVideoStateCallback();
+
+	// Send the recorded states after the last sent one up to and including the given one
+	void SendVideoStatesUntil(uint32_t stateId);
+};
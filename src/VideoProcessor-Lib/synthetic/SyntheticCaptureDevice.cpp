@@ -0,0 +1,437 @@
+/*
+ * Copyright(C) 2021 Dennis Fleurbaaij <mail@dennisfleurbaaij.com>
+ *
+ * This program is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, version 3.
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License along with this program. If not, see < https://www.gnu.org/licenses/>.
+ */
+
+
+#include <pch.h>
+
+#include <vector>
+
+#include <FrameTrace.h>
+#include <PipelineLatency.h>
+#include <VideoFrameHandle.h>
+
+#include "SyntheticCaptureDevice.h"
+
+
+// Publish the hardware latency every this many frames
+static const uint64_t HARDWARE_LATENCY_INTERVAL_FRAMES = 20;
+
+
+// Input encoding and bit depth on the wire which would be captured as the given encoding
+static void TranslateVideoFrameEncoding(VideoFrameEncoding videoFrameEncoding, ColorFormat& colorFormat, BitDepth& bitDepth)
+{
+	switch (videoFrameEncoding)
+	{
+	case VideoFrameEncoding::UYVY:
+	case VideoFrameEncoding::HDYC:
+		colorFormat = ColorFormat::YCbCr422;
+		bitDepth = BitDepth::BITDEPTH_8BIT;
+		return;
+
+	case VideoFrameEncoding::V210:
+		colorFormat = ColorFormat::YCbCr422;
+		bitDepth = BitDepth::BITDEPTH_10BIT;
+		return;
+
+	case VideoFrameEncoding::R210:
+	case VideoFrameEncoding::R10b:
+	case VideoFrameEncoding::R10l:
+		colorFormat = ColorFormat::RGB444;
+		bitDepth = BitDepth::BITDEPTH_10BIT;
+		return;
+
+	case VideoFrameEncoding::R12B:
+	case VideoFrameEncoding::R12L:
+		colorFormat = ColorFormat::RGB444;
+		bitDepth = BitDepth::BITDEPTH_12BIT;
+		return;
+	}
+
+	throw std::runtime_error("Video frame encoding not supported by the synthetic capture device");
+}
+
+
+SyntheticCaptureDevice::SyntheticCaptureDevice(const Config& config):
+	m_config(config),
+	m_stopEvent(TRUE)
+{
+	if (!m_config.displayMode)
+		throw std::runtime_error("Synthetic capture device needs a display mode");
+
+	if (m_config.bufferCount < 2)
+		throw std::runtime_error("Synthetic capture device needs at least two buffers");
+
+	// Throws if not supported
+	ColorFormat colorFormat;
+	BitDepth bitDepth;
+	TranslateVideoFrameEncoding(m_config.videoFrameEncoding, colorFormat, bitDepth);
+
+	VideoState videoState;
+	videoState.displayMode = m_config.displayMode;
+	videoState.videoFrameEncoding = m_config.videoFrameEncoding;
+
+	m_frameBufferPool.reset(new FrameBufferPool(
+		videoState.BytesPerFrame(), m_config.bufferCount, FrameBufferPool::ALIGNMENT_PAGE));
+
+	// Fill every buffer once with its own ramp so that consecutive frames differ
+	std::vector<FrameBuffer*> buffers;
+	for (uint32_t i = 0; i < m_config.bufferCount; ++i)
+	{
+		FrameBuffer* buffer = m_frameBufferPool->Acquire();
+		assert(buffer);
+
+		BYTE* data = buffer->Data();
+		for (size_t j = 0; j < m_frameBufferPool->GetBufferSize(); ++j)
+			data[j] = (BYTE)(j + i * 7);
+
+		buffers.push_back(buffer);
+	}
+
+	for (FrameBuffer* buffer : buffers)
+		buffer->Release();
+}
+
+
+SyntheticCaptureDevice::~SyntheticCaptureDevice()
+{
+	if (m_captureThread.joinable())
+		StopCapture();
+
+	m_callback = nullptr;
+}
+
+
+//
+// ACaptureDevice
+//
+
+
+void SyntheticCaptureDevice::SetCallbackHandler(ICaptureDeviceCallback* callback)
+{
+	m_callback = callback;
+
+	// Update client if subscribing
+	if (m_callback)
+	{
+		m_callback->OnCaptureDeviceState(m_state);
+		SendVideoStateCallback();
+	}
+
+	DbgLog((LOG_TRACE, 1, TEXT("SyntheticCaptureDevice::SetCallbackHandler(): updated callback")));
+}
+
+
+CString SyntheticCaptureDevice::GetName()
+{
+	CString name;
+	name.Format(TEXT("Synthetic %s %s"), m_config.displayMode->ToString().GetString(), ToString(m_config.videoFrameEncoding));
+	return name;
+}
+
+
+void SyntheticCaptureDevice::StartCapture()
+{
+	if (m_captureThread.joinable())
+		throw std::runtime_error("StartCapture() called but already started");
+
+	m_frameClock.reset(new SyntheticFrameClock(
+		m_config.clock, m_config.displayMode->TimeScale(), m_config.displayMode->FrameDuration()));
+
+	m_alternate = false;
+	m_capturedVideoFrameCount = 0;
+	m_missedVideoFrameCount = 0;
+	m_hardwareLatencyMs = 0;
+
+	m_stopEvent.Reset();
+	m_hostStartTime = PipelineLatency::Now();
+	m_captureThread = std::thread(&SyntheticCaptureDevice::CaptureThreadProc, this);
+
+	DbgLog((LOG_TRACE, 1, TEXT("SyntheticCaptureDevice::StartCapture(): completed successfully")));
+}
+
+
+void SyntheticCaptureDevice::StopCapture()
+{
+	if (!m_captureThread.joinable())
+		throw std::runtime_error("StopCapture() called while not started");
+
+	m_stopEvent.Set();
+	m_captureThread.join();
+
+	DbgLog((LOG_TRACE, 1, TEXT("SyntheticCaptureDevice::StopCapture(): completed successfully, frames: %I64u, missed: %I64u"),
+		m_capturedVideoFrameCount.load(), m_missedVideoFrameCount.load()));
+}
+
+
+CaptureInputs SyntheticCaptureDevice::SupportedCaptureInputs()
+{
+	CaptureInputs captureInputs;
+	captureInputs.push_back(CaptureInput(SYNTHETIC_CAPTURE_INPUT_ID, CaptureInputType::HDMI, TEXT("Synthetic")));
+
+	return captureInputs;
+}
+
+
+void SyntheticCaptureDevice::SetCaptureInput(const CaptureInputId captureInputId)
+{
+	if (captureInputId != SYNTHETIC_CAPTURE_INPUT_ID)
+		throw std::runtime_error("Synthetic capture device only has a single input");
+}
+
+
+ITimingClock* SyntheticCaptureDevice::GetTimingClock()
+{
+	if (m_state != CaptureDeviceState::CAPTUREDEVICESTATE_CAPTURING)
+		return nullptr;
+
+	return this;
+}
+
+
+void SyntheticCaptureDevice::SetFrameOffsetMs(int frameOffsetMs)
+{
+	DbgLog((LOG_TRACE, 1, TEXT("SyntheticCaptureDevice::SetFrameOffsetMs() to %i"), frameOffsetMs));
+
+	m_frameOffsetTicks = frameOffsetMs * (SyntheticFrameClock::CLOCK_TICKS_PER_SECOND / 1000);
+}
+
+
+//
+// ITimingClock
+//
+
+
+timingclocktime_t SyntheticCaptureDevice::TimingClockNow()
+{
+	assert(m_frameClock);
+
+	return m_frameClock->TicksAt(HostTimeS());
+}
+
+
+//
+// IUnknown
+//
+
+
+HRESULT	SyntheticCaptureDevice::QueryInterface(REFIID iid, LPVOID* ppv)
+{
+	if (!ppv)
+		return E_INVALIDARG;
+
+	// Initialise the return result
+	*ppv = nullptr;
+
+	// Obtain the IUnknown interface and compare it the provided REFIID
+	if (iid == IID_IUnknown)
+	{
+		*ppv = this;
+		AddRef();
+		return S_OK;
+	}
+
+	return E_NOINTERFACE;
+}
+
+
+ULONG SyntheticCaptureDevice::AddRef(void)
+{
+	return ++m_refCount;
+}
+
+
+ULONG SyntheticCaptureDevice::Release(void)
+{
+	ULONG newRefValue = --m_refCount;
+	if (newRefValue == 0)
+		delete this;
+
+	return newRefValue;
+}
+
+
+//
+// Internal helpers
+//
+
+
+void SyntheticCaptureDevice::CaptureThreadProc()
+{
+	// ! WARNING: Runs in the capture thread
+
+	DbgLog((LOG_TRACE, 1, TEXT("SyntheticCaptureDevice capture thread starting")));
+
+	// Sleeps need to be accurate to keep the cadence
+	timeBeginPeriod(1);
+
+	UpdateState(CaptureDeviceState::CAPTUREDEVICESTATE_CAPTURING);
+	SendCardStateCallback();
+	SendVideoStateCallback();
+
+	while (true)
+	{
+		const SyntheticFrameClock::Frame frame = m_frameClock->NextFrame();
+		if (m_config.unthrottled)
+		{
+			if (m_stopEvent.Check())
+				break;
+		}
+		else if (!WaitUntil(frame.callbackTimeS))
+		{
+			break;
+		}
+
+		m_capturedVideoFrameCount = frame.counter + 1;
+
+		if (frame.dropped)
+		{
+			++m_missedVideoFrameCount;
+			continue;
+		}
+
+		const int64_t arrivalTime = PipelineLatency::Now();
+		FrameTraceScope frameTrace(FrameTraceEvent::VIDEO_INPUT_FRAME_ARRIVED, frame.counter);
+
+		// Mid-stream video state change, goes out before the first frame it applies to
+		if (m_config.alternateIntervalFrames > 0)
+		{
+			const bool alternate = ((frame.counter / m_config.alternateIntervalFrames) % 2) == 1;
+			if (alternate != m_alternate)
+			{
+				m_alternate = alternate;
+				SendVideoStateCallback();
+			}
+		}
+
+		// Hardware latency, before the offset is applied like on real hardware
+		if (!m_config.unthrottled)
+		{
+			const timingclocktime_t timingClockNow = TimingClockNow();
+			if (timingClockNow > frame.timestamp)
+				PipelineLatency::Record(LatencyStage::HARDWARE_TO_CALLBACK, (uint64_t)(timingClockNow - frame.timestamp));
+
+			if (frame.counter % HARDWARE_LATENCY_INTERVAL_FRAMES == 0)
+				m_hardwareLatencyMs = TimingClockDiffMs(frame.timestamp, timingClockNow, TimingClockTicksPerSecond());
+		}
+
+		// Downstream holds on to all buffers, like a hardware overflow. Unthrottled that's
+		// back-pressure instead.
+		FrameBuffer* buffer = m_frameBufferPool->Acquire();
+		while (!buffer && m_config.unthrottled && !m_stopEvent.Check())
+		{
+			std::this_thread::yield();
+			buffer = m_frameBufferPool->Acquire();
+		}
+
+		if (!buffer)
+		{
+			++m_missedVideoFrameCount;
+			continue;
+		}
+
+		// Downstream takes its own reference if it needs the frame for longer than the callback
+		VideoFrameHandle videoFrame = VideoFrameHandle::Adopt(
+			VideoFrame(buffer->Data(), frame.counter, frame.timestamp + m_frameOffsetTicks, buffer));
+		videoFrame->SetArrivalTime(arrivalTime);
+
+		if (m_callback)
+			m_callback->OnCaptureDeviceVideoFrame(*videoFrame);
+
+		PipelineLatency::RecordSince(LatencyStage::CALLBACK_RESIDENCY, arrivalTime);
+	}
+
+	UpdateState(CaptureDeviceState::CAPTUREDEVICESTATE_READY);
+
+	timeEndPeriod(1);
+
+	DbgLog((LOG_TRACE, 1, TEXT("SyntheticCaptureDevice capture thread exiting")));
+}
+
+
+double SyntheticCaptureDevice::HostTimeS() const
+{
+	return (PipelineLatency::Now() - m_hostStartTime) / (double)PipelineLatency::TicksPerSecond();
+}
+
+
+bool SyntheticCaptureDevice::WaitUntil(double hostTimeS)
+{
+	while (true)
+	{
+		const double remainingS = hostTimeS - HostTimeS();
+		if (remainingS <= 0.0)
+			return true;
+
+		// Sleep for all but the last ms, which gets polled to not oversleep
+		const DWORD waitMs = (remainingS > 0.002) ? (DWORD)((remainingS - 0.001) * 1000.0) : 0;
+		if (m_stopEvent.Wait(waitMs))
+			return false;
+	}
+}
+
+
+void SyntheticCaptureDevice::UpdateState(CaptureDeviceState state)
+{
+	m_state = state;
+
+	if (m_callback)
+		m_callback->OnCaptureDeviceState(state);
+}
+
+
+void SyntheticCaptureDevice::SendCardStateCallback()
+{
+	if (!m_callback)
+		return;
+
+	CaptureDeviceCardStateComPtr cardState = new CaptureDeviceCardState();
+	if (!cardState)
+		throw std::runtime_error("Failed to alloc CaptureDeviceCardStateComPtr");
+
+	cardState->inputLocked = InputLocked::YES;
+	cardState->inputDisplayMode = m_config.displayMode;
+	TranslateVideoFrameEncoding(m_config.videoFrameEncoding, cardState->inputEncoding, cardState->inputBitDepth);
+
+	CString s;
+	s.Format(_T("Synthetic clock drift: %.01f ppm"), m_config.clock.driftPpm);
+	cardState->other.push_back(s);
+
+	s.Format(_T("Synthetic timestamp jitter: %.01f us"), m_config.clock.timestampJitterUs);
+	cardState->other.push_back(s);
+
+	s.Format(_T("Synthetic drop probability: %.04f"), m_config.clock.dropProbability);
+	cardState->other.push_back(s);
+
+	m_callback->OnCaptureDeviceCardStateChange(cardState);
+}
+
+
+void SyntheticCaptureDevice::SendVideoStateCallback()
+{
+	if (!m_callback)
+		return;
+
+	VideoStateComPtr videoState = new VideoState();
+	if (!videoState)
+		throw std::runtime_error("Failed to alloc VideoStateComPtr");
+
+	videoState->valid = (m_state == CaptureDeviceState::CAPTUREDEVICESTATE_CAPTURING);
+	if (videoState->valid)
+	{
+		videoState->displayMode = m_config.displayMode;
+		videoState->videoFrameEncoding = m_config.videoFrameEncoding;
+		videoState->eotf = m_alternate ? m_config.alternateEotf : m_config.eotf;
+		videoState->colorspace = m_alternate ? m_config.alternateColorSpace : m_config.colorSpace;
+
+		const HDRDataSharedPtr& hdrData = m_alternate ? m_config.alternateHdrData : m_config.hdrData;
+		if (hdrData && hdrData->IsValid())
+			videoState->hdrData = std::make_shared<HDRData>(*hdrData);
+	}
+
+	m_callback->OnCaptureDeviceVideoStateChange(videoState);
+}
@@ -0,0 +1,147 @@
+/*
+ * Copyright(C) 2021 Dennis Fleurbaaij <mail@dennisfleurbaaij.com>
+ *
+ * This program is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, version 3.
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License along with this program. If not, see < https://www.gnu.org/licenses/>.
+ */
+
+
+#pragma once
+
+
+#include <atomic>
+#include <memory>
+#include <thread>
+
+#include <ACaptureDevice.h>
+#include <FrameBufferPool.h>
+#include <ITimingClock.h>
+#include <VideoFrameEncoding.h>
+
+#include "SyntheticFrameClock.h"
+
+
+/**
+ * Capture device which generates frames itself, for testing the pipeline without capture hardware.
+ *
+ * Frames come from a capture thread at the display mode cadence of a SyntheticFrameClock, which
+ * also is the timing clock. They are delivered through the ICaptureDeviceCallback in the same
+ * order and with the same guarantees as a hardware device: first the state, then the video
+ * state and then the frames, on the capture thread.
+ *
+ * Frame buffers come from a pool and are filled with a byte pattern once at construction, so
+ * generating a frame costs nothing. The data is valid in the packing of all supported encodings
+ * but not a meaningful image. If downstream holds on to all buffers the frame counts as missed.
+ *
+ * Optionally the EOTF, color space and HDR data switch to an alternate set every so many frames,
+ * which is sent as a new video state before the first frame with it.
+ */
+class SyntheticCaptureDevice:
+	public ACaptureDevice,
+	public ITimingClock
+{
+public:
+
+	struct Config
+	{
+		// Required
+		DisplayModeSharedPtr displayMode;
+
+		// Any uncompressed encoding but ARGB_8BIT and BGRA_8BIT
+		VideoFrameEncoding videoFrameEncoding = VideoFrameEncoding::V210;
+
+		EOTF eotf = EOTF::SDR;
+		ColorSpace colorSpace = ColorSpace::REC_709;
+		HDRDataSharedPtr hdrData;
+
+		// Every this many frames switch between the above and the alternate set, 0 never switches
+		uint64_t alternateIntervalFrames = 0;
+		EOTF alternateEotf = EOTF::PQ;
+		ColorSpace alternateColorSpace = ColorSpace::BT_2020;
+		HDRDataSharedPtr alternateHdrData;
+
+		SyntheticFrameClock::Config clock;
+
+		// Generate frames back to back instead of at the clock's callback times and wait for a
+		// free buffer instead of missing the frame, for throughput benchmarks. Frame timestamps
+		// keep the cadence, so they run ahead of the timing clock.
+		bool unthrottled = false;
+
+		// Frame buffers in the pool
+		uint32_t bufferCount = 16;
+	};
+
+	SyntheticCaptureDevice(const Config&);
+	virtual ~SyntheticCaptureDevice();
+
+	// ACaptureDevice
+	void SetCallbackHandler(ICaptureDeviceCallback*) override;
+	CString GetName() override;
+	bool CanCapture() override { return true; }
+	void StartCapture() override;
+	void StopCapture() override;
+	CaptureInputId CurrentCaptureInputId() override { return SYNTHETIC_CAPTURE_INPUT_ID; }
+	CaptureInputs SupportedCaptureInputs() override;
+	void SetCaptureInput(const CaptureInputId) override;
+	ITimingClock* GetTimingClock() override;
+	void SetFrameOffsetMs(int) override;
+	double HardwareLatencyMs() const override { return m_hardwareLatencyMs; }
+	uint64_t VideoFrameCapturedCount() const override { return m_capturedVideoFrameCount; }
+	uint64_t VideoFrameMissedCount() const override { return m_missedVideoFrameCount; }
+
+	// ITimingClock
+	timingclocktime_t TimingClockNow() override;
+	bool TimingClockRunning() override { return m_state == CaptureDeviceState::CAPTUREDEVICESTATE_CAPTURING; }
+	timingclocktime_t TimingClockTicksPerSecond() const override { return SyntheticFrameClock::CLOCK_TICKS_PER_SECOND; }
+	const TCHAR* TimingClockDescription() override { return TEXT("Synthetic hardware clock"); }
+
+	// IUnknown
+	HRESULT	QueryInterface(REFIID iid, LPVOID* ppv) override;
+	ULONG AddRef() override;
+	ULONG Release() override;
+
+private:
+
+	static const CaptureInputId SYNTHETIC_CAPTURE_INPUT_ID = 0;
+
+	const Config m_config;
+
+	ICaptureDeviceCallback* m_callback = nullptr;
+	std::atomic<CaptureDeviceState> m_state = CaptureDeviceState::CAPTUREDEVICESTATE_READY;
+
+	// Outlives the capture runs, downstream might hold on to buffers after stopping
+	std::unique_ptr<FrameBufferPool> m_frameBufferPool;
+
+	// Recreated for every capture run, owned by the capture thread while running
+	std::unique_ptr<SyntheticFrameClock> m_frameClock;
+
+	// Performance counter at host time 0 of the frame clock
+	int64_t m_hostStartTime = 0;
+
+	// True while the alternate EOTF, color space and HDR data are used
+	bool m_alternate = false;
+
+	std::atomic<timingclocktime_t> m_frameOffsetTicks = 0;
+	double m_hardwareLatencyMs = 0;
+	std::atomic<uint64_t> m_capturedVideoFrameCount = 0;
+	std::atomic<uint64_t> m_missedVideoFrameCount = 0;
+
+	CAMEvent m_stopEvent;
+	std::thread m_captureThread;
+
+	std::atomic<ULONG> m_refCount = 0;
+
+	// Capture thread function
+	void CaptureThreadProc();
+
+	// Host time in seconds since the start of the capture
+	double HostTimeS() const;
+
+	// Wait until the given host time, returns false if stopped in the meantime
+	bool WaitUntil(double hostTimeS);
+
+	void UpdateState(CaptureDeviceState);
+	void SendCardStateCallback();
+	void SendVideoStateCallback();
+};
@@ -0,0 +1,72 @@
+/*
+ * Copyright(C) 2021 Dennis Fleurbaaij <mail@dennisfleurbaaij.com>
+ *
+ * This program is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, version 3.
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License along with this program. If not, see < https://www.gnu.org/licenses/>.
+ */
+
+
+#include <pch.h>
+
+#include <cmath>
+
+#include "SyntheticFrameClock.h"
+
+
+SyntheticFrameClock::SyntheticFrameClock(const Config& config, unsigned int timeScale, unsigned int frameDuration):
+	m_config(config),
+	m_frameDurationTicks((double)frameDuration * CLOCK_TICKS_PER_SECOND / timeScale),
+	m_random(config.seed),
+	m_normal(0.0, 1.0),
+	m_uniform(0.0, 1.0)
+{
+	if (timeScale == 0 || frameDuration == 0)
+		throw std::runtime_error("Invalid frame rate");
+
+	if (config.dropProbability < 0.0 || config.dropProbability >= 1.0)
+		throw std::runtime_error("Drop probability must be in [0, 1)");
+
+	if (config.timestampJitterUs < 0.0 || config.callbackLatencyUs < 0.0 || config.callbackJitterUs < 0.0)
+		throw std::runtime_error("Latency and jitter must be >= 0");
+}
+
+
+timingclocktime_t SyntheticFrameClock::TicksAt(double hostTimeS) const
+{
+	return START_TICKS + (timingclocktime_t)std::llround(hostTimeS * CLOCK_TICKS_PER_SECOND * (1.0 + m_config.driftPpm / 1e6));
+}
+
+
+double SyntheticFrameClock::HostTimeAt(timingclocktime_t ticks) const
+{
+	return (ticks - START_TICKS) / (CLOCK_TICKS_PER_SECOND * (1.0 + m_config.driftPpm / 1e6));
+}
+
+
+SyntheticFrameClock::Frame SyntheticFrameClock::NextFrame()
+{
+	Frame frame;
+	frame.counter = m_counter++;
+
+	const timingclocktime_t idealTimestamp = START_TICKS + (timingclocktime_t)std::llround(frame.counter * m_frameDurationTicks);
+
+	frame.timestamp = idealTimestamp;
+	if (m_config.timestampJitterUs > 0.0)
+		frame.timestamp += (timingclocktime_t)std::llround(m_normal(m_random) * m_config.timestampJitterUs);
+
+	// Hardware timestamps never go back
+	if (m_previousTimestamp != TIMING_CLOCK_TIME_INVALID && frame.timestamp <= m_previousTimestamp)
+		frame.timestamp = m_previousTimestamp + 1;
+	m_previousTimestamp = frame.timestamp;
+
+	double callbackDelayUs = m_config.callbackLatencyUs;
+	if (m_config.callbackJitterUs > 0.0)
+		callbackDelayUs += std::fabs(m_normal(m_random)) * m_config.callbackJitterUs;
+
+	frame.callbackTimeS = HostTimeAt(idealTimestamp) + callbackDelayUs / CLOCK_TICKS_PER_SECOND;
+
+	frame.dropped = (m_config.dropProbability > 0.0) && (m_uniform(m_random) < m_config.dropProbability);
+
+	return frame;
+}
@@ -0,0 +1,97 @@
+/*
+ * Copyright(C) 2021 Dennis Fleurbaaij <mail@dennisfleurbaaij.com>
+ *
+ * This program is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, version 3.
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License along with this program. If not, see < https://www.gnu.org/licenses/>.
+ */
+
+
+#pragma once
+
+
+#include <random>
+
+#include <TimingClock.h>
+
+
+/**
+ * Simulated capture hardware clock and frame cadence, this drives the SyntheticCaptureDevice.
+ *
+ * The hardware clock runs at 1MHz and drifts against the host clock by a fixed amount of ppm.
+ * Frames are at the exact display mode cadence on the hardware clock, their timestamps get
+ * gaussian jitter. The capture callback of a frame fires after a fixed latency plus half-gaussian
+ * jitter from the frame's ideal time. Frames can randomly be dropped, like on real hardware those
+ * show as a gap in the frame counter.
+ *
+ * Deterministic for a given seed. Not thread-safe.
+ */
+class SyntheticFrameClock
+{
+public:
+
+	static const timingclocktime_t CLOCK_TICKS_PER_SECOND = 1000000LL;  // us
+
+	// Hardware clock time at host time 0, real hardware clocks don't start at 0 either
+	static const timingclocktime_t START_TICKS = 1000000000LL;
+
+	struct Config
+	{
+		// Hardware clock speed relative to the host clock
+		double driftPpm = 0.0;
+
+		// Standard deviation of the frame timestamps from their ideal time
+		double timestampJitterUs = 0.0;
+
+		// Delay of the capture callback from the ideal frame time and the standard deviation
+		// of the (always positive) jitter on top of that
+		double callbackLatencyUs = 1000.0;
+		double callbackJitterUs = 0.0;
+
+		// Chance for every frame to get lost
+		double dropProbability = 0.0;
+
+		uint32_t seed = 1;
+	};
+
+	struct Frame
+	{
+		// Monotonically increasing, includes dropped frames
+		uint64_t counter;
+
+		// Hardware clock timestamp
+		timingclocktime_t timestamp;
+
+		// Host time in seconds at which the capture callback fires
+		double callbackTimeS;
+
+		// Frame was lost, don't deliver
+		bool dropped;
+	};
+
+	// Frame rate as in DisplayMode, frameDuration ticks of a timeScale per second clock
+	SyntheticFrameClock(const Config&, unsigned int timeScale, unsigned int frameDuration);
+
+	// Hardware clock time at the given host time in seconds
+	timingclocktime_t TicksAt(double hostTimeS) const;
+
+	// Host time in seconds at the given hardware clock time
+	double HostTimeAt(timingclocktime_t ticks) const;
+
+	// Generate the next frame
+	Frame NextFrame();
+
+	double FrameDurationTicks() const { return m_frameDurationTicks; }
+
+private:
+
+	const Config m_config;
+	const double m_frameDurationTicks;
+
+	uint64_t m_counter = 0;
+	timingclocktime_t m_previousTimestamp = TIMING_CLOCK_TIME_INVALID;
+
+	std::mt19937 m_random;
+	std::normal_distribution<double> m_normal;
+	std::uniform_real_distribution<double> m_uniform;
+};
@@ -15,6 +15,10 @@
 
 static const int OUTPUT_LINESIZE_ALIGNMENT = 1;
 
+// swscale takes its unaligned (slow and warning) path if a destination plane or line size is not
+// aligned to this, in which case we go through the intermediate frame
+static const int SWS_DIRECT_OUTPUT_ALIGNMENT = 16;
+
 
 CFFMpegDecoderVideoFrameFormatter::CFFMpegDecoderVideoFrameFormatter(
 	AVCodecID inputCodecId,
@@ -70,6 +74,7 @@ CFFMpegDecoderVideoFrameFormatter::CFFMpegDecoderVideoFrameFormatter(
 CFFMpegDecoderVideoFrameFormatter::~CFFMpegDecoderVideoFrameFormatter()
 {
 	Cleanup();
+	FreeIntermediateBuffer();
 
 	if (mAVCodecContext)
 	{
@@ -122,13 +127,6 @@ void CFFMpegDecoderVideoFrameFormatter::OnVideoState(VideoStateComPtr& videoStat
 	if (!mSws)
 		throw std::runtime_error("Failed to get context");
 
-	if(!av_image_alloc(
-		mOutputFrame->data, mOutputFrame->linesize,
-		mWidth, mHeight,
-		mTargetPixelFormat,
-		OUTPUT_LINESIZE_ALIGNMENT))
-		throw std::runtime_error("Failed to allocate mOutputFrame image");
-
 	mOutFrameSize = av_image_get_buffer_size(
 		mTargetPixelFormat,
 		mWidth, mHeight,
@@ -136,6 +134,30 @@ void CFFMpegDecoderVideoFrameFormatter::OnVideoState(VideoStateComPtr& videoStat
 
 	if(mOutFrameSize <= 0)
 		throw std::runtime_error("Failed to get output frame size");
+
+	// The planes are packed back to back in outBuffer, so if all line sizes are aligned so are all
+	// plane starts provided outBuffer itself is.
+	if (av_image_fill_linesizes(mOutLinesize, mTargetPixelFormat, mWidth) < 0)
+		throw std::runtime_error("Failed to get output line sizes");
+
+	mDirectOutputPossible = true;
+	for (int i = 0; i < 4; ++i)
+		if (mOutLinesize[i] % SWS_DIRECT_OUTPUT_ALIGNMENT != 0)
+			mDirectOutputPossible = false;
+
+	// Only reallocate the intermediate frame if it grows
+	mIntermediateSize = av_image_get_buffer_size(
+		mTargetPixelFormat,
+		mWidth, mHeight,
+		SWS_DIRECT_OUTPUT_ALIGNMENT);
+
+	if (mIntermediateSize <= 0)
+		throw std::runtime_error("Failed to get intermediate frame size");
+
+	if (mIntermediatePool && mIntermediatePool->GetBufferSize() < (size_t)mIntermediateSize)
+		FreeIntermediateBuffer();
+
+	mIndirectFrameCount = 0;
 }
 
 
@@ -164,7 +186,46 @@ bool CFFMpegDecoderVideoFrameFormatter::FormatVideoFrame(
 	if (ret < 0)
 		throw std::runtime_error("avcodec_receive_frame errored");
 
-	// Convert
+	// Convert straight into the output buffer if we can
+	if (mDirectOutputPossible && (reinterpret_cast<uintptr_t>(outBuffer) % SWS_DIRECT_OUTPUT_ALIGNMENT) == 0)
+	{
+		uint8_t* outData[4];
+		const int filledSize = av_image_fill_pointers(outData, mTargetPixelFormat, mHeight, (uint8_t*)outBuffer, mOutLinesize);
+		if (filledSize < 0 || filledSize > mOutFrameSize)
+			throw std::runtime_error("Failed to av_image_fill_pointers");
+
+		int scaled_lines = sws_scale(
+			mSws,
+			mInputFrame->data, mInputFrame->linesize,
+			0, mHeight,
+			outData, mOutLinesize);
+		if (scaled_lines != mHeight)
+			throw std::runtime_error("Failed to sws_scale all lines");
+
+		return true;
+	}
+
+	// Fall back to an intermediate frame, allocated on first use
+	if (!mOutputFrame->data[0])
+	{
+		if (!mIntermediatePool)
+		{
+			mIntermediatePool.reset(new FrameBufferPool(mIntermediateSize, 1));
+			mIntermediateBuffer = mIntermediatePool->Acquire();
+			assert(mIntermediateBuffer);
+		}
+
+		if (av_image_fill_arrays(
+			mOutputFrame->data, mOutputFrame->linesize,
+			mIntermediateBuffer->Data(),
+			mTargetPixelFormat,
+			mWidth, mHeight,
+			SWS_DIRECT_OUTPUT_ALIGNMENT) < 0)
+			throw std::runtime_error("Failed to set up mOutputFrame image");
+	}
+
+	++mIndirectFrameCount;
+
 	int scaled_lines = sws_scale(
 		mSws,
 		mInputFrame->data, mInputFrame->linesize,
@@ -197,10 +258,34 @@ LONG CFFMpegDecoderVideoFrameFormatter::GetOutFrameSize() const
 
 void CFFMpegDecoderVideoFrameFormatter::Cleanup()
 {
-	if (mOutFrameSize > 0)
+	if (mSws)
 	{
 		sws_freeContext(mSws);
+		mSws = nullptr;
+	}
+
+	// The buffer stays, it gets pointed to again on first use
+	if (mOutputFrame)
+	{
+		for (int i = 0; i < AV_NUM_DATA_POINTERS; ++i)
+		{
+			mOutputFrame->data[i] = nullptr;
+			mOutputFrame->linesize[i] = 0;
+		}
+	}
+}
+
+
+void CFFMpegDecoderVideoFrameFormatter::FreeIntermediateBuffer()
+{
+	if (mOutputFrame)
+		mOutputFrame->data[0] = nullptr;
 
-		av_freep(&mOutputFrame->data[0]);
+	if (mIntermediateBuffer)
+	{
+		mIntermediateBuffer->Release();
+		mIntermediateBuffer = nullptr;
 	}
+
+	mIntermediatePool.reset();
 }
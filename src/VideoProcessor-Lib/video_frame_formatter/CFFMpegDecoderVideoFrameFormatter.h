@@ -18,11 +18,18 @@ extern "C"
 	#include <libavcodec/avcodec.h>
 }
 
+#include <memory>
+
+#include <FrameBufferPool.h>
 #include <video_frame_formatter/IVideoFrameFormatter.h>
 
 
  /**
   * This formatter can convert using an ffmpeg decoder and scaler for a target pixel format
+  *
+  * The scaler writes straight into the output buffer if its address and the packed line sizes
+  * are aligned well enough for swscale, otherwise it scales into an intermediate frame and copies.
+  * The intermediate frame's buffer is kept over video state changes as long as it's large enough.
   */
 class CFFMpegDecoderVideoFrameFormatter:
 	public IVideoFrameFormatter
@@ -39,6 +46,9 @@ public:
 	bool FormatVideoFrame(const VideoFrame& inFrame, BYTE* outBuffer) override;
 	LONG GetOutFrameSize() const override;
 
+	// Number of frames which needed the intermediate frame and copy since the last OnVideoState()
+	uint64_t GetIndirectFrameCount() const { return mIndirectFrameCount; }
+
 private:
 
 	const AVPixelFormat mTargetPixelFormat;
@@ -49,12 +59,19 @@ private:
 	int mHeight = 0;
 	int mWidth = 0;
 	LONG mOutFrameSize = 0;
+	int mOutLinesize[4] = { 0 };  // Packed into outBuffer, av_image_* use 4 planes
+	bool mDirectOutputPossible = false;
+	uint64_t mIndirectFrameCount = 0;
 
 	struct SwsContext* mSws = nullptr;
 	AVFrame* mInputFrame = nullptr;
-	AVFrame* mOutputFrame = nullptr;
+	AVFrame* mOutputFrame = nullptr;  // Points into mIntermediateBuffer once set up
+	LONG mIntermediateSize = 0;
+	std::unique_ptr<FrameBufferPool> mIntermediatePool;
+	FrameBuffer* mIntermediateBuffer = nullptr;
 
 	AVPacket* mPkt;
 
 	void Cleanup();
+	void FreeIntermediateBuffer();
 };
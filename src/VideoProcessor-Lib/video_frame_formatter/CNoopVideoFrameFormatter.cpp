@@ -10,6 +10,14 @@
 
 #include "CNoopVideoFrameFormatter.h"
 
+#include <algorithm>
+
+
+CNoopVideoFrameFormatter::CNoopVideoFrameFormatter(SimdLevel maxSimdLevel):
+	m_maxSimdLevel(maxSimdLevel)
+{
+}
+
 
 void CNoopVideoFrameFormatter::OnVideoState(VideoStateComPtr& videoState)
 {
@@ -18,6 +26,19 @@ void CNoopVideoFrameFormatter::OnVideoState(VideoStateComPtr& videoState)
 
 	m_bytesPerVideoFrame = videoState->BytesPerFrame();
 	assert(m_bytesPerVideoFrame > 0);
+
+	m_bytesPerRow = videoState->BytesPerRow();
+	assert(m_bytesPerRow > 0);
+
+	m_height = videoState->displayMode->FrameHeight();
+	assert(m_height > 0);
+
+	m_simdLevel = std::min(m_maxSimdLevel, CpuSimdLevel());
+	m_copyFunc = GetStreamingCopyFunc(m_simdLevel);
+
+	DbgLog((LOG_TRACE, 1,
+		TEXT("CNoopVideoFrameFormatter::OnVideoState(): Using %s copy, %u bytes per row"),
+		ToString(m_simdLevel), m_bytesPerRow));
 }
 
 
@@ -28,7 +49,28 @@ bool CNoopVideoFrameFormatter::FormatVideoFrame(
 	if (m_bytesPerVideoFrame == 0)
 		throw std::runtime_error("bytes per frame not known, call OnVideoState() first");
 
-	memcpy(outBuffer, inFrame.GetData(), m_bytesPerVideoFrame);
+	return FormatVideoFrameSlice(inFrame, outBuffer, 0, m_height);
+}
+
+
+bool CNoopVideoFrameFormatter::FormatVideoFrameSlice(
+	const VideoFrame& inFrame,
+	BYTE* outBuffer,
+	uint32_t firstLine,
+	uint32_t lineCount)
+{
+	if (m_bytesPerRow == 0)
+		throw std::runtime_error("bytes per row not known, call OnVideoState() first");
+
+	assert(firstLine + lineCount <= m_height);
+	assert((size_t)m_height * m_bytesPerRow <= (size_t)m_bytesPerVideoFrame);
+
+	StreamingCopyRows(
+		m_copyFunc,
+		outBuffer + (size_t)firstLine * m_bytesPerRow, m_bytesPerRow,
+		(const BYTE*)inFrame.GetData() + (size_t)firstLine * m_bytesPerRow, m_bytesPerRow,
+		m_bytesPerRow, lineCount);
+
 	return true;
 }
 
@@ -9,24 +9,43 @@
 #pragma once
 
 
+#include <SimdLevel.h>
 #include <video_frame_formatter/IVideoFrameFormatter.h>
+#include <video_frame_formatter/StreamingCopy.h>
 
 
  /**
   * Video frame formatter which simply does a direct copy
+  *
+  * The copy uses non-temporal stores as the output is not read back by the CPU.
+  * Wrap in CSlicedVideoFrameFormatter to spread the copy over multiple threads.
   */
 class CNoopVideoFrameFormatter:
 	public IVideoFrameFormatter
 {
 public:
 
+	// The fastest copy the CPU supports up to maxSimdLevel will be used
+	CNoopVideoFrameFormatter(SimdLevel maxSimdLevel = SimdLevel::AVX512);
 	virtual ~CNoopVideoFrameFormatter() {}
 
 	// IVideoFrameFormatter
 	void OnVideoState(VideoStateComPtr& videoState) override;
 	bool FormatVideoFrame(const VideoFrame& inFrame, BYTE* outBuffer) override;
 	LONG GetOutFrameSize() const override;
+	uint32_t GetSliceLineAlignment() const override { return 1; }
+	bool FormatVideoFrameSlice(const VideoFrame& inFrame, BYTE* outBuffer, uint32_t firstLine, uint32_t lineCount) override;
+
+	// SIMD level in use, valid after OnVideoState()
+	SimdLevel GetSimdLevel() const { return m_simdLevel; }
 
 private:
+	const SimdLevel m_maxSimdLevel;
+
 	int m_bytesPerVideoFrame = 0;
+	uint32_t m_bytesPerRow = 0;
+	uint32_t m_height = 0;
+
+	SimdLevel m_simdLevel = SimdLevel::SCALAR;
+	StreamingCopyFunc m_copyFunc = nullptr;
 };
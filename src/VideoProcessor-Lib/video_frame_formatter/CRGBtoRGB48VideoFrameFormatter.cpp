@@ -0,0 +1,99 @@
+/*
+ * Copyright(C) 2021 Dennis Fleurbaaij <mail@dennisfleurbaaij.com>
+ *
+ * This program is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, version 3.
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License along with this program. If not, see < https://www.gnu.org/licenses/>.
+ */
+
+
+#include <pch.h>
+
+#include "CRGBtoRGB48VideoFrameFormatter.h"
+
+#include <algorithm>
+
+
+#define RGB48_VALUES_PER_PIXEL 3
+
+
+CRGBtoRGB48VideoFrameFormatter::CRGBtoRGB48VideoFrameFormatter(SimdLevel maxSimdLevel):
+    m_maxSimdLevel(maxSimdLevel)
+{
+}
+
+
+void CRGBtoRGB48VideoFrameFormatter::OnVideoState(VideoStateComPtr& videoState)
+{
+	if (!videoState)
+		throw std::runtime_error("Null video state is not allowed");
+
+    switch (videoState->videoFrameEncoding)
+    {
+    case VideoFrameEncoding::R210:
+    case VideoFrameEncoding::R10b:
+    case VideoFrameEncoding::R10l:
+        break;
+
+    case VideoFrameEncoding::R12B:
+    case VideoFrameEncoding::R12L:
+        if (videoState->displayMode->FrameWidth() % 8 != 0)
+            throw std::runtime_error("Can only handle conversions which align with 12-bit RGB boundry (8 pixels)");
+        break;
+
+    default:
+        throw std::runtime_error("Can only handle R210, R10b, R10l, R12B and R12L input");
+    }
+
+    m_height = videoState->displayMode->FrameHeight();
+    m_width = videoState->displayMode->FrameWidth();
+    m_bytesPerRow = videoState->BytesPerRow();
+
+    m_simdLevel = std::min(m_maxSimdLevel, CpuSimdLevel());
+    m_lineFunc = GetRGBToRGB48LineFunc(m_simdLevel, videoState->videoFrameEncoding);
+
+    DbgLog((LOG_TRACE, 1,
+        TEXT("CRGBtoRGB48VideoFrameFormatter::OnVideoState(): Using %s kernel for %s"),
+        ToString(m_simdLevel), ToString(videoState->videoFrameEncoding)));
+}
+
+
+bool CRGBtoRGB48VideoFrameFormatter::FormatVideoFrame(
+	const VideoFrame& inFrame,
+	BYTE* outBuffer)
+{
+    return FormatVideoFrameSlice(inFrame, outBuffer, 0, m_height);
+}
+
+
+bool CRGBtoRGB48VideoFrameFormatter::FormatVideoFrameSlice(
+    const VideoFrame& inFrame,
+    BYTE* outBuffer,
+    uint32_t firstLine,
+    uint32_t lineCount)
+{
+    // Write RGB48LE
+    // 16 bits per component, R, G, B in that order, little-endian
+    // https://docs.microsoft.com/en-us/windows/win32/directshow/uncompressed-rgb-video-subtypes
+
+    assert(firstLine + lineCount <= m_height);
+    assert(m_lineFunc);
+
+    const uint32_t dstStride = m_width * RGB48_VALUES_PER_PIXEL;
+
+    for (uint32_t line = firstLine; line < firstLine + lineCount; line++)
+    {
+        const uint32_t* src = (const uint32_t*)((const BYTE*)inFrame.GetData() + (ptrdiff_t)line * m_bytesPerRow);
+        uint16_t* dst = (uint16_t*)outBuffer + (ptrdiff_t)line * dstStride;
+
+        m_lineFunc(src, dst, m_width);
+    }
+
+    return true;
+}
+
+
+LONG CRGBtoRGB48VideoFrameFormatter::GetOutFrameSize() const
+{
+    return m_height * m_width * RGB48_VALUES_PER_PIXEL * sizeof(uint16_t);
+}
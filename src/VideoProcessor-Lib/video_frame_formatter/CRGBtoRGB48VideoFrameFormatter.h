@@ -0,0 +1,51 @@
+/*
+ * Copyright(C) 2021 Dennis Fleurbaaij <mail@dennisfleurbaaij.com>
+ *
+ * This program is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, version 3.
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License along with this program. If not, see < https://www.gnu.org/licenses/>.
+ */
+
+
+#pragma once
+
+
+#include <SimdLevel.h>
+#include <video_frame_formatter/IVideoFrameFormatter.h>
+#include <video_frame_formatter/RGBUnpack.h>
+
+
+ /**
+  * Video frame formatter which reads 10- and 12-bit RGB (R210, R10b, R10l, R12B and R12L)
+  * and writes RGB48LE in a single pass, straight into the output buffer.
+  *
+  * Lines are written top-down, which matches a negative bitmap height.
+  */
+class CRGBtoRGB48VideoFrameFormatter:
+	public IVideoFrameFormatter
+{
+public:
+
+	// The fastest kernel the CPU supports up to maxSimdLevel will be used
+	CRGBtoRGB48VideoFrameFormatter(SimdLevel maxSimdLevel = SimdLevel::AVX512);
+	virtual ~CRGBtoRGB48VideoFrameFormatter() {}
+
+	// IVideoFrameFormatter
+	void OnVideoState(VideoStateComPtr& videoState) override;
+	bool FormatVideoFrame(const VideoFrame& inFrame, BYTE* outBuffer) override;
+	LONG GetOutFrameSize() const override;
+	uint32_t GetSliceLineAlignment() const override { return 1; }
+	bool FormatVideoFrameSlice(const VideoFrame& inFrame, BYTE* outBuffer, uint32_t firstLine, uint32_t lineCount) override;
+
+	// SIMD level in use, valid after OnVideoState()
+	SimdLevel GetSimdLevel() const { return m_simdLevel; }
+
+private:
+	const SimdLevel m_maxSimdLevel;
+	SimdLevel m_simdLevel = SimdLevel::SCALAR;
+	RGBToRGB48LineFunc m_lineFunc = nullptr;
+
+	uint32_t m_height = 0;
+	uint32_t m_width = 0;
+	uint32_t m_bytesPerRow = 0;
+};
@@ -0,0 +1,278 @@
+/*
+ * Copyright(C) 2021 Dennis Fleurbaaij <mail@dennisfleurbaaij.com>
+ *
+ * This program is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, version 3.
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License along with this program. If not, see < https://www.gnu.org/licenses/>.
+ */
+
+
+#include <pch.h>
+
+#include "CSlicedVideoFrameFormatter.h"
+
+#include <chrono>
+
+
+// Per-slice timings are logged averaged over this many frames
+#define SLICE_TIMING_LOG_FRAMES 100
+
+
+CSlicedVideoFrameFormatter::CSlicedVideoFrameFormatter(IVideoFrameFormatter* videoFrameFormatter, unsigned int sliceCount):
+	m_videoFrameFormatter(videoFrameFormatter),
+	m_sliceCount(sliceCount)
+{
+	if (!m_videoFrameFormatter)
+		throw std::runtime_error("Null video frame formatter is not allowed");
+
+	if (m_sliceCount < 1 || m_sliceCount > MAX_SLICE_COUNT)
+		throw std::runtime_error("Slice count out of range");
+
+	m_slices.resize(1);
+
+	// Slice 0 runs on the calling thread, every other slice gets a worker pinned to its own
+	// logical processor. Processor 0 is left for the caller and the rest of the system, with
+	// more workers than processors they share processors 1..n-1.
+	const unsigned int maxAffinityBits = sizeof(DWORD_PTR) * 8;
+	const unsigned int processorCount = std::min(maxAffinityBits, std::max(1U, std::thread::hardware_concurrency()));
+
+	try
+	{
+		for (unsigned int i = 1; i < m_sliceCount; ++i)
+		{
+			const unsigned int processor = (processorCount > 1) ? (1 + (i - 1) % (processorCount - 1)) : 0;
+			m_workerThreads.emplace_back(&CSlicedVideoFrameFormatter::WorkerThreadProc, this, i, ((DWORD_PTR)1) << processor);
+		}
+	}
+	catch (...)
+	{
+		StopWorkerThreads();
+		throw;
+	}
+}
+
+
+CSlicedVideoFrameFormatter::~CSlicedVideoFrameFormatter()
+{
+	StopWorkerThreads();
+}
+
+
+void CSlicedVideoFrameFormatter::OnVideoState(VideoStateComPtr& videoState)
+{
+	if (!videoState)
+		throw std::runtime_error("Null video state is not allowed");
+
+	m_videoFrameFormatter->OnVideoState(videoState);
+
+	const uint32_t height = videoState->displayMode->FrameHeight();
+	const uint32_t alignment = m_videoFrameFormatter->GetSliceLineAlignment();
+
+	// Split the frame in units of the alignment, spread as evenly as possible with the last
+	// slice also taking any unaligned remainder.
+	unsigned int sliceCount = 1;
+	uint32_t units = 0;
+	if (alignment > 0)
+	{
+		units = height / alignment;
+		sliceCount = std::max(1U, std::min(m_sliceCount, units));
+	}
+
+	std::vector<Slice> slices(sliceCount);
+	for (unsigned int i = 0; i < sliceCount; ++i)
+	{
+		if (sliceCount == 1)
+		{
+			slices[i].lineCount = height;
+			break;
+		}
+
+		const uint32_t firstUnit = (uint32_t)((uint64_t)units * i / sliceCount);
+		const uint32_t endUnit = (uint32_t)((uint64_t)units * (i + 1) / sliceCount);
+
+		slices[i].firstLine = firstUnit * alignment;
+		slices[i].lineCount = (i == sliceCount - 1) ?
+			(height - slices[i].firstLine) :
+			((endUnit - firstUnit) * alignment);
+	}
+
+	m_slices = std::move(slices);
+	m_frameCounter = 0;
+
+	DbgLog((LOG_TRACE, 1,
+		TEXT("CSlicedVideoFrameFormatter::OnVideoState(): %u lines in %u slice(s), %u requested"),
+		height, (unsigned int)m_slices.size(), m_sliceCount));
+}
+
+
+bool CSlicedVideoFrameFormatter::FormatVideoFrame(const VideoFrame& inFrame, BYTE* outBuffer)
+{
+	if (m_slices.empty() || m_slices[0].lineCount == 0)
+		throw std::runtime_error("No slices known, call OnVideoState() first");
+
+	bool result = true;
+
+	if (m_slices.size() == 1)
+	{
+		const auto start = std::chrono::steady_clock::now();
+		result = m_videoFrameFormatter->FormatVideoFrame(inFrame, outBuffer);
+		m_slices[0].durationMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+		m_slices[0].durationMsSum += m_slices[0].durationMs;
+	}
+	else
+	{
+		// Hand out the job, the workers pick up their own slice
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_jobInFrame = &inFrame;
+			m_jobOutBuffer = outBuffer;
+			m_jobSliceCount = (unsigned int)m_slices.size();
+			m_pendingSlices = m_jobSliceCount - 1;
+			++m_jobGeneration;
+		}
+		m_jobCondition.notify_all();
+
+		FormatSlice(m_slices[0], inFrame, outBuffer);
+
+		// Barrier, all slices must be done before the buffer can be delivered
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_doneCondition.wait(lock, [this] { return m_pendingSlices == 0; });
+			m_jobSliceCount = 0;
+			m_jobInFrame = nullptr;
+			m_jobOutBuffer = nullptr;
+		}
+
+		// Every slice's exception is cleared, also the ones not rethrown, so they don't fail
+		// the next frame
+		std::exception_ptr exception;
+		for (Slice& slice : m_slices)
+		{
+			if (slice.exception && !exception)
+				exception = slice.exception;
+			slice.exception = nullptr;
+
+			result &= slice.result;
+		}
+
+		if (exception)
+			std::rethrow_exception(exception);
+	}
+
+	++m_frameCounter;
+	if (m_frameCounter % SLICE_TIMING_LOG_FRAMES == 0)
+	{
+		for (size_t i = 0; i < m_slices.size(); ++i)
+		{
+			DbgLog((LOG_TRACE, 1,
+				TEXT("CSlicedVideoFrameFormatter::FormatVideoFrame(): Slice %u (%u lines) took %.3f ms on average"),
+				(unsigned int)i, m_slices[i].lineCount, m_slices[i].durationMsSum / SLICE_TIMING_LOG_FRAMES));
+
+			m_slices[i].durationMsSum = 0.0;
+		}
+	}
+
+	return result;
+}
+
+
+LONG CSlicedVideoFrameFormatter::GetOutFrameSize() const
+{
+	return m_videoFrameFormatter->GetOutFrameSize();
+}
+
+
+std::vector<double> CSlicedVideoFrameFormatter::GetSliceTimingsMs() const
+{
+	std::vector<double> timings;
+	timings.reserve(m_slices.size());
+
+	for (const Slice& slice : m_slices)
+		timings.push_back(slice.durationMs);
+
+	return timings;
+}
+
+
+void CSlicedVideoFrameFormatter::FormatSlice(Slice& slice, const VideoFrame& inFrame, BYTE* outBuffer)
+{
+	assert(outBuffer);
+
+	const auto start = std::chrono::steady_clock::now();
+
+	try
+	{
+		slice.result = m_videoFrameFormatter->FormatVideoFrameSlice(inFrame, outBuffer, slice.firstLine, slice.lineCount);
+	}
+	catch (...)
+	{
+		slice.result = false;
+		slice.exception = std::current_exception();
+	}
+
+	slice.durationMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	slice.durationMsSum += slice.durationMs;
+}
+
+
+void CSlicedVideoFrameFormatter::WorkerThreadProc(unsigned int sliceIndex, DWORD_PTR affinityMask)
+{
+	if (!SetThreadAffinityMask(GetCurrentThread(), affinityMask))
+		DbgLog((LOG_TRACE, 1, TEXT("CSlicedVideoFrameFormatter::WorkerThreadProc(): Failed to pin slice %u worker"), sliceIndex));
+
+	uint64_t seenGeneration = 0;
+
+	while (true)
+	{
+		// Everything about the job is taken under the lock, a worker which is not counted in
+		// m_pendingSlices must never touch the slices or the frame.
+		Slice* slice = nullptr;
+		const VideoFrame* inFrame = nullptr;
+		BYTE* outBuffer = nullptr;
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_jobCondition.wait(lock, [&] { return m_stop || m_jobGeneration != seenGeneration; });
+
+			if (m_stop)
+				return;
+
+			seenGeneration = m_jobGeneration;
+
+			// Workers beyond the active slice count sit this frame out
+			if (sliceIndex >= m_jobSliceCount)
+				continue;
+
+			slice = &m_slices[sliceIndex];
+			inFrame = m_jobInFrame;
+			outBuffer = m_jobOutBuffer;
+		}
+
+		assert(inFrame);
+		FormatSlice(*slice, *inFrame, outBuffer);
+
+		bool lastSlice;
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			assert(m_pendingSlices > 0);
+			lastSlice = (--m_pendingSlices == 0);
+		}
+
+		if (lastSlice)
+			m_doneCondition.notify_one();
+	}
+}
+
+
+void CSlicedVideoFrameFormatter::StopWorkerThreads()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_stop = true;
+	}
+	m_jobCondition.notify_all();
+
+	for (std::thread& workerThread : m_workerThreads)
+		workerThread.join();
+
+	m_workerThreads.clear();
+}
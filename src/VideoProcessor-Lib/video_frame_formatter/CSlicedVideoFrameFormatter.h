@@ -0,0 +1,95 @@
+/*
+ * Copyright(C) 2021 Dennis Fleurbaaij <mail@dennisfleurbaaij.com>
+ *
+ * This program is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, version 3.
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License along with this program. If not, see < https://www.gnu.org/licenses/>.
+ */
+
+
+#pragma once
+
+
+#include <condition_variable>
+#include <exception>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include <video_frame_formatter/IVideoFrameFormatter.h>
+
+
+ /**
+  * Video frame formatter which splits every frame into horizontal slices and formats them
+  * in parallel on a persistent pool of worker threads, each pinned to its own core.
+  *
+  * Slice boundaries follow the slice line alignment of the wrapped formatter (V210 lines
+  * are 48-pixel padded so any line works, P010 needs line pairs). The first slice is
+  * formatted on the calling thread and FormatVideoFrame() only returns once all slices
+  * are done, so the frame is complete before it is delivered.
+  *
+  * Formatters which cannot be sliced are passed through as-is.
+  */
+class CSlicedVideoFrameFormatter:
+	public IVideoFrameFormatter
+{
+public:
+
+	// More slices than this only adds synchronization overhead
+	static const unsigned int MAX_SLICE_COUNT = 64;
+
+	// Takes ownership of videoFrameFormatter, sliceCount includes the calling thread
+	CSlicedVideoFrameFormatter(IVideoFrameFormatter* videoFrameFormatter, unsigned int sliceCount);
+	virtual ~CSlicedVideoFrameFormatter();
+
+	// IVideoFrameFormatter
+	void OnVideoState(VideoStateComPtr& videoState) override;
+	bool FormatVideoFrame(const VideoFrame& inFrame, BYTE* outBuffer) override;
+	LONG GetOutFrameSize() const override;
+
+	// Amount of slices frames are split in, valid after OnVideoState()
+	// 1 if the wrapped formatter cannot be sliced
+	unsigned int GetActiveSliceCount() const { return (unsigned int)m_slices.size(); }
+
+	// Time each slice of the last formatted frame took, in ms
+	// Can only be called from the thread calling FormatVideoFrame()
+	std::vector<double> GetSliceTimingsMs() const;
+
+private:
+
+	struct Slice
+	{
+		uint32_t firstLine = 0;
+		uint32_t lineCount = 0;
+
+		// Written only by the thread formatting the slice, read after the barrier
+		bool result = false;
+		double durationMs = 0.0;
+		double durationMsSum = 0.0;
+		std::exception_ptr exception;
+	};
+
+	void WorkerThreadProc(unsigned int sliceIndex, DWORD_PTR affinityMask);
+	void FormatSlice(Slice& slice, const VideoFrame& inFrame, BYTE* outBuffer);
+	void StopWorkerThreads();
+
+	const std::unique_ptr<IVideoFrameFormatter> m_videoFrameFormatter;
+	const unsigned int m_sliceCount;
+
+	std::vector<Slice> m_slices;
+	std::vector<std::thread> m_workerThreads;
+
+	// Job hand-off to the workers, protected by m_mutex. Only workers with an index below
+	// m_jobSliceCount take part in a job, exactly those are counted in m_pendingSlices.
+	std::mutex m_mutex;
+	std::condition_variable m_jobCondition;
+	std::condition_variable m_doneCondition;
+	uint64_t m_jobGeneration = 0;
+	unsigned int m_jobSliceCount = 0;
+	unsigned int m_pendingSlices = 0;
+	bool m_stop = false;
+	const VideoFrame* m_jobInFrame = nullptr;
+	BYTE* m_jobOutBuffer = nullptr;
+
+	uint64_t m_frameCounter = 0;
+};
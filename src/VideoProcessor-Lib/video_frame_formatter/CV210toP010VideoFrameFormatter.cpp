@@ -10,27 +10,20 @@
 
 #include "CV210toP010VideoFrameFormatter.h"
 
-//
-// Parts of this are copied from ffmpeg v210dec.c, see /3rdparty/ffmpeg/README.txt for license and attribution
-//
-
-
-#define V210_READ_PACK_BLOCK(a, b, c) \
-    do {                              \
-        val  = *src++;                \
-        a = val & 0x3FF;              \
-        b = (val >> 10) & 0x3FF;      \
-        c = (val >> 20) & 0x3FF;      \
-    } while (0)
-
-
-#define P010_WRITE_VALUE(d, v) (*d++ = (v << 6))
+#include <algorithm>
 
 
 #define PIXELS_PER_PACK 6
 #define BYTES_PER_PACK (4 * sizeof(uint32_t))
 
 
+CV210toP010VideoFrameFormatter::CV210toP010VideoFrameFormatter(ChromaSiting chromaSiting, SimdLevel maxSimdLevel):
+    m_chromaSiting(chromaSiting),
+    m_maxSimdLevel(maxSimdLevel)
+{
+}
+
+
 void CV210toP010VideoFrameFormatter::OnVideoState(VideoStateComPtr& videoState)
 {
 	if (!videoState)
@@ -54,12 +47,29 @@ void CV210toP010VideoFrameFormatter::OnVideoState(VideoStateComPtr& videoState)
 
     if(bytes != expectedBytes)
         throw std::runtime_error("Unexpected amount of bytes for frame");
+
+    m_simdLevel = std::min(m_maxSimdLevel, CpuSimdLevel());
+    m_linePairFunc = GetV210ToP010LinePairFunc(m_simdLevel, m_chromaSiting);
+
+    DbgLog((LOG_TRACE, 1,
+        TEXT("CV210toP010VideoFrameFormatter::OnVideoState(): Using %s kernel, %s chroma siting"),
+        ToString(m_simdLevel), ToString(m_chromaSiting)));
 }
 
 
 bool CV210toP010VideoFrameFormatter::FormatVideoFrame(
 	const VideoFrame& inFrame,
 	BYTE* outBuffer)
+{
+    return FormatVideoFrameSlice(inFrame, outBuffer, 0, m_height);
+}
+
+
+bool CV210toP010VideoFrameFormatter::FormatVideoFrameSlice(
+    const VideoFrame& inFrame,
+    BYTE* outBuffer,
+    uint32_t firstLine,
+    uint32_t lineCount)
 {
 	// Read V210
 	// https://wiki.multimedia.cx/index.php/V210
@@ -68,63 +78,33 @@ bool CV210toP010VideoFrameFormatter::FormatVideoFrame(
     // Like NV12, 10bpp per component, data in the high bits, zeros in the low bits (we assume little-endian native)
 	// https://docs.microsoft.com/en-us/windows/win32/medfound/10-bit-and-16-bit-yuv-video-formats
 
+    // Slices start on a line pair as every pair shares an output chroma line. The line above
+    // the slice is only read, so neighbouring slices can run concurrently.
+    assert(firstLine % 2 == 0);
+    assert(lineCount % 2 == 0);
+    assert(firstLine + lineCount <= m_height);
+
     const uint32_t pixels = m_height * m_width;
     const uint32_t aligned_width = ((m_width + 47) / 48) * 48;
     const uint32_t stride = aligned_width * 8 / 3;
 
-    uint16_t* dstY = (uint16_t *)outBuffer;
-    uint16_t* dstUV = (uint16_t*)(outBuffer + ((ptrdiff_t)pixels * sizeof(uint16_t)));
+    uint16_t* dstY = (uint16_t *)outBuffer + (ptrdiff_t)firstLine * m_width;
+    uint16_t* dstUV = (uint16_t*)(outBuffer + ((ptrdiff_t)pixels * sizeof(uint16_t))) + (ptrdiff_t)(firstLine / 2) * m_width;
 
-    const uint32_t packsPerLine = m_width / PIXELS_PER_PACK;
+    assert(m_linePairFunc);
 
-    for (uint32_t line = 0; line < m_height; line++)
+    for (uint32_t line = firstLine; line < firstLine + lineCount; line += 2)
     {
-        const uint32_t* src = (const uint32_t*)((const BYTE *)inFrame.GetData() + (ptrdiff_t)(line * stride));  // Lines start at 128 byte alignment
-
-        for (uint32_t pack = 0; pack < packsPerLine; pack++)
-        {
-            uint32_t val;
-            uint16_t u, y1, y2, v;
-
-            if (line % 2 == 0)
-            {
-                V210_READ_PACK_BLOCK(u, y1, v);
-                P010_WRITE_VALUE(dstUV, u);
-                P010_WRITE_VALUE(dstY, y1);
-                P010_WRITE_VALUE(dstUV, v);
-
-                V210_READ_PACK_BLOCK(y1, u, y2);
-                P010_WRITE_VALUE(dstY, y1);
-                P010_WRITE_VALUE(dstUV, u);
-                P010_WRITE_VALUE(dstY, y2);
-
-                V210_READ_PACK_BLOCK(v, y1, u);
-                P010_WRITE_VALUE(dstUV, v);
-                P010_WRITE_VALUE(dstY, y1);
-                P010_WRITE_VALUE(dstUV, u);
-
-                V210_READ_PACK_BLOCK(y1, v, y2);
-                P010_WRITE_VALUE(dstY, y1);
-                P010_WRITE_VALUE(dstUV, v);
-                P010_WRITE_VALUE(dstY, y2);
-            }
-            else
-            {
-                V210_READ_PACK_BLOCK(u, y1, v);
-                P010_WRITE_VALUE(dstY, y1);
-
-                V210_READ_PACK_BLOCK(y1, u, y2);
-                P010_WRITE_VALUE(dstY, y1);
-                P010_WRITE_VALUE(dstY, y2);
-
-                V210_READ_PACK_BLOCK(v, y1, u);
-                P010_WRITE_VALUE(dstY, y1);
-
-                V210_READ_PACK_BLOCK(y1, v, y2);
-                P010_WRITE_VALUE(dstY, y1);
-                P010_WRITE_VALUE(dstY, y2);
-            }
-        }
+        const BYTE* srcTop = (const BYTE*)inFrame.GetData() + (ptrdiff_t)(line * stride);  // Lines start at 128 byte alignment
+        const BYTE* srcAbove = (line == 0) ? srcTop : srcTop - stride;  // Repeat the edge
+
+        m_linePairFunc(
+            (const uint32_t*)srcAbove, (const uint32_t*)srcTop, (const uint32_t*)(srcTop + stride),
+            dstY, dstY + m_width, dstUV,
+            m_width);
+
+        dstY += 2 * m_width;
+        dstUV += m_width;  // Every 2 pixels and every 2 lines 2 values
     }
 
 	return true;
@@ -9,26 +9,46 @@
 #pragma once
 
 
+#include <ChromaSiting.h>
+#include <SimdLevel.h>
 #include <video_frame_formatter/IVideoFrameFormatter.h>
+#include <video_frame_formatter/V210Unpack.h>
 
 
  /**
   * Video frame formatter which reads V210 and write to P010
   * (that's YUV422 to YUV420 both in 10 bit, all assuming this is running on little endian hardware)
+  *
+  * Lines are processed in pairs, the chroma of both lines is filtered vertically to the
+  * requested chroma siting.
   */
 class CV210toP010VideoFrameFormatter:
 	public IVideoFrameFormatter
 {
 public:
 
+	// The fastest kernel the CPU supports up to maxSimdLevel will be used
+	CV210toP010VideoFrameFormatter(
+		ChromaSiting chromaSiting = ChromaSiting::LEFT,
+		SimdLevel maxSimdLevel = SimdLevel::AVX512);
 	virtual ~CV210toP010VideoFrameFormatter() {}
 
 	// IVideoFrameFormatter
 	void OnVideoState(VideoStateComPtr& videoState) override;
 	bool FormatVideoFrame(const VideoFrame& inFrame, BYTE* outBuffer) override;
 	LONG GetOutFrameSize() const override;
+	uint32_t GetSliceLineAlignment() const override { return 2; }
+	bool FormatVideoFrameSlice(const VideoFrame& inFrame, BYTE* outBuffer, uint32_t firstLine, uint32_t lineCount) override;
+
+	// SIMD level in use, valid after OnVideoState()
+	SimdLevel GetSimdLevel() const { return m_simdLevel; }
 
 private:
+	const ChromaSiting m_chromaSiting;
+	const SimdLevel m_maxSimdLevel;
+	SimdLevel m_simdLevel = SimdLevel::SCALAR;
+	V210ToP010LinePairFunc m_linePairFunc = nullptr;
+
 	uint32_t m_height = 0;
 	uint32_t m_width = 0;
 };
@@ -10,27 +10,19 @@
 
 #include "CV210toP210VideoFrameFormatter.h"
 
-//
-// Parts of this are copied from ffmpeg v210dec.c, see /3rdparty/ffmpeg/README.txt for license and attribution
-//
-
-
-#define V210_READ_PACK_BLOCK(a, b, c) \
-    do {                              \
-        val  = *src++;                \
-        a = val & 0x3FF;              \
-        b = (val >> 10) & 0x3FF;      \
-        c = (val >> 20) & 0x3FF;      \
-    } while (0)
-
-
-#define P010_WRITE_VALUE(d, v) (*d++ = (v << 6))
+#include <algorithm>
 
 
 #define PIXELS_PER_PACK 6
 #define BYTES_PER_PACK (4 * sizeof(uint32_t))
 
 
+CV210toP210VideoFrameFormatter::CV210toP210VideoFrameFormatter(SimdLevel maxSimdLevel):
+    m_maxSimdLevel(maxSimdLevel)
+{
+}
+
+
 void CV210toP210VideoFrameFormatter::OnVideoState(VideoStateComPtr& videoState)
 {
 	if (!videoState)
@@ -54,12 +46,27 @@ void CV210toP210VideoFrameFormatter::OnVideoState(VideoStateComPtr& videoState)
 
     if(bytes != expectedBytes)
         throw std::runtime_error("Unexpected amount of bytes for frame");
+
+    m_simdLevel = std::min(m_maxSimdLevel, CpuSimdLevel());
+    m_lineFunc = GetV210ToP210LineFunc(m_simdLevel);
+
+    DbgLog((LOG_TRACE, 1, TEXT("CV210toP210VideoFrameFormatter::OnVideoState(): Using %s kernel"), ToString(m_simdLevel)));
 }
 
 
 bool CV210toP210VideoFrameFormatter::FormatVideoFrame(
 	const VideoFrame& inFrame,
 	BYTE* outBuffer)
+{
+    return FormatVideoFrameSlice(inFrame, outBuffer, 0, m_height);
+}
+
+
+bool CV210toP210VideoFrameFormatter::FormatVideoFrameSlice(
+    const VideoFrame& inFrame,
+    BYTE* outBuffer,
+    uint32_t firstLine,
+    uint32_t lineCount)
 {
 	// Read V210
 	// https://wiki.multimedia.cx/index.php/V210
@@ -68,44 +75,27 @@ bool CV210toP210VideoFrameFormatter::FormatVideoFrame(
     // 10bpp per component, data in the high bits, zeros in the low bits (we assume little-endian native)
 	// https://docs.microsoft.com/en-us/windows/win32/medfound/10-bit-and-16-bit-yuv-video-formats
 
+    // Every V210 line is padded to 48 pixels (128 bytes) so any line split keeps the
+    // kernels on whole packs, every line writes its own Y and UV line.
+    assert(firstLine + lineCount <= m_height);
+
     const uint32_t pixels = m_height * m_width;
     const uint32_t aligned_width = ((m_width + 47) / 48) * 48;
     const uint32_t stride = aligned_width * 8 / 3;
 
-    uint16_t* dstY = (uint16_t *)outBuffer;
-    uint16_t* dstUV = (uint16_t*)(outBuffer + ((ptrdiff_t)pixels * sizeof(uint16_t)));
+    uint16_t* dstY = (uint16_t *)outBuffer + (ptrdiff_t)firstLine * m_width;
+    uint16_t* dstUV = (uint16_t*)(outBuffer + ((ptrdiff_t)pixels * sizeof(uint16_t))) + (ptrdiff_t)firstLine * m_width;
 
-    const uint32_t packsPerLine = m_width / PIXELS_PER_PACK;
+    assert(m_lineFunc);
 
-    for (uint32_t line = 0; line < m_height; line++)
+    for (uint32_t line = firstLine; line < firstLine + lineCount; line++)
     {
         const uint32_t* src = (const uint32_t*)((const BYTE *)inFrame.GetData() + (ptrdiff_t)(line * stride));  // Lines start at 128 byte alignment
 
-        for (uint32_t pack = 0; pack < packsPerLine; pack++)
-        {
-            uint32_t val;
-            uint16_t u, y1, y2, v;
-
-            V210_READ_PACK_BLOCK(u, y1, v);
-            P010_WRITE_VALUE(dstUV, u);
-            P010_WRITE_VALUE(dstY, y1);
-            P010_WRITE_VALUE(dstUV, v);
-
-            V210_READ_PACK_BLOCK(y1, u, y2);
-            P010_WRITE_VALUE(dstY, y1);
-            P010_WRITE_VALUE(dstUV, u);
-            P010_WRITE_VALUE(dstY, y2);
-
-            V210_READ_PACK_BLOCK(v, y1, u);
-            P010_WRITE_VALUE(dstUV, v);
-            P010_WRITE_VALUE(dstY, y1);
-            P010_WRITE_VALUE(dstUV, u);
-
-            V210_READ_PACK_BLOCK(y1, v, y2);
-            P010_WRITE_VALUE(dstY, y1);
-            P010_WRITE_VALUE(dstUV, v);
-            P010_WRITE_VALUE(dstY, y2);
-        }
+        m_lineFunc(src, dstY, dstUV, m_width);
+
+        dstY += m_width;
+        dstUV += m_width;  // Every 2 pixels 2 values
     }
 
 	return true;
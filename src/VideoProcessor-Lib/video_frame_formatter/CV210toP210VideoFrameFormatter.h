@@ -9,7 +9,9 @@
 #pragma once
 
 
+#include <SimdLevel.h>
 #include <video_frame_formatter/IVideoFrameFormatter.h>
+#include <video_frame_formatter/V210Unpack.h>
 
 
  /**
@@ -21,14 +23,25 @@ class CV210toP210VideoFrameFormatter:
 {
 public:
 
+	// The fastest kernel the CPU supports up to maxSimdLevel will be used
+	CV210toP210VideoFrameFormatter(SimdLevel maxSimdLevel = SimdLevel::AVX512);
 	virtual ~CV210toP210VideoFrameFormatter() {}
 
 	// IVideoFrameFormatter
 	void OnVideoState(VideoStateComPtr& videoState) override;
 	bool FormatVideoFrame(const VideoFrame& inFrame, BYTE* outBuffer) override;
 	LONG GetOutFrameSize() const override;
+	uint32_t GetSliceLineAlignment() const override { return 1; }
+	bool FormatVideoFrameSlice(const VideoFrame& inFrame, BYTE* outBuffer, uint32_t firstLine, uint32_t lineCount) override;
+
+	// SIMD level in use, valid after OnVideoState()
+	SimdLevel GetSimdLevel() const { return m_simdLevel; }
 
 private:
+	const SimdLevel m_maxSimdLevel;
+	SimdLevel m_simdLevel = SimdLevel::SCALAR;
+	V210ToP210LineFunc m_lineFunc = nullptr;
+
 	uint32_t m_height = 0;
 	uint32_t m_width = 0;
 };
@@ -34,4 +34,19 @@ public:
 	// Get size of frame that will be put in FormatVideoFrame()'s outBuffer, in bytes
 	// Can only be called after OnVideoState()
 	virtual LONG GetOutFrameSize() const = 0;
+
+	// Slicing support, lets a frame be formatted as horizontal bands on multiple threads.
+	// Returns the amount of lines each slice must be a multiple of, 0 if not sliceable.
+	// Can only be called after OnVideoState()
+	virtual uint32_t GetSliceLineAlignment() const { return 0; }
+
+	// Format lines [firstLine, firstLine + lineCount) of the frame into the same place in
+	// outBuffer as FormatVideoFrame() would. Slices of one frame can be formatted concurrently.
+	// firstLine must be a multiple of GetSliceLineAlignment(), so must lineCount unless the
+	// slice ends at the last line of the frame.
+	// Returns true if something was converted, false if not
+	virtual bool FormatVideoFrameSlice(const VideoFrame& inFrame, BYTE* outBuffer, uint32_t firstLine, uint32_t lineCount)
+	{
+		throw std::runtime_error("Formatter does not support slicing");
+	}
 };
@@ -0,0 +1,484 @@
+/*
+ * Copyright(C) 2021 Dennis Fleurbaaij <mail@dennisfleurbaaij.com>
+ *
+ * This program is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, version 3.
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License along with this program. If not, see < https://www.gnu.org/licenses/>.
+ */
+
+
+#include <pch.h>
+
+#include <immintrin.h>
+
+#include "RGBUnpack.h"
+
+//
+// See docs/bmd_pixel_formats.pdf and the "Pixel Formats" section of "Blackmagic DeckLink SDK.pdf"
+//
+// 10-bit formats hold a pixel per 32-bit word, the bit positions of the components differ:
+//   r210: big-endian    xx RRRRRRRRRR GGGGGGGGGG BBBBBBBBBB
+//   R10b: big-endian    RRRRRRRRRR GGGGGGGGGG BBBBBBBBBB xx
+//   R10l: little-endian RRRRRRRRRR GGGGGGGGGG BBBBBBBBBB xx
+//
+// The 10-bit SIMD kernels byte swap if needed, move every component to bits 6-15 of its own
+// 32-bit word, replicate the top bits into the bottom bits and shuffle R, G and B together.
+//
+// 12-bit formats are a continuous little-endian stream of 12-bit R, G, B, R, G, ... values
+// in 36 byte blocks of 8 pixels, the first value in the lowest bits of the first word. R12B is
+// the same but with every 32-bit word big-endian, which is the DPX packed 12-bit layout.
+//
+// The 12-bit SIMD kernels work on groups of 12 bytes (3 words, 8 values) per 128-bit lane,
+// they gather every value into a 16-bit word with a single shuffle (which also does the byte
+// swap for R12B) and then only have to mask or shift and replicate the top bits.
+//
+
+
+#define EXPAND_10_TO_16(v) ((uint16_t)(((v) << 6) | ((v) >> 4)))
+#define EXPAND_12_TO_16(v) ((uint16_t)(((v) << 4) | ((v) >> 8)))
+
+
+#define RGB12_BYTES_PER_GROUP 12
+#define RGB12_UINT32_PER_GROUP 3
+#define RGB12_VALUES_PER_GROUP 8
+
+
+// Shuffle masks, -1 zeroes the byte
+#define SHUFFLE_BSWAP32     3,  2,  1,  0,  7,  6,  5,  4, 11, 10,  9,  8, 15, 14, 13, 12
+#define SHUFFLE_RG_LO       0,  1,  2,  3, -1, -1,  4,  5,  6,  7, -1, -1,  8,  9, 10, 11
+#define SHUFFLE_B_LO       -1, -1, -1, -1,  0,  1, -1, -1, -1, -1,  4,  5, -1, -1, -1, -1
+#define SHUFFLE_RG_HI      -1, -1, 12, 13, 14, 15, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1
+#define SHUFFLE_B_HI        8,  9, -1, -1, -1, -1, 12, 13, -1, -1, -1, -1, -1, -1, -1, -1
+#define SHUFFLE_RGB12_LE    0,  1,  1,  2,  3,  4,  4,  5,  6,  7,  7,  8,  9, 10, 10, 11
+#define SHUFFLE_RGB12_BE    3,  2,  2,  1,  0,  7,  7,  6,  5,  4,  4, 11, 10,  9,  9,  8
+
+
+//
+// Scalar
+//
+
+
+// Unpack the given amount of 10-bit pixels, advances all pointers
+template<bool bigEndian, int rPos, int gPos, int bPos>
+static inline void RGB10ToRGB48Pixels(const uint32_t*& src, uint16_t*& dst, uint32_t pixels)
+{
+    for (uint32_t pixel = 0; pixel < pixels; pixel++)
+    {
+        uint32_t val = *src++;
+        if (bigEndian)
+            val = _byteswap_ulong(val);
+
+        *dst++ = EXPAND_10_TO_16((val >> rPos) & 0x3FF);
+        *dst++ = EXPAND_10_TO_16((val >> gPos) & 0x3FF);
+        *dst++ = EXPAND_10_TO_16((val >> bPos) & 0x3FF);
+    }
+}
+
+
+// Unpack the given amount of 12-bit groups, advances all pointers
+template<bool bigEndian>
+static inline void RGB12ToRGB48Groups(const uint32_t*& src, uint16_t*& dst, uint32_t groups)
+{
+    for (uint32_t group = 0; group < groups; group++)
+    {
+        uint32_t words[RGB12_UINT32_PER_GROUP];
+        for (int i = 0; i < RGB12_UINT32_PER_GROUP; i++)
+            words[i] = bigEndian ? _byteswap_ulong(src[i]) : src[i];
+
+        // Every 3 bytes hold 2 values
+        const uint8_t* bytes = (const uint8_t*)words;
+        for (int i = 0; i < RGB12_BYTES_PER_GROUP; i += 3)
+        {
+            const uint16_t a = bytes[i] | ((bytes[i + 1] & 0x0F) << 8);
+            const uint16_t b = (bytes[i + 1] >> 4) | (bytes[i + 2] << 4);
+
+            *dst++ = EXPAND_12_TO_16(a);
+            *dst++ = EXPAND_12_TO_16(b);
+        }
+
+        src += RGB12_UINT32_PER_GROUP;
+    }
+}
+
+
+template<bool bigEndian, int rPos, int gPos, int bPos>
+static void RGB10ToRGB48LineScalar(const uint32_t* src, uint16_t* dst, uint32_t width)
+{
+    RGB10ToRGB48Pixels<bigEndian, rPos, gPos, bPos>(src, dst, width);
+}
+
+
+template<bool bigEndian>
+static void RGB12ToRGB48LineScalar(const uint32_t* src, uint16_t* dst, uint32_t width)
+{
+    RGB12ToRGB48Groups<bigEndian>(src, dst, width * 3 / RGB12_VALUES_PER_GROUP);
+}
+
+
+//
+// SSSE3, 8 pixels (10-bit) or 2 groups (12-bit) per iteration
+//
+
+
+// Move the 10-bit value at pos to bits 6-15 of every 32-bit word
+template<int pos>
+static inline __m128i RGB10ToBit6SSSE3(const __m128i in)
+{
+    return (pos >= 6) ?
+        _mm_srli_epi32(in, (pos >= 6) ? (pos - 6) : 0) :
+        _mm_slli_epi32(in, (pos < 6) ? (6 - pos) : 0);
+}
+
+
+// Unpack 4 pixels into 24 bytes of RGB48, the first 16 in lo and the last 8 in the low half of hi
+template<bool bigEndian, int rPos, int gPos, int bPos>
+static inline void RGB10UnpackSSSE3(__m128i in, __m128i& lo, __m128i& hi)
+{
+    const __m128i mask = _mm_set1_epi32(0x0000FFC0);
+
+    if (bigEndian)
+        in = _mm_shuffle_epi8(in, _mm_setr_epi8(SHUFFLE_BSWAP32));
+
+    __m128i r = _mm_and_si128(RGB10ToBit6SSSE3<rPos>(in), mask);
+    __m128i g = _mm_and_si128(RGB10ToBit6SSSE3<gPos>(in), mask);
+    __m128i b = _mm_and_si128(RGB10ToBit6SSSE3<bPos>(in), mask);
+
+    r = _mm_or_si128(r, _mm_srli_epi16(r, 10));
+    g = _mm_or_si128(g, _mm_srli_epi16(g, 10));
+    b = _mm_or_si128(b, _mm_srli_epi16(b, 10));
+
+    const __m128i rg = _mm_or_si128(r, _mm_slli_epi32(g, 16));
+
+    lo = _mm_or_si128(
+        _mm_shuffle_epi8(rg, _mm_setr_epi8(SHUFFLE_RG_LO)),
+        _mm_shuffle_epi8(b, _mm_setr_epi8(SHUFFLE_B_LO)));
+    hi = _mm_or_si128(
+        _mm_shuffle_epi8(rg, _mm_setr_epi8(SHUFFLE_RG_HI)),
+        _mm_shuffle_epi8(b, _mm_setr_epi8(SHUFFLE_B_HI)));
+}
+
+
+// Unpack a 12-byte group in the low bytes of in into 8 values
+template<bool bigEndian>
+static inline __m128i RGB12UnpackSSSE3(const __m128i in)
+{
+    const __m128i maskEven = _mm_set1_epi32(0x00000FFF);
+    const __m128i maskOdd = _mm_set1_epi32(0x0FFF0000);
+
+    // Even values are in the low 12 bits of their word, odd values in the high 12 bits
+    const __m128i v = _mm_shuffle_epi8(in, bigEndian ? _mm_setr_epi8(SHUFFLE_RGB12_BE) : _mm_setr_epi8(SHUFFLE_RGB12_LE));
+    const __m128i c = _mm_or_si128(_mm_and_si128(v, maskEven), _mm_and_si128(_mm_srli_epi16(v, 4), maskOdd));
+
+    return _mm_or_si128(_mm_slli_epi16(c, 4), _mm_srli_epi16(c, 8));
+}
+
+
+template<bool bigEndian, int rPos, int gPos, int bPos>
+static void RGB10ToRGB48LineSSSE3(const uint32_t* src, uint16_t* dst, uint32_t width)
+{
+    const uint32_t blocks = width / 8;
+
+    for (uint32_t block = 0; block < blocks; block++)
+    {
+        __m128i lo0, hi0, lo1, hi1;
+        RGB10UnpackSSSE3<bigEndian, rPos, gPos, bPos>(_mm_loadu_si128((const __m128i*)src), lo0, hi0);
+        RGB10UnpackSSSE3<bigEndian, rPos, gPos, bPos>(_mm_loadu_si128((const __m128i*)src + 1), lo1, hi1);
+
+        // 2x 24 bytes -> 48 bytes
+        __m128i* out = (__m128i*)dst;
+        _mm_storeu_si128(out + 0, lo0);
+        _mm_storeu_si128(out + 1, _mm_unpacklo_epi64(hi0, lo1));
+        _mm_storeu_si128(out + 2, _mm_alignr_epi8(hi1, lo1, 8));
+
+        src += 8;
+        dst += 8 * 3;
+    }
+
+    RGB10ToRGB48Pixels<bigEndian, rPos, gPos, bPos>(src, dst, width - blocks * 8);
+}
+
+
+template<bool bigEndian>
+static void RGB12ToRGB48LineSSSE3(const uint32_t* src, uint16_t* dst, uint32_t width)
+{
+    const uint32_t groups = width * 3 / RGB12_VALUES_PER_GROUP;
+    uint32_t group = 0;
+
+    // The 16 byte loads read 4 bytes past the group, stay within the line
+    for (; group + 2 <= groups; group++)
+    {
+        _mm_storeu_si128((__m128i*)dst, RGB12UnpackSSSE3<bigEndian>(_mm_loadu_si128((const __m128i*)src)));
+
+        src += RGB12_UINT32_PER_GROUP;
+        dst += RGB12_VALUES_PER_GROUP;
+    }
+
+    RGB12ToRGB48Groups<bigEndian>(src, dst, groups - group);
+}
+
+
+//
+// AVX2, 16 pixels (10-bit) or 2 groups (12-bit) per iteration
+//
+
+
+template<int pos>
+static inline __m256i RGB10ToBit6AVX2(const __m256i in)
+{
+    return (pos >= 6) ?
+        _mm256_srli_epi32(in, (pos >= 6) ? (pos - 6) : 0) :
+        _mm256_slli_epi32(in, (pos < 6) ? (6 - pos) : 0);
+}
+
+
+// Unpack 8 pixels into 48 bytes of RGB48 (3 full vectors)
+template<bool bigEndian, int rPos, int gPos, int bPos>
+static inline void RGB10UnpackStoreAVX2(__m256i in, uint16_t* dst)
+{
+    const __m256i mask = _mm256_set1_epi32(0x0000FFC0);
+
+    if (bigEndian)
+        in = _mm256_shuffle_epi8(in, _mm256_broadcastsi128_si256(_mm_setr_epi8(SHUFFLE_BSWAP32)));
+
+    __m256i r = _mm256_and_si256(RGB10ToBit6AVX2<rPos>(in), mask);
+    __m256i g = _mm256_and_si256(RGB10ToBit6AVX2<gPos>(in), mask);
+    __m256i b = _mm256_and_si256(RGB10ToBit6AVX2<bPos>(in), mask);
+
+    r = _mm256_or_si256(r, _mm256_srli_epi16(r, 10));
+    g = _mm256_or_si256(g, _mm256_srli_epi16(g, 10));
+    b = _mm256_or_si256(b, _mm256_srli_epi16(b, 10));
+
+    const __m256i rg = _mm256_or_si256(r, _mm256_slli_epi32(g, 16));
+
+    // Every lane holds 4 pixels, lo the first 16 bytes of those and hi the last 8
+    const __m256i lo = _mm256_or_si256(
+        _mm256_shuffle_epi8(rg, _mm256_broadcastsi128_si256(_mm_setr_epi8(SHUFFLE_RG_LO))),
+        _mm256_shuffle_epi8(b, _mm256_broadcastsi128_si256(_mm_setr_epi8(SHUFFLE_B_LO))));
+    const __m256i hi = _mm256_or_si256(
+        _mm256_shuffle_epi8(rg, _mm256_broadcastsi128_si256(_mm_setr_epi8(SHUFFLE_RG_HI))),
+        _mm256_shuffle_epi8(b, _mm256_broadcastsi128_si256(_mm_setr_epi8(SHUFFLE_B_HI))));
+
+    const __m128i lo0 = _mm256_castsi256_si128(lo);
+    const __m128i lo1 = _mm256_extracti128_si256(lo, 1);
+    const __m128i hi0 = _mm256_castsi256_si128(hi);
+    const __m128i hi1 = _mm256_extracti128_si256(hi, 1);
+
+    __m128i* out = (__m128i*)dst;
+    _mm_storeu_si128(out + 0, lo0);
+    _mm_storeu_si128(out + 1, _mm_unpacklo_epi64(hi0, lo1));
+    _mm_storeu_si128(out + 2, _mm_alignr_epi8(hi1, lo1, 8));
+}
+
+
+template<bool bigEndian, int rPos, int gPos, int bPos>
+static void RGB10ToRGB48LineAVX2(const uint32_t* src, uint16_t* dst, uint32_t width)
+{
+    const uint32_t blocks = width / 16;
+
+    for (uint32_t block = 0; block < blocks; block++)
+    {
+        RGB10UnpackStoreAVX2<bigEndian, rPos, gPos, bPos>(_mm256_loadu_si256((const __m256i*)src), dst);
+        RGB10UnpackStoreAVX2<bigEndian, rPos, gPos, bPos>(_mm256_loadu_si256((const __m256i*)src + 1), dst + 8 * 3);
+
+        src += 16;
+        dst += 16 * 3;
+    }
+
+    RGB10ToRGB48Pixels<bigEndian, rPos, gPos, bPos>(src, dst, width - blocks * 16);
+}
+
+
+template<bool bigEndian>
+static void RGB12ToRGB48LineAVX2(const uint32_t* src, uint16_t* dst, uint32_t width)
+{
+    const uint32_t groups = width * 3 / RGB12_VALUES_PER_GROUP;
+    uint32_t group = 0;
+
+    const __m256i shuffle = _mm256_broadcastsi128_si256(
+        bigEndian ? _mm_setr_epi8(SHUFFLE_RGB12_BE) : _mm_setr_epi8(SHUFFLE_RGB12_LE));
+    const __m256i maskEven = _mm256_set1_epi32(0x00000FFF);
+    const __m256i maskOdd = _mm256_set1_epi32(0x0FFF0000);
+
+    // A group per lane, the second 16 byte load reads 4 bytes past the second group, stay within the line
+    for (; group + 3 <= groups; group += 2)
+    {
+        const __m256i in = _mm256_inserti128_si256(
+            _mm256_castsi128_si256(_mm_loadu_si128((const __m128i*)src)),
+            _mm_loadu_si128((const __m128i*)(src + RGB12_UINT32_PER_GROUP)),
+            1);
+
+        const __m256i v = _mm256_shuffle_epi8(in, shuffle);
+        const __m256i c = _mm256_or_si256(_mm256_and_si256(v, maskEven), _mm256_and_si256(_mm256_srli_epi16(v, 4), maskOdd));
+
+        _mm256_storeu_si256((__m256i*)dst, _mm256_or_si256(_mm256_slli_epi16(c, 4), _mm256_srli_epi16(c, 8)));
+
+        src += 2 * RGB12_UINT32_PER_GROUP;
+        dst += 2 * RGB12_VALUES_PER_GROUP;
+    }
+
+    RGB12ToRGB48Groups<bigEndian>(src, dst, groups - group);
+}
+
+
+//
+// AVX-512 (F + BW), 16 pixels (10-bit) or 4 groups (12-bit) per iteration
+//
+
+
+// Word indices to interleave 16 pixels of RG (32-bit words) and B (low half of 32-bit words,
+// 32+ selects from B) into RGB48, the first 32 output words and then the last 16.
+alignas(64) static const uint16_t RGB10_PERMUTE_AVX512[2][32] = {
+    {  0,  1, 32,  2,  3, 34,  4,  5, 36,  6,  7, 38,  8,  9, 40, 10, 11, 42, 12, 13, 44, 14, 15, 46, 16, 17, 48, 18, 19, 50, 20, 21 },
+    { 52, 22, 23, 54, 24, 25, 56, 26, 27, 58, 28, 29, 60, 30, 31, 62,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0 }
+};
+
+
+template<int pos>
+static inline __m512i RGB10ToBit6AVX512(const __m512i in)
+{
+    return (pos >= 6) ?
+        _mm512_srli_epi32(in, (pos >= 6) ? (pos - 6) : 0) :
+        _mm512_slli_epi32(in, (pos < 6) ? (6 - pos) : 0);
+}
+
+
+template<bool bigEndian, int rPos, int gPos, int bPos>
+static void RGB10ToRGB48LineAVX512(const uint32_t* src, uint16_t* dst, uint32_t width)
+{
+    const __m512i mask = _mm512_set1_epi32(0x0000FFC0);
+    const __m512i permute0 = _mm512_load_si512(RGB10_PERMUTE_AVX512[0]);
+    const __m512i permute1 = _mm512_load_si512(RGB10_PERMUTE_AVX512[1]);
+
+    const uint32_t blocks = width / 16;
+
+    for (uint32_t block = 0; block < blocks; block++)
+    {
+        __m512i in = _mm512_loadu_si512(src);
+
+        if (bigEndian)
+            in = _mm512_shuffle_epi8(in, _mm512_broadcast_i32x4(_mm_setr_epi8(SHUFFLE_BSWAP32)));
+
+        __m512i r = _mm512_and_si512(RGB10ToBit6AVX512<rPos>(in), mask);
+        __m512i g = _mm512_and_si512(RGB10ToBit6AVX512<gPos>(in), mask);
+        __m512i b = _mm512_and_si512(RGB10ToBit6AVX512<bPos>(in), mask);
+
+        r = _mm512_or_si512(r, _mm512_srli_epi16(r, 10));
+        g = _mm512_or_si512(g, _mm512_srli_epi16(g, 10));
+        b = _mm512_or_si512(b, _mm512_srli_epi16(b, 10));
+
+        const __m512i rg = _mm512_or_si512(r, _mm512_slli_epi32(g, 16));
+
+        // 16 pixels -> 64 + 32 bytes
+        _mm512_storeu_si512(dst, _mm512_permutex2var_epi16(rg, permute0, b));
+        _mm256_storeu_si256((__m256i*)(dst + 32), _mm512_castsi512_si256(_mm512_permutex2var_epi16(rg, permute1, b)));
+
+        src += 16;
+        dst += 16 * 3;
+    }
+
+    RGB10ToRGB48Pixels<bigEndian, rPos, gPos, bPos>(src, dst, width - blocks * 16);
+}
+
+
+template<bool bigEndian>
+static void RGB12ToRGB48LineAVX512(const uint32_t* src, uint16_t* dst, uint32_t width)
+{
+    const uint32_t groups = width * 3 / RGB12_VALUES_PER_GROUP;
+    uint32_t group = 0;
+
+    // Group n (words 3n to 3n+2) to lane n
+    const __m512i spread = _mm512_setr_epi32(0, 1, 2, 2, 3, 4, 5, 5, 6, 7, 8, 8, 9, 10, 11, 11);
+    const __m512i shuffle = _mm512_broadcast_i32x4(
+        bigEndian ? _mm_setr_epi8(SHUFFLE_RGB12_BE) : _mm_setr_epi8(SHUFFLE_RGB12_LE));
+    const __m512i maskEven = _mm512_set1_epi32(0x00000FFF);
+    const __m512i maskOdd = _mm512_set1_epi32(0x0FFF0000);
+
+    for (; group + 4 <= groups; group += 4)
+    {
+        // Masked load of exactly 4 groups (12 words), never reads past the line
+        const __m512i in = _mm512_permutexvar_epi32(spread, _mm512_maskz_loadu_epi32(0x0FFF, src));
+
+        const __m512i v = _mm512_shuffle_epi8(in, shuffle);
+        const __m512i c = _mm512_or_si512(_mm512_and_si512(v, maskEven), _mm512_and_si512(_mm512_srli_epi16(v, 4), maskOdd));
+
+        _mm512_storeu_si512(dst, _mm512_or_si512(_mm512_slli_epi16(c, 4), _mm512_srli_epi16(c, 8)));
+
+        src += 4 * RGB12_UINT32_PER_GROUP;
+        dst += 4 * RGB12_VALUES_PER_GROUP;
+    }
+
+    RGB12ToRGB48Groups<bigEndian>(src, dst, groups - group);
+}
+
+
+//
+// Dispatch
+//
+
+
+template<bool bigEndian, int rPos, int gPos, int bPos>
+static RGBToRGB48LineFunc GetRGB10ToRGB48LineFunc(SimdLevel simdLevel)
+{
+    switch (simdLevel)
+    {
+    case SimdLevel::SCALAR:
+        return RGB10ToRGB48LineScalar<bigEndian, rPos, gPos, bPos>;
+
+    case SimdLevel::SSSE3:
+        return RGB10ToRGB48LineSSSE3<bigEndian, rPos, gPos, bPos>;
+
+    case SimdLevel::AVX2:
+        return RGB10ToRGB48LineAVX2<bigEndian, rPos, gPos, bPos>;
+
+    case SimdLevel::AVX512:
+        return RGB10ToRGB48LineAVX512<bigEndian, rPos, gPos, bPos>;
+    }
+
+    throw std::runtime_error("GetRGBToRGB48LineFunc() failed, SIMD level not recognized");
+}
+
+
+template<bool bigEndian>
+static RGBToRGB48LineFunc GetRGB12ToRGB48LineFunc(SimdLevel simdLevel)
+{
+    switch (simdLevel)
+    {
+    case SimdLevel::SCALAR:
+        return RGB12ToRGB48LineScalar<bigEndian>;
+
+    case SimdLevel::SSSE3:
+        return RGB12ToRGB48LineSSSE3<bigEndian>;
+
+    case SimdLevel::AVX2:
+        return RGB12ToRGB48LineAVX2<bigEndian>;
+
+    case SimdLevel::AVX512:
+        return RGB12ToRGB48LineAVX512<bigEndian>;
+    }
+
+    throw std::runtime_error("GetRGBToRGB48LineFunc() failed, SIMD level not recognized");
+}
+
+
+RGBToRGB48LineFunc GetRGBToRGB48LineFunc(SimdLevel simdLevel, VideoFrameEncoding videoFrameEncoding)
+{
+    switch (videoFrameEncoding)
+    {
+    case VideoFrameEncoding::R210:
+        return GetRGB10ToRGB48LineFunc<true, 20, 10, 0>(simdLevel);
+
+    case VideoFrameEncoding::R10b:
+        return GetRGB10ToRGB48LineFunc<true, 22, 12, 2>(simdLevel);
+
+    case VideoFrameEncoding::R10l:
+        return GetRGB10ToRGB48LineFunc<false, 22, 12, 2>(simdLevel);
+
+    case VideoFrameEncoding::R12B:
+        return GetRGB12ToRGB48LineFunc<true>(simdLevel);
+
+    case VideoFrameEncoding::R12L:
+        return GetRGB12ToRGB48LineFunc<false>(simdLevel);
+    }
+
+    throw std::runtime_error("GetRGBToRGB48LineFunc() failed, video frame encoding not supported");
+}
@@ -0,0 +1,27 @@
+/*
+ * Copyright(C) 2021 Dennis Fleurbaaij <mail@dennisfleurbaaij.com>
+ *
+ * This program is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, version 3.
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License along with this program. If not, see < https://www.gnu.org/licenses/>.
+ */
+
+
+#pragma once
+
+
+#include <SimdLevel.h>
+#include <VideoFrameEncoding.h>
+
+
+// Unpack a single line of 10- or 12-bit DeckLink RGB into RGB48LE, that is 16-bit R, G and B
+// values per pixel. Values are scaled to the full 16-bit range by bit replication.
+// - R210, R10b and R10l hold one 32-bit word per pixel, any width is allowed
+// - R12B and R12L hold 8 pixels per 36 bytes, width must be a multiple of 8
+// - dst receives 3 * width values
+typedef void (*RGBToRGB48LineFunc)(const uint32_t* src, uint16_t* dst, uint32_t width);
+
+
+// Get the fastest line unpacker for the given encoding which does not exceed the given SIMD level.
+// All implementations produce bit-identical output.
+RGBToRGB48LineFunc GetRGBToRGB48LineFunc(SimdLevel simdLevel, VideoFrameEncoding videoFrameEncoding);
@@ -0,0 +1,39 @@
+/*
+ * Copyright(C) 2021 Dennis Fleurbaaij <mail@dennisfleurbaaij.com>
+ *
+ * This program is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, version 3.
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License along with this program. If not, see < https://www.gnu.org/licenses/>.
+ */
+
+
+#pragma once
+
+
+#include <SimdLevel.h>
+
+
+// Copy size bytes using non-temporal (cache bypassing) stores where the SIMD level allows it,
+// meant for destinations which are written once and not read back by the CPU such as
+// DirectShow samples. The non-temporal stores are only globally visible after
+// StreamingCopyFence(), call it before handing the destination to another thread.
+typedef void (*StreamingCopyFunc)(BYTE* dst, const BYTE* src, size_t size);
+
+
+// Get the fastest copy function which does not exceed the given SIMD level.
+// SCALAR is a plain memcpy.
+StreamingCopyFunc GetStreamingCopyFunc(SimdLevel simdLevel);
+
+
+// Order all previous non-temporal stores of this thread before any later stores
+void StreamingCopyFence();
+
+
+// Copy rowCount rows of rowBytes between buffers with possibly different strides, rows which
+// are contiguous in both buffers are copied in a single run and small copies fall back to
+// memcpy. Ends with StreamingCopyFence().
+void StreamingCopyRows(
+	StreamingCopyFunc copyFunc,
+	BYTE* dst, size_t dstStride,
+	const BYTE* src, size_t srcStride,
+	size_t rowBytes, uint32_t rowCount);
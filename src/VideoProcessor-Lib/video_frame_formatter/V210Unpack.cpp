@@ -0,0 +1,574 @@
+/*
+ * Copyright(C) 2021 Dennis Fleurbaaij <mail@dennisfleurbaaij.com>
+ *
+ * This program is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, version 3.
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License along with this program. If not, see < https://www.gnu.org/licenses/>.
+ */
+
+#include <pch.h>
+
+#include <immintrin.h>
+
+#include "V210Unpack.h"
+
+//
+// Parts of this are copied from ffmpeg v210dec.c, see /3rdparty/ffmpeg/README.txt for license and attribution
+//
+// A V210 pack is 4 little-endian 32-bit words holding 3 10-bit values each (bits 0-9, 10-19, 20-29)
+// for 6 pixels:
+//   word 0: U0 Y0 V0
+//   word 1: Y1 U2 Y2
+//   word 2: V2 Y3 U4
+//   word 3: Y4 V4 Y5
+//
+// The SIMD kernels all work the same way on each 128-bit lane (one pack):
+//   1. Build a vector of 16-bit words with the first two values of every 32-bit word:
+//      [a0 b0 a1 b1 a2 b2 a3 b3], and one with the third value: [c0 - c1 - c2 - c3 -]
+//   2. Shuffle these into 6 Y values [b0 a1 c1 b2 a3 c3] and 6 UV values [a0 c0 b1 a2 c2 b3]
+//      in the low 12 bytes of the lane, the high 4 bytes are zero.
+//   3. Optionally filter the UV values vertically, they are still in the low bits here.
+//   4. Shift to the high bits, stitch the 12 byte lanes together into full vectors and store.
+//
+
+
+#define V210_READ_PACK_BLOCK(a, b, c) \
+    do {                              \
+        val  = *src++;                \
+        a = val & 0x3FF;              \
+        b = (val >> 10) & 0x3FF;      \
+        c = (val >> 20) & 0x3FF;      \
+    } while (0)
+
+
+#define P010_WRITE_VALUE(d, v) (*d++ = (v << 6))
+
+
+#define PIXELS_PER_PACK 6
+#define UINT32_PER_PACK 4
+
+
+// Shuffle masks, -1 zeroes the byte
+#define SHUFFLE_Y_AB   2,  3,  4,  5, -1, -1, 10, 11, 12, 13, -1, -1, -1, -1, -1, -1
+#define SHUFFLE_Y_C   -1, -1, -1, -1,  4,  5, -1, -1, -1, -1, 12, 13, -1, -1, -1, -1
+#define SHUFFLE_UV_AB  0,  1, -1, -1,  6,  7,  8,  9, -1, -1, 14, 15, -1, -1, -1, -1
+#define SHUFFLE_UV_C  -1, -1,  0,  1, -1, -1, -1, -1,  8,  9, -1, -1, -1, -1, -1, -1
+
+
+//
+// Scalar
+//
+
+
+// Unpack the given amount of packs, advances all pointers
+static inline void V210ToP210Packs(const uint32_t*& src, uint16_t*& dstY, uint16_t*& dstUV, uint32_t packs)
+{
+    for (uint32_t pack = 0; pack < packs; pack++)
+    {
+        uint32_t val;
+        uint16_t u, y1, y2, v;
+
+        V210_READ_PACK_BLOCK(u, y1, v);
+        P010_WRITE_VALUE(dstUV, u);
+        P010_WRITE_VALUE(dstY, y1);
+        P010_WRITE_VALUE(dstUV, v);
+
+        V210_READ_PACK_BLOCK(y1, u, y2);
+        P010_WRITE_VALUE(dstY, y1);
+        P010_WRITE_VALUE(dstUV, u);
+        P010_WRITE_VALUE(dstY, y2);
+
+        V210_READ_PACK_BLOCK(v, y1, u);
+        P010_WRITE_VALUE(dstUV, v);
+        P010_WRITE_VALUE(dstY, y1);
+        P010_WRITE_VALUE(dstUV, u);
+
+        V210_READ_PACK_BLOCK(y1, v, y2);
+        P010_WRITE_VALUE(dstY, y1);
+        P010_WRITE_VALUE(dstUV, v);
+        P010_WRITE_VALUE(dstY, y2);
+    }
+}
+
+
+// Read a single pack into 10-bit values in output order, advances src
+static inline void V210ReadPack(const uint32_t*& src, uint16_t y[PIXELS_PER_PACK], uint16_t uv[PIXELS_PER_PACK])
+{
+    uint32_t val;
+
+    V210_READ_PACK_BLOCK(uv[0], y[0], uv[1]);
+    V210_READ_PACK_BLOCK(y[1], uv[2], y[2]);
+    V210_READ_PACK_BLOCK(uv[3], y[3], uv[4]);
+    V210_READ_PACK_BLOCK(y[4], uv[5], y[5]);
+}
+
+
+// Unpack the given amount of packs of a line pair, advances all pointers
+template<ChromaSiting chromaSiting>
+static inline void V210ToP010PairPacks(
+    const uint32_t*& srcAbove, const uint32_t*& srcTop, const uint32_t*& srcBottom,
+    uint16_t*& dstYTop, uint16_t*& dstYBottom, uint16_t*& dstUV,
+    uint32_t packs)
+{
+    for (uint32_t pack = 0; pack < packs; pack++)
+    {
+        uint16_t yTop[PIXELS_PER_PACK], uvTop[PIXELS_PER_PACK];
+        uint16_t yBottom[PIXELS_PER_PACK], uvBottom[PIXELS_PER_PACK];
+
+        V210ReadPack(srcTop, yTop, uvTop);
+        V210ReadPack(srcBottom, yBottom, uvBottom);
+
+        for (int i = 0; i < PIXELS_PER_PACK; i++)
+        {
+            P010_WRITE_VALUE(dstYTop, yTop[i]);
+            P010_WRITE_VALUE(dstYBottom, yBottom[i]);
+        }
+
+        if (chromaSiting == ChromaSiting::TOP_LEFT)
+        {
+            uint16_t yAbove[PIXELS_PER_PACK], uvAbove[PIXELS_PER_PACK];
+            V210ReadPack(srcAbove, yAbove, uvAbove);
+
+            // [1 2 1] / 4 centered on the top line
+            for (int i = 0; i < PIXELS_PER_PACK; i++)
+                P010_WRITE_VALUE(dstUV, (uint16_t)((uvAbove[i] + 2 * uvTop[i] + uvBottom[i] + 2) >> 2));
+        }
+        else
+        {
+            // [1 1] / 2, halfway between the lines
+            for (int i = 0; i < PIXELS_PER_PACK; i++)
+                P010_WRITE_VALUE(dstUV, (uint16_t)((uvTop[i] + uvBottom[i] + 1) >> 1));
+        }
+    }
+}
+
+
+static void V210ToP210LineScalar(const uint32_t* src, uint16_t* dstY, uint16_t* dstUV, uint32_t width)
+{
+    V210ToP210Packs(src, dstY, dstUV, width / PIXELS_PER_PACK);
+}
+
+
+template<ChromaSiting chromaSiting>
+static void V210ToP010LinePairScalar(
+    const uint32_t* srcAbove, const uint32_t* srcTop, const uint32_t* srcBottom,
+    uint16_t* dstYTop, uint16_t* dstYBottom, uint16_t* dstUV,
+    uint32_t width)
+{
+    V210ToP010PairPacks<chromaSiting>(srcAbove, srcTop, srcBottom, dstYTop, dstYBottom, dstUV, width / PIXELS_PER_PACK);
+}
+
+
+//
+// SSSE3, 4 packs (24 pixels) per iteration
+//
+
+
+// Unpack a single pack into Y and UV in the low 12 bytes, both still in the low bits
+static inline void V210UnpackSSSE3(const __m128i in, __m128i& y, __m128i& uv)
+{
+    const __m128i maskA = _mm_set1_epi32(0x000003FF);
+    const __m128i maskB = _mm_set1_epi32(0x03FF0000);
+
+    // (v << 6) puts b in the high word, (v >> 20) puts c in the low word
+    const __m128i ab = _mm_or_si128(_mm_and_si128(in, maskA), _mm_and_si128(_mm_slli_epi32(in, 6), maskB));
+    const __m128i c = _mm_and_si128(_mm_srli_epi32(in, 20), maskA);
+
+    y = _mm_or_si128(
+        _mm_shuffle_epi8(ab, _mm_setr_epi8(SHUFFLE_Y_AB)),
+        _mm_shuffle_epi8(c, _mm_setr_epi8(SHUFFLE_Y_C)));
+    uv = _mm_or_si128(
+        _mm_shuffle_epi8(ab, _mm_setr_epi8(SHUFFLE_UV_AB)),
+        _mm_shuffle_epi8(c, _mm_setr_epi8(SHUFFLE_UV_C)));
+}
+
+
+// Shift 4 packs worth of values to the high bits and store them as 3 full vectors
+static inline void V210StoreSSSE3(uint16_t* dst, const __m128i v[4])
+{
+    const __m128i v0 = _mm_slli_epi16(v[0], 6);
+    const __m128i v1 = _mm_slli_epi16(v[1], 6);
+    const __m128i v2 = _mm_slli_epi16(v[2], 6);
+    const __m128i v3 = _mm_slli_epi16(v[3], 6);
+
+    __m128i* out = (__m128i*)dst;
+    _mm_storeu_si128(out + 0, _mm_or_si128(v0, _mm_slli_si128(v1, 12)));
+    _mm_storeu_si128(out + 1, _mm_or_si128(_mm_srli_si128(v1, 4), _mm_slli_si128(v2, 8)));
+    _mm_storeu_si128(out + 2, _mm_or_si128(_mm_srli_si128(v2, 8), _mm_slli_si128(v3, 4)));
+}
+
+
+static void V210ToP210LineSSSE3(const uint32_t* src, uint16_t* dstY, uint16_t* dstUV, uint32_t width)
+{
+    const uint32_t packs = width / PIXELS_PER_PACK;
+    const uint32_t blocks = packs / 4;
+
+    for (uint32_t block = 0; block < blocks; block++)
+    {
+        __m128i y[4], uv[4];
+
+        for (int i = 0; i < 4; i++)
+            V210UnpackSSSE3(_mm_loadu_si128((const __m128i*)src + i), y[i], uv[i]);
+
+        V210StoreSSSE3(dstY, y);
+        V210StoreSSSE3(dstUV, uv);
+
+        src += 4 * UINT32_PER_PACK;
+        dstY += 4 * PIXELS_PER_PACK;
+        dstUV += 4 * PIXELS_PER_PACK;
+    }
+
+    V210ToP210Packs(src, dstY, dstUV, packs - blocks * 4);
+}
+
+
+template<ChromaSiting chromaSiting>
+static void V210ToP010LinePairSSSE3(
+    const uint32_t* srcAbove, const uint32_t* srcTop, const uint32_t* srcBottom,
+    uint16_t* dstYTop, uint16_t* dstYBottom, uint16_t* dstUV,
+    uint32_t width)
+{
+    const __m128i two = _mm_set1_epi16(2);
+
+    const uint32_t packs = width / PIXELS_PER_PACK;
+    const uint32_t blocks = packs / 4;
+
+    for (uint32_t block = 0; block < blocks; block++)
+    {
+        __m128i yTop[4], yBottom[4], uv[4];
+
+        for (int i = 0; i < 4; i++)
+        {
+            __m128i uvTop, uvBottom;
+            V210UnpackSSSE3(_mm_loadu_si128((const __m128i*)srcTop + i), yTop[i], uvTop);
+            V210UnpackSSSE3(_mm_loadu_si128((const __m128i*)srcBottom + i), yBottom[i], uvBottom);
+
+            if (chromaSiting == ChromaSiting::TOP_LEFT)
+            {
+                __m128i yAbove, uvAbove;
+                V210UnpackSSSE3(_mm_loadu_si128((const __m128i*)srcAbove + i), yAbove, uvAbove);
+
+                const __m128i sum = _mm_add_epi16(
+                    _mm_add_epi16(uvAbove, uvBottom),
+                    _mm_add_epi16(_mm_add_epi16(uvTop, uvTop), two));
+                uv[i] = _mm_srli_epi16(sum, 2);
+            }
+            else
+            {
+                uv[i] = _mm_avg_epu16(uvTop, uvBottom);
+            }
+        }
+
+        V210StoreSSSE3(dstYTop, yTop);
+        V210StoreSSSE3(dstYBottom, yBottom);
+        V210StoreSSSE3(dstUV, uv);
+
+        srcAbove += 4 * UINT32_PER_PACK;
+        srcTop += 4 * UINT32_PER_PACK;
+        srcBottom += 4 * UINT32_PER_PACK;
+        dstYTop += 4 * PIXELS_PER_PACK;
+        dstYBottom += 4 * PIXELS_PER_PACK;
+        dstUV += 4 * PIXELS_PER_PACK;
+    }
+
+    V210ToP010PairPacks<chromaSiting>(srcAbove, srcTop, srcBottom, dstYTop, dstYBottom, dstUV, packs - blocks * 4);
+}
+
+
+//
+// AVX2, 8 packs (48 pixels, 128 bytes) per iteration
+//
+
+
+static inline void V210UnpackAVX2(const __m256i in, __m256i& y, __m256i& uv)
+{
+    const __m256i maskA = _mm256_set1_epi32(0x000003FF);
+    const __m256i maskB = _mm256_set1_epi32(0x03FF0000);
+
+    const __m256i ab = _mm256_or_si256(_mm256_and_si256(in, maskA), _mm256_and_si256(_mm256_slli_epi32(in, 6), maskB));
+    const __m256i c = _mm256_and_si256(_mm256_srli_epi32(in, 20), maskA);
+
+    y = _mm256_or_si256(
+        _mm256_shuffle_epi8(ab, _mm256_setr_epi8(SHUFFLE_Y_AB, SHUFFLE_Y_AB)),
+        _mm256_shuffle_epi8(c, _mm256_setr_epi8(SHUFFLE_Y_C, SHUFFLE_Y_C)));
+    uv = _mm256_or_si256(
+        _mm256_shuffle_epi8(ab, _mm256_setr_epi8(SHUFFLE_UV_AB, SHUFFLE_UV_AB)),
+        _mm256_shuffle_epi8(c, _mm256_setr_epi8(SHUFFLE_UV_C, SHUFFLE_UV_C)));
+}
+
+
+static inline void V210StoreAVX2(uint16_t* dst, const __m256i v[4])
+{
+    // Every input vector holds 6 valid 32-bit words at 0,1,2 and 4,5,6, these permutes
+    // move them together such that a single blend per output stitches 2 inputs.
+    const __m256i permute0 = _mm256_setr_epi32(0, 1, 2, 4, 5, 6, 0, 1);
+    const __m256i permute1 = _mm256_setr_epi32(2, 4, 5, 6, 0, 1, 2, 4);
+    const __m256i permute2 = _mm256_setr_epi32(5, 6, 0, 1, 2, 4, 5, 6);
+
+    const __m256i v0 = _mm256_slli_epi16(v[0], 6);
+    const __m256i v1 = _mm256_slli_epi16(v[1], 6);
+    const __m256i v2 = _mm256_slli_epi16(v[2], 6);
+    const __m256i v3 = _mm256_slli_epi16(v[3], 6);
+
+    __m256i* out = (__m256i*)dst;
+    _mm256_storeu_si256(out + 0, _mm256_blend_epi32(
+        _mm256_permutevar8x32_epi32(v0, permute0), _mm256_permutevar8x32_epi32(v1, permute0), 0xC0));
+    _mm256_storeu_si256(out + 1, _mm256_blend_epi32(
+        _mm256_permutevar8x32_epi32(v1, permute1), _mm256_permutevar8x32_epi32(v2, permute1), 0xF0));
+    _mm256_storeu_si256(out + 2, _mm256_blend_epi32(
+        _mm256_permutevar8x32_epi32(v2, permute2), _mm256_permutevar8x32_epi32(v3, permute2), 0xFC));
+}
+
+
+static void V210ToP210LineAVX2(const uint32_t* src, uint16_t* dstY, uint16_t* dstUV, uint32_t width)
+{
+    const uint32_t packs = width / PIXELS_PER_PACK;
+    const uint32_t blocks = packs / 8;
+
+    for (uint32_t block = 0; block < blocks; block++)
+    {
+        __m256i y[4], uv[4];
+
+        for (int i = 0; i < 4; i++)
+            V210UnpackAVX2(_mm256_loadu_si256((const __m256i*)src + i), y[i], uv[i]);
+
+        V210StoreAVX2(dstY, y);
+        V210StoreAVX2(dstUV, uv);
+
+        src += 8 * UINT32_PER_PACK;
+        dstY += 8 * PIXELS_PER_PACK;
+        dstUV += 8 * PIXELS_PER_PACK;
+    }
+
+    V210ToP210Packs(src, dstY, dstUV, packs - blocks * 8);
+}
+
+
+template<ChromaSiting chromaSiting>
+static void V210ToP010LinePairAVX2(
+    const uint32_t* srcAbove, const uint32_t* srcTop, const uint32_t* srcBottom,
+    uint16_t* dstYTop, uint16_t* dstYBottom, uint16_t* dstUV,
+    uint32_t width)
+{
+    const __m256i two = _mm256_set1_epi16(2);
+
+    const uint32_t packs = width / PIXELS_PER_PACK;
+    const uint32_t blocks = packs / 8;
+
+    for (uint32_t block = 0; block < blocks; block++)
+    {
+        __m256i yTop[4], yBottom[4], uv[4];
+
+        for (int i = 0; i < 4; i++)
+        {
+            __m256i uvTop, uvBottom;
+            V210UnpackAVX2(_mm256_loadu_si256((const __m256i*)srcTop + i), yTop[i], uvTop);
+            V210UnpackAVX2(_mm256_loadu_si256((const __m256i*)srcBottom + i), yBottom[i], uvBottom);
+
+            if (chromaSiting == ChromaSiting::TOP_LEFT)
+            {
+                __m256i yAbove, uvAbove;
+                V210UnpackAVX2(_mm256_loadu_si256((const __m256i*)srcAbove + i), yAbove, uvAbove);
+
+                const __m256i sum = _mm256_add_epi16(
+                    _mm256_add_epi16(uvAbove, uvBottom),
+                    _mm256_add_epi16(_mm256_add_epi16(uvTop, uvTop), two));
+                uv[i] = _mm256_srli_epi16(sum, 2);
+            }
+            else
+            {
+                uv[i] = _mm256_avg_epu16(uvTop, uvBottom);
+            }
+        }
+
+        V210StoreAVX2(dstYTop, yTop);
+        V210StoreAVX2(dstYBottom, yBottom);
+        V210StoreAVX2(dstUV, uv);
+
+        srcAbove += 8 * UINT32_PER_PACK;
+        srcTop += 8 * UINT32_PER_PACK;
+        srcBottom += 8 * UINT32_PER_PACK;
+        dstYTop += 8 * PIXELS_PER_PACK;
+        dstYBottom += 8 * PIXELS_PER_PACK;
+        dstUV += 8 * PIXELS_PER_PACK;
+    }
+
+    V210ToP010PairPacks<chromaSiting>(srcAbove, srcTop, srcBottom, dstYTop, dstYBottom, dstUV, packs - blocks * 8);
+}
+
+
+//
+// AVX-512 (F + BW), 8 packs (48 pixels, 128 bytes) per iteration
+//
+
+
+static inline void V210UnpackAVX512(const __m512i in, __m512i& y, __m512i& uv)
+{
+    const __m512i maskA = _mm512_set1_epi32(0x000003FF);
+    const __m512i maskB = _mm512_set1_epi32(0x03FF0000);
+
+    const __m512i ab = _mm512_or_si512(_mm512_and_si512(in, maskA), _mm512_and_si512(_mm512_slli_epi32(in, 6), maskB));
+    const __m512i c = _mm512_and_si512(_mm512_srli_epi32(in, 20), maskA);
+
+    y = _mm512_or_si512(
+        _mm512_shuffle_epi8(ab, _mm512_broadcast_i32x4(_mm_setr_epi8(SHUFFLE_Y_AB))),
+        _mm512_shuffle_epi8(c, _mm512_broadcast_i32x4(_mm_setr_epi8(SHUFFLE_Y_C))));
+    uv = _mm512_or_si512(
+        _mm512_shuffle_epi8(ab, _mm512_broadcast_i32x4(_mm_setr_epi8(SHUFFLE_UV_AB))),
+        _mm512_shuffle_epi8(c, _mm512_broadcast_i32x4(_mm_setr_epi8(SHUFFLE_UV_C))));
+}
+
+
+static inline void V210StoreAVX512(uint16_t* dst, const __m512i v[2])
+{
+    // Valid 32-bit words are 0,1,2 of every lane, 16+ selects from the second input
+    const __m512i permute0 = _mm512_setr_epi32(0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, 16, 17, 18, 20);
+    const __m512i permute1 = _mm512_setr_epi32(5, 6, 8, 9, 10, 12, 13, 14, 0, 0, 0, 0, 0, 0, 0, 0);
+
+    const __m512i v0 = _mm512_slli_epi16(v[0], 6);
+    const __m512i v1 = _mm512_slli_epi16(v[1], 6);
+
+    // 2x 4x 12 bytes -> 64 + 32 bytes
+    _mm512_storeu_si512(dst, _mm512_permutex2var_epi32(v0, permute0, v1));
+    _mm256_storeu_si256((__m256i*)(dst + 32), _mm512_castsi512_si256(_mm512_permutexvar_epi32(permute1, v1)));
+}
+
+
+static void V210ToP210LineAVX512(const uint32_t* src, uint16_t* dstY, uint16_t* dstUV, uint32_t width)
+{
+    const uint32_t packs = width / PIXELS_PER_PACK;
+    const uint32_t blocks = packs / 8;
+
+    for (uint32_t block = 0; block < blocks; block++)
+    {
+        __m512i y[2], uv[2];
+
+        for (int i = 0; i < 2; i++)
+            V210UnpackAVX512(_mm512_loadu_si512((const __m512i*)src + i), y[i], uv[i]);
+
+        V210StoreAVX512(dstY, y);
+        V210StoreAVX512(dstUV, uv);
+
+        src += 8 * UINT32_PER_PACK;
+        dstY += 8 * PIXELS_PER_PACK;
+        dstUV += 8 * PIXELS_PER_PACK;
+    }
+
+    V210ToP210Packs(src, dstY, dstUV, packs - blocks * 8);
+}
+
+
+template<ChromaSiting chromaSiting>
+static void V210ToP010LinePairAVX512(
+    const uint32_t* srcAbove, const uint32_t* srcTop, const uint32_t* srcBottom,
+    uint16_t* dstYTop, uint16_t* dstYBottom, uint16_t* dstUV,
+    uint32_t width)
+{
+    const __m512i two = _mm512_set1_epi16(2);
+
+    const uint32_t packs = width / PIXELS_PER_PACK;
+    const uint32_t blocks = packs / 8;
+
+    for (uint32_t block = 0; block < blocks; block++)
+    {
+        __m512i yTop[2], yBottom[2], uv[2];
+
+        for (int i = 0; i < 2; i++)
+        {
+            __m512i uvTop, uvBottom;
+            V210UnpackAVX512(_mm512_loadu_si512((const __m512i*)srcTop + i), yTop[i], uvTop);
+            V210UnpackAVX512(_mm512_loadu_si512((const __m512i*)srcBottom + i), yBottom[i], uvBottom);
+
+            if (chromaSiting == ChromaSiting::TOP_LEFT)
+            {
+                __m512i yAbove, uvAbove;
+                V210UnpackAVX512(_mm512_loadu_si512((const __m512i*)srcAbove + i), yAbove, uvAbove);
+
+                const __m512i sum = _mm512_add_epi16(
+                    _mm512_add_epi16(uvAbove, uvBottom),
+                    _mm512_add_epi16(_mm512_add_epi16(uvTop, uvTop), two));
+                uv[i] = _mm512_srli_epi16(sum, 2);
+            }
+            else
+            {
+                uv[i] = _mm512_avg_epu16(uvTop, uvBottom);
+            }
+        }
+
+        V210StoreAVX512(dstYTop, yTop);
+        V210StoreAVX512(dstYBottom, yBottom);
+        V210StoreAVX512(dstUV, uv);
+
+        srcAbove += 8 * UINT32_PER_PACK;
+        srcTop += 8 * UINT32_PER_PACK;
+        srcBottom += 8 * UINT32_PER_PACK;
+        dstYTop += 8 * PIXELS_PER_PACK;
+        dstYBottom += 8 * PIXELS_PER_PACK;
+        dstUV += 8 * PIXELS_PER_PACK;
+    }
+
+    V210ToP010PairPacks<chromaSiting>(srcAbove, srcTop, srcBottom, dstYTop, dstYBottom, dstUV, packs - blocks * 8);
+}
+
+
+//
+// Dispatch
+//
+
+
+V210ToP210LineFunc GetV210ToP210LineFunc(SimdLevel simdLevel)
+{
+    switch (simdLevel)
+    {
+    case SimdLevel::SCALAR:
+        return V210ToP210LineScalar;
+
+    case SimdLevel::SSSE3:
+        return V210ToP210LineSSSE3;
+
+    case SimdLevel::AVX2:
+        return V210ToP210LineAVX2;
+
+    case SimdLevel::AVX512:
+        return V210ToP210LineAVX512;
+    }
+
+    throw std::runtime_error("GetV210ToP210LineFunc() failed, SIMD level not recognized");
+}
+
+
+template<ChromaSiting chromaSiting>
+static V210ToP010LinePairFunc GetV210ToP010LinePairFuncForSiting(SimdLevel simdLevel)
+{
+    switch (simdLevel)
+    {
+    case SimdLevel::SCALAR:
+        return V210ToP010LinePairScalar<chromaSiting>;
+
+    case SimdLevel::SSSE3:
+        return V210ToP010LinePairSSSE3<chromaSiting>;
+
+    case SimdLevel::AVX2:
+        return V210ToP010LinePairAVX2<chromaSiting>;
+
+    case SimdLevel::AVX512:
+        return V210ToP010LinePairAVX512<chromaSiting>;
+    }
+
+    throw std::runtime_error("GetV210ToP010LinePairFunc() failed, SIMD level not recognized");
+}
+
+
+V210ToP010LinePairFunc GetV210ToP010LinePairFunc(SimdLevel simdLevel, ChromaSiting chromaSiting)
+{
+    switch (chromaSiting)
+    {
+    case ChromaSiting::LEFT:
+        return GetV210ToP010LinePairFuncForSiting<ChromaSiting::LEFT>(simdLevel);
+
+    case ChromaSiting::TOP_LEFT:
+        return GetV210ToP010LinePairFuncForSiting<ChromaSiting::TOP_LEFT>(simdLevel);
+    }
+
+    throw std::runtime_error("GetV210ToP010LinePairFunc() failed, chroma siting not recognized");
+}
@@ -0,0 +1,40 @@
+/*
+ * Copyright(C) 2021 Dennis Fleurbaaij <mail@dennisfleurbaaij.com>
+ *
+ * This program is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, version 3.
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License along with this program. If not, see < https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+
+#include <ChromaSiting.h>
+#include <SimdLevel.h>
+
+
+// Unpack a single V210 line into a line of Y and a line of interleaved UV
+// 16-bit values with the 10 significant bits in the high bits (P210/P010 layout).
+// - width must be a multiple of 6 (a V210 pack)
+// - dstY receives width values, dstUV receives width values (width/2 UV pairs)
+typedef void (*V210ToP210LineFunc)(const uint32_t* src, uint16_t* dstY, uint16_t* dstUV, uint32_t width);
+
+
+// Get the fastest line unpacker which does not exceed the given SIMD level.
+// All implementations produce bit-identical output.
+V210ToP210LineFunc GetV210ToP210LineFunc(SimdLevel simdLevel);
+
+
+// Unpack a pair of V210 lines into two lines of Y and a single line of interleaved UV,
+// the chroma is filtered vertically according to the chroma siting.
+// - srcAbove is the line above srcTop, only used for TOP_LEFT siting. Pass srcTop for the first line.
+// - dstYTop and dstYBottom receive width values each, dstUV receives width values
+typedef void (*V210ToP010LinePairFunc)(
+	const uint32_t* srcAbove, const uint32_t* srcTop, const uint32_t* srcBottom,
+	uint16_t* dstYTop, uint16_t* dstYBottom, uint16_t* dstUV,
+	uint32_t width);
+
+
+// Get the fastest line pair unpacker for the given chroma siting which does not exceed the
+// given SIMD level. All implementations produce bit-identical output.
+V210ToP010LinePairFunc GetV210ToP010LinePairFunc(SimdLevel simdLevel, ChromaSiting chromaSiting);
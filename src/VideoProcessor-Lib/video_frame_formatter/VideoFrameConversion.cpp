@@ -0,0 +1,91 @@
+/*
+ * Copyright(C) 2021 Dennis Fleurbaaij <mail@dennisfleurbaaij.com>
+ *
+ * This program is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, version 3.
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License along with this program. If not, see < https://www.gnu.org/licenses/>.
+ */
+
+#include <pch.h>
+
+#include <video_frame_formatter/CNoopVideoFrameFormatter.h>
+#include <video_frame_formatter/CRGBtoRGB48VideoFrameFormatter.h>
+#include <video_frame_formatter/CV210toP010VideoFrameFormatter.h>
+#include <video_frame_formatter/CV210toP210VideoFrameFormatter.h>
+
+#include "VideoFrameConversion.h"
+
+
+const TCHAR* ToString(const VideoFrameConversion videoFrameConversion)
+{
+	switch (videoFrameConversion)
+	{
+	case VideoFrameConversion::NONE:
+		return TEXT("None");
+
+	case VideoFrameConversion::V210_TO_P010:
+		return TEXT("V210toP010");
+
+	case VideoFrameConversion::V210_TO_P010_TOP_LEFT:
+		return TEXT("V210toP010 (top-left chroma)");
+
+	case VideoFrameConversion::V210_TO_P210:
+		return TEXT("V210toP210");
+
+	case VideoFrameConversion::RGB_TO_RGB48:
+		return TEXT("RGBtoRGB48");
+	}
+
+	throw std::runtime_error("VideoFrameConversion ToString() failed, value not recognized");
+}
+
+
+VideoFrameConversion VideoFrameConversionPick(VideoFrameEncoding videoFrameEncoding, VideoConversionOverride videoConversionOverride)
+{
+	switch (videoFrameEncoding)
+	{
+		// p010 is lossy, only used on request to revert decklink upscaling
+	case VideoFrameEncoding::V210:
+		if (videoConversionOverride == VideoConversionOverride::VIDEOCONVERSION_V210_TO_P010)
+			return VideoFrameConversion::V210_TO_P010;
+
+		if (videoConversionOverride == VideoConversionOverride::VIDEOCONVERSION_V210_TO_P010_TOP_LEFT)
+			return VideoFrameConversion::V210_TO_P010_TOP_LEFT;
+
+		return VideoFrameConversion::V210_TO_P210;
+
+	case VideoFrameEncoding::R210:
+	case VideoFrameEncoding::R10b:
+	case VideoFrameEncoding::R10l:
+	case VideoFrameEncoding::R12B:
+	case VideoFrameEncoding::R12L:
+		return VideoFrameConversion::RGB_TO_RGB48;
+
+	default:
+		return VideoFrameConversion::NONE;
+	}
+}
+
+
+IVideoFrameFormatter* VideoFrameConversionFormatter(VideoFrameConversion videoFrameConversion)
+{
+	switch (videoFrameConversion)
+	{
+	case VideoFrameConversion::NONE:
+		return new CNoopVideoFrameFormatter();
+
+	case VideoFrameConversion::V210_TO_P010:
+		return new CV210toP010VideoFrameFormatter(ChromaSiting::LEFT);
+
+	case VideoFrameConversion::V210_TO_P010_TOP_LEFT:
+		return new CV210toP010VideoFrameFormatter(ChromaSiting::TOP_LEFT);
+
+	case VideoFrameConversion::V210_TO_P210:
+		return new CV210toP210VideoFrameFormatter();
+
+	case VideoFrameConversion::RGB_TO_RGB48:
+		return new CRGBtoRGB48VideoFrameFormatter();
+	}
+
+	throw std::runtime_error("Unknown VideoFrameConversion");
+}
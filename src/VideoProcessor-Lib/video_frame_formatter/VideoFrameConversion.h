@@ -0,0 +1,50 @@
+/*
+ * Copyright(C) 2021 Dennis Fleurbaaij <mail@dennisfleurbaaij.com>
+ *
+ * This program is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, version 3.
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License along with this program. If not, see < https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+
+#include <atlstr.h>
+
+#include <VideoConversionOverride.h>
+#include <VideoFrameEncoding.h>
+#include <video_frame_formatter/IVideoFrameFormatter.h>
+
+
+/**
+ * Conversion of captured frames before they are handed to the renderer
+ */
+enum class VideoFrameConversion
+{
+	// Passed through as captured
+	NONE,
+
+	// v210 (YUV422) to p010 (YUV420), MPEG-2 (left) chroma siting
+	V210_TO_P010,
+
+	// v210 (YUV422) to p010 (YUV420), top-left chroma siting
+	V210_TO_P010_TOP_LEFT,
+
+	// v210 to p210, both YUV422
+	V210_TO_P210,
+
+	// 10- and 12-bit RGB to RGB48
+	RGB_TO_RGB48
+};
+
+
+const TCHAR* ToString(const VideoFrameConversion);
+
+
+// The conversion the MPC video renderer does for frames of the given encoding, which also is
+// what the null renderer benchmarks
+VideoFrameConversion VideoFrameConversionPick(VideoFrameEncoding, VideoConversionOverride);
+
+
+// New formatter doing the given conversion, owned by the caller
+IVideoFrameFormatter* VideoFrameConversionFormatter(VideoFrameConversion);
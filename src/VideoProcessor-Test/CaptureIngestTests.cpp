@@ -0,0 +1,181 @@
+/*
+ * Copyright(C) 2021 Dennis Fleurbaaij <mail@dennisfleurbaaij.com>
+ *
+ * This program is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, version 3.
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License along with this program. If not, see < https://www.gnu.org/licenses/>.
+ */
+
+
+
+#include "pch.h"
+#include "CppUnitTest.h"
+
+#include <thread>
+#include <vector>
+
+#include <CaptureIngest.h>
+#include <IRenderer.h>
+
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace Tests
+{
+	// Source buffer which counts references taken and released
+	class ReferenceCountingSourceBuffer:
+		public IUnknown
+	{
+	public:
+		std::atomic<int> addRefCount = 0;
+		std::atomic<int> releaseCount = 0;
+
+		HRESULT	QueryInterface(REFIID, LPVOID*) override { return E_NOINTERFACE; }
+		ULONG AddRef() override { return ++addRefCount; }
+		ULONG Release() override { ++releaseCount; return 0; }
+	};
+
+
+	// Renderer which records the frames it gets, blocking on the first one until released
+	class BlockingVideoRenderer:
+		public IVideoRenderer
+	{
+	public:
+		std::vector<uint64_t> counters;
+		std::atomic_bool blocked = false;
+		std::atomic_bool release = false;
+
+		bool OnVideoState(VideoStateComPtr&) override { return true; }
+		void OnVideoFrame(VideoFrame& videoFrame) override
+		{
+			if (counters.empty())
+			{
+				blocked = true;
+				while (!release)
+					std::this_thread::yield();
+			}
+
+			counters.push_back(videoFrame.GetCounter());
+		}
+		HRESULT OnWindowsEvent(LONG_PTR, LONG_PTR) override { return S_OK; }
+		void Build() override {}
+		void Start() override {}
+		void Stop() override {}
+		void Reset() override {}
+		void OnSize() override {}
+		void OnPaint() override {}
+		void SetFrameQueueMaxSize(size_t) override {}
+		size_t GetFrameQueueSize() override { return 0; }
+		double EntryLatencyMs() const override { return 0.0; }
+		double ExitLatencyMs() const override { return 0.0; }
+		uint64_t ExitLatencySampleCount() const override { return 0; }
+		uint64_t DroppedFrameCount() const override { return 0; }
+	};
+
+
+	TEST_CLASS(CaptureIngestTests)
+	{
+	public:
+
+		TEST_METHOD(CaptureIngestHandOffTest)
+		{
+			BlockingVideoRenderer renderer;
+			std::vector<ReferenceCountingSourceBuffer> buffers(5);
+			const BYTE data = 0;
+
+			CaptureIngest ingest(renderer, 2);
+			ingest.Start();
+
+			VideoFrame first(&data, 0, 100, &buffers[0]);
+			ingest.OnVideoFrame(first);
+			while (!renderer.blocked)
+				std::this_thread::yield();
+
+			// The renderer is stuck on the first frame, the capture thread carries on and the
+			// ingest queue keeps the newest ones
+			for (int i = 1; i < 5; i++)
+			{
+				VideoFrame videoFrame(&data, i, 100 + i, &buffers[i]);
+				ingest.OnVideoFrame(videoFrame);
+			}
+
+			Assert::AreEqual((uint64_t)2, ingest.DroppedFrameCount());
+
+			renderer.release = true;
+			while (ingest.IngestedFrameCount() < 3)
+				std::this_thread::yield();
+
+			ingest.Stop();
+
+			Assert::AreEqual((size_t)3, renderer.counters.size());
+			Assert::AreEqual((uint64_t)0, renderer.counters[0]);
+			Assert::AreEqual((uint64_t)3, renderer.counters[1]);
+			Assert::AreEqual((uint64_t)4, renderer.counters[2]);
+
+			// Every reference the ingest took is given back, delivered or dropped
+			for (int i = 0; i < 5; i++)
+			{
+				Assert::AreEqual(1, (int)buffers[i].addRefCount);
+				Assert::AreEqual(1, (int)buffers[i].releaseCount);
+			}
+		}
+
+		TEST_METHOD(CaptureIngestDropNewestTest)
+		{
+			BlockingVideoRenderer renderer;
+			std::vector<ReferenceCountingSourceBuffer> buffers(5);
+			const BYTE data = 0;
+
+			CaptureIngest ingest(renderer, 2, FrameDropPolicy::DROP_NEWEST);
+			ingest.Start();
+
+			VideoFrame first(&data, 0, 100, &buffers[0]);
+			ingest.OnVideoFrame(first);
+			while (!renderer.blocked)
+				std::this_thread::yield();
+
+			// A full queue keeps what it has, the new frames aren't even referenced
+			for (int i = 1; i < 5; i++)
+			{
+				VideoFrame videoFrame(&data, i, 100 + i, &buffers[i]);
+				ingest.OnVideoFrame(videoFrame);
+			}
+
+			Assert::AreEqual((uint64_t)2, ingest.DroppedFrameCount());
+			Assert::AreEqual(0, (int)buffers[3].addRefCount);
+			Assert::AreEqual(0, (int)buffers[4].addRefCount);
+
+			renderer.release = true;
+			while (ingest.IngestedFrameCount() < 3)
+				std::this_thread::yield();
+
+			ingest.Stop();
+
+			Assert::AreEqual((size_t)3, renderer.counters.size());
+			Assert::AreEqual((uint64_t)1, renderer.counters[1]);
+			Assert::AreEqual((uint64_t)2, renderer.counters[2]);
+		}
+
+		TEST_METHOD(CaptureIngestInactiveTest)
+		{
+			BlockingVideoRenderer renderer;
+			ReferenceCountingSourceBuffer buffer;
+			const BYTE data = 0;
+
+			CaptureIngest ingest(renderer, 2);
+
+			// Not started, the frame is left alone
+			VideoFrame videoFrame(&data, 0, 100, &buffer);
+			ingest.OnVideoFrame(videoFrame);
+
+			ingest.Start();
+			ingest.Stop();
+
+			ingest.OnVideoFrame(videoFrame);
+
+			Assert::AreEqual(0, (int)buffer.addRefCount);
+			Assert::AreEqual(0, (int)buffer.releaseCount);
+			Assert::IsTrue(renderer.counters.empty());
+		}
+	};
+}
@@ -0,0 +1,110 @@
+/*
+ * Copyright(C) 2021 Dennis Fleurbaaij <mail@dennisfleurbaaij.com>
+ *
+ * This program is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, version 3.
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License along with this program. If not, see < https://www.gnu.org/licenses/>.
+ */
+
+
+
+#include "pch.h"
+#include "CppUnitTest.h"
+
+#include <thread>
+#include <vector>
+
+#include <FrameBufferPool.h>
+
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace Tests
+{
+	TEST_CLASS(FrameBufferPoolTests)
+	{
+	public:
+
+		TEST_METHOD(FrameBufferPoolRecycleTest)
+		{
+			FrameBufferPool pool(1000, 3, FrameBufferPool::ALIGNMENT_PAGE);
+			pool.PreFault();
+
+			std::vector<FrameBuffer*> buffers;
+			for (int i = 0; i < 3; i++)
+			{
+				FrameBuffer* buffer = pool.Acquire();
+				Assert::IsNotNull(buffer);
+				Assert::AreEqual((uintptr_t)0, reinterpret_cast<uintptr_t>(buffer->Data()) % FrameBufferPool::ALIGNMENT_PAGE);
+				buffers.push_back(buffer);
+			}
+
+			Assert::IsNull(pool.Acquire());
+			Assert::AreEqual((uint64_t)1, pool.GetMissCount());
+			Assert::AreEqual(3u, pool.GetInUseCount());
+
+			// Only the last release returns it
+			buffers[1]->AddRef();
+			Assert::AreEqual((ULONG)1, buffers[1]->Release());
+			Assert::IsNull(pool.Acquire());
+			Assert::AreEqual((ULONG)0, buffers[1]->Release());
+
+			Assert::IsTrue(buffers[1] == pool.Acquire());
+
+			for (FrameBuffer* buffer : buffers)
+				buffer->Release();
+
+			Assert::AreEqual(0u, pool.GetInUseCount());
+			Assert::AreEqual(3u, pool.GetHighWaterMark());
+			Assert::AreEqual((uint64_t)2, pool.GetMissCount());
+		}
+
+
+		TEST_METHOD(FrameBufferPoolConcurrencyTest)
+		{
+			const uint32_t bufferCount = 4;
+			const int iterations = 100000;
+
+			FrameBufferPool pool(64, bufferCount);
+			std::atomic<int> owners[bufferCount] = {};
+
+			// Every acquired buffer must have exactly one owner
+			auto worker = [&]()
+			{
+				for (int i = 0; i < iterations; i++)
+				{
+					FrameBuffer* buffer = pool.Acquire();
+					if (!buffer)
+						continue;
+
+					const uint32_t index = (uint32_t)buffer->Data()[0];
+					Assert::AreEqual(1, ++owners[index]);
+					Assert::AreEqual(0, --owners[index]);
+
+					buffer->Release();
+				}
+			};
+
+			// Mark every buffer with its index
+			std::vector<FrameBuffer*> buffers;
+			for (uint32_t i = 0; i < bufferCount; i++)
+			{
+				buffers.push_back(pool.Acquire());
+				buffers.back()->Data()[0] = (BYTE)i;
+			}
+			for (FrameBuffer* buffer : buffers)
+				buffer->Release();
+
+			std::thread thread1(worker);
+			std::thread thread2(worker);
+			std::thread thread3(worker);
+			worker();
+			thread1.join();
+			thread2.join();
+			thread3.join();
+
+			Assert::AreEqual(0u, pool.GetInUseCount());
+			Assert::IsTrue(pool.GetHighWaterMark() <= bufferCount);
+		}
+	};
+}
@@ -0,0 +1,157 @@
+/*
+ * Copyright(C) 2021 Dennis Fleurbaaij <mail@dennisfleurbaaij.com>
+ *
+ * This program is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, version 3.
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License along with this program. If not, see < https://www.gnu.org/licenses/>.
+ */
+
+
+
+#include "pch.h"
+#include "CppUnitTest.h"
+
+#include <thread>
+#include <vector>
+
+#include <FrameDistributor.h>
+
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace Tests
+{
+	// Source buffer with a plain reference count, one per captured frame
+	class CapturedSourceBuffer:
+		public IUnknown
+	{
+	public:
+		std::atomic<ULONG> refCount = 0;
+
+		HRESULT	QueryInterface(REFIID, LPVOID*) override { return E_NOINTERFACE; }
+		ULONG AddRef() override { return ++refCount; }
+		ULONG Release() override { return --refCount; }
+	};
+
+
+	// Sink which records what it got, optionally blocking on the first frame until released
+	class RecordingVideoFrameSink:
+		public IVideoFrameSink
+	{
+	public:
+		std::vector<uint64_t> counters;
+		std::vector<const void*> data;
+		bool blockOnFirstFrame = false;
+		std::atomic_bool blocked = false;
+		std::atomic_bool release = false;
+
+		void OnVideoFrame(VideoFrame& videoFrame) override
+		{
+			if (blockOnFirstFrame && counters.empty())
+			{
+				blocked = true;
+				while (!release)
+					std::this_thread::yield();
+			}
+
+			counters.push_back(videoFrame.GetCounter());
+			data.push_back(videoFrame.GetData());
+		}
+	};
+
+
+	TEST_CLASS(FrameDistributorTests)
+	{
+	public:
+
+		TEST_METHOD(FrameDistributorSlowSinkTest)
+		{
+			const int frameCount = 9;
+			std::vector<CapturedSourceBuffer> buffers(frameCount);
+			std::vector<BYTE> frameData(frameCount);
+
+			RecordingVideoFrameSink primarySink;
+			RecordingVideoFrameSink slowSink;
+			RecordingVideoFrameSink previewSink;
+			slowSink.blockOnFirstFrame = true;
+
+			FrameDistributor frameDistributor;
+			const size_t primary = frameDistributor.AddInlineSink(primarySink);
+			const size_t slow = frameDistributor.AddSink(slowSink, 2, FrameDropPolicy::DROP_NEWEST);
+			const size_t preview = frameDistributor.AddSink(previewSink, 4, FrameDropPolicy::DROP_OLDEST, 3);
+			Assert::AreEqual((size_t)3, frameDistributor.SinkCount());
+
+			frameDistributor.Start();
+
+			for (int i = 0; i < frameCount; i++)
+			{
+				VideoFrame videoFrame(&frameData[i], i, 100 + i, &buffers[i]);
+				frameDistributor.OnVideoFrame(videoFrame);
+
+				// Keep the slow sink stuck on the first frame
+				if (i == 0)
+				{
+					while (!slowSink.blocked)
+						std::this_thread::yield();
+				}
+			}
+
+			// The slow sink only held up itself, its queue kept the first frames it could take
+			Assert::AreEqual((size_t)frameCount, primarySink.counters.size());
+			Assert::AreEqual((uint64_t)frameCount, frameDistributor.DeliveredFrameCount(primary));
+			Assert::AreEqual((uint64_t)6, frameDistributor.DroppedFrameCount(slow));
+
+			slowSink.release = true;
+			while (frameDistributor.DeliveredFrameCount(slow) < 3 ||
+				frameDistributor.DeliveredFrameCount(preview) < 3)
+				std::this_thread::yield();
+
+			frameDistributor.Stop();
+
+			Assert::AreEqual((size_t)3, slowSink.counters.size());
+			for (int i = 0; i < 3; i++)
+				Assert::AreEqual((uint64_t)i, slowSink.counters[i]);
+
+			// Every third frame for the preview
+			Assert::AreEqual((size_t)3, previewSink.counters.size());
+			for (int i = 0; i < 3; i++)
+				Assert::AreEqual((uint64_t)(i * 3), previewSink.counters[i]);
+			Assert::AreEqual((uint64_t)0, frameDistributor.DroppedFrameCount(preview));
+
+			// All sinks saw the captured data itself and every reference is given back
+			for (int i = 0; i < frameCount; i++)
+				Assert::AreEqual((const void*)&frameData[i], primarySink.data[i]);
+			Assert::AreEqual((const void*)&frameData[0], slowSink.data[0]);
+			Assert::AreEqual((const void*)&frameData[3], previewSink.data[1]);
+
+			for (int i = 0; i < frameCount; i++)
+				Assert::AreEqual((ULONG)0, (ULONG)buffers[i].refCount);
+		}
+
+		TEST_METHOD(FrameDistributorStoppedTest)
+		{
+			CapturedSourceBuffer buffer;
+			const BYTE data = 0;
+
+			RecordingVideoFrameSink inlineSink;
+			RecordingVideoFrameSink queuedSink;
+
+			FrameDistributor frameDistributor;
+			frameDistributor.AddInlineSink(inlineSink);
+			frameDistributor.AddSink(queuedSink, 2, FrameDropPolicy::DROP_OLDEST);
+
+			// Frames are ignored outside of start and stop
+			VideoFrame videoFrame(&data, 0, 100, &buffer);
+			frameDistributor.OnVideoFrame(videoFrame);
+
+			frameDistributor.Start();
+			frameDistributor.Stop();
+
+			frameDistributor.OnVideoFrame(videoFrame);
+
+			Assert::IsTrue(inlineSink.counters.empty());
+			Assert::IsTrue(queuedSink.counters.empty());
+			Assert::AreEqual((ULONG)0, (ULONG)buffer.refCount);
+		}
+	};
+}
@@ -0,0 +1,175 @@
+/*
+ * Copyright(C) 2021 Dennis Fleurbaaij <mail@dennisfleurbaaij.com>
+ *
+ * This program is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, version 3.
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License along with this program. If not, see < https://www.gnu.org/licenses/>.
+ */
+
+
+#include "pch.h"
+#include "CppUnitTest.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include <FrameTimestampFilter.h>
+
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace Tests
+{
+	// 60Hz capture timestamps in us with drift and uniform jitter
+	class SyntheticCaptureTimestamps
+	{
+	public:
+
+		static const timingclocktime_t TICKS_PER_SECOND = 1000000;
+		static constexpr double NOMINAL_FRAME_DURATION_TICKS = 1000000.0 / 60.0;
+
+		double driftPpm;
+		double jitterTicks;
+		timingclocktime_t start = 5000000;
+
+		SyntheticCaptureTimestamps(double driftPpm, double jitterTicks):
+			driftPpm(driftPpm),
+			jitterTicks(jitterTicks)
+		{
+		}
+
+		// Timestamp without jitter
+		double Ideal(uint64_t frameCounter) const
+		{
+			return start + frameCounter * NOMINAL_FRAME_DURATION_TICKS * (1.0 + driftPpm / 1000000.0);
+		}
+
+		timingclocktime_t Raw(uint64_t frameCounter)
+		{
+			m_seed = m_seed * 1664525 + 1013904223;
+			const double jitter = jitterTicks * (((m_seed >> 16) / 32768.0) - 1.0);
+
+			return (timingclocktime_t)llround(Ideal(frameCounter) + jitter);
+		}
+
+	private:
+
+		uint32_t m_seed = 1;
+	};
+
+
+	TEST_CLASS(FrameTimestampFilterTests)
+	{
+	public:
+
+		TEST_METHOD(FrameTimestampFilterJitterTest)
+		{
+			SyntheticCaptureTimestamps timestamps(40.0, 500.0);
+			FrameTimestampFilter filter(SyntheticCaptureTimestamps::NOMINAL_FRAME_DURATION_TICKS, SyntheticCaptureTimestamps::TICKS_PER_SECOND);
+
+			double maxErrorTicks = 0.0;
+			double sumErrorTicks2 = 0.0;
+			int errorCount = 0;
+			for (uint64_t i = 1; i < 1000; i++)
+			{
+				const timingclocktime_t filtered = filter.Filter(i, timestamps.Raw(i));
+
+				// Once the window is full the jitter must be mostly gone
+				if (i > FrameTimestampFilter::WINDOW_SIZE)
+				{
+					const double errorTicks = filtered - timestamps.Ideal(i);
+					maxErrorTicks = std::max(maxErrorTicks, fabs(errorTicks));
+					sumErrorTicks2 += errorTicks * errorTicks;
+					++errorCount;
+				}
+			}
+
+			Assert::IsTrue(maxErrorTicks < timestamps.jitterTicks / 2);
+			Assert::IsTrue(sqrt(sumErrorTicks2 / errorCount) < timestamps.jitterTicks / 5);
+
+			const FrameTimestampFilter::Statistics statistics = filter.TakeStatistics();
+			Assert::AreEqual(999u, statistics.frameCount);
+			Assert::IsTrue(statistics.rawIntervalJitterRmsUs > 300.0);
+			Assert::IsTrue(statistics.residualRmsUs < statistics.rawIntervalJitterRmsUs);
+			Assert::AreEqual((uint64_t)0, statistics.discontinuityCount);
+		}
+
+		TEST_METHOD(FrameTimestampFilterDriftTest)
+		{
+			SyntheticCaptureTimestamps timestamps(200.0, 0.0);
+			FrameTimestampFilter filter(SyntheticCaptureTimestamps::NOMINAL_FRAME_DURATION_TICKS, SyntheticCaptureTimestamps::TICKS_PER_SECOND);
+
+			for (uint64_t i = 1; i < 1000; i++)
+			{
+				const timingclocktime_t raw = timestamps.Raw(i);
+				const timingclocktime_t filtered = filter.Filter(i, raw);
+
+				// Follows the drift without lagging behind once measured
+				if (i > FrameTimestampFilter::MIN_FIT_FRAMES)
+					Assert::IsTrue(std::abs(filtered - raw) <= 1);
+			}
+
+			Assert::IsTrue(fabs(filter.TakeStatistics().frameDurationPpm - 200.0) < 10.0);
+		}
+
+		TEST_METHOD(FrameTimestampFilterNominalLockTest)
+		{
+			SyntheticCaptureTimestamps timestamps(0.0, 500.0);
+			FrameTimestampFilter filter(SyntheticCaptureTimestamps::NOMINAL_FRAME_DURATION_TICKS, SyntheticCaptureTimestamps::TICKS_PER_SECOND);
+
+			// Before there are enough frames to measure the cadence is the nominal one
+			for (uint64_t i = 1; i < FrameTimestampFilter::MIN_FIT_FRAMES; i++)
+			{
+				filter.Filter(i, timestamps.Raw(i));
+				Assert::AreEqual(SyntheticCaptureTimestamps::NOMINAL_FRAME_DURATION_TICKS, filter.FrameDurationTicks());
+			}
+		}
+
+		TEST_METHOD(FrameTimestampFilterDiscontinuityTest)
+		{
+			SyntheticCaptureTimestamps timestamps(0.0, 100.0);
+			FrameTimestampFilter filter(SyntheticCaptureTimestamps::NOMINAL_FRAME_DURATION_TICKS, SyntheticCaptureTimestamps::TICKS_PER_SECOND);
+
+			for (uint64_t i = 1; i < 200; i++)
+				filter.Filter(i, timestamps.Raw(i));
+
+			// Timestamps jump while the counter does not, snaps to the new frame
+			timestamps.start += 10000;
+			timingclocktime_t raw = timestamps.Raw(200);
+			Assert::AreEqual(raw, filter.Filter(200, raw));
+
+			for (uint64_t i = 201; i < 300; i++)
+				filter.Filter(i, timestamps.Raw(i));
+
+			// Counter restarts
+			raw = timestamps.Raw(1);
+			Assert::AreEqual(raw, filter.Filter(1, raw));
+
+			Assert::AreEqual((uint64_t)2, filter.TakeStatistics().discontinuityCount);
+		}
+
+		TEST_METHOD(FrameTimestampFilterResetTest)
+		{
+			SyntheticCaptureTimestamps timestamps(0.0, 100.0);
+			FrameTimestampFilter filter(SyntheticCaptureTimestamps::NOMINAL_FRAME_DURATION_TICKS, SyntheticCaptureTimestamps::TICKS_PER_SECOND);
+
+			for (uint64_t i = 1; i < 200; i++)
+				filter.Filter(i, timestamps.Raw(i));
+
+			// Starts over from the first frame after a reset, a single frame is taken as-is and
+			// the next is predicted at the nominal duration
+			const double nominalFrameDurationTicks = SyntheticCaptureTimestamps::NOMINAL_FRAME_DURATION_TICKS;
+
+			filter.Reset();
+			Assert::AreEqual(nominalFrameDurationTicks, filter.FrameDurationTicks());
+
+			const timingclocktime_t raw = timestamps.Raw(200);
+			Assert::AreEqual(raw, filter.Filter(200, raw));
+			Assert::AreEqual(nominalFrameDurationTicks, filter.FrameDurationTicks());
+
+			filter.Filter(201, timestamps.Raw(201));
+			Assert::AreEqual(nominalFrameDurationTicks, filter.FrameDurationTicks());
+			Assert::AreEqual((uint64_t)0, filter.TakeStatistics().discontinuityCount);
+		}
+	};
+}
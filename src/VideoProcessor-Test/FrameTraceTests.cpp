@@ -0,0 +1,139 @@
+/*
+ * Copyright(C) 2021 Dennis Fleurbaaij <mail@dennisfleurbaaij.com>
+ *
+ * This program is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, version 3.
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License along with this program. If not, see < https://www.gnu.org/licenses/>.
+ */
+
+
+
+#include "pch.h"
+#include "CppUnitTest.h"
+
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <FrameTrace.h>
+
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace Tests
+{
+	static size_t CountOccurrences(const std::string& haystack, const std::string& needle)
+	{
+		size_t count = 0;
+		for (size_t pos = haystack.find(needle); pos != std::string::npos; pos = haystack.find(needle, pos + 1))
+			++count;
+
+		return count;
+	}
+
+
+	TEST_CLASS(FrameTraceTests)
+	{
+	public:
+
+		TEST_METHOD(DisabledTest)
+		{
+			FrameTrace::Clear();
+			FrameTrace::SetEnabled(false);
+
+			FrameTrace::Record(FrameTraceEvent::DELIVER, 1, 100, 200);
+			{
+				FrameTraceScope scope(FrameTraceEvent::FORMAT, 1);
+			}
+
+			std::ostringstream stream;
+			Assert::AreEqual((size_t)0, FrameTrace::WriteChromeTrace(stream, 0, 1000000));
+			Assert::AreEqual(std::string("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n]}\n"), stream.str());
+		}
+
+		TEST_METHOD(ChromeTraceTest)
+		{
+			FrameTrace::Clear();
+			FrameTrace::SetEnabled(true);
+
+			// Ticks are us
+			FrameTrace::Record(FrameTraceEvent::VIDEO_INPUT_FRAME_ARRIVED, 7, 1000, 1500);
+			FrameTrace::Record(FrameTraceEvent::DEQUEUE, 7, 2000, 2000);
+			FrameTrace::Record(FrameTraceEvent::DELIVER, 7, 2100, 4100);
+
+			// Too old
+			FrameTrace::Record(FrameTraceEvent::DELIVER, 6, 100, 900);
+
+			std::ostringstream stream;
+			Assert::AreEqual((size_t)3, FrameTrace::WriteChromeTrace(stream, 1000, 1000000));
+
+			const std::string json = stream.str();
+			Assert::AreEqual((size_t)1, CountOccurrences(json, "\"name\":\"VideoInputFrameArrived\",\"cat\":\"frame\",\"ph\":\"X\""));
+			Assert::AreEqual((size_t)1, CountOccurrences(json, "\"ts\":0.000,\"dur\":500.000,\"args\":{\"frame\":7}"));
+			Assert::AreEqual((size_t)1, CountOccurrences(json, "\"name\":\"Dequeue\",\"cat\":\"frame\",\"ph\":\"i\""));
+			Assert::AreEqual((size_t)1, CountOccurrences(json, "\"ts\":1100.000,\"dur\":2000.000"));
+			Assert::AreEqual((size_t)0, CountOccurrences(json, "\"frame\":6"));
+
+			// Sorted by start
+			Assert::IsTrue(json.find("VideoInputFrameArrived") < json.find("Dequeue"));
+			Assert::IsTrue(json.find("Dequeue") < json.find("Deliver"));
+
+			FrameTrace::SetEnabled(false);
+		}
+
+		TEST_METHOD(WrapAroundTest)
+		{
+			FrameTrace::Clear();
+			FrameTrace::SetEnabled(true);
+
+			// Oldest events get overwritten
+			const uint32_t eventCount = FrameTrace::THREAD_BUFFER_CAPACITY + 100;
+			for (uint32_t i = 0; i < eventCount; ++i)
+				FrameTrace::Record(FrameTraceEvent::FORMAT, i, i * 10, i * 10 + 5);
+
+			std::ostringstream stream;
+			Assert::AreEqual((size_t)FrameTrace::THREAD_BUFFER_CAPACITY, FrameTrace::WriteChromeTrace(stream, 0, 1000000));
+			Assert::AreEqual((size_t)0, CountOccurrences(stream.str(), "\"frame\":99}"));
+			Assert::AreEqual((size_t)1, CountOccurrences(stream.str(), "\"frame\":100}"));
+
+			FrameTrace::SetEnabled(false);
+		}
+
+		TEST_METHOD(ConcurrencyTest)
+		{
+			// Threads record into their own buffers while dumps are taken, nothing may get lost
+			// or torn
+			FrameTrace::Clear();
+			FrameTrace::SetEnabled(true);
+
+			const int threadCount = 4;
+			const uint32_t eventsPerThread = FrameTrace::THREAD_BUFFER_CAPACITY / 2;
+
+			std::vector<std::thread> threads;
+			for (int t = 0; t < threadCount; ++t)
+			{
+				threads.emplace_back([t, eventsPerThread]()
+				{
+					for (uint32_t i = 0; i < eventsPerThread; ++i)
+						FrameTrace::Record(FrameTraceEvent::DELIVER, i, i * 4 + t, i * 4 + t + 1);
+				});
+			}
+
+			for (int i = 0; i < 10; ++i)
+			{
+				std::ostringstream stream;
+				FrameTrace::WriteChromeTrace(stream, 0, 1000000);
+			}
+
+			for (std::thread& thread : threads)
+				thread.join();
+
+			std::ostringstream stream;
+			Assert::AreEqual((size_t)(threadCount * eventsPerThread), FrameTrace::WriteChromeTrace(stream, 0, 1000000));
+			Assert::AreEqual((size_t)(threadCount * eventsPerThread), CountOccurrences(stream.str(), "\"dur\":1.000,"));
+
+			FrameTrace::SetEnabled(false);
+		}
+	};
+}
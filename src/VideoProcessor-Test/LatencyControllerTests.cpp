@@ -0,0 +1,184 @@
+/*
+ * Copyright(C) 2021 Dennis Fleurbaaij <mail@dennisfleurbaaij.com>
+ *
+ * This program is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, version 3.
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License along with this program. If not, see < https://www.gnu.org/licenses/>.
+ */
+
+
+#include "pch.h"
+#include "CppUnitTest.h"
+
+#include <algorithm>
+#include <cmath>
+#include <deque>
+
+#include <LatencyController.h>
+
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace Tests
+{
+	// Simulated capture to renderer pipeline on a simulated clock.
+	// The exit latency is the pipeline latency minus the frame offset, offset changes show up a
+	// few samples late like they would with frames already in the queue, and it has some jitter.
+	// It can be measured less often than the controller runs, like a renderer delivering fewer
+	// frames than the controller's update rate.
+	class SimulatedPipeline
+	{
+	public:
+
+		static const int DELAY_SAMPLES = 3;
+		static constexpr double SAMPLE_INTERVAL_S = 0.1;
+
+		double latencyMs;
+		double jitterMs = 0.0;
+		double timeS = 0.0;
+		int measurementIntervalSamples = 1;
+
+		SimulatedPipeline(double latencyMs, int frameOffsetMs):
+			latencyMs(latencyMs),
+			m_frameOffsetsMs(DELAY_SAMPLES, frameOffsetMs)
+		{
+		}
+
+		// Run the loop for the given time, returns the largest offset change within any second
+		int Run(LatencyController& latencyController, double durationS)
+		{
+			std::deque<int> offsetsMs;
+			int maxChangeMs = 0;
+
+			const double endS = timeS + durationS;
+			while (timeS < endS)
+			{
+				timeS += SAMPLE_INTERVAL_S;
+
+				if (m_tick++ % measurementIntervalSamples == 0)
+				{
+					m_exitLatencyMs = ExitLatencyMs();
+					++m_exitLatencySampleCount;
+				}
+
+				const int offsetMs = latencyController.Update(m_exitLatencyMs, m_exitLatencySampleCount, timeS);
+				m_frameOffsetsMs.pop_front();
+				m_frameOffsetsMs.push_back(offsetMs);
+
+				offsetsMs.push_back(offsetMs);
+				if (offsetsMs.size() > (size_t)round(1.0 / SAMPLE_INTERVAL_S))
+					offsetsMs.pop_front();
+
+				maxChangeMs = std::max(maxChangeMs, abs(offsetsMs.back() - offsetsMs.front()));
+			}
+
+			return maxChangeMs;
+		}
+
+	private:
+
+		std::deque<int> m_frameOffsetsMs;
+		uint32_t m_seed = 1;
+		uint64_t m_tick = 0;
+		double m_exitLatencyMs = 0.0;
+		uint64_t m_exitLatencySampleCount = 0;
+
+		double ExitLatencyMs()
+		{
+			m_seed = m_seed * 1664525 + 1013904223;
+			const double jitter = jitterMs * (((m_seed >> 16) / 32768.0) - 1.0);
+
+			return latencyMs - m_frameOffsetsMs.front() + jitter;
+		}
+	};
+
+
+	TEST_CLASS(LatencyControllerTests)
+	{
+	public:
+
+		TEST_METHOD(LatencyControllerConvergesTest)
+		{
+			LatencyController::Config config;
+			config.targetLeadMs = 8.0;
+
+			LatencyController latencyController(config);
+			latencyController.Reset(90);
+
+			// Needs an offset of 103 to get to a lead of 8
+			SimulatedPipeline pipeline(95.0, 90);
+			pipeline.jitterMs = 1.0;
+			pipeline.Run(latencyController, 60.0);
+
+			Assert::AreEqual(103, latencyController.OffsetMs());
+
+			const LatencyController::Telemetry telemetry = latencyController.GetTelemetry();
+			Assert::IsFalse(telemetry.correcting);
+			Assert::IsTrue(fabs(telemetry.filteredErrorMs) < config.hysteresisMs);
+			Assert::AreEqual((uint64_t)600, telemetry.sampleCount);
+		}
+
+		TEST_METHOD(LatencyControllerSlewLimitTest)
+		{
+			LatencyController::Config config;
+			config.targetLeadMs = 8.0;
+
+			LatencyController latencyController(config);
+			latencyController.Reset(103);
+
+			SimulatedPipeline pipeline(95.0, 103);
+			pipeline.Run(latencyController, 10.0);
+			Assert::AreEqual(103, latencyController.OffsetMs());
+
+			// Pipeline latency jumps, the offset follows no faster than the slew limit.
+			// One more is allowed for the rounding to whole milliseconds.
+			pipeline.latencyMs += 30.0;
+			const int maxChangeMs = pipeline.Run(latencyController, 60.0);
+
+			Assert::IsTrue(maxChangeMs <= (int)config.maxSlewMsPerS + 1);
+			Assert::AreEqual(133, latencyController.OffsetMs());
+		}
+
+		TEST_METHOD(LatencyControllerHysteresisTest)
+		{
+			LatencyController::Config config;
+			config.targetLeadMs = 8.0;
+
+			LatencyController latencyController(config);
+			latencyController.Reset(103);
+
+			// Off by less than the hysteresis, leave it
+			SimulatedPipeline pipeline(95.8, 103);
+			pipeline.jitterMs = 0.1;
+			Assert::AreEqual(0, pipeline.Run(latencyController, 60.0));
+			Assert::AreEqual(103, latencyController.OffsetMs());
+
+			const LatencyController::Telemetry telemetry = latencyController.GetTelemetry();
+			Assert::IsFalse(telemetry.correcting);
+			Assert::IsTrue(fabs(telemetry.errorMs - 0.8) < 0.2);
+		}
+
+		TEST_METHOD(LatencyControllerStaleMeasurementTest)
+		{
+			LatencyController::Config config;
+			config.targetLeadMs = 8.0;
+
+			LatencyController latencyController(config);
+			latencyController.Reset(90);
+
+			// Measured every half second while the controller runs every 100ms, only the fresh
+			// measurements may count and it has to settle just the same
+			SimulatedPipeline pipeline(95.0, 90);
+			pipeline.jitterMs = 1.0;
+			pipeline.measurementIntervalSamples = 5;
+			const int maxChangeMs = pipeline.Run(latencyController, 60.0);
+
+			Assert::IsTrue(maxChangeMs <= (int)config.maxSlewMsPerS + 1);
+			Assert::AreEqual(103, latencyController.OffsetMs());
+
+			const LatencyController::Telemetry telemetry = latencyController.GetTelemetry();
+			Assert::IsFalse(telemetry.correcting);
+			Assert::AreEqual((uint64_t)120, telemetry.sampleCount);
+		}
+	};
+}
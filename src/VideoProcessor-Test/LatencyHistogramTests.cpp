@@ -0,0 +1,129 @@
+/*
+ * Copyright(C) 2021 Dennis Fleurbaaij <mail@dennisfleurbaaij.com>
+ *
+ * This program is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, version 3.
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License along with this program. If not, see < https://www.gnu.org/licenses/>.
+ */
+
+
+
+#include "pch.h"
+#include "CppUnitTest.h"
+
+#include <thread>
+#include <vector>
+
+#include <LatencyHistogram.h>
+
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace Tests
+{
+	TEST_CLASS(LatencyHistogramTests)
+	{
+	public:
+
+		TEST_METHOD(BucketBoundsTest)
+		{
+			// Every value must land in a bucket which contains it and buckets must be contiguous
+			uint64_t expectedLowerBound = 0;
+			for (unsigned int i = 0; i < LatencyHistogram::BUCKET_COUNT; ++i)
+			{
+				const uint64_t lower = LatencyHistogram::BucketLowerBound(i);
+				const uint64_t upper = LatencyHistogram::BucketUpperBound(i);
+
+				Assert::AreEqual(expectedLowerBound, lower);
+				Assert::IsTrue(upper >= lower);
+				Assert::AreEqual(i, LatencyHistogram::BucketIndex(lower));
+				Assert::AreEqual(i, LatencyHistogram::BucketIndex(upper));
+
+				// Relative bucket width is bounded
+				Assert::IsTrue((upper - lower) * LatencyHistogram::SUB_BUCKET_COUNT <= lower);
+
+				expectedLowerBound = upper + 1;
+			}
+
+			// Out of range values go into the last bucket
+			Assert::AreEqual(LatencyHistogram::BUCKET_COUNT - 1, LatencyHistogram::BucketIndex(UINT64_MAX));
+		}
+
+		TEST_METHOD(PercentileTest)
+		{
+			LatencyHistogram histogram;
+
+			Assert::AreEqual((uint64_t)0, histogram.GetSnapshot().count);
+
+			// 1..10000 us
+			for (uint64_t v = 1; v <= 10000; ++v)
+				histogram.Record(v);
+
+			const LatencyHistogram::Snapshot snapshot = histogram.GetSnapshot();
+			Assert::AreEqual((uint64_t)10000, snapshot.count);
+			Assert::AreEqual((uint64_t)10000, snapshot.max);
+
+			// Within the bucket resolution of the exact percentile
+			Assert::IsTrue(snapshot.p50 >= 5000 * 15 / 16 && snapshot.p50 <= 5000 * 17 / 16);
+			Assert::IsTrue(snapshot.p99 >= 9900 * 15 / 16 && snapshot.p99 <= 9900 * 17 / 16);
+			Assert::IsTrue(snapshot.p999 >= 9990 * 15 / 16 && snapshot.p999 <= 10000);
+
+			histogram.Reset();
+			Assert::AreEqual((uint64_t)0, histogram.GetSnapshot().count);
+			Assert::AreEqual((uint64_t)0, histogram.GetSnapshot().max);
+		}
+
+		TEST_METHOD(OutlierTest)
+		{
+			// A single outlier in a thousand shows in the p99.9 and max but not the p99
+			LatencyHistogram histogram;
+
+			for (int i = 0; i < 999; ++i)
+				histogram.Record(100);
+			histogram.Record(250000);
+
+			const LatencyHistogram::Snapshot snapshot = histogram.GetSnapshot();
+			Assert::IsTrue(snapshot.p50 >= 96 && snapshot.p50 <= 104);
+			Assert::IsTrue(snapshot.p99 >= 96 && snapshot.p99 <= 104);
+			Assert::IsTrue(snapshot.p999 >= 96 && snapshot.p999 <= 104);
+			Assert::AreEqual((uint64_t)250000, snapshot.max);
+
+			histogram.Record(250000);
+			Assert::IsTrue(histogram.GetSnapshot().p999 > 230000);
+		}
+
+		TEST_METHOD(ConcurrencyTest)
+		{
+			// No counts may get lost when recording from several threads while taking snapshots
+			const int threadCount = 4;
+			const int valuesPerThread = 100000;
+
+			LatencyHistogram histogram;
+			std::vector<std::thread> threads;
+
+			for (int t = 0; t < threadCount; ++t)
+			{
+				threads.emplace_back([&histogram, t]()
+				{
+					for (int i = 0; i < valuesPerThread; ++i)
+						histogram.Record((uint64_t)(i % 1000) + t * 1000);
+				});
+			}
+
+			uint64_t previousCount = 0;
+			for (int i = 0; i < 100; ++i)
+			{
+				const uint64_t count = histogram.GetSnapshot().count;
+				Assert::IsTrue(count >= previousCount);
+				previousCount = count;
+			}
+
+			for (std::thread& thread : threads)
+				thread.join();
+
+			const LatencyHistogram::Snapshot snapshot = histogram.GetSnapshot();
+			Assert::AreEqual((uint64_t)(threadCount * valuesPerThread), snapshot.count);
+			Assert::AreEqual((uint64_t)(threadCount * 1000 - 1), snapshot.max);
+		}
+	};
+}
@@ -0,0 +1,203 @@
+/*
+ * Copyright(C) 2021 Dennis Fleurbaaij <mail@dennisfleurbaaij.com>
+ *
+ * This program is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, version 3.
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License along with this program. If not, see < https://www.gnu.org/licenses/>.
+ */
+
+
+
+#include "pch.h"
+#include "CppUnitTest.h"
+
+#include <vector>
+
+#include <raw_capture/RawCaptureRecorder.h>
+#include <FrameBufferPool.h>
+
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace Tests
+{
+	static const TCHAR* RAW_CAPTURE_TEST_PATH = TEXT("RawCaptureRecorderTest.vprc");
+
+
+	static VideoStateComPtr RawCaptureTestState(unsigned int frameWidth, unsigned int frameHeight)
+	{
+		VideoStateComPtr videoState = new VideoState();
+		videoState->valid = true;
+		videoState->displayMode = std::make_shared<DisplayMode>(frameWidth, frameHeight, false, 60000, 1001);
+		videoState->videoFrameEncoding = VideoFrameEncoding::UYVY;
+		videoState->eotf = EOTF::SDR;
+		videoState->colorspace = ColorSpace::REC_709;
+		return videoState;
+	}
+
+
+	// Read a part of the recorded file
+	static std::vector<BYTE> ReadRawCapture(uint64_t offset, size_t size)
+	{
+		std::vector<BYTE> data(size);
+
+		FILE* file = nullptr;
+		Assert::AreEqual(0, (int)_tfopen_s(&file, RAW_CAPTURE_TEST_PATH, TEXT("rb")));
+		Assert::AreEqual(0, _fseeki64(file, (int64_t)offset, SEEK_SET));
+		Assert::AreEqual(size, fread(data.data(), 1, size, file));
+		fclose(file);
+
+		return data;
+	}
+
+
+	TEST_CLASS(RawCaptureRecorderTests)
+	{
+	public:
+
+		TEST_METHOD(RawCaptureRecorderRoundTripTest)
+		{
+			// 128x128 UYVY frames are page sized and written directly from the page aligned capture
+			// buffers, 100x100 ones are not and go through the staging buffers.
+			const uint32_t alignedFrameSize = 128 * 128 * 2;
+			const uint32_t unalignedFrameSize = 100 * 100 * 2;
+			const int frameCount = 20;
+
+			FrameBufferPool capturePool(alignedFrameSize, 4, FrameBufferPool::ALIGNMENT_PAGE);
+
+			{
+				RawCaptureRecorder recorder(RAW_CAPTURE_TEST_PATH, 16 * 1024 * 1024, 1000);
+
+				// Frames are ignored until started and dropped until there is a state
+				FrameBuffer* buffer = capturePool.Acquire();
+				VideoFrame lostFrame(buffer->Data(), 99, 0, buffer);
+				recorder.OnVideoFrame(lostFrame);
+				Assert::AreEqual((uint64_t)0, recorder.DroppedFrameCount());
+
+				recorder.Start();
+				recorder.OnVideoFrame(lostFrame);
+				Assert::AreEqual((uint64_t)1, recorder.DroppedFrameCount());
+				buffer->Release();
+
+				for (int i = 0; i < frameCount; i++)
+				{
+					if (i == 0)
+						recorder.OnVideoState(RawCaptureTestState(128, 128));
+					if (i == frameCount / 2)
+						recorder.OnVideoState(RawCaptureTestState(100, 100));
+
+					// Wait for room rather than testing the drops
+					while (recorder.Backlog() >= RawCaptureRecorder::DEFAULT_MAX_QUEUED_FRAMES)
+						Sleep(1);
+
+					buffer = nullptr;
+					while (!buffer)
+						buffer = capturePool.Acquire();
+
+					memset(buffer->Data(), i + 1, alignedFrameSize);
+
+					VideoFrame videoFrame(buffer->Data(), i, i * 1001, buffer);
+					recorder.OnVideoFrame(videoFrame);
+					buffer->Release();
+				}
+
+				recorder.Stop();
+
+				Assert::AreEqual((uint64_t)frameCount, recorder.RecordedFrameCount());
+				Assert::AreEqual((uint64_t)1, recorder.DroppedFrameCount());
+				Assert::AreEqual(0u, recorder.Backlog());
+				Assert::AreEqual(
+					(frameCount / 2) * (alignedFrameSize + RawCaptureAlign(unalignedFrameSize)),
+					recorder.BytesWritten());
+			}
+
+			// All capture buffers are given back
+			Assert::AreEqual(0u, capturePool.GetInUseCount());
+
+			const std::vector<BYTE> headerData = ReadRawCapture(0, sizeof(RawCaptureFileHeader));
+			const RawCaptureFileHeader& header = *(const RawCaptureFileHeader*)headerData.data();
+
+			Assert::AreEqual(RAW_CAPTURE_MAGIC, header.magic);
+			Assert::AreEqual(RAW_CAPTURE_VERSION, header.version);
+			Assert::AreEqual((int64_t)1000, header.timingClockTicksPerSecond);
+			Assert::AreEqual(2u, header.stateCount);
+			Assert::AreEqual((uint64_t)frameCount, header.frameCount);
+			Assert::AreEqual((uint64_t)1, header.droppedFrameCount);
+			Assert::AreEqual(header.dataEndOffset, header.stateTableOffset);
+
+			const std::vector<BYTE> stateData = ReadRawCapture(header.stateTableOffset, 2 * sizeof(RawCaptureStateRecord));
+			const RawCaptureStateRecord* states = (const RawCaptureStateRecord*)stateData.data();
+
+			Assert::AreEqual(alignedFrameSize, states[0].bytesPerFrame);
+			Assert::AreEqual(unalignedFrameSize, states[1].bytesPerFrame);
+
+			VideoStateComPtr videoState = FromRawCaptureStateRecord(states[1]);
+			Assert::IsTrue(videoState->valid);
+			Assert::AreEqual(100u, videoState->displayMode->FrameWidth());
+			Assert::IsTrue(videoState->videoFrameEncoding == VideoFrameEncoding::UYVY);
+			Assert::IsTrue(videoState->colorspace == ColorSpace::REC_709);
+
+			const std::vector<BYTE> indexData = ReadRawCapture(header.indexOffset, frameCount * sizeof(RawCaptureIndexEntry));
+			const RawCaptureIndexEntry* index = (const RawCaptureIndexEntry*)indexData.data();
+
+			for (int i = 0; i < frameCount; i++)
+			{
+				const uint32_t stateId = (i < frameCount / 2) ? 0 : 1;
+
+				Assert::AreEqual((uint64_t)i, index[i].counter);
+				Assert::AreEqual((int64_t)i * 1001, index[i].timingTimestamp);
+				Assert::AreEqual(stateId, index[i].stateId);
+				Assert::AreEqual(states[stateId].bytesPerFrame, index[i].size);
+				Assert::AreEqual((uint64_t)0, index[i].offset % RAW_CAPTURE_ALIGNMENT);
+
+				const std::vector<BYTE> frameData = ReadRawCapture(index[i].offset, index[i].size);
+				for (BYTE b : frameData)
+					Assert::AreEqual((BYTE)(i + 1), b);
+			}
+
+			DeleteFile(RAW_CAPTURE_TEST_PATH);
+		}
+
+		TEST_METHOD(RawCaptureRecorderFileFullTest)
+		{
+			// Room for the header, the state table reserve, one index page and three frames
+			const uint32_t frameSize = 128 * 128 * 2;
+			const uint64_t stateTableReserve = RawCaptureAlign(RawCaptureRecorder::MAX_STATE_COUNT * sizeof(RawCaptureStateRecord));
+			const uint64_t fileSize = RAW_CAPTURE_ALIGNMENT * 2 + stateTableReserve + frameSize * 3;
+
+			FrameBufferPool capturePool(frameSize, 1, FrameBufferPool::ALIGNMENT_PAGE);
+
+			{
+				RawCaptureRecorder recorder(RAW_CAPTURE_TEST_PATH, fileSize, 1000);
+				recorder.OnVideoState(RawCaptureTestState(128, 128));
+				recorder.Start();
+
+				for (int i = 0; i < 10; i++)
+				{
+					FrameBuffer* buffer = nullptr;
+					while (!buffer)
+						buffer = capturePool.Acquire();
+
+					VideoFrame videoFrame(buffer->Data(), i, i, buffer);
+					recorder.OnVideoFrame(videoFrame);
+					buffer->Release();
+				}
+
+				recorder.Stop();
+
+				// Frames which didn't fit are dropped rather than written past the end
+				Assert::AreEqual((uint64_t)3, recorder.RecordedFrameCount());
+				Assert::AreEqual((uint64_t)7, recorder.DroppedFrameCount());
+			}
+
+			Assert::AreEqual(0u, capturePool.GetInUseCount());
+
+			const std::vector<BYTE> headerData = ReadRawCapture(0, sizeof(RawCaptureFileHeader));
+			const RawCaptureFileHeader& header = *(const RawCaptureFileHeader*)headerData.data();
+			Assert::AreEqual((uint64_t)3, header.frameCount);
+			Assert::AreEqual((uint64_t)RAW_CAPTURE_ALIGNMENT + frameSize * 3, header.dataEndOffset);
+
+			DeleteFile(RAW_CAPTURE_TEST_PATH);
+		}
+	};
+}
@@ -0,0 +1,343 @@
+/*
+ * Copyright(C) 2021 Dennis Fleurbaaij <mail@dennisfleurbaaij.com>
+ *
+ * This program is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, version 3.
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License along with this program. If not, see < https://www.gnu.org/licenses/>.
+ */
+
+
+
+#include "pch.h"
+#include "CppUnitTest.h"
+
+#include <chrono>
+#include <functional>
+#include <mutex>
+#include <vector>
+
+#include <raw_capture/RawCaptureRecorder.h>
+#include <raw_capture/RawCaptureReplayDevice.h>
+#include <FrameBufferPool.h>
+
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace Tests
+{
+	static const TCHAR* RAW_CAPTURE_REPLAY_TEST_PATH = TEXT("RawCaptureReplayDeviceTest.vprc");
+	static const int RAW_CAPTURE_REPLAY_TEST_FRAME_COUNT = 20;
+
+
+	static VideoStateComPtr ReplayTestState(unsigned int frameSize, EOTF eotf)
+	{
+		VideoStateComPtr videoState = new VideoState();
+		videoState->valid = true;
+		videoState->displayMode = std::make_shared<DisplayMode>(frameSize, frameSize, false, 60000, 1001);
+		videoState->videoFrameEncoding = VideoFrameEncoding::UYVY;
+		videoState->eotf = eotf;
+		videoState->colorspace = ColorSpace::REC_709;
+		return videoState;
+	}
+
+
+	// Records frames 0-9 as 128x128 SDR and 10-19 as 100x100 PQ, 10 ms apart and filled with
+	// their counter + 1. In between the input goes away and comes back as 112x112 SDR without
+	// any frames, after the last frame it goes away again.
+	static void RecordReplayTestFile()
+	{
+		FrameBufferPool capturePool(128 * 128 * 2, 4, FrameBufferPool::ALIGNMENT_PAGE);
+		RawCaptureRecorder recorder(RAW_CAPTURE_REPLAY_TEST_PATH, 16 * 1024 * 1024, 1000);
+		recorder.Start();
+
+		for (int i = 0; i < RAW_CAPTURE_REPLAY_TEST_FRAME_COUNT; i++)
+		{
+			if (i == 0)
+				recorder.OnVideoState(ReplayTestState(128, EOTF::SDR));
+
+			if (i == RAW_CAPTURE_REPLAY_TEST_FRAME_COUNT / 2)
+			{
+				recorder.OnVideoState(new VideoState());
+				recorder.OnVideoState(ReplayTestState(112, EOTF::SDR));
+				recorder.OnVideoState(ReplayTestState(100, EOTF::PQ));
+			}
+
+			while (recorder.Backlog() >= RawCaptureRecorder::DEFAULT_MAX_QUEUED_FRAMES)
+				Sleep(1);
+
+			FrameBuffer* buffer = nullptr;
+			while (!buffer)
+				buffer = capturePool.Acquire();
+
+			memset(buffer->Data(), i + 1, capturePool.GetBufferSize());
+
+			VideoFrame videoFrame(buffer->Data(), i, i * 10, buffer);
+			recorder.OnVideoFrame(videoFrame);
+			buffer->Release();
+		}
+
+		recorder.OnVideoState(new VideoState());
+
+		recorder.Stop();
+		Assert::AreEqual((uint64_t)RAW_CAPTURE_REPLAY_TEST_FRAME_COUNT, recorder.RecordedFrameCount());
+	}
+
+
+	// Keeps the video states and frames in the order they came in
+	class RecordingCaptureDeviceCallback:
+		public ICaptureDeviceCallback
+	{
+	public:
+
+		struct Event
+		{
+			bool isFrame;
+
+			// Frames
+			uint64_t counter;
+			timingclocktime_t timingTimestamp;
+			BYTE firstByte;
+
+			// Video states, 0 if not valid
+			unsigned int frameWidth;
+			EOTF eotf;
+		};
+
+		std::mutex mutex;
+		std::vector<Event> events;
+
+		void OnCaptureDeviceState(CaptureDeviceState) override {}
+		void OnCaptureDeviceCardStateChange(CaptureDeviceCardStateComPtr) override {}
+		void OnCaptureDeviceError(const CString&) override {}
+
+		void OnCaptureDeviceVideoStateChange(VideoStateComPtr videoState) override
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+
+			Event event = {};
+			event.frameWidth = videoState->valid ? videoState->displayMode->FrameWidth() : 0;
+			event.eotf = videoState->eotf;
+			events.push_back(event);
+		}
+
+		void OnCaptureDeviceVideoFrame(VideoFrame& videoFrame) override
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+
+			Event event = {};
+			event.isFrame = true;
+			event.counter = videoFrame.GetCounter();
+			event.timingTimestamp = videoFrame.GetTimingTimestamp();
+			event.firstByte = *(const BYTE*)videoFrame.GetData();
+			events.push_back(event);
+		}
+	};
+
+
+	// Replay until all frames are out, returns how long that took
+	static double ReplayTestFile(RawCaptureReplayDevice::Config config, RecordingCaptureDeviceCallback& callback)
+	{
+		config.path = RAW_CAPTURE_REPLAY_TEST_PATH;
+		ACaptureDeviceComPtr captureDevice = new RawCaptureReplayDevice(config);
+		RawCaptureReplayDevice& replayDevice = static_cast<RawCaptureReplayDevice&>(*captureDevice);
+
+		captureDevice->SetCallbackHandler(&callback);
+
+		const auto start = std::chrono::steady_clock::now();
+		captureDevice->StartCapture();
+
+		const auto timeout = start + std::chrono::seconds(5);
+		while (!replayDevice.IsFinished() && std::chrono::steady_clock::now() < timeout)
+			Sleep(1);
+
+		const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+		Assert::IsTrue(replayDevice.IsFinished());
+		Assert::AreEqual((uint64_t)RAW_CAPTURE_REPLAY_TEST_FRAME_COUNT, captureDevice->VideoFrameCapturedCount());
+		Assert::AreEqual((uint64_t)0, captureDevice->VideoFrameMissedCount());
+
+		captureDevice->StopCapture();
+		captureDevice->SetCallbackHandler(nullptr);
+
+		return seconds;
+	}
+
+
+	TEST_CLASS(RawCaptureReplayDeviceTests)
+	{
+	public:
+
+		TEST_METHOD(RawCaptureReplayDeviceRoundTripTest)
+		{
+			RecordReplayTestFile();
+
+			RawCaptureReplayDevice::Config config;
+			config.unthrottled = true;
+			config.bufferCount = 2;
+
+			RecordingCaptureDeviceCallback callback;
+			ReplayTestFile(config, callback);
+
+			// Invalid state on subscribing, then every recorded state at its place between the frames
+			const std::vector<RecordingCaptureDeviceCallback::Event>& events = callback.events;
+			Assert::AreEqual((size_t)RAW_CAPTURE_REPLAY_TEST_FRAME_COUNT + 6, events.size());
+
+			Assert::IsFalse(events[0].isFrame);
+			Assert::AreEqual(0u, events[0].frameWidth);
+
+			Assert::IsFalse(events[1].isFrame);
+			Assert::AreEqual(128u, events[1].frameWidth);
+			Assert::IsTrue(events[1].eotf == EOTF::SDR);
+
+			const size_t secondStatesEvent = 2 + RAW_CAPTURE_REPLAY_TEST_FRAME_COUNT / 2;
+			Assert::IsTrue(events[secondStatesEvent - 1].isFrame);
+
+			Assert::IsFalse(events[secondStatesEvent].isFrame);
+			Assert::AreEqual(0u, events[secondStatesEvent].frameWidth);
+
+			Assert::IsFalse(events[secondStatesEvent + 1].isFrame);
+			Assert::AreEqual(112u, events[secondStatesEvent + 1].frameWidth);
+
+			Assert::IsFalse(events[secondStatesEvent + 2].isFrame);
+			Assert::AreEqual(100u, events[secondStatesEvent + 2].frameWidth);
+			Assert::IsTrue(events[secondStatesEvent + 2].eotf == EOTF::PQ);
+
+			Assert::IsTrue(events[secondStatesEvent + 3].isFrame);
+
+			Assert::IsFalse(events.back().isFrame);
+			Assert::AreEqual(0u, events.back().frameWidth);
+
+			uint64_t counter = 0;
+			for (const RecordingCaptureDeviceCallback::Event& event : events)
+			{
+				if (!event.isFrame)
+					continue;
+
+				Assert::AreEqual(counter, event.counter);
+				Assert::AreEqual((timingclocktime_t)counter * 10, event.timingTimestamp);
+				Assert::AreEqual((BYTE)(counter + 1), event.firstByte);
+				++counter;
+			}
+
+			DeleteFile(RAW_CAPTURE_REPLAY_TEST_PATH);
+		}
+
+		TEST_METHOD(RawCaptureReplayDeviceTimingTest)
+		{
+			RecordReplayTestFile();
+
+			// Frames are 10 ms apart, the last one can't come before 190 ms
+			RawCaptureReplayDevice::Config config;
+			RecordingCaptureDeviceCallback callback;
+			const double seconds = ReplayTestFile(config, callback);
+
+			Assert::IsTrue(seconds >= 0.18);
+
+			DeleteFile(RAW_CAPTURE_REPLAY_TEST_PATH);
+		}
+
+		TEST_METHOD(RawCaptureReplayDeviceUnfinishedTest)
+		{
+			// Header of a recording which never got stopped
+			std::vector<BYTE> headerBlock(RAW_CAPTURE_ALIGNMENT, 0);
+			RawCaptureFileHeader& header = *(RawCaptureFileHeader*)headerBlock.data();
+			header.magic = RAW_CAPTURE_MAGIC;
+			header.version = RAW_CAPTURE_VERSION;
+			header.alignment = RAW_CAPTURE_ALIGNMENT;
+			header.timingClockTicksPerSecond = 1000;
+
+			FILE* file = nullptr;
+			Assert::AreEqual(0, (int)_tfopen_s(&file, RAW_CAPTURE_REPLAY_TEST_PATH, TEXT("wb")));
+			Assert::AreEqual(headerBlock.size(), fwrite(headerBlock.data(), 1, headerBlock.size(), file));
+			fclose(file);
+
+			RawCaptureReplayDevice::Config config;
+			config.path = RAW_CAPTURE_REPLAY_TEST_PATH;
+
+			bool thrown = false;
+			try
+			{
+				RawCaptureReplayDevice replayDevice(config);
+			}
+			catch (std::runtime_error&)
+			{
+				thrown = true;
+			}
+
+			Assert::IsTrue(thrown);
+
+			DeleteFile(RAW_CAPTURE_REPLAY_TEST_PATH);
+		}
+
+		TEST_METHOD(RawCaptureReplayDeviceCorruptIndexTest)
+		{
+			RecordReplayTestFile();
+
+			std::vector<BYTE> recording;
+			{
+				FILE* file = nullptr;
+				Assert::AreEqual(0, (int)_tfopen_s(&file, RAW_CAPTURE_REPLAY_TEST_PATH, TEXT("rb")));
+
+				BYTE block[RAW_CAPTURE_ALIGNMENT];
+				size_t read;
+				while ((read = fread(block, 1, sizeof(block), file)) > 0)
+					recording.insert(recording.end(), block, block + read);
+
+				fclose(file);
+			}
+
+			// Opens a patched copy of the recording, true if it got rejected
+			const auto isRejected = [&](const std::function<void(BYTE*)>& patch)
+			{
+				std::vector<BYTE> corrupted = recording;
+				patch(corrupted.data());
+
+				FILE* file = nullptr;
+				Assert::AreEqual(0, (int)_tfopen_s(&file, RAW_CAPTURE_REPLAY_TEST_PATH, TEXT("wb")));
+				Assert::AreEqual(corrupted.size(), fwrite(corrupted.data(), 1, corrupted.size(), file));
+				fclose(file);
+
+				RawCaptureReplayDevice::Config config;
+				config.path = RAW_CAPTURE_REPLAY_TEST_PATH;
+
+				try
+				{
+					RawCaptureReplayDevice replayDevice(config);
+				}
+				catch (std::runtime_error&)
+				{
+					return true;
+				}
+
+				return false;
+			};
+
+			Assert::IsFalse(isRejected([](BYTE*) {}));
+
+			// Offset past the end of the frame data
+			Assert::IsTrue(isRejected([](BYTE* data)
+			{
+				const RawCaptureFileHeader& header = *(const RawCaptureFileHeader*)data;
+				RawCaptureIndexEntry* index = (RawCaptureIndexEntry*)(data + header.indexOffset);
+				index[header.frameCount - 1].offset = header.dataEndOffset + RAW_CAPTURE_ALIGNMENT;
+			}));
+
+			// Stored frame size agrees with the index, but not with the state itself
+			Assert::IsTrue(isRejected([](BYTE* data)
+			{
+				const RawCaptureFileHeader& header = *(const RawCaptureFileHeader*)data;
+				RawCaptureStateRecord* states = (RawCaptureStateRecord*)(data + header.stateTableOffset);
+				RawCaptureIndexEntry* index = (RawCaptureIndexEntry*)(data + header.indexOffset);
+
+				states[0].bytesPerFrame = 64;
+				for (uint64_t i = 0; i < header.frameCount; ++i)
+				{
+					if (index[i].stateId == 0)
+						index[i].size = 64;
+				}
+			}));
+
+			DeleteFile(RAW_CAPTURE_REPLAY_TEST_PATH);
+		}
+	};
+}
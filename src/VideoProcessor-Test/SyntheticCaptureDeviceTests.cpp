@@ -0,0 +1,276 @@
+/*
+ * Copyright(C) 2021 Dennis Fleurbaaij <mail@dennisfleurbaaij.com>
+ *
+ * This program is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, version 3.
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License along with this program. If not, see < https://www.gnu.org/licenses/>.
+ */
+
+
+
+#include "pch.h"
+#include "CppUnitTest.h"
+
+#include <chrono>
+#include <functional>
+#include <mutex>
+#include <vector>
+
+#include <synthetic/SyntheticCaptureDevice.h>
+#include <VideoFrameHandle.h>
+
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace Tests
+{
+	// Keeps the callbacks in the order they came in, holds on to the frames while asked to
+	class SyntheticTestCaptureDeviceCallback:
+		public ICaptureDeviceCallback
+	{
+	public:
+
+		enum class EventType { STATE, CARD_STATE, VIDEO_STATE, VIDEO_FRAME };
+
+		struct Event
+		{
+			EventType type;
+
+			CaptureDeviceState state;
+
+			// Video states
+			bool valid;
+			EOTF eotf;
+
+			// Frames
+			uint64_t counter;
+		};
+
+		std::mutex mutex;
+		std::vector<Event> events;
+		uint64_t videoFrameCount = 0;
+
+		bool holdVideoFrames = false;
+		std::vector<VideoFrameHandle> heldVideoFrames;
+
+		void OnCaptureDeviceState(CaptureDeviceState state) override
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+
+			Event event = {};
+			event.type = EventType::STATE;
+			event.state = state;
+			events.push_back(event);
+		}
+
+		void OnCaptureDeviceCardStateChange(CaptureDeviceCardStateComPtr) override
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+
+			Event event = {};
+			event.type = EventType::CARD_STATE;
+			events.push_back(event);
+		}
+
+		void OnCaptureDeviceVideoStateChange(VideoStateComPtr videoState) override
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+
+			Event event = {};
+			event.type = EventType::VIDEO_STATE;
+			event.valid = videoState->valid;
+			event.eotf = videoState->eotf;
+			events.push_back(event);
+		}
+
+		void OnCaptureDeviceVideoFrame(VideoFrame& videoFrame) override
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+
+			Event event = {};
+			event.type = EventType::VIDEO_FRAME;
+			event.counter = videoFrame.GetCounter();
+			events.push_back(event);
+
+			++videoFrameCount;
+
+			if (holdVideoFrames)
+				heldVideoFrames.push_back(VideoFrameHandle(videoFrame));
+		}
+
+		void OnCaptureDeviceError(const CString&) override {}
+	};
+
+
+	static SyntheticCaptureDevice::Config SyntheticTestConfig()
+	{
+		SyntheticCaptureDevice::Config config;
+		config.displayMode = std::make_shared<DisplayMode>(128, 128, false /* interlaced */, 60000, 1001);
+		config.videoFrameEncoding = VideoFrameEncoding::UYVY;
+		config.bufferCount = 2;
+		return config;
+	}
+
+
+	// Poll until the condition holds, false on timeout
+	static bool SyntheticTestWaitFor(const std::function<bool()>& condition)
+	{
+		const auto timeout = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+		while (!condition())
+		{
+			if (std::chrono::steady_clock::now() >= timeout)
+				return false;
+
+			Sleep(1);
+		}
+
+		return true;
+	}
+
+
+	TEST_CLASS(SyntheticCaptureDeviceTests)
+	{
+	public:
+
+		TEST_METHOD(SyntheticCaptureDeviceStateOrderTest)
+		{
+			SyntheticCaptureDevice::Config config = SyntheticTestConfig();
+			config.unthrottled = true;
+			config.alternateIntervalFrames = 4;
+
+			ACaptureDeviceComPtr captureDevice = new SyntheticCaptureDevice(config);
+
+			SyntheticTestCaptureDeviceCallback callback;
+			captureDevice->SetCallbackHandler(&callback);
+
+			captureDevice->StartCapture();
+			Assert::IsTrue(SyntheticTestWaitFor([&]() { return captureDevice->VideoFrameCapturedCount() >= 40; }));
+			captureDevice->StopCapture();
+			captureDevice->SetCallbackHandler(nullptr);
+
+			// Subscribing gets the current state, capturing starts with the state, the card
+			// state and the video state before the first frame
+			const std::vector<SyntheticTestCaptureDeviceCallback::Event>& events = callback.events;
+			Assert::IsTrue(events.size() > 6);
+
+			Assert::IsTrue(events[0].type == SyntheticTestCaptureDeviceCallback::EventType::STATE);
+			Assert::IsTrue(events[0].state == CaptureDeviceState::CAPTUREDEVICESTATE_READY);
+			Assert::IsTrue(events[1].type == SyntheticTestCaptureDeviceCallback::EventType::VIDEO_STATE);
+			Assert::IsFalse(events[1].valid);
+
+			Assert::IsTrue(events[2].type == SyntheticTestCaptureDeviceCallback::EventType::STATE);
+			Assert::IsTrue(events[2].state == CaptureDeviceState::CAPTUREDEVICESTATE_CAPTURING);
+			Assert::IsTrue(events[3].type == SyntheticTestCaptureDeviceCallback::EventType::CARD_STATE);
+			Assert::IsTrue(events[4].type == SyntheticTestCaptureDeviceCallback::EventType::VIDEO_STATE);
+			Assert::IsTrue(events[4].valid);
+			Assert::IsTrue(events[4].eotf == EOTF::SDR);
+
+			// Every 4 frames the EOTF switches, the new video state goes out right before the
+			// first frame it applies to
+			EOTF eotf = EOTF::SDR;
+			uint64_t counter = 0;
+			for (size_t i = 5; i < events.size() - 1; ++i)
+			{
+				const SyntheticTestCaptureDeviceCallback::Event& event = events[i];
+				if (event.type == SyntheticTestCaptureDeviceCallback::EventType::VIDEO_STATE)
+				{
+					Assert::IsTrue(event.valid);
+					Assert::IsTrue(event.eotf != eotf);
+					eotf = event.eotf;
+
+					Assert::IsTrue(events[i + 1].type == SyntheticTestCaptureDeviceCallback::EventType::VIDEO_FRAME);
+					Assert::AreEqual((uint64_t)0, events[i + 1].counter % 4);
+					continue;
+				}
+
+				Assert::IsTrue(event.type == SyntheticTestCaptureDeviceCallback::EventType::VIDEO_FRAME);
+				Assert::AreEqual(counter, event.counter);
+				Assert::IsTrue(eotf == (((counter / 4) % 2) == 1 ? EOTF::PQ : EOTF::SDR));
+				++counter;
+			}
+
+			Assert::IsTrue(events.back().type == SyntheticTestCaptureDeviceCallback::EventType::STATE);
+			Assert::IsTrue(events.back().state == CaptureDeviceState::CAPTUREDEVICESTATE_READY);
+
+			// Counts frames, not the last counter
+			Assert::AreEqual(counter, captureDevice->VideoFrameCapturedCount());
+			Assert::AreEqual((uint64_t)0, captureDevice->VideoFrameMissedCount());
+		}
+
+		TEST_METHOD(SyntheticCaptureDeviceDropTest)
+		{
+			SyntheticCaptureDevice::Config config = SyntheticTestConfig();
+			config.unthrottled = true;
+			config.clock.dropProbability = 0.25;
+			config.clock.seed = 7;
+
+			ACaptureDeviceComPtr captureDevice = new SyntheticCaptureDevice(config);
+
+			SyntheticTestCaptureDeviceCallback callback;
+			captureDevice->SetCallbackHandler(&callback);
+
+			captureDevice->StartCapture();
+			Assert::IsTrue(SyntheticTestWaitFor([&]() { return captureDevice->VideoFrameCapturedCount() >= 200; }));
+			captureDevice->StopCapture();
+			captureDevice->SetCallbackHandler(nullptr);
+
+			// Dropped frames are gaps in the counter and count as missed
+			uint64_t nextCounter = 0;
+			uint64_t gaps = 0;
+			for (const SyntheticTestCaptureDeviceCallback::Event& event : callback.events)
+			{
+				if (event.type != SyntheticTestCaptureDeviceCallback::EventType::VIDEO_FRAME)
+					continue;
+
+				Assert::IsTrue(event.counter >= nextCounter);
+				gaps += event.counter - nextCounter;
+				nextCounter = event.counter + 1;
+			}
+
+			Assert::IsTrue(gaps > 0);
+
+			const uint64_t capturedCount = captureDevice->VideoFrameCapturedCount();
+			Assert::IsTrue(capturedCount >= nextCounter);
+			Assert::AreEqual(gaps + (capturedCount - nextCounter), captureDevice->VideoFrameMissedCount());
+			Assert::AreEqual(capturedCount, callback.videoFrameCount + captureDevice->VideoFrameMissedCount());
+		}
+
+		TEST_METHOD(SyntheticCaptureDeviceBufferReleaseTest)
+		{
+			ACaptureDeviceComPtr captureDevice = new SyntheticCaptureDevice(SyntheticTestConfig());
+
+			SyntheticTestCaptureDeviceCallback callback;
+			callback.holdVideoFrames = true;
+			captureDevice->SetCallbackHandler(&callback);
+
+			captureDevice->StartCapture();
+
+			// With both buffers held downstream the next frames are missed
+			Assert::IsTrue(SyntheticTestWaitFor([&]() { return captureDevice->VideoFrameMissedCount() >= 3; }));
+
+			uint64_t videoFrameCount;
+			{
+				std::lock_guard<std::mutex> lock(callback.mutex);
+				Assert::AreEqual((uint64_t)2, callback.videoFrameCount);
+
+				videoFrameCount = callback.videoFrameCount;
+				callback.holdVideoFrames = false;
+				callback.heldVideoFrames.clear();
+			}
+
+			// Released buffers get used again
+			Assert::IsTrue(SyntheticTestWaitFor([&]()
+			{
+				std::lock_guard<std::mutex> lock(callback.mutex);
+				return callback.videoFrameCount >= videoFrameCount + 3;
+			}));
+
+			captureDevice->StopCapture();
+			captureDevice->SetCallbackHandler(nullptr);
+
+			Assert::AreEqual(
+				captureDevice->VideoFrameCapturedCount(),
+				callback.videoFrameCount + captureDevice->VideoFrameMissedCount());
+		}
+	};
+}
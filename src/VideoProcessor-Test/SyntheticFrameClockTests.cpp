@@ -0,0 +1,158 @@
+/*
+ * Copyright(C) 2021 Dennis Fleurbaaij <mail@dennisfleurbaaij.com>
+ *
+ * This program is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, version 3.
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License along with this program. If not, see < https://www.gnu.org/licenses/>.
+ */
+
+
+
+#include "pch.h"
+#include "CppUnitTest.h"
+
+#include <cmath>
+
+#include <synthetic/SyntheticFrameClock.h>
+
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace Tests
+{
+	TEST_CLASS(SyntheticFrameClockTests)
+	{
+	public:
+
+		TEST_METHOD(SyntheticFrameClockCadenceTest)
+		{
+			// 23.976, not a whole amount of ticks per frame
+			SyntheticFrameClock::Config config;
+			SyntheticFrameClock clock(config, 24000, 1001);
+
+			const int frameCount = 24000;
+			SyntheticFrameClock::Frame first = clock.NextFrame();
+			SyntheticFrameClock::Frame last = first;
+			for (int i = 1; i < frameCount; i++)
+			{
+				SyntheticFrameClock::Frame frame = clock.NextFrame();
+				Assert::AreEqual((uint64_t)i, frame.counter);
+				Assert::IsFalse(frame.dropped);
+
+				// Whole ticks, so every frame is either floor or ceil of the exact duration
+				const timingclocktime_t interval = frame.timestamp - last.timestamp;
+				Assert::IsTrue(interval == 41708 || interval == 41709);
+				last = frame;
+			}
+
+			// No accumulated error
+			const double expected = (frameCount - 1) * 1001.0 * SyntheticFrameClock::CLOCK_TICKS_PER_SECOND / 24000.0;
+			Assert::IsTrue(std::fabs((last.timestamp - first.timestamp) - expected) <= 1.0);
+
+			// Callback after the latency at the ideal time, no drift so host time equals clock time
+			Assert::AreEqual(0.001, first.callbackTimeS, 1e-9);
+			Assert::AreEqual(expected / SyntheticFrameClock::CLOCK_TICKS_PER_SECOND + 0.001, last.callbackTimeS, 1e-6);
+		}
+
+		TEST_METHOD(SyntheticFrameClockDriftTest)
+		{
+			SyntheticFrameClock::Config config;
+			config.driftPpm = 100.0;
+			SyntheticFrameClock clock(config, 60, 1);
+
+			// Clock runs fast, 100us per second
+			Assert::AreEqual(SyntheticFrameClock::START_TICKS + 0, clock.TicksAt(0.0));
+			Assert::AreEqual(SyntheticFrameClock::START_TICKS + 10001000, clock.TicksAt(10.0));
+			Assert::AreEqual(10.0, clock.HostTimeAt(SyntheticFrameClock::START_TICKS + 10001000), 1e-9);
+
+			// So frames come earlier in host time
+			SyntheticFrameClock::Frame frame;
+			for (int i = 0; i <= 600; i++)
+				frame = clock.NextFrame();
+
+			Assert::AreEqual(10.0 / 1.0001 + 0.001, frame.callbackTimeS, 1e-6);
+		}
+
+		TEST_METHOD(SyntheticFrameClockJitterTest)
+		{
+			SyntheticFrameClock::Config config;
+			config.timestampJitterUs = 200.0;
+			config.callbackJitterUs = 500.0;
+			SyntheticFrameClock clock(config, 50, 1);
+
+			const int frameCount = 50000;
+			double sum = 0.0;
+			double sumSquared = 0.0;
+			timingclocktime_t previousTimestamp = 0;
+
+			for (int i = 0; i < frameCount; i++)
+			{
+				const SyntheticFrameClock::Frame frame = clock.NextFrame();
+
+				Assert::IsTrue(frame.timestamp > previousTimestamp);
+				previousTimestamp = frame.timestamp;
+
+				// Callback never before the latency
+				const double idealS = i / 50.0;
+				Assert::IsTrue(frame.callbackTimeS >= idealS + 0.001 - 1e-9);
+
+				const double errorUs = (double)(frame.timestamp - SyntheticFrameClock::START_TICKS) - i * 20000.0;
+				sum += errorUs;
+				sumSquared += errorUs * errorUs;
+			}
+
+			const double mean = sum / frameCount;
+			const double stddev = std::sqrt(sumSquared / frameCount - mean * mean);
+			Assert::AreEqual(0.0, mean, 5.0);
+			Assert::AreEqual(200.0, stddev, 5.0);
+		}
+
+		TEST_METHOD(SyntheticFrameClockDropTest)
+		{
+			SyntheticFrameClock::Config config;
+			config.dropProbability = 0.05;
+			SyntheticFrameClock clock(config, 60, 1);
+
+			const int frameCount = 100000;
+			int droppedCount = 0;
+			for (int i = 0; i < frameCount; i++)
+			{
+				if (clock.NextFrame().dropped)
+					++droppedCount;
+			}
+
+			Assert::AreEqual(0.05, droppedCount / (double)frameCount, 0.005);
+		}
+
+		TEST_METHOD(SyntheticFrameClockSeedTest)
+		{
+			SyntheticFrameClock::Config config;
+			config.timestampJitterUs = 100.0;
+			config.callbackJitterUs = 100.0;
+			config.dropProbability = 0.1;
+
+			SyntheticFrameClock clock1(config, 60, 1);
+			SyntheticFrameClock clock2(config, 60, 1);
+
+			config.seed = 2;
+			SyntheticFrameClock clock3(config, 60, 1);
+
+			bool differs = false;
+			for (int i = 0; i < 1000; i++)
+			{
+				const SyntheticFrameClock::Frame frame1 = clock1.NextFrame();
+				const SyntheticFrameClock::Frame frame2 = clock2.NextFrame();
+				const SyntheticFrameClock::Frame frame3 = clock3.NextFrame();
+
+				Assert::AreEqual(frame1.timestamp, frame2.timestamp);
+				Assert::AreEqual(frame1.callbackTimeS, frame2.callbackTimeS);
+				Assert::AreEqual(frame1.dropped, frame2.dropped);
+
+				if (frame1.timestamp != frame3.timestamp)
+					differs = true;
+			}
+
+			Assert::IsTrue(differs);
+		}
+	};
+}
@@ -0,0 +1,148 @@
+/*
+ * Copyright(C) 2021 Dennis Fleurbaaij <mail@dennisfleurbaaij.com>
+ *
+ * This program is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, version 3.
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License along with this program. If not, see < https://www.gnu.org/licenses/>.
+ */
+
+
+#include "pch.h"
+#include "CppUnitTest.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include <TimingClockModel.h>
+
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace Tests
+{
+	// Synthetic hardware clock in us which drifts against a 10MHz counter, reads take a few
+	// counter ticks and the clock is read somewhere within that bracket.
+	class SyntheticDriftingClock
+	{
+	public:
+
+		static const timingclocktime_t CLOCK_TICKS_PER_SECOND = 1000000;
+		static const int64_t COUNTER_TICKS_PER_SECOND = 10000000;
+
+		double driftPpm;
+		timingclocktime_t clockOffset = 123456789;
+		int64_t counter = 987654321;
+
+		SyntheticDriftingClock(double driftPpm):
+			driftPpm(driftPpm)
+		{
+		}
+
+		// The exact clock time at a counter value
+		timingclocktime_t ClockTimeAt(int64_t atCounter) const
+		{
+			const double seconds = (double)atCounter / COUNTER_TICKS_PER_SECOND;
+			return clockOffset + (timingclocktime_t)floor(seconds * CLOCK_TICKS_PER_SECOND * (1.0 + driftPpm / 1000000.0));
+		}
+
+		// Read the clock after advancing by intervalS, the read takes readTicks counter ticks
+		// and happens at readAt (0..1) within it.
+		bool Sample(TimingClockModel& model, double intervalS, int64_t readTicks, double readAt)
+		{
+			counter += (int64_t)(intervalS * COUNTER_TICKS_PER_SECOND);
+
+			const int64_t counterBefore = counter;
+			const timingclocktime_t clockTime = ClockTimeAt(counter + (int64_t)(readTicks * readAt));
+			counter += readTicks;
+
+			return model.AddSample(counterBefore, clockTime, counter);
+		}
+
+		// Largest prediction error over the next second, in clock ticks (us)
+		timingclocktime_t MaxPredictionError(const TimingClockModel& model) const
+		{
+			timingclocktime_t maxError = 0;
+			for (int64_t c = counter; c < counter + COUNTER_TICKS_PER_SECOND; c += COUNTER_TICKS_PER_SECOND / 100)
+				maxError = std::max(maxError, std::abs(model.ClockTimeAt(c) - ClockTimeAt(c)));
+
+			return maxError;
+		}
+	};
+
+
+	TEST_CLASS(TimingClockModelTests)
+	{
+	public:
+
+		TEST_METHOD(TimingClockModelDriftTest)
+		{
+			SyntheticDriftingClock clock(50.0);
+			TimingClockModel model(SyntheticDriftingClock::CLOCK_TICKS_PER_SECOND, SyntheticDriftingClock::COUNTER_TICKS_PER_SECOND);
+
+			Assert::IsFalse(model.IsValid());
+
+			uint32_t seed = 1;
+			for (uint32_t i = 0; i < TimingClockModel::WINDOW_SIZE; i++)
+			{
+				seed = seed * 1664525 + 1013904223;
+				Assert::IsTrue(clock.Sample(model, 0.25, 20 + (seed >> 28), (seed >> 16 & 0xff) / 255.0));
+			}
+
+			Assert::IsTrue(model.IsValid());
+			Assert::IsTrue(fabs(model.DriftPpm() - 50.0) < 2.0);
+			Assert::IsTrue(clock.MaxPredictionError(model) <= 3);
+			Assert::IsTrue(model.ResidualRmsUs() < 2.0);
+			Assert::AreEqual((uint64_t)0, model.RejectedSampleCount());
+		}
+
+		TEST_METHOD(TimingClockModelOutlierTest)
+		{
+			SyntheticDriftingClock clock(-30.0);
+			TimingClockModel model(SyntheticDriftingClock::CLOCK_TICKS_PER_SECOND, SyntheticDriftingClock::COUNTER_TICKS_PER_SECOND);
+
+			for (int i = 0; i < 32; i++)
+			{
+				// Preempted read, taken at the very end of a 10ms bracket
+				if (i % 5 == 4)
+				{
+					Assert::IsFalse(clock.Sample(model, 0.25, 100000, 1.0));
+					continue;
+				}
+
+				Assert::IsTrue(clock.Sample(model, 0.25, 20, 0.5));
+			}
+
+			// A single clock glitch
+			clock.clockOffset += 5000;
+			Assert::IsFalse(clock.Sample(model, 0.25, 20, 0.5));
+			clock.clockOffset -= 5000;
+
+			Assert::AreEqual((uint64_t)7, model.RejectedSampleCount());
+			Assert::IsTrue(fabs(model.DriftPpm() + 30.0) < 2.0);
+			Assert::IsTrue(clock.MaxPredictionError(model) <= 3);
+		}
+
+		TEST_METHOD(TimingClockModelStepTest)
+		{
+			SyntheticDriftingClock clock(10.0);
+			TimingClockModel model(SyntheticDriftingClock::CLOCK_TICKS_PER_SECOND, SyntheticDriftingClock::COUNTER_TICKS_PER_SECOND);
+
+			for (int i = 0; i < 16; i++)
+				Assert::IsTrue(clock.Sample(model, 0.25, 20, 0.5));
+
+			// Clock jumps, after a few rejected samples the model follows
+			clock.clockOffset += 1000000;
+
+			int rejectedCount = 0;
+			for (int i = 0; i < 32; i++)
+			{
+				if (!clock.Sample(model, 0.25, 20, 0.5))
+					++rejectedCount;
+			}
+
+			Assert::IsTrue(rejectedCount > 0 && rejectedCount < 16);
+			Assert::IsTrue(model.IsValid());
+			Assert::IsTrue(clock.MaxPredictionError(model) <= 3);
+		}
+	};
+}
@@ -1,7 +1,14 @@
 #include "pch.h"
 #include "CppUnitTest.h"
 
+#include <atomic>
+#include <functional>
+#include <random>
+#include <vector>
+
 #include <video_frame_formatter/CNoopVideoFrameFormatter.h>
+#include <video_frame_formatter/CRGBtoRGB48VideoFrameFormatter.h>
+#include <video_frame_formatter/CSlicedVideoFrameFormatter.h>
 #include <video_frame_formatter/CFFMpegDecoderVideoFrameFormatter.h>
 #include <video_frame_formatter/CV210toP010VideoFrameFormatter.h>
 #include <video_frame_formatter/CV210toP210VideoFrameFormatter.h>
@@ -11,6 +18,33 @@ using namespace Microsoft::VisualStudio::CppUnitTestFramework;
 
 namespace Tests
 {
+	// Formats nothing, every slice throws while failing is set
+	class FailingSliceVideoFrameFormatter:
+		public IVideoFrameFormatter
+	{
+	public:
+
+		std::atomic<bool> failing = true;
+
+		void OnVideoState(VideoStateComPtr& videoState) override { m_height = videoState->displayMode->FrameHeight(); }
+		bool FormatVideoFrame(const VideoFrame& inFrame, BYTE* outBuffer) override { return FormatVideoFrameSlice(inFrame, outBuffer, 0, m_height); }
+		LONG GetOutFrameSize() const override { return 1; }
+		uint32_t GetSliceLineAlignment() const override { return 1; }
+
+		bool FormatVideoFrameSlice(const VideoFrame&, BYTE*, uint32_t, uint32_t) override
+		{
+			if (failing)
+				throw std::runtime_error("Slice failed");
+
+			return true;
+		}
+
+	private:
+
+		uint32_t m_height = 0;
+	};
+
+
 	TEST_CLASS(VideoFrameFormatterTests)
 	{
 	public:
@@ -30,6 +64,38 @@ namespace Tests
 			Assert::AreEqual(5529600L, vff.GetOutFrameSize());
 		}
 
+		TEST_METHOD(CNoopVideoFrameFormatterSimdTest)
+		{
+			VideoStateComPtr vs = new VideoState();
+			vs->valid = true;
+			vs->displayMode = std::make_shared<DisplayMode>(1280, 720, false /* interlaced */, 60000, 1000);
+			vs->videoFrameEncoding = VideoFrameEncoding::V210;  // 3456 bytes per row
+
+			std::vector<uint32_t> inData(vs->BytesPerFrame() / sizeof(uint32_t));
+			std::mt19937 rng(1234);
+			for (uint32_t& v : inData)
+				v = rng();
+
+			const VideoFrame videoFrame(inData.data(), 0, 0, nullptr);
+
+			// Every copy level must reproduce the frame exactly
+			for (SimdLevel simdLevel : { SimdLevel::SCALAR, SimdLevel::SSSE3, SimdLevel::AVX2, SimdLevel::AVX512 })
+			{
+				if (simdLevel > CpuSimdLevel())
+					break;
+
+				CNoopVideoFrameFormatter vff(simdLevel);
+				vff.OnVideoState(vs);
+				Assert::IsTrue(vff.GetSimdLevel() == simdLevel);
+				Assert::AreEqual((LONG)vs->BytesPerFrame(), vff.GetOutFrameSize());
+
+				std::vector<BYTE> actual(vff.GetOutFrameSize());
+				Assert::IsTrue(vff.FormatVideoFrame(videoFrame, actual.data()));
+
+				Assert::IsTrue(memcmp(actual.data(), inData.data(), actual.size()) == 0);
+			}
+		}
+
 		TEST_METHOD(CV210toP010VideoFrameFormatterTest)
 		{
 			CV210toP010VideoFrameFormatter vff;
@@ -45,6 +111,85 @@ namespace Tests
 			Assert::AreEqual(6220800L, vff.GetOutFrameSize());
 		}
 
+		TEST_METHOD(CV210toP010VideoFrameFormatterSimdTest)
+		{
+			VideoStateComPtr vs = new VideoState();
+			vs->valid = true;
+			vs->displayMode = std::make_shared<DisplayMode>(1920, 1080, false /* interlaced */, 24000, 1000);
+			vs->videoFrameEncoding = VideoFrameEncoding::V210;
+
+			std::vector<uint32_t> inData(vs->BytesPerFrame() / sizeof(uint32_t));
+			std::mt19937 rng(1234);
+			for (uint32_t& v : inData)
+				v = rng();
+
+			const VideoFrame videoFrame(inData.data(), 0, 0, nullptr);
+
+			for (ChromaSiting chromaSiting : { ChromaSiting::LEFT, ChromaSiting::TOP_LEFT })
+			{
+				CV210toP010VideoFrameFormatter scalarVff(chromaSiting, SimdLevel::SCALAR);
+				scalarVff.OnVideoState(vs);
+
+				std::vector<BYTE> expected(scalarVff.GetOutFrameSize());
+				Assert::IsTrue(scalarVff.FormatVideoFrame(videoFrame, expected.data()));
+
+				// Every level up to what this CPU can do must be bit-identical to scalar
+				for (SimdLevel simdLevel : { SimdLevel::SSSE3, SimdLevel::AVX2, SimdLevel::AVX512 })
+				{
+					if (simdLevel > CpuSimdLevel())
+						break;
+
+					CV210toP010VideoFrameFormatter vff(chromaSiting, simdLevel);
+					vff.OnVideoState(vs);
+					Assert::IsTrue(vff.GetSimdLevel() == simdLevel);
+
+					std::vector<BYTE> actual(vff.GetOutFrameSize());
+					Assert::IsTrue(vff.FormatVideoFrame(videoFrame, actual.data()));
+
+					Assert::IsTrue(expected == actual, ToString(simdLevel));
+				}
+			}
+		}
+
+		TEST_METHOD(CV210toP010VideoFrameFormatterChromaFilterTest)
+		{
+			VideoStateComPtr vs = new VideoState();
+			vs->valid = true;
+			vs->displayMode = std::make_shared<DisplayMode>(1920, 1080, false /* interlaced */, 24000, 1000);
+			vs->videoFrameEncoding = VideoFrameEncoding::V210;
+
+			// Every line has chroma 4 * line number, luma is irrelevant
+			const uint32_t stride = vs->BytesPerRow() / sizeof(uint32_t);
+			std::vector<uint32_t> inData(vs->BytesPerFrame() / sizeof(uint32_t));
+			for (uint32_t line = 0; line < 1080; line++)
+			{
+				const uint32_t c = (4 * line) % 1024;
+				for (uint32_t i = 0; i < stride; i++)
+					inData[line * stride + i] = c | (c << 10) | (c << 20);
+			}
+
+			const VideoFrame videoFrame(inData.data(), 0, 0, nullptr);
+			const uint32_t uvOffset = 1920 * 1080;
+
+			// Left: average of both lines of the pair
+			CV210toP010VideoFrameFormatter leftVff(ChromaSiting::LEFT);
+			leftVff.OnVideoState(vs);
+			std::vector<uint16_t> leftOut(leftVff.GetOutFrameSize() / sizeof(uint16_t));
+			Assert::IsTrue(leftVff.FormatVideoFrame(videoFrame, (BYTE*)leftOut.data()));
+
+			Assert::AreEqual((uint16_t)(2 << 6), leftOut[uvOffset]);  // (0 + 4) / 2
+			Assert::AreEqual((uint16_t)(10 << 6), leftOut[uvOffset + 1920]);  // (8 + 12) / 2
+
+			// Top-left: [1 2 1] centered on the top line, repeated edge
+			CV210toP010VideoFrameFormatter topLeftVff(ChromaSiting::TOP_LEFT);
+			topLeftVff.OnVideoState(vs);
+			std::vector<uint16_t> topLeftOut(topLeftVff.GetOutFrameSize() / sizeof(uint16_t));
+			Assert::IsTrue(topLeftVff.FormatVideoFrame(videoFrame, (BYTE*)topLeftOut.data()));
+
+			Assert::AreEqual((uint16_t)(1 << 6), topLeftOut[uvOffset]);  // (0 + 0 + 4 + 2) / 4
+			Assert::AreEqual((uint16_t)(8 << 6), topLeftOut[uvOffset + 1920]);  // (4 + 16 + 12 + 2) / 4
+		}
+
 		TEST_METHOD(CV210toP210VideoFrameFormatterTest)
 		{
 			CV210toP210VideoFrameFormatter vff;
@@ -60,6 +205,241 @@ namespace Tests
 			Assert::AreEqual(8294400L, vff.GetOutFrameSize());
 		}
 
+		TEST_METHOD(CV210toP210VideoFrameFormatterSimdTest)
+		{
+			VideoStateComPtr vs = new VideoState();
+			vs->valid = true;
+			vs->displayMode = std::make_shared<DisplayMode>(1920, 1080, false /* interlaced */, 24000, 1000);
+			vs->videoFrameEncoding = VideoFrameEncoding::V210;
+
+			std::vector<uint32_t> inData(vs->BytesPerFrame() / sizeof(uint32_t));
+			std::mt19937 rng(1234);
+			for (uint32_t& v : inData)
+				v = rng();
+
+			const VideoFrame videoFrame(inData.data(), 0, 0, nullptr);
+
+			CV210toP210VideoFrameFormatter scalarVff(SimdLevel::SCALAR);
+			scalarVff.OnVideoState(vs);
+			Assert::IsTrue(scalarVff.GetSimdLevel() == SimdLevel::SCALAR);
+
+			std::vector<BYTE> expected(scalarVff.GetOutFrameSize());
+			Assert::IsTrue(scalarVff.FormatVideoFrame(videoFrame, expected.data()));
+
+			// Every level up to what this CPU can do must be bit-identical to scalar
+			for (SimdLevel simdLevel : { SimdLevel::SSSE3, SimdLevel::AVX2, SimdLevel::AVX512 })
+			{
+				if (simdLevel > CpuSimdLevel())
+					break;
+
+				CV210toP210VideoFrameFormatter vff(simdLevel);
+				vff.OnVideoState(vs);
+				Assert::IsTrue(vff.GetSimdLevel() == simdLevel);
+
+				std::vector<BYTE> actual(vff.GetOutFrameSize());
+				Assert::IsTrue(vff.FormatVideoFrame(videoFrame, actual.data()));
+
+				Assert::IsTrue(expected == actual, ToString(simdLevel));
+			}
+		}
+
+		TEST_METHOD(CSlicedVideoFrameFormatterTest)
+		{
+			VideoStateComPtr vs = new VideoState();
+			vs->valid = true;
+			vs->displayMode = std::make_shared<DisplayMode>(1920, 1080, false /* interlaced */, 24000, 1000);
+			vs->videoFrameEncoding = VideoFrameEncoding::V210;
+
+			std::vector<uint32_t> inData(vs->BytesPerFrame() / sizeof(uint32_t));
+			std::mt19937 rng(1234);
+			for (uint32_t& v : inData)
+				v = rng();
+
+			const VideoFrame videoFrame(inData.data(), 0, 0, nullptr);
+
+			// Top-left siting reads the line above each slice, so this also covers the slice edges
+			const std::vector<std::function<IVideoFrameFormatter*()>> factories = {
+				[] { return new CNoopVideoFrameFormatter(); },
+				[] { return new CV210toP210VideoFrameFormatter(); },
+				[] { return new CV210toP010VideoFrameFormatter(ChromaSiting::TOP_LEFT); }
+			};
+
+			for (const auto& factory : factories)
+			{
+				IVideoFrameFormatter* unslicedVff = factory();
+				unslicedVff->OnVideoState(vs);
+
+				std::vector<BYTE> expected(unslicedVff->GetOutFrameSize());
+				Assert::IsTrue(unslicedVff->FormatVideoFrame(videoFrame, expected.data()));
+				delete unslicedVff;
+
+				for (unsigned int sliceCount : { 1, 2, 3, 7 })
+				{
+					CSlicedVideoFrameFormatter vff(factory(), sliceCount);
+					vff.OnVideoState(vs);
+					Assert::AreEqual(sliceCount, vff.GetActiveSliceCount());
+
+					std::vector<BYTE> actual(vff.GetOutFrameSize());
+					for (int i = 0; i < 3; ++i)
+						Assert::IsTrue(vff.FormatVideoFrame(videoFrame, actual.data()));
+
+					Assert::IsTrue(expected == actual);
+					Assert::AreEqual((size_t)sliceCount, vff.GetSliceTimingsMs().size());
+				}
+			}
+		}
+
+		TEST_METHOD(CSlicedVideoFrameFormatterExceptionTest)
+		{
+			VideoStateComPtr vs = new VideoState();
+			vs->valid = true;
+			vs->displayMode = std::make_shared<DisplayMode>(1920, 1080, false /* interlaced */, 24000, 1000);
+			vs->videoFrameEncoding = VideoFrameEncoding::V210;
+
+			BYTE data = 0;
+			const VideoFrame videoFrame(&data, 0, 0, nullptr);
+
+			FailingSliceVideoFrameFormatter* failingVff = new FailingSliceVideoFrameFormatter();
+			CSlicedVideoFrameFormatter vff(failingVff, 4);
+			vff.OnVideoState(vs);
+
+			// All slices throw, one gets rethrown
+			bool thrown = false;
+			try
+			{
+				vff.FormatVideoFrame(videoFrame, &data);
+			}
+			catch (std::runtime_error&)
+			{
+				thrown = true;
+			}
+
+			Assert::IsTrue(thrown);
+
+			// The other slices' exceptions must not fail the next frame
+			failingVff->failing = false;
+			Assert::IsTrue(vff.FormatVideoFrame(videoFrame, &data));
+		}
+
+		TEST_METHOD(CRGBtoRGB48VideoFrameFormatterTest)
+		{
+			VideoStateComPtr vs = new VideoState();
+			vs->valid = true;
+			vs->displayMode = std::make_shared<DisplayMode>(1920, 1080, false /* interlaced */, 24000, 1000);
+			vs->videoFrameEncoding = VideoFrameEncoding::R210;
+
+			// r210 is big-endian xx R G B, only the first line is set: R = 1023, G = 512, B = 0
+			std::vector<uint32_t> inData(vs->BytesPerFrame() / sizeof(uint32_t), 0);
+			for (uint32_t i = 0; i < 1920; i++)
+				inData[i] = _byteswap_ulong((0x3FF << 20) | (0x200 << 10));
+
+			const VideoFrame videoFrame(inData.data(), 0, 0, nullptr);
+			const uint32_t lastLineOffset = 1079 * 1920 * 3;
+
+			CRGBtoRGB48VideoFrameFormatter vff;
+			vff.OnVideoState(vs);
+			Assert::AreEqual(12441600L, vff.GetOutFrameSize());
+
+			std::vector<uint16_t> out(vff.GetOutFrameSize() / sizeof(uint16_t));
+			Assert::IsTrue(vff.FormatVideoFrame(videoFrame, (BYTE*)out.data()));
+
+			Assert::AreEqual((uint16_t)0xFFFF, out[0]);
+			Assert::AreEqual((uint16_t)0x8020, out[1]);  // Bit replicated
+			Assert::AreEqual((uint16_t)0x0000, out[2]);
+			Assert::AreEqual((uint16_t)0x0000, out[lastLineOffset]);
+		}
+
+		TEST_METHOD(CRGBtoRGB48VideoFrameFormatterRGB12Test)
+		{
+			for (VideoFrameEncoding videoFrameEncoding : { VideoFrameEncoding::R12B, VideoFrameEncoding::R12L })
+			{
+				VideoStateComPtr vs = new VideoState();
+				vs->valid = true;
+				vs->displayMode = std::make_shared<DisplayMode>(1920, 1080, false /* interlaced */, 24000, 1000);
+				vs->videoFrameEncoding = videoFrameEncoding;
+
+				// Every block of 8 pixels is 9 words holding 24 values R0 G0 B0 R1 ... B7, value n
+				// at bits 12n to 12n+11 counted from the lowest bit of the first word. R12B stores
+				// the words big-endian like DPX, R12L little-endian.
+				// Only the first line is set, every value differs.
+				std::vector<uint32_t> inData(vs->BytesPerFrame() / sizeof(uint32_t), 0);
+				std::vector<uint16_t> values(1920 * 3);
+				for (uint32_t block = 0; block < 1920 / 8; block++)
+				{
+					uint32_t words[9] = {};
+					for (uint32_t n = 0; n < 24; n++)
+					{
+						const uint16_t value = ((block * 24 + n) * 0x9D + 0x123) & 0xFFF;
+						values[block * 24 + n] = value;
+
+						const uint32_t bit = n * 12;
+						words[bit / 32] |= (uint32_t)value << (bit % 32);
+						if (bit % 32 > 20)
+							words[bit / 32 + 1] |= (uint32_t)value >> (32 - bit % 32);
+					}
+
+					for (uint32_t i = 0; i < 9; i++)
+						inData[block * 9 + i] = (videoFrameEncoding == VideoFrameEncoding::R12B) ? _byteswap_ulong(words[i]) : words[i];
+				}
+
+				const VideoFrame videoFrame(inData.data(), 0, 0, nullptr);
+
+				CRGBtoRGB48VideoFrameFormatter vff;
+				vff.OnVideoState(vs);
+
+				std::vector<uint16_t> out(vff.GetOutFrameSize() / sizeof(uint16_t));
+				Assert::IsTrue(vff.FormatVideoFrame(videoFrame, (BYTE*)out.data()));
+
+				// 12 bits widened to 16 with the top bits replicated
+				for (size_t i = 0; i < values.size(); i++)
+					Assert::AreEqual((uint16_t)((values[i] << 4) | (values[i] >> 8)), out[i], ToString(videoFrameEncoding));
+
+				Assert::AreEqual((uint16_t)0x0000, out[values.size()]);
+			}
+		}
+
+		TEST_METHOD(CRGBtoRGB48VideoFrameFormatterSimdTest)
+		{
+			for (VideoFrameEncoding videoFrameEncoding : {
+				VideoFrameEncoding::R210, VideoFrameEncoding::R10b, VideoFrameEncoding::R10l,
+				VideoFrameEncoding::R12B, VideoFrameEncoding::R12L })
+			{
+				VideoStateComPtr vs = new VideoState();
+				vs->valid = true;
+				vs->displayMode = std::make_shared<DisplayMode>(1920, 1080, false /* interlaced */, 24000, 1000);
+				vs->videoFrameEncoding = videoFrameEncoding;
+
+				std::vector<uint32_t> inData(vs->BytesPerFrame() / sizeof(uint32_t));
+				std::mt19937 rng(1234);
+				for (uint32_t& v : inData)
+					v = rng();
+
+				const VideoFrame videoFrame(inData.data(), 0, 0, nullptr);
+
+				CRGBtoRGB48VideoFrameFormatter scalarVff(SimdLevel::SCALAR);
+				scalarVff.OnVideoState(vs);
+
+				std::vector<BYTE> expected(scalarVff.GetOutFrameSize());
+				Assert::IsTrue(scalarVff.FormatVideoFrame(videoFrame, expected.data()));
+
+				// Every level up to what this CPU can do must be bit-identical to scalar
+				for (SimdLevel simdLevel : { SimdLevel::SSSE3, SimdLevel::AVX2, SimdLevel::AVX512 })
+				{
+					if (simdLevel > CpuSimdLevel())
+						break;
+
+					CRGBtoRGB48VideoFrameFormatter vff(simdLevel);
+					vff.OnVideoState(vs);
+					Assert::IsTrue(vff.GetSimdLevel() == simdLevel);
+
+					std::vector<BYTE> actual(vff.GetOutFrameSize());
+					Assert::IsTrue(vff.FormatVideoFrame(videoFrame, actual.data()));
+
+					Assert::IsTrue(expected == actual, ToString(videoFrameEncoding));
+				}
+			}
+		}
+
 		TEST_METHOD(CFFMpegDecoderVideoFrameFormatterR210RGB48LETest)
 		{
 			CFFMpegDecoderVideoFrameFormatter vff(
@@ -93,5 +473,38 @@ namespace Tests
 
 			Assert::AreEqual(12441600L, vff.GetOutFrameSize());
 		}
+
+		TEST_METHOD(CFFMpegDecoderVideoFrameFormatterDirectOutputTest)
+		{
+			VideoStateComPtr vs = new VideoState();
+			vs->valid = true;
+			vs->displayMode = std::make_shared<DisplayMode>(1920, 1080, false /* interlaced */, 24000, 1000);
+			vs->videoFrameEncoding = VideoFrameEncoding::R210;
+
+			std::vector<uint32_t> inData(vs->BytesPerFrame() / sizeof(uint32_t));
+			std::mt19937 rng(1234);
+			for (uint32_t& v : inData)
+				v = rng() & 0x3FFFFFFF;
+
+			const VideoFrame videoFrame(inData.data(), 0, 0, nullptr);
+
+			CFFMpegDecoderVideoFrameFormatter vff(
+				AV_CODEC_ID_R210,
+				AV_PIX_FMT_RGB48LE);
+			vff.OnVideoState(vs);
+
+			// Aligned output is scaled into directly, one byte off forces the intermediate frame
+			std::vector<BYTE> storage(vff.GetOutFrameSize() * 2 + 32);
+			BYTE* const alignedOut = storage.data() + (16 - reinterpret_cast<uintptr_t>(storage.data()) % 16);
+			BYTE* const unalignedOut = alignedOut + vff.GetOutFrameSize() + 1;
+
+			Assert::IsTrue(vff.FormatVideoFrame(videoFrame, alignedOut));
+			Assert::AreEqual(0ULL, (unsigned long long)vff.GetIndirectFrameCount());
+
+			Assert::IsTrue(vff.FormatVideoFrame(videoFrame, unalignedOut));
+			Assert::AreEqual(1ULL, (unsigned long long)vff.GetIndirectFrameCount());
+
+			Assert::IsTrue(memcmp(alignedOut, unalignedOut, vff.GetOutFrameSize()) == 0);
+		}
 	};
 }
@@ -0,0 +1,114 @@
+/*
+ * Copyright(C) 2021 Dennis Fleurbaaij <mail@dennisfleurbaaij.com>
+ *
+ * This program is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, version 3.
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License along with this program. If not, see < https://www.gnu.org/licenses/>.
+ */
+
+
+
+#include "pch.h"
+#include "CppUnitTest.h"
+
+#include <utility>
+
+#include <VideoFrameHandle.h>
+
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace Tests
+{
+	// Source buffer with a plain reference count which starts at zero
+	class RefCountedSourceBuffer:
+		public IUnknown
+	{
+	public:
+		std::atomic<ULONG> refCount = 0;
+
+		HRESULT	QueryInterface(REFIID, LPVOID*) override { return E_NOINTERFACE; }
+		ULONG AddRef() override { return ++refCount; }
+		ULONG Release() override { return --refCount; }
+	};
+
+
+	TEST_CLASS(VideoFrameHandleTests)
+	{
+	public:
+
+		TEST_METHOD(VideoFrameHandleMoveTest)
+		{
+			RefCountedSourceBuffer buffer;
+			const BYTE data = 0;
+
+			{
+				VideoFrameHandle first(VideoFrame(&data, 7, 100, &buffer));
+				Assert::AreEqual((ULONG)1, (ULONG)buffer.refCount);
+
+				// Moves hand the reference over
+				VideoFrameHandle second(std::move(first));
+				VideoFrameHandle third;
+				third = std::move(second);
+
+				Assert::IsFalse((bool)first);
+				Assert::IsFalse((bool)second);
+				Assert::IsTrue((bool)third);
+				Assert::AreEqual((uint64_t)7, third->GetCounter());
+				Assert::AreEqual((ULONG)1, (ULONG)buffer.refCount);
+			}
+
+			Assert::AreEqual((ULONG)0, (ULONG)buffer.refCount);
+		}
+
+		TEST_METHOD(VideoFrameHandleShareTest)
+		{
+			RefCountedSourceBuffer buffer;
+			const BYTE data = 0;
+
+			VideoFrameHandle first(VideoFrame(&data, 0, 100, &buffer));
+			VideoFrameHandle second = first.Share();
+			Assert::AreEqual((ULONG)2, (ULONG)buffer.refCount);
+			Assert::AreEqual(first->GetData(), second->GetData());
+
+			first.Reset();
+			Assert::AreEqual((ULONG)1, (ULONG)buffer.refCount);
+
+			// Assigning over a handle releases what it held
+			RefCountedSourceBuffer otherBuffer;
+			second = VideoFrameHandle(VideoFrame(&data, 1, 200, &otherBuffer));
+			Assert::AreEqual((ULONG)0, (ULONG)buffer.refCount);
+			Assert::AreEqual((ULONG)1, (ULONG)otherBuffer.refCount);
+		}
+
+		TEST_METHOD(VideoFrameHandleAdoptDetachTest)
+		{
+			RefCountedSourceBuffer buffer;
+			const BYTE data = 0;
+
+			// Like a freshly acquired pool buffer, the reference is there already
+			buffer.AddRef();
+
+			VideoFrameHandle videoFrame = VideoFrameHandle::Adopt(VideoFrame(&data, 0, 100, &buffer));
+			Assert::AreEqual((ULONG)1, (ULONG)buffer.refCount);
+
+			const VideoFrame detachedFrame = videoFrame.Detach();
+			Assert::IsFalse((bool)videoFrame);
+			Assert::AreEqual((ULONG)1, (ULONG)buffer.refCount);
+
+			VideoFrameHandle::Adopt(detachedFrame).Reset();
+			Assert::AreEqual((ULONG)0, (ULONG)buffer.refCount);
+		}
+
+		TEST_METHOD(VideoFrameHandleNoSourceBufferTest)
+		{
+			const BYTE data = 0;
+
+			VideoFrameHandle videoFrame(VideoFrame(&data, 0, 100, nullptr));
+			VideoFrameHandle sharedFrame = videoFrame.Share();
+
+			Assert::IsTrue((bool)sharedFrame);
+			Assert::AreEqual((const void*)&data, sharedFrame->GetData());
+		}
+	};
+}
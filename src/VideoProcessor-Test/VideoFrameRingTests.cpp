@@ -0,0 +1,179 @@
+/*
+ * Copyright(C) 2021 Dennis Fleurbaaij <mail@dennisfleurbaaij.com>
+ *
+ * This program is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, version 3.
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License along with this program. If not, see < https://www.gnu.org/licenses/>.
+ */
+
+
+#include "pch.h"
+#include "CppUnitTest.h"
+
+#include <thread>
+#include <vector>
+
+#include <microsoft_directshow/live_source_filter/CVideoFrameRing.h>
+
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace Tests
+{
+	// Source buffer which counts releases, every frame has its own so release always reports 0
+	class CountingSourceBuffer:
+		public IUnknown
+	{
+	public:
+		std::atomic<int> releaseCount = 0;
+
+		HRESULT	QueryInterface(REFIID, LPVOID*) override { return E_NOINTERFACE; }
+		ULONG AddRef() override { return 1; }
+		ULONG Release() override { ++releaseCount; return 0; }
+	};
+
+
+	TEST_CLASS(VideoFrameRingTests)
+	{
+	public:
+
+		TEST_METHOD(CVideoFrameRingDropOldestTest)
+		{
+			CVideoFrameRing ring;
+			std::vector<CountingSourceBuffer> buffers(5);
+			const BYTE data = 0;
+
+			for (int i = 0; i < 5; i++)
+				Assert::AreEqual(i < 3 ? 0u : 1u, ring.Push(VideoFrameHandle::Adopt(VideoFrame(&data, i, 100 + i, &buffers[i])), 3));
+
+			Assert::AreEqual(3u, ring.Size());
+			Assert::AreEqual(1, (int)buffers[0].releaseCount);
+			Assert::AreEqual(1, (int)buffers[1].releaseCount);
+
+			VideoFrameHandle videoFrame;
+			bool hasNextFrame = false;
+			timingclocktime_t nextFrameTimestamp = 0;
+
+			Assert::IsTrue(ring.Pop(videoFrame, 1, hasNextFrame, nextFrameTimestamp));
+			Assert::AreEqual((uint64_t)2, videoFrame->GetCounter());
+			Assert::IsTrue(hasNextFrame);
+			Assert::AreEqual((timingclocktime_t)103, nextFrameTimestamp);
+
+			// Popped frames are owned by the caller, purged ones released by the ring
+			Assert::AreEqual(0, (int)buffers[2].releaseCount);
+			videoFrame.Reset();
+			Assert::AreEqual(1, (int)buffers[2].releaseCount);
+			Assert::AreEqual(2u, ring.Purge());
+			Assert::AreEqual(1, (int)buffers[3].releaseCount);
+			Assert::AreEqual(1, (int)buffers[4].releaseCount);
+			Assert::AreEqual(0u, ring.Size());
+		}
+
+		TEST_METHOD(CVideoFrameRingDropNonMonotonicTest)
+		{
+			CVideoFrameRing ring;
+			std::vector<CountingSourceBuffer> buffers(4);
+			const BYTE data = 0;
+
+			// A frame which is not younger than the queued ones replaces all of those
+			Assert::AreEqual(0u, ring.Push(VideoFrameHandle::Adopt(VideoFrame(&data, 0, 100, &buffers[0])), 8));
+			Assert::AreEqual(0u, ring.Push(VideoFrameHandle::Adopt(VideoFrame(&data, 1, 200, &buffers[1])), 8));
+			Assert::AreEqual(0u, ring.Push(VideoFrameHandle::Adopt(VideoFrame(&data, 2, 300, &buffers[2])), 8));
+			Assert::AreEqual(2u, ring.Push(VideoFrameHandle::Adopt(VideoFrame(&data, 3, 200, &buffers[3])), 8));
+
+			Assert::AreEqual(2u, ring.Size());
+			Assert::AreEqual(1, (int)buffers[1].releaseCount);
+			Assert::AreEqual(1, (int)buffers[2].releaseCount);
+
+			// Clock-clock needs two frames queued to pop
+			VideoFrameHandle videoFrame;
+			bool hasNextFrame = false;
+			timingclocktime_t nextFrameTimestamp = 0;
+
+			Assert::IsTrue(ring.Pop(videoFrame, 2, hasNextFrame, nextFrameTimestamp));
+			Assert::AreEqual((uint64_t)0, videoFrame->GetCounter());
+			Assert::AreEqual((timingclocktime_t)200, nextFrameTimestamp);
+			Assert::IsFalse(ring.Pop(videoFrame, 2, hasNextFrame, nextFrameTimestamp));
+
+			Assert::IsTrue(ring.Pop(videoFrame, 1, hasNextFrame, nextFrameTimestamp));
+			Assert::AreEqual((uint64_t)3, videoFrame->GetCounter());
+			Assert::IsFalse(hasNextFrame);
+		}
+
+		TEST_METHOD(CVideoFrameRingDropReasonTest)
+		{
+			CVideoFrameRing ring;
+			std::vector<CountingSourceBuffer> buffers(4);
+			const BYTE data = 0;
+			uint32_t reorderedFrameCount = 99;
+
+			Assert::AreEqual(0u, ring.Push(VideoFrameHandle::Adopt(VideoFrame(&data, 0, 100, &buffers[0])), 2, &reorderedFrameCount));
+			Assert::AreEqual(0u, reorderedFrameCount);
+			Assert::AreEqual(0u, ring.Push(VideoFrameHandle::Adopt(VideoFrame(&data, 1, 200, &buffers[1])), 2, &reorderedFrameCount));
+
+			// Full, the oldest goes
+			Assert::AreEqual(1u, ring.Push(VideoFrameHandle::Adopt(VideoFrame(&data, 2, 300, &buffers[2])), 2, &reorderedFrameCount));
+			Assert::AreEqual(0u, reorderedFrameCount);
+
+			// Replaces the newest queued one, which leaves room for it
+			Assert::AreEqual(1u, ring.Push(VideoFrameHandle::Adopt(VideoFrame(&data, 3, 250, &buffers[3])), 2, &reorderedFrameCount));
+			Assert::AreEqual(1u, reorderedFrameCount);
+
+			Assert::AreEqual(1, (int)buffers[0].releaseCount);
+			Assert::AreEqual(1, (int)buffers[2].releaseCount);
+			Assert::AreEqual(2u, ring.Purge());
+		}
+
+		TEST_METHOD(CVideoFrameRingConcurrencyTest)
+		{
+			// Every frame must be released exactly once, either by the ring or by the consumer which
+			// popped it, and the consumer must get them in the order they were pushed.
+			const int frameCount = 200000;
+
+			CVideoFrameRing ring;
+			std::vector<CountingSourceBuffer> buffers(frameCount);
+			std::vector<int> popCount(frameCount, 0);
+			const BYTE data = 0;
+
+			std::atomic<bool> producerDone = false;
+			bool consumerOrdered = true;
+
+			std::thread consumer([&]()
+			{
+				int64_t lastCounter = -1;
+				VideoFrameHandle videoFrame;
+				bool hasNextFrame;
+				timingclocktime_t nextFrameTimestamp;
+
+				while (!producerDone || ring.Size() > 0)
+				{
+					if (!ring.Pop(videoFrame, 1, hasNextFrame, nextFrameTimestamp))
+						continue;
+
+					if ((int64_t)videoFrame->GetCounter() <= lastCounter)
+						consumerOrdered = false;
+					lastCounter = (int64_t)videoFrame->GetCounter();
+
+					++popCount[videoFrame->GetCounter()];
+				}
+			});
+
+			// Every 7th frame jumps back in time
+			for (int i = 0; i < frameCount; i++)
+			{
+				const timingclocktime_t timestamp = (i % 7 == 6) ? (i * 10 - 25) : (i * 10);
+				ring.Push(VideoFrameHandle::Adopt(VideoFrame(&data, i, timestamp, &buffers[i])), 4);
+			}
+
+			producerDone = true;
+			consumer.join();
+
+			Assert::IsTrue(consumerOrdered);
+			for (int i = 0; i < frameCount; i++)
+			{
+				Assert::IsTrue(popCount[i] <= 1);
+				Assert::AreEqual(1, (int)buffers[i].releaseCount);
+			}
+		}
+	};
+}